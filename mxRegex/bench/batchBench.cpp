@@ -0,0 +1,114 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// MxRegex_batch() scaling benchmark, 1..n threads
+// HTTP request line regex on synthetic access log records.
+//
+// usage: batchBench [recordNum [maxThreadNum]]
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../mxRegexBatch.h"
+
+
+
+int main(int argc, char** argv)
+{
+    static const char* const C_METHOD[] = { "GET", "POST", "PUT", "get" };
+
+    std::vector<std::string> record;
+    std::vector<const char*> strP;
+    std::vector<BATCH_RESULT> res;
+    std::vector<BATCH_RESULT> resRef;
+    REGEXPROG prog;
+    UInt32 recordNum;
+    UInt32 matchNum;
+    UInt32 matchNumRef;
+    UInt16 threadNum;
+    UInt16 t;
+    UInt32 t1;
+    char buf[256];
+    double ms;
+    double msRef;
+
+    recordNum = argc > 1 ? (UInt32)atol(argv[1]) : 200000;
+    threadNum = argc > 2 ? (UInt16)atoi(argv[2]) : (UInt16)std::thread::hardware_concurrency();
+    if (threadNum == 0)
+        threadNum = 1;
+
+    MxRegex_init();
+
+    if (MxRegex_compile("^\\s*(GET|POST)\\s+(\\S+)\\s+HTTP/(\\d)\\.(\\d)", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE, &prog) != REGEXSTS_OK)
+    {
+        printf("compile error %d\n", prog.retSts);
+        return 1;
+    }
+
+    // synthetic records, about 3/4 match
+
+    srand(1);
+    for (t1 = 0; t1 < recordNum; t1++)
+    {
+        snprintf(buf, sizeof(buf), " %s /static/img%u/page%u.html HTTP/1.%u\r\n", C_METHOD[rand() % 4], (unsigned)(rand() % 1000), (unsigned)t1, (unsigned)(rand() % 2));
+        record.push_back(buf);
+    }
+    for (t1 = 0; t1 < recordNum; t1++)
+        strP.push_back(record[t1].c_str());
+
+    res.resize(recordNum);
+    resRef.resize(recordNum);
+
+    printf("records: %u\n", (unsigned)recordNum);
+    printf("threads        ms   Mrec/s  speedup\n");
+
+    msRef = 0;
+    matchNumRef = 0;
+
+    for (t = 1; t <= threadNum; t++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        matchNum = MxRegex_batch(&prog, strP.data(), recordNum, t == 1 ? resRef.data() : res.data(), t);
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (t == 1)
+        {
+            msRef = ms;
+            matchNumRef = matchNum;
+        }
+        else if (matchNum != matchNumRef || memcmp(res.data(), resRef.data(), recordNum * sizeof(BATCH_RESULT)) != 0)
+        {
+            printf("%7u results differ from 1 thread\n", (unsigned)t);
+            return 1;
+        }
+
+        printf("%7u %9.1f %8.2f %8.2f\n", (unsigned)t, ms, recordNum / ms / 1000.0, msRef / ms);
+    }
+
+    printf("matching records: %u\n", (unsigned)matchNumRef);
+    return 0;
+}
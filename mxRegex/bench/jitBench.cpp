@@ -0,0 +1,307 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+// MxRegex_jit() benchmark and differential check.
+// Regex with REGEXMODE_JIT run past JIT_HOT: same result before and after promotion to native code.
+// Random regex (JIT subset and not) on random str: all matches of native code compared with the interpreter,
+// the Pike VM (REGEXMODE_LINEAR) result is printed too, to tell which one deviates from leftmost first.
+// Exit 1 on any difference of native code and interpreter, or of results on promotion.
+// Then interpreted / native timing of some hot regex.
+//
+// usage: jitBench [regexNum [loopNum]]
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../mxRegex.h"
+
+
+
+#if MXREGEX_JIT
+
+
+
+#define FIND_MAX 10                                 // matches compared on each str
+#define STR_NUM 8                                   // random str of each regex
+#define STR_MAX_LEN 30
+
+
+
+// timing case
+
+typedef struct
+{
+    const char* name;
+    const char* regex;
+    std::string str;
+    UInt16 mode;
+
+} JIT_CASE;
+
+
+
+
+// all matches (max FIND_MAX) of str as a printable list
+// parm: prog, str
+// ret: matches, caps of each one
+
+static std::string Bench_find(const REGEXPROG* progP, const std::string& str)
+{
+    static MXREGEX_M m;                                     // zero initialized
+    REGEXITER it;
+    REGEXSPAN caps[MAX_CAPS];
+    std::string res;
+    char buf[48];
+    UInt8 capsNum;
+    UInt8 c;
+    int f;
+
+    MxRegex_findBegin(&it, progP, str.c_str(), str.size(), caps);
+    for (f = 0; f < FIND_MAX && (capsNum = MxRegex_findNext(&m, &it)) != 0; f++)
+    {
+        for (c = 0; c < capsNum; c++)
+        {
+            snprintf(buf, sizeof(buf), "%c(%u,%u)", c == 0 ? ' ' : ',', (unsigned)caps[c].ofs, (unsigned)caps[c].len);
+            res += buf;
+        }
+    }
+
+    return res;
+}
+
+
+
+
+// promotion check: each regex run 2 * JIT_HOT times, results must not change on promotion to native code
+// ret: nr of regex whose result changed
+
+static UInt32 Bench_hot()
+{
+    static const char* const C_HOT[][2] = {
+        { "^[ab]?[^a]|c", "baaxxbcaxa" },
+        { ".{2,}b", " b 1c" },
+        { "(\\w+)@(\\w+)\\.com", "mail to user@example.com" },
+        { "(ab|a)b*c", "abbc ac" } };
+
+    REGEXPROG prog;
+    std::string res0;
+    UInt32 errNum;
+    UInt32 l;
+    UInt8 t1;
+
+    errNum = 0;
+    for (t1 = 0; t1 < sizeof(C_HOT) / sizeof(C_HOT[0]); t1++)
+    {
+        MxRegex_compile(C_HOT[t1][0], REGEXMODE_JIT, &prog);
+        res0 = Bench_find(&prog, C_HOT[t1][1]);
+        for (l = 1; l < 2 * JIT_HOT; l++)
+        {
+            if (Bench_find(&prog, C_HOT[t1][1]) != res0)
+            {
+                printf("JIT PROMOTION ERROR /%s/ \"%s\" at run %u\n", C_HOT[t1][0], C_HOT[t1][1], (unsigned)l);
+                errNum++;
+                break;
+            }
+        }
+        MxRegex_jitFree(&prog);
+    }
+
+    printf("promotion errors: %u\n", (unsigned)errNum);
+    return errNum;
+}
+
+
+
+
+// differential check of random regex
+// parm: nr of regex
+// ret: nr of native code errors (differs from interpreter)
+
+static UInt32 Bench_diff(const UInt32 regexNum)
+{
+    static const char* const C_ATOM[] = { "a", "b", "ab", "[ab]", ".", "c", "x", "A", "\\d", "\\w", "\\s", "[^a]", "^", "$", "\\b", "\\B",
+        "(a|b)", "(ab|a)", "(a*)", "(b+)", "(?:ba|a)", "(a(b|c)|a)", "(x|)", "(?:(a)|b)", "|" };
+    static const char* const C_QUANT[] = { "", "", "", "*", "+", "?", "{2}", "{1,3}", "{0,2}", "{5}", "{2,}" };
+    static const UInt16 C_MODE[] = { 0, REGEXMODE_CASE_INSENSITIVE, REGEXMODE_MULTILINE, REGEXMODE_SINGLELINE,
+        REGEXMODE_CASE_INSENSITIVE | REGEXMODE_MULTILINE };
+    static const char C_CHAR[] = "abcABx1\n \r_";
+
+    REGEXPROG progInt;
+    REGEXPROG progJit;
+    REGEXPROG progPike;
+    std::string regex;
+    std::string str;
+    std::string resInt;
+    std::string resJit;
+    std::string resPike;
+    UInt32 jitNum;
+    UInt32 runNum;
+    UInt32 errNum;
+    UInt32 r;
+    int s;
+    int k;
+    int len;
+    UInt16 mode;
+    const char* aP;
+
+    srand(1);
+    jitNum = runNum = errNum = 0;
+
+    for (r = 0; r < regexNum; r++)
+    {
+        regex.clear();
+        for (k = 1 + rand() % 6; k > 0; k--)
+        {
+            aP = C_ATOM[rand() % (sizeof(C_ATOM) / sizeof(C_ATOM[0]))];
+            regex += aP;
+            if (aP[0] != '^' && aP[0] != '$' && aP[0] != '|' && !(aP[0] == '\\' && (aP[1] == 'b' || aP[1] == 'B')))
+                regex += C_QUANT[rand() % (sizeof(C_QUANT) / sizeof(C_QUANT[0]))];
+        }
+        mode = C_MODE[rand() % (sizeof(C_MODE) / sizeof(C_MODE[0]))];
+
+        if (MxRegex_compile(regex.c_str(), mode, &progInt) != REGEXSTS_OK)
+            continue;
+        MxRegex_compile(regex.c_str(), mode, &progJit);
+        MxRegex_compile(regex.c_str(), mode | REGEXMODE_LINEAR, &progPike);
+        jitNum += MxRegex_jit(&progJit);
+
+        for (s = 0; s < STR_NUM; s++)
+        {
+            str.clear();
+            for (len = rand() % STR_MAX_LEN; len > 0; len--)
+                str += C_CHAR[rand() % (sizeof(C_CHAR) - 1)];
+
+            resInt = Bench_find(&progInt, str);
+            resJit = Bench_find(&progJit, str);
+            runNum++;
+            if (resInt == resJit)
+                continue;
+
+            resPike = Bench_find(&progPike, str);
+            if (errNum++ < 10)
+                printf("JIT ERROR /%s/ mode %04x str len %u:\n  interpreter%s\n  jit        %s\n  pike vm    %s\n", regex.c_str(), (unsigned)mode,
+                    (unsigned)str.size(), resInt.c_str(), resJit.c_str(), resPike.c_str());
+        }
+
+        MxRegex_jitFree(&progJit);
+    }
+
+    printf("regex: %u, native code: %u, str: %u\n", (unsigned)regexNum, (unsigned)jitNum, (unsigned)runNum);
+    printf("jit errors: %u\n", (unsigned)errNum);
+
+    return errNum;
+}
+
+
+
+
+// interpreted / native timing of one case
+// parm: case, nr of runs
+
+static void Bench_time(const JIT_CASE* cP, const UInt32 loopNum)
+{
+    REGEXPROG prog[2];
+    static MXREGEX_M m;                                     // zero initialized
+    UInt32 matchNum[2];
+    double ms[2];
+    UInt32 l;
+    int v;
+
+    MxRegex_compile(cP->regex, cP->mode, &prog[0]);
+    MxRegex_compile(cP->regex, cP->mode, &prog[1]);
+    if (!MxRegex_jit(&prog[1]))
+    {
+        printf("%-12s not in jit subset\n", cP->name);
+        return;
+    }
+
+    for (v = 0; v < 2; v++)
+    {
+        matchNum[v] = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (l = 0; l < loopNum; l++)
+            matchNum[v] += MxRegex_exec_len_ex(&m, &prog[v], cP->str.c_str(), cP->str.size()) != 0;
+        ms[v] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    printf("%-12s %9.1f %9.1f %8.2f%s\n", cP->name, ms[0], ms[1], ms[0] / ms[1], matchNum[0] != matchNum[1] ? "  (results differ)" : "");
+    MxRegex_jitFree(&prog[1]);
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+    std::vector<JIT_CASE> caseV;
+    std::string text;
+    UInt32 regexNum;
+    UInt32 loopNum;
+    UInt32 errNum;
+    UInt32 t1;
+    char buf[64];
+
+    regexNum = argc > 1 ? (UInt32)atol(argv[1]) : 20000;
+    loopNum = argc > 2 ? (UInt32)atol(argv[2]) : 20000;
+
+    MxRegex_init();
+
+    errNum = Bench_hot();
+    errNum += Bench_diff(regexNum);
+
+    // hot regex, text with the match at the end
+
+    for (t1 = 0; t1 < 20; t1++)
+    {
+        snprintf(buf, sizeof(buf), "user%u at host%u, ", (unsigned)t1, (unsigned)t1);
+        text += buf;
+    }
+
+    caseV.push_back({ "http", "^\\s*(GET|POST)\\s+(\\S+)\\s+HTTP/(\\d)\\.(\\d)", " get /static/img1/page2.html HTTP/1.1\r\n",
+        REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE });
+    caseV.push_back({ "mail", "(\\w+)@(\\w+)\\.com", text + "user@example.com", 0 });
+    caseV.push_back({ "date", "(\\d{4})-(\\d\\d)-(\\d\\d)T(\\d\\d):(\\d\\d)", text + "2022-10-17T12:30", 0 });
+    caseV.push_back({ "key value", "key\\s*=\\s*([a-z_]+|\\d+);", text + "KEY = some_value;", REGEXMODE_CASE_INSENSITIVE });
+
+    printf("\nruns: %u\n", (unsigned)loopNum);
+    printf("case         interp ms    jit ms  speedup\n");
+    for (t1 = 0; t1 < caseV.size(); t1++)
+        Bench_time(&caseV[t1], loopNum);
+
+    return errNum != 0;
+}
+
+
+#else
+
+int main()
+{
+    printf("MXREGEX_JIT is 0\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,330 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+// Regex benchmark: cases of test main() in mxRegex.cpp, and synthetic inputs from 16 bytes to 64K,
+// compared with std::regex on the same cases.
+// Reports ns/match, MB/s and watchdog iterations (MXREGEX_M.iterateCnt) of each case, results also to a JSON file.
+//
+// usage: regexBench [jsonFile [minMs]]
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "../mxRegex.h"
+
+
+
+#define STD_MAX_LEN 4096                            // std::regex is recursive: skipped on longer synthetic input (stack)
+
+
+
+// benchmark case
+
+typedef struct
+{
+    std::string name;
+    std::string regex;
+    std::string str;
+    UInt16 mode;
+
+} BENCH_CASE;
+
+
+
+// benchmark result
+
+typedef struct
+{
+    double ns;                                      // ns for each regex call
+    UInt32 runNum;                                  // nr of regex calls
+    UInt8 capsNum;                                  // result
+    UInt16 iterateCnt;                              // watchdog iterations of last call
+
+} BENCH_RES;
+
+
+
+
+// cases of test main() in mxRegex.cpp
+
+static void Bench_mainCases(std::vector<BENCH_CASE>& caseV)
+{
+    const UInt16 ci = REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE;
+
+    caseV.push_back({ "ip", "^ip\\s*(\\d+(?:\\.\\d+){3})$", "ip 1.12.123.123", ci });
+    caseV.push_back({ "ip multiline", "^ip ((?:\\d+(?:\\.\\d+){3})|(?:[a-z]+(?:\\.[a-z]+){3}))$", "aa\nip a.bb.ccc.d\nbb", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_MULTILINE });
+    caseV.push_back({ "spk", "^SPK\\s*((?:\\s*[+-][VAP])+)$", "spk -v+a-p", ci | REGEXMODE_MULTILINE });
+    caseV.push_back({ "alt anchor", "^123$|^456", "asd\n123\raaa", ci | REGEXMODE_MULTILINE });
+    caseV.push_back({ "email", "^([a-zA-Z0-9._%-]+@[a-zA-Z0-9.-]+\\.[a-zA-Z]{2,6})$", "address.ext@gmail.com", ci });
+    caseV.push_back({ "apn", "^[\\w-.]+(\\.\\w{2,3})$", "apn.vodafone.it", ci });
+    caseV.push_back({ "alt star", "(a.*z|b.*y)*.*", "azbazbyc", ci });
+    caseV.push_back({ "alt caps", "a(b)|c(d)|a(e)f", "aef", ci });
+    caseV.push_back({ "(a|b)*c", "(a|b)*c", "abc", ci });
+    caseV.push_back({ "(a|b)*c|(a|ab)*c", "(a|b)*c|(a|ab)*c", "xc", ci });
+    caseV.push_back({ "alt dot", "(.a|.b).*|.*(.a|.b)", "xa", ci });
+    caseV.push_back({ "a+b+c", "a+b+c", "aabbabc", ci });
+    caseV.push_back({ "charset star", "([abc])*bcd", "abcd", ci });
+    caseV.push_back({ "alt repeat", "(...|aa)*a", "aa", ci });
+    caseV.push_back({ "greedy split", "(a*)(a|aa)", "aaaa", ci });
+    caseV.push_back({ "counted", "(a*)(b{0,1})(b{1,})b{3}", "aaabbbbbbb", ci });
+    caseV.push_back({ "foo bar", "((foo)|(bar))!bas", "foo!bar!bas", ci });
+    caseV.push_back({ "path alt", "^(([^!]+!)?([^!]+)|.+!([^!]+!)([^!]+))$", "foo!bar!bas", ci });
+    caseV.push_back({ "path alt2", "^([^!]+!)?([^!]+)$|^.+!([^!]+!)([^!]+)$", "foo!bar!bas", ci });
+    caseV.push_back({ "empty star", "(.?)*", "x", ci });
+    caseV.push_back({ "aba", "(aba|ab|a)(aba|ab|a)(aba|ab|a)", "ababa", ci });
+    caseV.push_back({ "dot star", ".*(b)", "ab", ci });
+    caseV.push_back({ "dot star 2", "(.*)c(.*)", "abcde", ci });
+    caseV.push_back({ "url", "^(http:\\/\\/www\\.|https:\\/\\/www\\.|http:\\/\\/|https:\\/\\/)?[a-z0-9]+([\\-\\.]{1}[a-z0-9]+)*\\.[a-z]{2,5}(:[0-9]{1,5})?(\\/.*)?$", "https://www.google.com:80", ci });
+    caseV.push_back({ "weeknights", "(wee|week)(knights|night)(s*)", "weeknights", ci });
+    caseV.push_back({ "weeknights 2", "(weeka|wee)(night|knights)", "weeknights", ci });
+    caseV.push_back({ "http", "^\\s*(GET|POST)\\s+(\\S+)\\s+HTTP/(\\d)\\.(\\d)", " GET /index.html HTTP/1.0\r\n\r\n", ci });
+    caseV.push_back({ "fail", "[.]", "a", REGEXMODE_SINGLELINE });
+    caseV.push_back({ "anchor alt", "^[ab]?[^a]|c", "baaxxbcaxa", 0 });
+    caseV.push_back({ "min occ", ".{2,}b", " b 1c", 0 });
+}
+
+
+
+// synthetic inputs, 16 bytes to 64K
+
+static void Bench_syntheticCases(std::vector<BENCH_CASE>& caseV)
+{
+    static const char* const C_WORD[] = { "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit" };
+    std::string text;
+    std::string ab;
+    size_t len;
+
+    srand(1);
+
+    for (len = 16; len <= 65536; len *= 4)
+    {
+        text.clear();                                           // words, match at end of str
+        while (text.size() < len)
+        {
+            text += C_WORD[rand() % 8];
+            text += ' ';
+        }
+        text.resize(len - 16);
+        text += " user@host.com 7";
+
+        ab.assign(len - 1, 'a');                                // (a|b)* family: no match
+        for (size_t t = 1; t < ab.size(); t += 2)
+            ab[t] = 'b';
+        ab += 'x';
+
+        caseV.push_back({ "literal " + std::to_string(len), "host\\.com \\d", text, REGEXMODE_SINGLELINE });
+        caseV.push_back({ "email " + std::to_string(len), "[a-z]+@[a-z]+\\.[a-z]{2,3}", text, REGEXMODE_SINGLELINE });
+        caseV.push_back({ "word span " + std::to_string(len), "^[a-z ]+@", text, REGEXMODE_SINGLELINE });
+        caseV.push_back({ "(a|b)*c " + std::to_string(len), "(a|b)*c", ab, REGEXMODE_SINGLELINE });
+        caseV.push_back({ "(a|b)*c|(a|ab)*c " + std::to_string(len), "(a|b)*c|(a|ab)*c", ab, REGEXMODE_SINGLELINE });
+    }
+}
+
+
+
+// run regex at least minMs
+// ret
+//  0 compile error
+
+static UInt8 Bench_mxRegex(const BENCH_CASE& c, const double minMs, BENCH_RES* resP)
+{
+    static MXREGEX_M m;
+    REGEXPROG prog;
+    UInt32 runNum;
+    UInt32 batchNum;
+    double ms;
+
+    if (MxRegex_compile(c.regex.c_str(), c.mode, &prog) != REGEXSTS_OK)
+        return 0;
+
+    resP->capsNum = MxRegex_exec_len_ex(&m, &prog, c.str.data(), c.str.size());    // warm up (DFA cache)
+    resP->iterateCnt = m.iterateCnt;
+
+    auto start = std::chrono::steady_clock::now();
+    for (runNum = 0, ms = 0, batchNum = 1; ms < minMs; batchNum *= 2)   // batches of doubling size, until minMs
+    {
+        for (UInt32 t = 0; t < batchNum; t++)
+            MxRegex_exec_len_ex(&m, &prog, c.str.data(), c.str.size());
+        runNum += batchNum;
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    resP->ns = ms * 1e6 / runNum;
+    resP->runNum = runNum;
+    return 1;
+}
+
+
+
+// run std::regex at least minMs, same flags
+// ret
+//  0 not available (regex syntax, or input too long)
+
+static UInt8 Bench_stdRegex(const BENCH_CASE& c, const double minMs, BENCH_RES* resP)
+{
+    std::regex::flag_type flags;
+    std::regex re;
+    std::cmatch cm;
+    UInt32 runNum;
+    UInt32 batchNum;
+    double ms;
+
+    if (c.str.size() > STD_MAX_LEN)
+        return 0;
+
+    flags = std::regex::ECMAScript;
+    if (c.mode & REGEXMODE_CASE_INSENSITIVE)
+        flags |= std::regex::icase;
+#if defined(__GLIBCXX__) && _GLIBCXX_RELEASE >= 11
+    if (c.mode & REGEXMODE_MULTILINE)
+        flags |= std::regex::multiline;
+#else
+    if (c.mode & REGEXMODE_MULTILINE)
+        return 0;
+#endif
+
+    try
+    {
+        re.assign(c.regex, flags);
+        resP->capsNum = std::regex_search(c.str.data(), c.str.data() + c.str.size(), cm, re) ? (UInt8)cm.size() : 0;
+    }
+    catch (const std::exception&)                               // syntax not supported, or too complex
+    {
+        return 0;
+    }
+
+    resP->iterateCnt = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (runNum = 0, ms = 0, batchNum = 1; ms < minMs; batchNum *= 2)
+    {
+        for (UInt32 t = 0; t < batchNum; t++)
+            std::regex_search(c.str.data(), c.str.data() + c.str.size(), cm, re);
+        runNum += batchNum;
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    resP->ns = ms * 1e6 / runNum;
+    resP->runNum = runNum;
+    return 1;
+}
+
+
+
+// JSON string, escaped
+
+static std::string Bench_json(const std::string& s)
+{
+    std::string ret;
+    char buf[8];
+
+    ret = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            ret += '\\';
+            ret += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+            ret += buf;
+        }
+        else
+            ret += c;
+    }
+    ret += "\"";
+
+    return ret;
+}
+
+
+
+int main(int argc, char** argv)
+{
+    std::vector<BENCH_CASE> caseV;
+    BENCH_RES res;
+    BENCH_RES resStd;
+    const char* jsonP;
+    FILE* fP;
+    double minMs;
+    UInt32 jsonNum;
+    UInt8 isStd;
+    size_t t;
+
+    jsonP = argc > 1 ? argv[1] : "regexBench.json";
+    minMs = argc > 2 ? atof(argv[2]) : 20;
+    memset(&resStd, 0, sizeof(resStd));                 // set only if std::regex runs the case
+
+    MxRegex_init();
+    Bench_mainCases(caseV);
+    Bench_syntheticCases(caseV);
+
+    if ((fP = fopen(jsonP, "w")) == 0)
+    {
+        printf("can't write %s\n", jsonP);
+        return 1;
+    }
+
+    fprintf(fP, "{\n  \"version\": \"%s\",\n  \"minMs\": %.1f,\n  \"cases\": [\n", VER, minMs);
+
+    printf("%-28s %7s %12s %10s %9s %6s %12s %10s\n", "case", "len", "ns/match", "MB/s", "runs", "iter", "std ns", "std MB/s");
+
+    for (t = 0, jsonNum = 0; t < caseV.size(); t++)
+    {
+        const BENCH_CASE& c = caseV[t];
+
+        if (!Bench_mxRegex(c, minMs, &res))
+        {
+            printf("%-28s compile error\n", c.name.c_str());
+            continue;
+        }
+        isStd = Bench_stdRegex(c, minMs, &resStd);
+
+        printf("%-28s %7u %12.1f %10.1f %9u %6u", c.name.c_str(), (unsigned)c.str.size(), res.ns, c.str.size() * 1e3 / res.ns, (unsigned)res.runNum, (unsigned)res.iterateCnt);
+        if (isStd)
+            printf(" %12.1f %10.1f%s\n", resStd.ns, c.str.size() * 1e3 / resStd.ns, ((resStd.capsNum != 0) != (res.capsNum != 0)) ? " (result differs)" : "");
+        else
+            printf(" %12s %10s\n", "-", "-");
+
+        fprintf(fP, "%s    { \"name\": %s, \"regex\": %s, \"len\": %u, \"mode\": %u, \"match\": %u, \"nsPerMatch\": %.2f, \"bytesPerSec\": %.0f, \"runs\": %u, \"iterations\": %u",
+            jsonNum++ ? ",\n" : "", Bench_json(c.name).c_str(), Bench_json(c.regex).c_str(), (unsigned)c.str.size(), (unsigned)c.mode, (unsigned)res.capsNum,
+            res.ns, c.str.size() * 1e9 / res.ns, (unsigned)res.runNum, (unsigned)res.iterateCnt);
+        if (isStd)
+            fprintf(fP, ", \"std\": { \"match\": %u, \"nsPerMatch\": %.2f, \"bytesPerSec\": %.0f, \"runs\": %u } }", (unsigned)resStd.capsNum, resStd.ns, c.str.size() * 1e9 / resStd.ns, (unsigned)resStd.runNum);
+        else
+            fprintf(fP, ", \"std\": null }");
+    }
+
+    fprintf(fP, "\n  ]\n}\n");
+    fclose(fP);
+
+    printf("results: %s\n", jsonP);
+    return 0;
+}
@@ -18,7 +18,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 
 */
 
-#define MXREGEX_DEBUG 1
+#ifndef MXREGEX_DEBUG
+#define MXREGEX_DEBUG 1                             // test main() with trace output (windows only), 0 in library builds
+#endif
 
 
 #if MXREGEX_DEBUG
@@ -30,21 +32,118 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 
 
 
+#include <string.h>
+
 #include "mxRegex.h"
+#include "mxRegexInt.h"
+
+#if MXREGEX_TRACE
+#include <stdio.h>
+#endif
+
+
+#if MXREGEX_SIMD && defined(__AVX2__)
+#include <immintrin.h>
+#define SPAN_VECTOR 32                              // AVX2 span, 32 bytes at once
+#elif MXREGEX_SIMD && (defined(__SSSE3__) || defined(__AVX__))
+#include <tmmintrin.h>
+#define SPAN_VECTOR 16                              // SSSE3 span, 16 bytes at once
+#else
+#define SPAN_VECTOR 0                               // scalar span
+#endif
+
+#if SPAN_VECTOR && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+
+
+
+// thread local storage class
+
+#if !MXREGEX_TLS
+#define THREAD_LOCAL
+#elif defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#elif defined(__cplusplus)
+#define THREAD_LOCAL thread_local
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+
+
+// hot path counters, see REGEXSTATS
+
+#if MXREGEX_STATS
+#define STATS_INC(mP, field) ((mP)->stats.field++)
+#define STATS_PEAK(mP, field, n) do { if ((n) > (mP)->stats.field) (mP)->stats.field = (n); } while (0)
+#define STATS_FAR(mP, p) do { if ((p) > (mP)->statsFarP) (mP)->statsFarP = (p); } while (0)
+#else
+#define STATS_INC(mP, field)
+#define STATS_PEAK(mP, field, n)
+#define STATS_FAR(mP, p)
+#endif
 
 
 
+// trace event, one predictable branch if no hook, see MxRegex_setTrace()
+
+#if MXREGEX_TRACE
+#define TRACE(mP, kind, recurseNum, strP, regexP, arg) do { if ((mP)->traceHookP != 0) Trace_event(mP, kind, recurseNum, strP, regexP, arg); } while (0)
+#else
+#define TRACE(mP, kind, recurseNum, strP, regexP, arg)
+#endif
+
 
 
 // VARS
 
-MXREGEX_M m;
+THREAD_LOCAL MXREGEX_M m;                           // default regex data used by MxRegex(), one for each thread
+
+
+// releases allocations of default regex data m when its thread exits (constructed by 1st allocation, see Regex_alloc())
+
+struct RegexRelease
+{
+    UInt8 isUsed;
+
+    ~RegexRelease()
+    {
+        MxRegex_release_ex(&m);
+    }
+};
+
+#if MXREGEX_TLS
+static thread_local RegexRelease mRelease;
+#else
+static RegexRelease mRelease;
+#endif
+
+
+#if MXREGEX_TRACE
 
+THREAD_LOCAL REGEXTRACE_HOOK traceHookP;            // trace hook of each thread, see MxRegex_setTrace()
+THREAD_LOCAL void* traceCtxP;
+
+#endif
 
 #if MXREGEX_DEBUG
 
-char buf[1024];
-UInt16 step;
+THREAD_LOCAL char buf[1024];
+
+#endif
+
+
+// predefined charsets, set by MxRegex_init() then read only
+
+#if !CONST_CHARSET
+
+CHARSET charset_dot;                                // . non singleline, including \r\n
+CHARSET charset_word;                               // \w
+CHARSET charset_digit;                              // \d
+CHARSET charset_whitespace;                         // \s
 
 #endif
 
@@ -59,7 +158,7 @@ UInt16 step;
 const CHARSET C_WORD_CHARSET = { {0x00000000, 0x03ff0000, 0x87fffffe, 0x07fffffe, 0x00000000, 0x00000000, 0x00000000, 0x00000000} };
 const CHARSET C_DIGIT_CHARSET = { {0x00000000, 0x03ff0000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000} };
 const CHARSET C_WHITESPACE_CHARSET = { {0x00003e00, 0x00000001, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000} };
-const CHARSET C_DOT_CHARSET = { {0xfffffffe, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff } };
+const CHARSET C_DOT_CHARSET = { {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff } };
 
 #else
 
@@ -69,6 +168,28 @@ const char* const C_WHITESPACE_CHARSET_STR = " \t\r\n\v\f";
 
 #endif
 
+// case folding ISO 8859-1: other case of each char (a-z A-Z, 0xc0-0xde 0xe0-0xfe except 0xd7 0xf7), else char itself
+// case insensitive regex is folded by compiler, see Atom_charsetFold()
+
+const UInt8 C_CASE_FOLD[256] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f,
+    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f,
+    0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x5b, 0x5c, 0x5d, 0x5e, 0x5f,
+    0x60, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f,
+    0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x7b, 0x7c, 0x7d, 0x7e, 0x7f,
+    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
+    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f,
+    0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf,
+    0xb0, 0xb1, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xbb, 0xbc, 0xbd, 0xbe, 0xbf,
+    0xe0, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xeb, 0xec, 0xed, 0xee, 0xef,
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xd7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xdf,
+    0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf,
+    0xd0, 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xf7, 0xd8, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xff
+};
+
 const char* const C_ANCHOR_NO_ESC_CHARSET = "bB";                           // anchor after escape (i.e. no $ ^)
 const char* const C_ANCHOR_META_NO_ESC_CHARSET = "wWdDsSh";                 // metaclass after escape (i.e. no .)
 
@@ -78,27 +199,28 @@ const char* const C_ANCHOR_META_NO_ESC_CHARSET = "wWdDsSh";                 // m
 
 
 
-// dummy for debug
 
-#if MXREGEX_DEBUG
 
-void Nop()
-{
-}
 
-#endif
 
 
+// convert to uppercase, ISO 8859-1 (see C_CASE_FOLD)
+
+char Upper(const char c)
+{
+    UInt8 f;
+
+    f = C_CASE_FOLD[(UInt8)c];
+    return (f < (UInt8)c) ? (char)f : c;                // uppercase letters come first in ISO 8859-1
+}
 
 
 
-// convert uppercase  a-z -> A-Z (may be replaced by library)
+// other case of char, ISO 8859-1 (char itself if no case)
 
-char Upper(const char c)
+char Fold(const char c)
 {
-    if (c >= 'a' && c <= 'z')
-        return c - ('a' - 'A');
-    return c;
+    return (char)C_CASE_FOLD[(UInt8)c];
 }
 
 
@@ -178,11 +300,63 @@ UInt8 CharInStr(const char c, const char* strP)
 
 
 
+// offset of compiled atom in regex string (see REGEXINST.regexOfs)
+// ptr after last atom EOS is reported as regex len + 1, i.e. after \0
+
+UInt16 RegexOfs(MXREGEX_M* mP, const REGEXINST* regexP)
+{
+    if (regexP == 0)
+        return 0;
+
+    if (regexP >= &mP->progP->inst[mP->progP->instNum])
+        return mP->progP->inst[mP->progP->instNum - 1].regexOfs + 1;
+
+    return regexP->regexOfs;
+}
+
+
+
+
+// send trace event to hook (see TRACE)
+// parm:
+//  recurseNum: recursion level, mP->traceRecurseNum if event is not raised by parser
+//  strP: str parser, 0 = parser of recursion level
+//  regexP: regex position of event
+//  arg: see REGEXTRACE_KIND
+
+#if MXREGEX_TRACE
+
+void Trace_event(MXREGEX_M* mP, const UInt16 kind, const UInt16 recurseNum, const char* strP, const REGEXINST* regexP, const UInt16 arg)
+{
+    REGEXTRACE_EVENT e;
+
+    if (kind == REGEXTRACE_STEP)
+        mP->traceStep++;
+    mP->traceRecurseNum = recurseNum;
+
+    if (strP == 0)
+        strP = mP->segment[recurseNum].strParseP;
+
+    e.step = mP->traceStep;
+    e.recurseNum = recurseNum;
+    e.kind = kind;
+    e.strOfs = strP != 0 ? (size_t)(strP - mP->strOrigP) : 0;
+    e.regexOfs = RegexOfs(mP, regexP);
+    e.arg = arg;
+
+    mP->traceHookP(mP->traceCtxP, &e);
+}
+
+#endif
+
+
+
+
 //
 // BACKTRACK
 //
 //
-// We keep track of last MAX_BACKTRACK quantifiers of interest, wehere minOcc != maxOcc
+// We keep track of last limit.backtrackNum quantifiers of interest, wehere minOcc != maxOcc
 // bactrack position refers to 1st char after atom, e.g. regex"[ab]*cd", atom "[ab]*", position is &"c"
 // iteraition is needed for segment quantifier e.g. (\d+)+
 
@@ -196,32 +370,30 @@ UInt8 CharInStr(const char c, const char* strP)
 // ret
 //  1 ok, 0 fail ovf
 
-UInt8 BacktrackAdd(const char* regexParseP, const UInt16 iteration)
+UInt8 BacktrackAdd(MXREGEX_M* mP, const REGEXINST* regexParseP, const REGEXOFS iteration)
 {
     BACKTRACK* bP;
     UInt16 t;
 
-    for (t = 0; t < m.backtrackNum; t++)                    // check if exists, search for leftmost element
+    for (t = 0; t < mP->backtrackNum; t++)                    // check if exists, search for leftmost element
     {
-        bP = &m.backtrack[t];
+        bP = &mP->backtrack[t];
         if (bP->regexParseP == regexParseP && bP->iteration == iteration)                
             return 1;                                       // if position already present, already ok
     }
 
     // add new position
 
-    if (m.backtrackNum >= MAX_BACKTRACK - 1)
+    if (mP->backtrackNum >= mP->limit.backtrackNum)
     {
-        m.retSts = REGEXSTS_BACKTRACK_OVF;
+        mP->retSts = REGEXSTS_BACKTRACK_OVF;
         return 0;
     }
 
-    bP = &m.backtrack[m.backtrackNum++];                     // set new position
+    bP = &mP->backtrack[mP->backtrackNum++];                     // set new position
+    STATS_PEAK(mP, backtrackPeak, mP->backtrackNum);
 
-#if MXREGEX_DEBUG
-    snprintf(buf, sizeof(buf), "- BacktrackAdd num: %d, iteration: %d, regexP: %s\r\n", m.backtrackNum, iteration, regexParseP);
-    OutputDebugStringA((LPCSTR)buf);
-#endif
+    TRACE(mP, REGEXTRACE_BACKTRACK_ADD, mP->traceRecurseNum, 0, regexParseP, mP->backtrackNum);
 
     bP->regexParseP = regexParseP;
     bP->minOcc = 0;                                         // set init values, ok
@@ -239,14 +411,14 @@ UInt8 BacktrackAdd(const char* regexParseP, const UInt16 iteration)
 // ret
 //  ptr to backtrack element, 0 if not found
 
-BACKTRACK* BacktrackGet(const char* regexParseP, const UInt16 iteration)
+BACKTRACK* BacktrackGet(MXREGEX_M* mP, const REGEXINST* regexParseP, const REGEXOFS iteration)
 {
     BACKTRACK* bP;
     UInt16 t;
 
-    for (t = 0; t < m.backtrackNum; t++)
+    for (t = 0; t < mP->backtrackNum; t++)
     {
-        bP = &m.backtrack[t];
+        bP = &mP->backtrack[t];
         if (bP->regexParseP == regexParseP && bP->iteration == iteration)
             return bP;
     }
@@ -256,79 +428,75 @@ BACKTRACK* BacktrackGet(const char* regexParseP, const UInt16 iteration)
 
 
 
-void AltSegmRemoveAt(const char* regexP);
+void AltSegmRemoveAt(MXREGEX_M* mP, const REGEXINST* regexP);
+ALTSEGM* AltSegmNext(MXREGEX_M* mP, const REGEXINST* regexP, const REGEXINST* regexEndP);
+void AltSegmIterate(MXREGEX_M* mP, ALTSEGM* asP);
 
 
 
-// update backtracks for next iteration
-//
-// - sort backtrack items by parseP (i.e. regex left to right)
-// - search for last updatable element (right to left) at the right regexP
-// - if found, update element and restart counter of all elements at the right of it (i.e. nested)
-//      if not found, no need for new iteration
+// search backtrack for next iteration: rightmost updatable element between regexP and regexEndP (excluded), higher iteration first
 // parm
-//  parseP  ptr from where which elements will be removed
+//  regexP      ptr from where elements are considered
+//  regexEndP   ptr end of elements considered
 // ret
-//  1 elements updated, require reparse
-//  0 no change, reparse not necessary
+//  ptr to backtrack element, 0 if none (no more occurrences to give back)
 
-UInt8 BacktrackIterate(const char* regexParseP)
+BACKTRACK* BacktrackNext(MXREGEX_M* mP, const REGEXINST* regexP, const REGEXINST* regexEndP)
 {
     BACKTRACK* bP;
-    const char* cP;
+    BACKTRACK* retP;
     UInt16 t1;
-    UInt16 t2;
-    UInt16 iteration;
-
-    if (m.backtrackNum == 0)                                    // if no backtrack, nothing to do
-        return 0;
-
-    // search for rightmost backtrack, higher iteration first
 
-    cP = 0;
-    t2 = MAX_BACKTRACK;                                         // deflt: not found
-    iteration = 0;
+    retP = 0;
 
-    for (t1 = 0; t1 < m.backtrackNum; t1++)
+    for (t1 = 0; t1 < mP->backtrackNum; t1++)
     {
-        bP = &m.backtrack[t1];
+        bP = &mP->backtrack[t1];
 
-        if (bP->regexParseP < regexParseP)                      // if before regexP, ignore
+        if (bP->regexParseP < regexP || bP->regexParseP >= regexEndP)  // if out of range, ignore
             continue;
 
         if (bP->maxOcc != BACKTRACK_MAXOCC                      // if backtrack evaluated once
             && bP->maxOcc > bP->minOcc                          //  and needs new iteration, restart at right
-            && bP->regexParseP > cP                             //  and mostright right: save
-            && bP->iteration >= iteration)                      //  and at least same iteration or higher
-        {
-            t2 = t1;
-            cP = bP->regexParseP;
-            iteration = bP->iteration;
-        }
+            && (retP == 0 || bP->regexParseP > retP->regexParseP    //  and mostright right: save
+                || (bP->regexParseP == retP->regexParseP && bP->iteration >= retP->iteration)))   //  or same, higher iteration
+            retP = bP;
     }
 
-    if (t2 >= MAX_BACKTRACK)                                    // no backtrack: complete, nothing to do
-        return 0;
+    return retP;
+}
 
-    // do backtrack and invalidate all backtrack after cP
 
-    m.backtrack[t2].maxOcc--;
-    AltSegmRemoveAt(cP);                                        // reevaluate alt segm after backtrack
-#if MXREGEX_DEBUG
-    snprintf(buf, sizeof(buf), "- BacktrackIterate %s, reset altSegm, new maxOcc %d\r\n", cP, m.backtrack[t2].maxOcc);
-    OutputDebugStringA((LPCSTR)buf);
-#endif
 
-    for (t1 = 0; t1 < m.backtrackNum; t1++)
+// update backtrack for next iteration: one occurrence less,
+// and restart counter of all elements at the right of it (i.e. nested), reevaluate alt segm at the right
+// parm
+//  bP      backtrack, see BacktrackNext()
+
+void BacktrackIterate(MXREGEX_M* mP, BACKTRACK* bP)
+{
+    const REGEXINST* cP;
+    REGEXOFS iteration;
+    UInt16 t1;
+
+    cP = bP->regexParseP;
+    iteration = bP->iteration;
+
+    bP->maxOcc--;
+    AltSegmRemoveAt(mP, cP);                                        // reevaluate alt segm after backtrack
+    TRACE(mP, REGEXTRACE_BACKTRACK_ITERATE, mP->traceRecurseNum, 0, cP, bP->maxOcc);
+
+    for (t1 = 0; t1 < mP->backtrackNum; t1++)
     {
-        bP = &m.backtrack[t1];
+        bP = &mP->backtrack[t1];
         if (bP->regexParseP > cP)
             bP->maxOcc = BACKTRACK_MAXOCC;
         else if(bP->regexParseP == cP && bP->iteration > iteration)
             bP->maxOcc = BACKTRACK_MAXOCC;
     }
 
-    return 1;                                                   // no need for new iteration
+    STATS_INC(mP, backtrackRetryNum);
+    return;
 }
 
 
@@ -365,17 +533,17 @@ UInt8 IsMetaclass(const char c)
 // atom charset handling
 //
 
-// following functions use working charset m.atom.charset
+// following functions use working charset atomP->charset
 
 
 // reset charset
 
-void Atom_charsetResetAll()
+void Atom_charsetResetAll(REGEXATOM* atomP)
 {
-    register UInt8 t;
+    UInt8 t;
 
-    for (t = 0; t < sizeidx_(m.atom.charset.map); t++)
-        m.atom.charset.map[t] = 0L;
+    for (t = 0; t < sizeidx_(atomP->charset.map); t++)
+        atomP->charset.map[t] = 0L;
 
     return;
 }
@@ -384,9 +552,9 @@ void Atom_charsetResetAll()
 
 // add char to charset
 
-void Atom_charsetAddChar(const char c)
+void Atom_charsetAddChar(REGEXATOM* atomP, const char c)
 {
-    m.atom.charset.map[c / 32] |= 1L << (c & 31);
+    atomP->charset.map[(UInt8)c / 32] |= 1L << ((UInt8)c & 31);
     return;
 }
 
@@ -394,9 +562,9 @@ void Atom_charsetAddChar(const char c)
 
 // remove char from charset
 
-void Atom_charsetRemoveChar(const char c)
+void Atom_charsetRemoveChar(REGEXATOM* atomP, const char c)
 {
-    m.atom.charset.map[c / 32] &= ~(1L << (c & 31));
+    atomP->charset.map[(UInt8)c / 32] &= ~(1L << ((UInt8)c & 31));
     return;
 }
 
@@ -404,10 +572,10 @@ void Atom_charsetRemoveChar(const char c)
 
 // add string to charset
 
-void Atom_charsetAddStr(const char* strP)
+void Atom_charsetAddStr(REGEXATOM* atomP, const char* strP)
 {
     for (; *strP != '\0'; strP++)
-        Atom_charsetAddChar(*strP);
+        Atom_charsetAddChar(atomP, *strP);
     return;
 }
 
@@ -415,14 +583,29 @@ void Atom_charsetAddStr(const char* strP)
 
 // invert (negate) charse
 
-void Atom_charsetInvert()
+void Atom_charsetInvert(REGEXATOM* atomP)
 {
-    register UInt8 t;
+    UInt8 t;
+
+    for (t = 0; t < sizeidx_(atomP->charset.map); t++)
+        atomP->charset.map[t] = ~atomP->charset.map[t];
+
+    return;                                          // \0 is in charset: end of str is checked by ptr (see MXREGEX_M.strEndP)
+}
+
+
 
-    for (t = 0; t < sizeidx_(m.atom.charset.map); t++)
-        m.atom.charset.map[t] = ~m.atom.charset.map[t];
+// close charset under case folding: add other case of each char (case insensitive, see C_CASE_FOLD)
 
-    m.atom.charset.map[0] &= ~1L;                    // \0 cannot be in charset
+void Atom_charsetFold(REGEXATOM* atomP)
+{
+    UInt16 t;
+
+    for (t = 0; t < 256; t++)
+    {
+        if (atomP->charset.map[t / 32] & (1L << (t & 31)))
+            Atom_charsetAddChar(atomP, Fold((char)t));
+    }
 
     return;
 }
@@ -431,12 +614,12 @@ void Atom_charsetInvert()
 
 // merge charset to working charset
 
-void Atom_charsetMerge(const CHARSET* charsetP)
+void Atom_charsetMerge(REGEXATOM* atomP, const CHARSET* charsetP)
 {
-    register UInt8 t;
+    UInt8 t;
 
-    for (t = 0; t < sizeidx_(m.atom.charset.map); t++)
-        m.atom.charset.map[t] |= charsetP->map[t];
+    for (t = 0; t < sizeidx_(atomP->charset.map); t++)
+        atomP->charset.map[t] |= charsetP->map[t];
 
     return;
 }
@@ -445,12 +628,12 @@ void Atom_charsetMerge(const CHARSET* charsetP)
 
 // export (copy) from working charset
 
-void Atom_charsetExport(CHARSET* charsetDstP)
+void Atom_charsetExport(REGEXATOM* atomP, CHARSET* charsetDstP)
 {
-    register UInt8 t;
+    UInt8 t;
 
     for (t = 0; t < sizeidx_(charsetDstP->map); t++)
-        charsetDstP->map[t] = m.atom.charset.map[t];
+        charsetDstP->map[t] = atomP->charset.map[t];
 
     return;
 }
@@ -459,12 +642,12 @@ void Atom_charsetExport(CHARSET* charsetDstP)
 
 // import (copy) to working charset
 
-void Atom_charsetImport(const CHARSET* charsetSrcP)
+void Atom_charsetImport(REGEXATOM* atomP, const CHARSET* charsetSrcP)
 {
-    register UInt8 t;
+    UInt8 t;
 
-    for (t = 0; t < sizeidx_(m.atom.charset.map); t++)
-        m.atom.charset.map[t] = charsetSrcP->map[t];
+    for (t = 0; t < sizeidx_(atomP->charset.map); t++)
+        atomP->charset.map[t] = charsetSrcP->map[t];
 
     return;
 }
@@ -475,13 +658,159 @@ void Atom_charsetImport(const CHARSET* charsetSrcP)
 
 UInt8 Atom_charInCharset(const CHARSET* charsetP, const char c)
 {
-    if (((charsetP->map[c / 32]) & (1L << (c & 31))))
+    if (((charsetP->map[(UInt8)c / 32]) & (1L << ((UInt8)c & 31))))
         return 1;
     return 0;
 }
 
 
 
+// build charset nibble lookup table, used by Charset_span()
+// byte b is in charset if lut[(b & 15) + (b & 128 ? 16 : 0)] has bit ((b >> 4) & 7) set
+
+void Charset_lut(const CHARSET* charsetP, UInt8* lutP)
+{
+    UInt16 t;
+    UInt8 c;
+
+    for (t = 0; t < 32; t++)
+        lutP[t] = 0;
+
+    for (t = 0; t < 256; t++)
+    {
+        c = (UInt8)t;
+        if (Atom_charInCharset(charsetP, (char)c))
+            lutP[(c & 15) + ((c & 128) ? 16 : 0)] |= 1 << ((c >> 4) & 7);
+    }
+
+    return;
+}
+
+
+
+// check if char is in lookup table
+
+#define LUT_HAS(lutP, c) ((lutP)[((c) & 15) + (((c) & 128) ? 16 : 0)] & (1 << (((c) >> 4) & 7)))
+
+
+
+#if SPAN_VECTOR
+
+// index of lowest bit set
+
+UInt16 LowBit(UInt32 mask)
+{
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return (UInt16)idx;
+#else
+    return (UInt16)__builtin_ctz((unsigned int)mask);
+#endif
+}
+
+#endif
+
+
+
+// span: nr of leading chars of str in charset, up to maxLen (\0 is a normal char, caller limits maxLen to end of str)
+// vector version classifies 16/32 chars at once with two nibble lookups (pshufb):
+// low nibble selects the table row (8 bits for high nibble 0-7, 8 bits for 8-f), high nibble selects the bit.
+// Vector loads are aligned, so they never cross a page boundary past end of str.
+// parm
+//  lutP    charset lookup table, see Charset_lut()
+//  strP    ptr to str
+//  maxLen  max nr of chars
+// ret
+//  nr of chars in charset
+
+REGEXOFS Charset_span(const UInt8* lutP, const char* strP, const REGEXOFS maxLen)
+{
+    const UInt8* p;
+    REGEXOFS n;
+
+    p = (const UInt8*)strP;
+    n = 0;
+
+#if SPAN_VECTOR
+
+    while (n < maxLen && ((size_t)(p + n) & (SPAN_VECTOR - 1)))  // head, up to aligned address
+    {
+        if (!LUT_HAS(lutP, p[n]))
+            return n;
+        n++;
+    }
+
+#if SPAN_VECTOR == 32
+
+    const __m256i rowLo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)lutP));
+    const __m256i rowHi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(lutP + 16)));
+    const __m256i bitSel = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128,
+        1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i seven = _mm256_set1_epi8(7);
+
+    while (n < maxLen)
+    {
+        __m256i v = _mm256_load_si256((const __m256i*)(p + n));
+        __m256i lo = _mm256_and_si256(v, nibble);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+        __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(rowLo, lo), _mm256_shuffle_epi8(rowHi, lo), _mm256_cmpgt_epi8(hi, seven));
+        __m256i bit = _mm256_shuffle_epi8(bitSel, hi);
+        __m256i in = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit);
+        UInt32 mask = ~(UInt32)(unsigned int)_mm256_movemask_epi8(in) & 0xffffffffUL;
+
+        if (mask)
+        {
+            n += LowBit(mask);
+            return (n < maxLen) ? n : maxLen;
+        }
+        n += 32;
+    }
+
+#else
+
+    const __m128i rowLo = _mm_loadu_si128((const __m128i*)lutP);
+    const __m128i rowHi = _mm_loadu_si128((const __m128i*)(lutP + 16));
+    const __m128i bitSel = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i seven = _mm_set1_epi8(7);
+
+    while (n < maxLen)
+    {
+        __m128i v = _mm_load_si128((const __m128i*)(p + n));
+        __m128i lo = _mm_and_si128(v, nibble);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+        __m128i isHi = _mm_cmpgt_epi8(hi, seven);
+        __m128i row = _mm_or_si128(_mm_and_si128(isHi, _mm_shuffle_epi8(rowHi, lo)), _mm_andnot_si128(isHi, _mm_shuffle_epi8(rowLo, lo)));
+        __m128i bit = _mm_shuffle_epi8(bitSel, hi);
+        __m128i in = _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit);
+        UInt32 mask = ~(UInt32)_mm_movemask_epi8(in) & 0xffff;
+
+        if (mask)
+        {
+            n += LowBit(mask);
+            return (n < maxLen) ? n : maxLen;
+        }
+        n += 16;
+    }
+
+#endif
+
+    return maxLen;
+
+#else
+
+    while (n < maxLen && LUT_HAS(lutP, p[n]))                   // scalar
+        n++;
+
+    return n;
+
+#endif
+}
+
+
+
 // functions related to regex atoms
 
 
@@ -492,12 +821,31 @@ UInt8 IsWord(const char c)
 #if CONST_CHARSET
     return Atom_charInCharset(&C_WORD_CHARSET, c);
 #else
-    return Atom_charInCharset(&m.charset_word, c);
+    return Atom_charInCharset(&charset_word, c);
 #endif
 }
 
 
 
+// check if str char at strP is a word char, end of str is \W
+
+UInt8 IsWordAt(const MXREGEX_M* mP, const char* strP)
+{
+    return (strP < mP->strEndP && IsWord(*strP)) ? 1 : 0;
+}
+
+
+
+// check if str char preceding strP is a word char, begin of str is \W
+// (str before a find start position is still seen, see MxRegex_findNext())
+
+UInt8 IsWordBefore(const MXREGEX_M* mP, const char* strP)
+{
+    return (strP > mP->strOrigP && IsWord(strP[-1])) ? 1 : 0;
+}
+
+
+
 
 
 
@@ -541,76 +889,76 @@ UInt16 ParseInt(const char* strP, UInt16* retLenP)
 // parm
 //  c  metaclass char
 
-void Atom_charsetAddClass(const char c)
+void Atom_charsetAddClass(REGEXATOM* atomP, const char c)
 {
-    static CHARSET csTmp;
+    CHARSET csTmp;
 
     switch (c)
     {
     case 'w':                   // \w: "a-zA-Z0-9_" + accented (if in charset)
 #if CONST_CHARSET
-        Atom_charsetMerge(&C_WORD_CHARSET);
+        Atom_charsetMerge(atomP, &C_WORD_CHARSET);
 #else
-        Atom_charsetMerge(&m.charset_word);
+        Atom_charsetMerge(atomP, &charset_word);
 #endif
         break;
 
     case 'W':                   // \W: ^\w
-        Atom_charsetExport(&csTmp);
+        Atom_charsetExport(atomP, &csTmp);
 #if CONST_CHARSET
-        Atom_charsetImport(&C_WORD_CHARSET);
+        Atom_charsetImport(atomP, &C_WORD_CHARSET);
 #else
-        Atom_charsetImport(&m.charset_word);
+        Atom_charsetImport(atomP, &charset_word);
 #endif
-        Atom_charsetInvert();
-        Atom_charsetMerge(&csTmp);
+        Atom_charsetInvert(atomP);
+        Atom_charsetMerge(atomP, &csTmp);
         break;
 
     case 'd':                   // \d: "0-9"
 #if CONST_CHARSET
-        Atom_charsetMerge(&C_DIGIT_CHARSET);
+        Atom_charsetMerge(atomP, &C_DIGIT_CHARSET);
 #else
-        Atom_charsetMerge(&m.charset_digit);
+        Atom_charsetMerge(atomP, &charset_digit);
 #endif
         break;
 
     case 'D':                   // \D: ^\d
-        Atom_charsetExport(&csTmp);
+        Atom_charsetExport(atomP, &csTmp);
 #if CONST_CHARSET
-        Atom_charsetImport(&C_DIGIT_CHARSET);
+        Atom_charsetImport(atomP, &C_DIGIT_CHARSET);
 #else
-        Atom_charsetImport(&m.charset_digit);
+        Atom_charsetImport(atomP, &charset_digit);
 #endif
-        Atom_charsetInvert();
-        Atom_charsetMerge(&csTmp);
+        Atom_charsetInvert(atomP);
+        Atom_charsetMerge(atomP, &csTmp);
         break;
 
     case 'h':                   // \h: "0-9A-Fa-f"   hex char (NON STANDARD)
 #if CONST_CHARSET
-        Atom_charsetMerge(&C_DIGIT_CHARSET);
+        Atom_charsetMerge(atomP, &C_DIGIT_CHARSET);
 #else
-        Atom_charsetMerge(&m.charset_digit);
+        Atom_charsetMerge(atomP, &charset_digit);
 #endif
-        Atom_charsetAddStr("abcdefABCDEF");
+        Atom_charsetAddStr(atomP, "abcdefABCDEF");
         break;
 
     case 's':                   // \s: whitespace tab cr lf vt ff
 #if CONST_CHARSET
-        Atom_charsetMerge(&C_WHITESPACE_CHARSET);
+        Atom_charsetMerge(atomP, &C_WHITESPACE_CHARSET);
 #else
-        Atom_charsetMerge(&m.charset_whitespace);
+        Atom_charsetMerge(atomP, &charset_whitespace);
 #endif
         break;
 
     case 'S':                   // \S: ^\s
-        Atom_charsetExport(&csTmp);
+        Atom_charsetExport(atomP, &csTmp);
 #if CONST_CHARSET
-        Atom_charsetImport(&C_WHITESPACE_CHARSET);
+        Atom_charsetImport(atomP, &C_WHITESPACE_CHARSET);
 #else
-        Atom_charsetImport(&m.charset_whitespace);
+        Atom_charsetImport(atomP, &charset_whitespace);
 #endif
-        Atom_charsetInvert();
-        Atom_charsetMerge(&csTmp);
+        Atom_charsetInvert(atomP);
+        Atom_charsetMerge(atomP, &csTmp);
         break;
 
     default:                    // unhandled, ignore
@@ -628,14 +976,15 @@ void Atom_charsetAddClass(const char c)
 // parse quantifier ? * + {min[,max]} in Atom.
 // if present, add a backtrack position
 // parm:
+//  atomP       atom, set minOcc maxOcc
 //  charP       ptr to first possible quantifier char
-//  retLenP     RET pto to returned number of char parsed
+//  retLenP     RET pto to returned number of char parsed, 0 if charP is not a quantifier
 // ret:
-//  1: quantifier found, set retLenP
-//  0: charP is not a quantifier, or syntax error (check m.retStatus != REGEXSTS_OK)
+//  REGEXSTS_OK: ok, quantifier found or default {1,1}
+//  else: syntax error
 // NOTE condition min > max will return error
 
-UInt8 Atom_ParseQtf(const char* charP, UInt16* retLenP)
+REGEX_STS Atom_ParseQtf(REGEXATOM* atomP, const char* charP, UInt16* retLenP)
 {
     const char* baseP;
     UInt16 t;
@@ -647,82 +996,71 @@ UInt8 Atom_ParseQtf(const char* charP, UInt16* retLenP)
     {
     case '?':                                                       // quantifier ?
 
-        m.atom.minOcc = 0;
-        m.atom.maxOcc = 1;
+        atomP->minOcc = 0;
+        atomP->maxOcc = 1;
         break;
 
 
     case '*':                                                       // quantifier *
 
-        m.atom.minOcc = 0;
-        m.atom.maxOcc = 0xffff;
+        atomP->minOcc = 0;
+        atomP->maxOcc = BACKTRACK_MAXOCC;
         break;
 
 
     case '+':                                                       // quantifier +
 
-        m.atom.minOcc = 1;
-        m.atom.maxOcc = 0xffff;
+        atomP->minOcc = 1;
+        atomP->maxOcc = BACKTRACK_MAXOCC;
         break;
 
 
     case '{':                                                       // quantifier {min[,[max]]}
 
-        m.atom.minOcc = ParseInt(charP, &t);                        // {min
-        m.atom.maxOcc = m.atom.minOcc;                              // default
+        atomP->minOcc = ParseInt(charP, &t);                        // {min
+        atomP->maxOcc = atomP->minOcc;                              // default
 
         if (t == 0)
-        {
-            m.retSts = REGEXSTS_QUANTIFIER_ERR;
-            return 0;
-        }
+            return REGEXSTS_QUANTIFIER_ERR;
         charP += t;
         if (*charP == ',')                                          // if {min,
         {
             charP++;
             if (*charP == '}')                                      // if {min,}
             {
-                m.atom.maxOcc = 0xffff;
+                atomP->maxOcc = BACKTRACK_MAXOCC;
                 charP++;
                 break;
             }
-            m.atom.maxOcc = ParseInt(charP, &t);                    // {min,max
+            atomP->maxOcc = ParseInt(charP, &t);                    // {min,max
             if (t == 0)
-            {
-                m.retSts = REGEXSTS_QUANTIFIER_ERR;
-                return 0;
-            }
+                return REGEXSTS_QUANTIFIER_ERR;
             charP += t;
         }
         if (*charP++ == '}')                                        // check for closing }
             break;
 
-        m.retSts = REGEXSTS_SYNTAX;
-        return 0;                                                   // missing }, fail
+        return REGEXSTS_SYNTAX;                                     // missing }, fail
 
 
     case '}':                                                       // not expected, fail
 
-        m.retSts = REGEXSTS_SYNTAX;
-        return 0;                                                   // manca }, fail
+        return REGEXSTS_SYNTAX;                                     // manca }, fail
 
 
     default:                                                        // unexpected char, no quantifier: set {1,1}, ok
 
-        m.atom.minOcc = 1;
-        m.atom.maxOcc = 1;
-        return 0;
+        atomP->minOcc = 1;
+        atomP->maxOcc = 1;
+        return REGEXSTS_OK;
 
     }// switch
 
-    if (m.atom.minOcc > m.atom.maxOcc)                              // if minOcc > maxOcc, fail
-    {
-        m.retSts = REGEXSTS_QUANTIFIER_ERR;
-        return 0;
-    }
+    if (atomP->minOcc > atomP->maxOcc)                              // if minOcc > maxOcc, fail
+        return REGEXSTS_QUANTIFIER_ERR;
 
     *retLenP = charP - baseP;
-    return 1;
+    return REGEXSTS_OK;
 
 }
 
@@ -733,64 +1071,70 @@ UInt8 Atom_ParseQtf(const char* charP, UInt16* retLenP)
 
 // get regex atom that may be used to match 1 char in str, with possible quantifier.
 // If it's a metaclass like \d or [ab], return charset
-// Here we handle backtrack save/check
+// Used by regex compiler only, see MxRegex_compile()
 // parm
+//  atomP   RET parsed atom
 //  charP   prt to regex atom
+//  mode    regex mode flags
 // ret
-//  REGEXSTS_OK: ok, atom descriptors stored in m.atom, m.atom.endP updated to ptr to next atom
+//  REGEXSTS_OK: ok, atom descriptors stored in atomP, atomP->endP updated to ptr to next atom
 //  else: fatal error
 
-REGEX_STS GetRegexAtom(const char* charP, const UInt8 isCI, const UInt16 interation)
+REGEX_STS GetRegexAtom(REGEXATOM* atomP, const char* charP, const UInt16 mode)
 {
     UInt16 t;
+    UInt8 isCI;
+    REGEX_STS sts;
+
+    isCI = (mode & REGEXMODE_CASE_INSENSITIVE) ? 1 : 0;
 
     // init atom default results
 
-    m.atom.type = ATOMTYPE_CHAR;
-    m.atom.minOcc = 1;
-    m.atom.maxOcc = 1;
+    atomP->type = ATOMTYPE_CHAR;
+    atomP->minOcc = 1;
+    atomP->maxOcc = 1;
 
     // categorize regex char. Exit switch with break if quantifier may follow, otherwise just save endP and return
 
-    switch (m.atom.c = *charP++)                          // save regex char and move to next
+    switch (atomP->c = *charP++)                          // save regex char and move to next
     {
 
     case '\0':                                              // EOS
 
-        m.atom.type = ATOMTYPE_EOS;
-        m.atom.endP = charP;                             // set endP to \0 (len=0)
+        atomP->type = ATOMTYPE_EOS;
+        atomP->endP = charP;                             // set endP to \0 (len=0)
         return REGEXSTS_OK;
 
 
     case '\\':                                           // \ escape
 
-        m.atom.c = *charP++;                             // save escaped char
+        atomP->c = *charP++;                             // save escaped char
 
-        if (m.atom.c == '\0')                            // if got EOS: fail
+        if (atomP->c == '\0')                            // if got EOS: fail
         {
-            m.atom.endP = charP;
+            atomP->endP = charP;
             return REGEXSTS_SYNTAX;
         }
 
-        if (m.atom.c == 'x' && GetHex(charP, &t))         // if \xHH char hex code
+        if (atomP->c == 'x' && GetHex(charP, &t))         // if \xHH char hex code
         {
-            m.atom.c = (char)t;
+            atomP->c = (char)t;
             charP += 2;
             break;
         }
 
-        if (IsMetaclass(m.atom.c))                       // if simple metaclass (only one charset)
+        if (IsMetaclass(atomP->c))                       // if simple metaclass (only one charset)
         {
-            Atom_charsetResetAll();
-            Atom_charsetAddClass(m.atom.c);              // save charset
-            m.atom.type = ATOMTYPE_METACLASS;
+            Atom_charsetResetAll(atomP);
+            Atom_charsetAddClass(atomP, atomP->c);              // save charset
+            atomP->type = ATOMTYPE_METACLASS;
             break;
         }
 
-        if (IsAnchor(m.atom.c))                          // if anchor: return to caller
+        if (IsAnchor(atomP->c))                          // if anchor: return to caller
         {
-            m.atom.type = ATOMTYPE_ANCHOR;
-            m.atom.endP = charP;
+            atomP->type = ATOMTYPE_ANCHOR;
+            atomP->endP = charP;
             return REGEXSTS_OK;                             // no quantifier
         }
 
@@ -799,11 +1143,11 @@ REGEX_STS GetRegexAtom(const char* charP, const UInt8 isCI, const UInt16 interat
 
     case '[':                                               // CHARSET [^ac-e\d]
 
-        Atom_charsetResetAll();                             // init set (empty)
-        m.atom.charsetIsNegate = 0;                         // no negation [^
-        m.atom.charsetAllowNegate = 1;                      // waiting 1st char for possible negation
-        m.atom.gotMinus = 0;                                // no minus
-        m.atom.charsetLastChar = 0;                         // no from-char in char range
+        Atom_charsetResetAll(atomP);                             // init set (empty)
+        atomP->charsetIsNegate = 0;                         // no negation [^
+        atomP->charsetAllowNegate = 1;                      // waiting 1st char for possible negation
+        atomP->gotMinus = 0;                                // no minus
+        atomP->charsetLastChar = 0;                         // no from-char in char range
 
         // parse charset [..]
 
@@ -811,42 +1155,42 @@ REGEX_STS GetRegexAtom(const char* charP, const UInt8 isCI, const UInt16 interat
         {
             if (*charP == ']')                              // if end of charset, done: check quantifier
             {
-                if (m.atom.gotMinus)                        // if char range - pending, treat - as simple char and add to charset
-                    Atom_charsetAddChar('-');
+                if (atomP->gotMinus)                        // if char range - pending, treat - as simple char and add to charset
+                    Atom_charsetAddChar(atomP, '-');
                 charP++;                                    // skip ]
                 break;                                      // THIS IS THE ONLY EXIT POINT FOR CHARSET
             }
 
             if (*charP == '\0')                             // if EOS reached before ], fail
             {
-                m.atom.endP = charP;                        // return ptr to \0
+                atomP->endP = charP;                        // return ptr to \0
                 return REGEXSTS_SYNTAX;
             }
 
             if (*charP == '[' || *charP == '(')             // ( [ must be escaped, fail
             {
-                m.atom.endP = charP;
+                atomP->endP = charP;
                 return REGEXSTS_SYNTAX;
             }
 
             if (*charP == '^')
             {
-                if (m.atom.charsetAllowNegate)              // if ^ is 1st char in set, negate at the end
+                if (atomP->charsetAllowNegate)              // if ^ is 1st char in set, negate at the end
                 {
-                    m.atom.charsetAllowNegate = 0;
-                    m.atom.charsetIsNegate = 1;
+                    atomP->charsetAllowNegate = 0;
+                    atomP->charsetIsNegate = 1;
                     continue;
                 }
                 goto BR_CHARSET_ADDCHAR;
             }
 
-            m.atom.charsetAllowNegate = 0;                  // if got here, ^ will be a simple char
+            atomP->charsetAllowNegate = 0;                  // if got here, ^ will be a simple char
 
             if (*charP == '-')                              // char range A-B
             {
-                if (!IsWord(m.atom.charsetLastChar))        // if previous char was not a word, treat as simple char
+                if (!IsWord(atomP->charsetLastChar))        // if previous char was not a word, treat as simple char
                     goto BR_CHARSET_ADDCHAR;
-                m.atom.gotMinus = 1;                        // else prepare for char range
+                atomP->gotMinus = 1;                        // else prepare for char range
                 continue;
             }
 
@@ -856,20 +1200,20 @@ REGEX_STS GetRegexAtom(const char* charP, const UInt8 isCI, const UInt16 interat
 
                 if (*charP == '\0')                         // if \0 EOS: fail
                 {
-                    m.atom.endP = charP;
+                    atomP->endP = charP;
                     return REGEXSTS_SYNTAX;
                 }
 
-                if (m.atom.gotMinus)                        // if preceded by '-': fail
+                if (atomP->gotMinus)                        // if preceded by '-': fail
                 {
-                    m.atom.endP = charP;
+                    atomP->endP = charP;
                     return REGEXSTS_SYNTAX;
                 }
 
                 if (IsMetaclass(*charP))                    // if metaclass, add class to charset
                 {
-                    m.atom.charsetLastChar = 0;             // after metaclass, char range not allowed
-                    Atom_charsetAddClass(*charP);
+                    atomP->charsetLastChar = 0;             // after metaclass, char range not allowed
+                    Atom_charsetAddClass(atomP, *charP);
                     continue;
                 }
 
@@ -879,92 +1223,84 @@ REGEX_STS GetRegexAtom(const char* charP, const UInt8 isCI, const UInt16 interat
 
             // SIMPLE CHAR
 
-            if (m.atom.gotMinus)                            // if was a char range
+            if (atomP->gotMinus)                            // if was a char range
             {
                 if (IsWord(*charP))                         // if -to char is word
                 {
-                    if (*charP < m.atom.charsetLastChar)    // if bad order: fail
+                    if (*charP < atomP->charsetLastChar)    // if bad order: fail
                     {
-                        m.atom.endP = charP;
+                        atomP->endP = charP;
                         return REGEXSTS_SYNTAX;
                     }
 
-                    if (isCI)
-                    {
-                        for (t = m.atom.charsetLastChar; t <= (UInt16)(*charP); t++)
-                            Atom_charsetAddChar(Upper((char)t));       // add range to charset
-                    }
-                    else
-                    {
-                        for (t = m.atom.charsetLastChar; t <= (UInt16)(*charP); t++)
-                            Atom_charsetAddChar((char)t);       // add range to charset
-                    }
+                    for (t = atomP->charsetLastChar; t <= (UInt16)(*charP); t++)
+                        Atom_charsetAddChar(atomP, (char)t);       // add range to charset
 
-                    m.atom.gotMinus = 0;                    // invalidate this char range
-                    m.atom.charsetLastChar = 0;
+                    atomP->gotMinus = 0;                    // invalidate this char range
+                    atomP->charsetLastChar = 0;
                     continue;
                 }
             }
 
         BR_CHARSET_ADDCHAR:                                 // *** entrypoint add simple char to charset
 
-            if (isCI)
-                Atom_charsetAddChar(Upper(*charP));         // add char to charset
-            else
-                Atom_charsetAddChar(*charP);                // add char to charset
-            m.atom.charsetLastChar = *charP;                // save char for possible char range
-            m.atom.gotMinus = 0;                            // wait for next -
+            Atom_charsetAddChar(atomP, *charP);                    // add char to charset
+            atomP->charsetLastChar = *charP;                // save char for possible char range
+            atomP->gotMinus = 0;                            // wait for next -
 
         }// while 1
 
-        if (m.atom.charsetIsNegate)                         // if negated [^..], adj
-            Atom_charsetInvert();
+        if (isCI)                                           // case insensitive: add other case of chars, before negation
+            Atom_charsetFold(atomP);
+
+        if (atomP->charsetIsNegate)                         // if negated [^..], adj
+            Atom_charsetInvert(atomP);
 
-        m.atom.type = ATOMTYPE_METACLASS;
+        atomP->type = ATOMTYPE_METACLASS;
         break;
 
 
     case '(':                                               // metachar (
 
-        m.atom.endP = charP;
-        m.atom.type = ATOMTYPE_BRACKETOPEN;
+        atomP->endP = charP;
+        atomP->type = ATOMTYPE_BRACKETOPEN;
         return REGEXSTS_OK;                                 // no quantifier, ok
 
 
     case ')':                                               // metachar ) with possible quantifier
 
-        m.atom.type = ATOMTYPE_BRACKETCLOSE;
+        atomP->type = ATOMTYPE_BRACKETCLOSE;
         break;
 
 
     case '.':                                               // metaclass . (any char)
 
 #if CONST_CHARSET
-        Atom_charsetImport(&C_DOT_CHARSET);
+        Atom_charsetImport(atomP, &C_DOT_CHARSET);
 #else
-        Atom_charsetImport(&m.charset_dot);
+        Atom_charsetImport(atomP, &charset_dot);
 #endif
-        if (!m.isSingleLine)                                 // if NOT mode "single line", remove [\r\n] to set
+        if (!(mode & REGEXMODE_SINGLELINE))                 // if NOT mode "single line", remove [\r\n] to set
         {
-            Atom_charsetRemoveChar('\r');
-            Atom_charsetRemoveChar('\n');
+            Atom_charsetRemoveChar(atomP, '\r');
+            Atom_charsetRemoveChar(atomP, '\n');
         }
-        m.atom.type = ATOMTYPE_METACLASS;
+        atomP->type = ATOMTYPE_METACLASS;
         break;
 
 
     case '^':                                               // anchor str begin
     case '$':                                               // anchor str end
 
-        m.atom.endP = charP;
-        m.atom.type = ATOMTYPE_ANCHOR;
+        atomP->endP = charP;
+        atomP->type = ATOMTYPE_ANCHOR;
         return REGEXSTS_OK;                                 // no quantifier, ok
 
 
     case '|':                                               // | alternative segment, detected here if previous regex segment was a match
 
-        m.atom.endP = charP;
-        m.atom.type = ATOMTYPE_PIPE;
+        atomP->endP = charP;
+        atomP->type = ATOMTYPE_PIPE;
         return REGEXSTS_OK;                                 // no quantifier, ok
 
 
@@ -974,7 +1310,7 @@ REGEX_STS GetRegexAtom(const char* charP, const UInt8 isCI, const UInt16 interat
     case '?':
     case '*':
 
-        m.atom.endP = charP;
+        atomP->endP = charP;
         return REGEXSTS_SYNTAX;
 
 
@@ -986,19 +1322,12 @@ REGEX_STS GetRegexAtom(const char* charP, const UInt8 isCI, const UInt16 interat
 
     // here there could be a quantifier
 
-    if (Atom_ParseQtf(charP, &t))                           // if valid quantifier: skip it
-    {
-        charP += t;
-        if (m.atom.minOcc < m.atom.maxOcc)                  // if it's a possible trackback position, add if necessary
-            BacktrackAdd(charP, interation);
-    }
-    else                                                    // no valid quantifier, check for errors
-    {
-        if (m.retSts != REGEXSTS_OK)
-            return m.retSts;
-    }
+    if ((sts = Atom_ParseQtf(atomP, charP, &t)) != REGEXSTS_OK)    // check for errors
+        return sts;
+
+    charP += t;                                             // if valid quantifier: skip it
 
-    m.atom.endP = charP;                                     // no errors: save ptr to next atom, ok
+    atomP->endP = charP;                                     // no errors: save ptr to next atom, ok
     return REGEXSTS_OK;
 
 }
@@ -1007,1084 +1336,2476 @@ REGEX_STS GetRegexAtom(const char* charP, const UInt8 isCI, const UInt16 interat
 
 
 
-
 //
-// ALTERNATIVE SEGMENTS
+// REGEX COMPILER
 //
+// Regex is parsed once into an array of atoms (REGEXINST):
+// charsets are pre-built, quantifiers resolved, brackets and pipes linked by index.
+// The matcher never reads the regex string again.
 
 
-// add or update alternative segment
-// referenced by ptr to start of alternative segment group in regex i.e. regex 1st char or after a (
-// if new item, set regexBaseP = regexP, otherwise first copy former regexNextP as regexBaseP only if regexNextP has changed
+// add atom charset to program, reuse if already present
 // parm
-//  regexP              ptr reference segment
-//  regexNextP          ptr next alternative segment
-//  setAltSegmChanged   set altSegmChanged if updated
+//  progP   program
+//  atomP   atom with charset
 // ret
-//  1 ok, 0 fail, set retSts
+//  charset index, 0xff fail ovf
 
-UInt8 AltSegmAdd(const char* regexP, const char* regexNextP)
+UInt8 Prog_charsetAdd(REGEXPROG* progP, REGEXATOM* atomP)
 {
-    ALTSEGM* asP;
-    UInt16 t;
-
-#if MXREGEX_DEBUG
-    snprintf(buf, sizeof(buf), "- AltSegmAdd ref regexP: %s regexNextP: %s\r\n", regexP, regexNextP);
-    OutputDebugStringA((LPCSTR)buf);
-#endif
+    UInt8 t;
+    UInt8 t1;
 
-    for (t = 0; t < m.altSegmNum; t++)
+    for (t = 0; t < progP->charsetNum; t++)                 // search for same charset (e.g. \d used many times)
     {
-        asP = &m.altSegm[t];
-
-        if (asP->regexP == regexP)                          // if position already present
-        {
-            if (asP->regexNextP != regexNextP)              // if update value
-            {
-                asP->regexBaseP = asP->regexNextP;
-                asP->regexNextP = regexNextP;
+        for (t1 = 0; t1 < sizeidx_(atomP->charset.map); t1++)
+            if (progP->charset[t].map[t1] != atomP->charset.map[t1])
+                break;
 
-                m.altSegmChanged = 1;
-#if MXREGEX_DEBUG
-                snprintf(buf, sizeof(buf), "- update, set altSegmChanged, baseP: %s, nextP: %s\r\n", asP->regexBaseP, asP->regexNextP);
-                OutputDebugStringA((LPCSTR)buf);
-#endif
-            }
-            return 1;
-        }
+        if (t1 == sizeidx_(atomP->charset.map))             // found
+            return t;
     }
 
-    // here add a new location
+    if (progP->charsetNum >= MAX_PROG_CHARSET)              // check ovf
+        return 0xff;
 
-    if (m.altSegmNum >= MAX_ALTSEG)                         // check ovf
-    {
-        m.retSts = REGEXSTS_ALTSEGM_OVF;
-        return 0;
-    }
+    Atom_charsetExport(atomP, &progP->charset[progP->charsetNum]);
+    Charset_lut(&progP->charset[progP->charsetNum], progP->charsetLut[progP->charsetNum]);
+    return progP->charsetNum++;
+}
 
-    asP = &m.altSegm[m.altSegmNum++];
-    asP->regexP = regexP;
-    asP->regexBaseP = regexP;
-    asP->regexNextP = regexNextP;
 
-    m.altSegmChanged = 1;
 
-#if MXREGEX_DEBUG
-    snprintf(buf, sizeof(buf), "- add, set altSegmChanged, baseP: %s, nextP: %s\r\n", asP->regexBaseP, asP->regexNextP);
-    OutputDebugStringA((LPCSTR)buf);
-#endif
+// extract literal prefix: leading simple chars every match starts with (zero width anchors are skipped)
+// no prefix if regex has alternatives on base level (a|b)
 
-    return 1;
-}
+void Prog_prefix(REGEXPROG* progP)
+{
+    const REGEXINST* iP;
+    UInt16 idx;
+    UInt16 t;
 
+    progP->prefixLen = 0;
 
+    for (idx = 0; idx < progP->instNum; idx++)                  // check alternatives on base level
+    {
+        iP = &progP->inst[idx];
+        if (iP->type == ATOMTYPE_PIPE)
+            return;
+        if (iP->type == ATOMTYPE_BRACKETOPEN)
+            idx = iP->jump;
+    }
 
+    for (idx = 0; idx < progP->instNum; idx++)
+    {
+        iP = &progP->inst[idx];
 
-// get ptr to active alternative segment regexBaseP
-// referenced by ptr to start of alternative segment group in regex i.e. regex 1st char or after a (
-// parm
-//  regexP    ptr alternative segments base
-// ret
-//  ptr current alternative segment
-//  0 no alternative segment found
+        if (iP->type == ATOMTYPE_ANCHOR)                        // zero width, skip
+            continue;
+
+        if (iP->type != ATOMTYPE_CHAR || iP->c == '\0')
+            return;
+
+        for (t = 0; t < iP->minOcc; t++)                        // a{n} is n times a
+        {
+            if (progP->prefixLen >= MAX_PROG_PREFIX)
+                return;
+            progP->prefix[progP->prefixLen] = iP->c;
+            progP->prefixFold[progP->prefixLen++] = iP->cFold;
+        }
+
+        if (iP->maxOcc != iP->minOcc)                           // optional occurrences: prefix ends here
+            return;
+    }
 
-const char* AltSegmGet(const char* regexP)
+    return;
+}
+
+
+
+// check if every match starts at ^: each alternative on base level begins with anchor ^, e.g. ^ip\s+(\d+)$|^reset$
+// in multiline mode start positions are then only line starts, see Prog_lineFind()
+
+void Prog_lineStart(REGEXPROG* progP)
 {
-    ALTSEGM* asP;
-    UInt16 t;
+    const REGEXINST* iP;
+    UInt16 idx;
+    UInt8 isBegin;
 
-    for (t = 0; t < m.altSegmNum; t++)
+    progP->isLineStart = 0;
+    isBegin = 1;                                                // 1st atom of an alternative
+
+    for (idx = 0; idx < progP->instNum; idx++)
     {
-        asP = &m.altSegm[t];
-        if (asP->regexP == regexP)
-            return asP->regexBaseP;                         // found
+        iP = &progP->inst[idx];
+
+        if (isBegin && (iP->type != ATOMTYPE_ANCHOR || iP->c != '^'))
+            return;
+        isBegin = 0;
+
+        if (iP->type == ATOMTYPE_PIPE)                          // alternative on base level
+            isBegin = 1;
+        if (iP->type == ATOMTYPE_BRACKETOPEN)
+            idx = iP->jump;
     }
 
-    return 0;                                               // not found
+    progP->isLineStart = 1;
+    return;
 }
 
 
 
+// saturating add and multiply of lengths, REGEXOFS_MAX is no limit
 
-// remove all alternative segments AFTER regexBaseP, remove empty
+REGEXOFS LenAdd(const REGEXOFS a, const REGEXOFS b)
+{
+    return (a > REGEXOFS_MAX - b) ? REGEXOFS_MAX : (REGEXOFS)(a + b);
+}
+
+
+REGEXOFS LenMul(const REGEXOFS a, const REGEXOFS b)
+{
+    return (a != 0 && b > REGEXOFS_MAX / a) ? REGEXOFS_MAX : (REGEXOFS)(a * b);
+}
+
+
+
+// min and max len of atoms [beginIdx, endIdx) on one level: alternatives split by |, brackets times their quantifier
 // parm
-//  regexP  ptr after which descriptor will be removed  0 -> all
+//  retMin  RET min len
+//  retMax  RET max len, REGEXOFS_MAX no limit
 
-void AltSegmRemoveAt(const char* regexP)
+void Prog_lenAlt(const REGEXPROG* progP, UInt16 beginIdx, const UInt16 endIdx, REGEXOFS* retMin, REGEXOFS* retMax)
 {
-    ALTSEGM* asP;
-    UInt16 t;
-    UInt16 t1;
+    const REGEXINST* iP;
+    REGEXOFS segmMin;
+    REGEXOFS segmMax;
+    REGEXOFS innerMin;
+    REGEXOFS innerMax;
+    UInt8 isFirst;
 
-    t1 = 0;
-    for (t = 0; t < m.altSegmNum; t++)
+    segmMin = segmMax = 0;
+    isFirst = 1;
+
+    for (; beginIdx <= endIdx; beginIdx++)
     {
-        asP = &m.altSegm[t];
-        if (asP->regexP > regexP                        // if to be removed or empty: remove
-            || asP->regexP == 0)
+        iP = &progP->inst[beginIdx];
+
+        if (beginIdx == endIdx || iP->type == ATOMTYPE_PIPE)    // end of alternative
         {
-#if MXREGEX_DEBUG
-            snprintf(buf, sizeof(buf), "- AltSegmRemoveAt %s, set altSegmChanged, entry removed regexP: %s regexBaseP: %s\r\n", regexP, asP->regexP, asP->regexBaseP);
-            OutputDebugStringA(buf);
-#endif
+            if (isFirst || segmMin < *retMin)
+                *retMin = segmMin;
+            if (isFirst || segmMax > *retMax)
+                *retMax = segmMax;
+            isFirst = 0;
+            segmMin = segmMax = 0;
             continue;
         }
-        if (t1 != t)
+
+        switch (iP->type)
         {
-            m.altSegm[t1].regexP = asP->regexP;
-            m.altSegm[t1].regexBaseP = asP->regexBaseP;
-            m.altSegm[t1].regexNextP = asP->regexNextP;
-        }
-        t1++;
-    }
+        case ATOMTYPE_CHAR:
+        case ATOMTYPE_METACLASS:                                // one char for each occurrence
 
-    if (t1 != t)
-    {
-        m.altSegmNum = t1;                                  // adj if changed
-        m.altSegmChanged = 1;
-    }
-#if MXREGEX_DEBUG
-    else
-    {
-        snprintf(buf, sizeof(buf), "- AltSegmRemoveAt %s, no changes\r\n", regexP);
-        OutputDebugStringA(buf);
+            segmMin = LenAdd(segmMin, iP->minOcc);
+            segmMax = LenAdd(segmMax, iP->maxOcc);
+            break;
+
+
+        case ATOMTYPE_BRACKETOPEN:                              // bracket len times bracket quantifier
+
+            Prog_lenAlt(progP, beginIdx + 1, iP->jump, &innerMin, &innerMax);
+            beginIdx = iP->jump;
+            iP = &progP->inst[beginIdx];
+            segmMin = LenAdd(segmMin, LenMul(innerMin, iP->minOcc));
+            segmMax = LenAdd(segmMax, LenMul(innerMax, iP->maxOcc));
+            break;
+
+
+        default:                                                // anchors: zero width
+            break;
+        }
     }
-#endif
 
     return;
 }
 
 
 
+// min and max match len, and end anchor: each alternative on base level ends with $ (then a match with a max len
+// starts at most max len before end of str), see Prog_startFind()
 
-// search for alternative segment
-//
-// parm
-//  segmentP
-//  mode 0: search for ')', 1: search for '|' or ')',
-// ret
-//  0 no further alt segment or error
-//  1 found ')'
-//  2 found '|'
-//  segmentP->regexParseP updated to char after closing element
-
-UInt8 AltSegmSearch(SEGMENT* segmentP, UInt8 mode)
+void Prog_len(REGEXPROG* progP)
 {
-    UInt16 t1;
+    const REGEXINST* iP;
+    UInt16 idx;
 
-    // search for closing bracket (if nested)
+    Prog_lenAlt(progP, 0, progP->instNum - 1, &progP->minLen, &progP->maxLen);      // last atom is EOS
 
-    t1 = 0;
+    progP->isEndAnchor = 0;
 
-    while (1)
+    for (idx = 0; idx < progP->instNum; idx++)
     {
-        if (*segmentP->regexParseP == '\0')             // if \0 reached, search end
-        {
-            if (t1 > 0)                                 // if unbalanced brachets: fail
-                m.retSts = REGEXSTS_SYNTAX;
-            break;
-        }
+        iP = &progP->inst[idx];
 
-        if (*segmentP->regexParseP == '\\')             // if esc, skip
+        if (iP->type == ATOMTYPE_PIPE || iP->type == ATOMTYPE_EOS)     // end of alternative on base level
         {
-            segmentP->regexParseP++;
-            if (*segmentP->regexParseP++ == '\0')       // \0 after ESC, fail
-            {
-                m.retSts = REGEXSTS_SYNTAX;
-                break;
-            }
-            continue;
+            if (idx == 0 || progP->inst[idx - 1].type != ATOMTYPE_ANCHOR || progP->inst[idx - 1].c != '$')
+                return;
         }
+        if (iP->type == ATOMTYPE_BRACKETOPEN)
+            idx = iP->jump;
+    }
 
-        if (mode == 1)
-        {
-            if (*segmentP->regexParseP == '|' && t1 == 0)   // if found | start alternative block on current nesting level
-            {
-                segmentP->regexParseP++;                                    // resume regex from char after |
-                return 2;                                   // got |
-            }
-        }
+    progP->isEndAnchor = 1;
+    return;
+}
 
-        if (*segmentP->regexParseP == '(')              // se ( incerase nesting
-            t1++;
 
-        else if (*segmentP->regexParseP == ')')         // if ) decrease nesting, will match only on nested regex
+
+// size of backtracking regex arrays, see REGEXLIMITS
+// backtrack elements are keyed by atom and iteration of the segment parsing it: a quantifier within a bracket
+// with max occurrences n takes n elements (a bracket quantifier is parsed by its own segment), BACKTRACK_UNBOUNDED if no max
+
+void Prog_need(REGEXPROG* progP)
+{
+    const REGEXINST* iP;
+    UInt16 closeIdx[MAX_PROG_RECURSE];                          // idx of close bracket, for each nesting level
+    UInt8 isAlt[MAX_PROG_RECURSE];                              // segment has alternatives, for each nesting level
+    UInt32 backtrackNum;
+    REGEXOFS n;
+    UInt16 level;
+    UInt16 idx;
+
+    progP->need.recurseNum = 1;                                 // base segment
+    progP->need.altSegmNum = 0;
+    progP->need.capsNum = progP->capsNum;
+    backtrackNum = 0;
+
+    level = 0;
+    isAlt[0] = 0;
+
+    for (idx = 0; idx < progP->instNum; idx++)
+    {
+        iP = &progP->inst[idx];
+
+        switch (iP->type)
         {
-            if (t1-- == 0)                              // if at current level, it's the closing one
+        case ATOMTYPE_BRACKETOPEN:
+
+            closeIdx[++level] = iP->jump;
+            isAlt[level] = 0;
+            if (level + 1 > progP->need.recurseNum)
+                progP->need.recurseNum = level + 1;
+            break;
+
+
+        case ATOMTYPE_PIPE:                                     // one alternative segment for each segment with |
+
+            if (!isAlt[level])
+                progP->need.altSegmNum++;
+            isAlt[level] = 1;
+            break;
+
+
+        default:
+
+            if (iP->minOcc < iP->maxOcc)                        // one element for each iteration of bracket
             {
-                segmentP->regexParseP++;
-                return 1;                               // but parse is ok
+                n = level ? progP->inst[closeIdx[level]].maxOcc : 1;
+                backtrackNum += (n == BACKTRACK_MAXOCC) ? BACKTRACK_UNBOUNDED : (n ? n : 1);
             }
+
+            if (iP->type == ATOMTYPE_BRACKETCLOSE)
+                level--;
+            break;
         }
+    }
 
-        segmentP->regexParseP++;
+    progP->need.backtrackNum = (backtrackNum >= BACKTRACK_UNBOUNDED) ? BACKTRACK_UNBOUNDED : (UInt16)backtrackNum;
 
-    }//while 1
+    return;
+}
 
-    return 0;                                           // element not found
 
-}
 
+// search for char c in [strP, endP) (vectorized by library)
+// ret
+//  ptr to char, endP if not found
+
+const char* StrChrEnd(const char* strP, const char c, const char* endP)
+{
+    const char* p;
+
+    p = (const char*)memchr(strP, c, endP - strP);
+    return (p != 0) ? p : endP;
+}
 
 
 
-// update altSegm for next iteration
-//
-// - search for righmost altSegm nextP
-// - if found, move to next element
-// parm
-//  parseP  ptr from where to seach altSegm
+// search for next line end \r or \n in [strP, endP)
+// vector version compares 16/32 chars at once; loads are aligned, like Charset_span(); scalar version uses memchr()
 // ret
-//  1 elements updated, require reparse
-//  0 no change, reparse not necessary
+//  ptr to char, endP if not found
 
-UInt8 AltSegmIterate(const char* regexP)
+const char* StrNewline(const char* strP, const char* endP)
 {
-    ALTSEGM* asP;
-    UInt16 t;
-    UInt16 t1;
+#if SPAN_VECTOR
+    const UInt8* p;
+    size_t len;
+    size_t n;
+
+    p = (const UInt8*)strP;
+    len = endP - strP;
+    n = 0;
 
-    t = MAX_ALTSEG;                                                 // init as not present
+    while (n < len && ((size_t)(p + n) & (SPAN_VECTOR - 1)))    // head, up to aligned address
+    {
+        if (p[n] == '\r' || p[n] == '\n')
+            return strP + n;
+        n++;
+    }
+
+#if SPAN_VECTOR == 32
+
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
 
-    for (t1 = 0; t1 < m.altSegmNum; t1++)
+    while (n < len)
     {
-        asP = &m.altSegm[t1];
-        if (asP->regexP >= regexP)                                  // if valid range
+        __m256i v = _mm256_load_si256((const __m256i*)(p + n));
+        UInt32 mask = (UInt32)(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)));
+
+        if (mask)
         {
-            if (asP->regexNextP > asP->regexBaseP)                  // if valid alt segment
-            {
-                if (t < MAX_ALTSEG)                                 // if not first one
-                {
-                    if (asP->regexNextP > m.altSegm[t].regexNextP)  // compare and tag if at the right
-                        t = t1;
-                }
-                else
-                    t = t1;                                         // first occurrence, just tag
-            }
+            n += LowBit(mask);
+            return (n < len) ? strP + n : endP;
         }
+        n += 32;
     }
 
-    if (t < MAX_ALTSEG)                                             // if alt segment found, update parsepoint
-    {
-        asP = &m.altSegm[t];
+#else
 
-#if MXREGEX_DEBUG
-        snprintf(buf, sizeof(buf), "- AltSegmIterate update regexP: %s, regexBaseP: %s <- regexNextP: %s\r\n", asP->regexP, asP->regexBaseP, asP->regexNextP);
-        OutputDebugStringA((LPCSTR)buf);
-#endif
-        asP->regexBaseP = asP->regexNextP;
-        AltSegmRemoveAt(asP->regexBaseP);                           // remove alt segments after this point
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
 
-        return 1;
+    while (n < len)
+    {
+        __m128i v = _mm_load_si128((const __m128i*)(p + n));
+        UInt32 mask = (UInt32)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+
+        if (mask)
+        {
+            n += LowBit(mask);
+            return (n < len) ? strP + n : endP;
+        }
+        n += 16;
     }
 
-#if MXREGEX_DEBUG
-    snprintf(buf, sizeof(buf), "- AltSegmIterate no change\r\n");
-    OutputDebugStringA((LPCSTR)buf);
 #endif
 
-    return 0;                                                       // no change
-}
+    return endP;
 
+#else
 
+    const char* p;
 
+    p = StrChrEnd(strP, '\n', endP);
+    return StrChrEnd(strP, '\r', p);                           // \r before \n
 
+#endif
+}
 
 
 
-// init segment vars
+// search for next start position with regex literal prefix
 // parm
-//  recurseNum  nesting level
-//  strP        ptr base str
-//  regexP      ptr base regex
-//  mode        regex flags
-//  isCap       capturing segment
+//  progP   compiled regex (with prefix)
+//  strP    ptr to str
+//  endP    ptr to end of str
 // ret
-//  REGEXSTS_OK: ok
-//  else fatal error
+//  ptr to next candidate position, 0 if prefix not found (no match)
 
-REGEX_STS SegmentInit(const UInt16 recurseNum, const char* strP, const char* regexP, const UInt16 mode, UInt8 isCap)
+const char* Prog_prefixFind(const REGEXPROG* progP, const char* strP, const char* endP)
 {
-    SEGMENT* segmentP;
+    const char* p;
+    const char* caseP;
+    const char* foldP;
+    UInt8 t;
 
-    if (recurseNum >= MAX_RECURSE)              // recurse overfflow, fail
-        return REGEXSTS_RECURSE_OVF;
+    caseP = StrChrEnd(strP, progP->prefix[0], endP);           // 1st char
+    foldP = endP;
+    if (progP->prefixFold[0] != progP->prefix[0])              // case insensitive letter: search for both cases
+        foldP = StrChrEnd(strP, progP->prefixFold[0], endP);
 
-    // init dati branch
+    while (1)
+    {
+        p = (foldP < caseP) ? foldP : caseP;                    // nearest candidate
+
+        if (endP - p < progP->prefixLen)                        // no room for prefix (or not found)
+            return 0;
 
-    segmentP = &m.segment[recurseNum];
+        for (t = 1; t < progP->prefixLen; t++)                  // check following chars
+        {
+            if (p[t] != progP->prefix[t] && p[t] != progP->prefixFold[t])
+                break;
+        }
 
-    segmentP->strP = strP;                      // ptr str base
-    segmentP->strParseP = strP;                 // ptr str in parsing
-    segmentP->regexP = regexP;                  // ptr regex base
-    segmentP->regexParseP = regexP;             // ptr regex in parsing
-    segmentP->strCapP = strP;                   // ptr capture str
-    segmentP->mode = mode;                      // segment mode
-    segmentP->isCap = isCap;                    // is a capture
-    segmentP->anchorSOSfail = 0;  
-    segmentP->isCI = (mode & REGEXMODE_CASE_INSENSITIVE) ? 1 : 0;       // set initial case insensitive flag
+        if (t == progP->prefixLen)
+            return p;                                           // FOUND
 
-    return REGEXSTS_OK;
+        if (p == caseP)                                         // search again the case taken
+            caseP = StrChrEnd(p + 1, progP->prefix[0], endP);
+        else
+            foldP = StrChrEnd(p + 1, progP->prefixFold[0], endP);
+    }
 }
 
 
 
-
-// save caps if is capture
+// search for required literal of regex in [strP, endP): rarest char first (memchr), then the whole literal around it
+// a match starting at strP or later contains the literal, so if not found str can't match
 // ret
-// 1 ok, 0 fail (see retSts)
-// NOTE caps[0] is reserved to match, start from caps[1]
+//  1 found, 0 not found (NO MATCH)
 
-UInt8 CapsSave(SEGMENT* segmentP)
+UInt8 Prog_mustFind(const REGEXPROG* progP, const char* strP, const char* endP)
 {
-    CAPS* capsP;
-    UInt16 t;
+    const char* p;
+    const char* caseP;
+    const char* foldP;
+    const char* lastP;
+    UInt8 rare;
+    UInt8 t;
+
+    if (endP - strP < progP->mustLen)
+        return 0;
 
-    if (segmentP->isCap)                                    // IF IS CAPTURE, SAVE TO CAPS
+    rare = progP->mustRare;
+    p = strP + rare;                                            // rarest char is in [p, lastP)
+    lastP = endP - (progP->mustLen - rare - 1);
+
+    caseP = StrChrEnd(p, progP->must[rare], lastP);
+    foldP = lastP;
+    if (progP->mustFold[rare] != progP->must[rare])             // case insensitive letter: search for both cases
+        foldP = StrChrEnd(p, progP->mustFold[rare], lastP);
+
+    while (1)
     {
-        capsP = 0;
-        for (t = 1; t < m.capsNum; t++)                     // check if parsepoint already present (one bracket pair may add only one caps)
-        {
-            capsP = &m.caps[t];
-            if (capsP->regexP == segmentP->regexP           // is caps already present or null: overwrite
-                || capsP->regexP == 0)
-                goto BR_SAVE;
-        }
+        p = (foldP < caseP) ? foldP : caseP;                    // nearest candidate
 
-        if (m.capsNum >= MAX_CAPS)                      	// check for ovf, add new caps
-        {
-            m.retSts = REGEXSTS_CAPS_OVS;
+        if (p >= lastP)
             return 0;
-        }
 
-        capsP = &m.caps[m.capsNum++];                       // add new caps
-
-    BR_SAVE:
+        for (t = 0; t < progP->mustLen; t++)                    // check whole literal
+        {
+            if (p[t - rare] != progP->must[t] && p[t - rare] != progP->mustFold[t])
+                break;
+        }
 
-        capsP->regexP = segmentP->regexP;
-        capsP->strP = segmentP->strCapP;
-        capsP->len = segmentP->strParseP - segmentP->strCapP;
+        if (t == progP->mustLen)
+            return 1;                                           // FOUND
 
-#if MXREGEX_DEBUG
-        snprintf(buf, sizeof(buf), "- CapsSave %d regexP: %s strP: %s len: %d \r\n", t, capsP->regexP, capsP->strP, capsP->len);
-        OutputDebugStringA((LPCSTR)buf);
-#endif
+        if (p == caseP)                                         // search again the case taken
+            caseP = StrChrEnd(p + 1, progP->must[rare], lastP);
+        else
+            foldP = StrChrEnd(p + 1, progP->mustFold[rare], lastP);
     }
-
-    return 1;
 }
 
 
 
-// remove all caps after regexP (included)
+// search for next line start (multiline anchor ^), with regex literal prefix if any
+// line starts are str begin and the positions after \r or \n, found by a vectorized scan of line ends;
+// with a prefix, the prefix is searched first, and a prefix within a line skips the rest of the line
+// parm
+//  progP       compiled regex
+//  strOrigP    ptr to str begin
+//  strP        search start
+//  endP        ptr to end of str
+// ret
+//  ptr to next candidate position, 0 if none (no match)
 
-void CapsRemove(const char* regexP)
+const char* Prog_lineFind(const REGEXPROG* progP, const char* strOrigP, const char* strP, const char* endP)
 {
-    CAPS* cP;
-    UInt16 t;
-
-    for (t = 0; t < m.capsNum; t++)
+    while (1)
     {
-        cP = &m.caps[t];
-        if (cP->regexP >= regexP)
+        if (strP > strOrigP && strP[-1] != '\r' && strP[-1] != '\n')     // within a line: skip to next line
         {
-#if MXREGEX_DEBUG
-            snprintf(buf, sizeof(buf), "- CapsRemove %d, regexP: %s removed at: %s\r\n", t, regexP, cP->regexP);
-            OutputDebugStringA((LPCSTR)buf);
-#endif
-            cP->regexP = 0;
+            if ((strP = StrNewline(strP, endP)) == endP)
+                return 0;
+            strP++;
         }
-    }
-
-    return;
-}
 
+        if (progP->prefixLen == 0)
+            return strP;                                        // FOUND
 
+        if ((strP = Prog_prefixFind(progP, strP, endP)) == 0)
+            return 0;                                           // prefix not found
 
+        if (strP == strOrigP || strP[-1] == '\r' || strP[-1] == '\n')
+            return strP;                                        // FOUND, prefix at line start
+    }
+}
 
 
 
-// recursive regex parser
-// possible captures will be saved to caps, incrementing capsNum
-// parm:
-//  recurseNum: recursion depth; bound check in MxRegex_init
+// search for next start position of backtracking regex: next line start (multiline regex anchored by ^),
+// or next position with literal prefix, else strP. A regex anchored by ^ (not multiline) starts at str begin only.
+// Start positions are pruned by match len: a match needs min len chars, and a regex anchored by $ with a max len
+// can't start before end of str - max len
 // ret
-//  1 regex match
-//  0 fail, check retSts for fatal errors
+//  ptr to next candidate position, 0 if none (no match)
 
-UInt8 MxRegex_(UInt16 recurseNum)
+const char* Prog_startFind(const MXREGEX_M* mP, const char* strP)
 {
-    SEGMENT* segmentP;
-    BACKTRACK* backtrackP;
+    const REGEXPROG* progP;
 
-    static UInt16 t;                                                // locals not used in recursion, can be static
-    static const char* cP;
+    progP = mP->progP;
 
-    segmentP = &m.segment[recurseNum];
+    if (progP->isLineStart && !mP->isMultiLine && strP > mP->strOrigP)
+        return 0;
 
-    segmentP->segmNumOcc = 0;
-    segmentP->parseFailed = 0;
-    segmentP->isEnoughOcc = 0;
-    segmentP->strCharAcquired = 0;                                  // clear flag char acquired
+    if (progP->isEndAnchor && !mP->isMultiLine && progP->maxLen < (size_t)(mP->strEndP - strP))
+        strP = mP->strEndP - progP->maxLen;
 
+    if (progP->isLineStart && mP->isMultiLine)
+        strP = Prog_lineFind(progP, mP->strOrigP, strP, mP->strEndP);
+    else if (progP->prefixLen)
+        strP = Prog_prefixFind(progP, strP, mP->strEndP);
 
-    if ((cP = AltSegmGet(segmentP->regexP)))                        // get current alternative segment (0 = not found).
-    {
-        segmentP->regexParseP = cP;                                 // if exists, set parser
-#if MXREGEX_DEBUG
-        snprintf(buf, sizeof(buf), "- initial AltSegmGet regexP: %s, regexParseP: %s\r\n", segmentP->regexP, segmentP->regexParseP);
-        OutputDebugStringA((LPCSTR)buf);
-#endif
+    if (strP == 0 || (size_t)(mP->strEndP - strP) < progP->minLen)
+        return 0;
+
+    return strP;
+}
+
+
+
+// load compiled atom to working atom mP->atom
+// if it's a possible backtrack position, add it (see BacktrackAdd)
+// parm
+//  regexP      ptr to compiled atom
+//  iteration   segment iteration
+
+void Atom_fetch(MXREGEX_M* mP, const REGEXINST* regexP, const REGEXOFS iteration)
+{
+    mP->atom.type = (ATOM_TYPE)regexP->type;
+    mP->atom.c = regexP->c;
+    mP->atom.cFold = regexP->cFold;
+    mP->atom.minOcc = regexP->minOcc;
+    mP->atom.maxOcc = regexP->maxOcc;
+
+    if (regexP->type == ATOMTYPE_METACLASS)
+    {
+        mP->atom.charsetP = &mP->progP->charset[regexP->charsetIdx];
+        mP->atom.charsetLutP = mP->progP->charsetLut[regexP->charsetIdx];
+    }
+
+    if (mP->atom.minOcc < mP->atom.maxOcc)                      // if it's a possible trackback position, add if necessary
+        BacktrackAdd(mP, regexP + 1, iteration);
+
+    return;
+}
+
+
+
+
+
+
+//
+// ALTERNATIVE SEGMENTS
+//
+
+
+// add or update alternative segment
+// referenced by ptr to start of alternative segment group in regex i.e. regex 1st char or after a (
+// if new item, set regexBaseP = regexP, otherwise first copy former regexNextP as regexBaseP only if regexNextP has changed
+// parm
+//  regexP              ptr reference segment
+//  regexNextP          ptr next alternative segment
+//  setAltSegmChanged   set altSegmChanged if updated
+// ret
+//  1 ok, 0 fail, set retSts
+
+UInt8 AltSegmAdd(MXREGEX_M* mP, const REGEXINST* regexP, const REGEXINST* regexNextP)
+{
+    ALTSEGM* asP;
+    UInt16 t;
+
+    for (t = 0; t < mP->altSegmNum; t++)
+    {
+        asP = &mP->altSegm[t];
+
+        if (asP->regexP == regexP)                          // if position already present
+        {
+            if (asP->regexNextP != regexNextP)              // if update value
+            {
+                asP->regexBaseP = asP->regexNextP;
+                asP->regexNextP = regexNextP;
+
+                mP->altSegmChanged = 1;
+                TRACE(mP, REGEXTRACE_ALTSEGM_ADD, mP->traceRecurseNum, 0, regexP, RegexOfs(mP, regexNextP));
+            }
+            return 1;
+        }
+    }
+
+    // here add a new location
+
+    if (mP->altSegmNum >= mP->limit.altSegmNum)               // check ovf
+    {
+        mP->retSts = REGEXSTS_ALTSEGM_OVF;
+        return 0;
+    }
+
+    asP = &mP->altSegm[mP->altSegmNum++];
+    STATS_PEAK(mP, altSegmPeak, mP->altSegmNum);
+    asP->regexP = regexP;
+    asP->regexBaseP = regexP;
+    asP->regexNextP = regexNextP;
+
+    mP->altSegmChanged = 1;
+    TRACE(mP, REGEXTRACE_ALTSEGM_ADD, mP->traceRecurseNum, 0, regexP, RegexOfs(mP, regexNextP));
+
+    return 1;
+}
+
+
+
+
+// get alternative segment descriptor
+// referenced by ptr to start of alternative segment group in regex i.e. regex 1st char or after a (
+// parm
+//  regexP    ptr alternative segments base
+// ret
+//  ptr descriptor, 0 not found
+
+ALTSEGM* AltSegmFind(MXREGEX_M* mP, const REGEXINST* regexP)
+{
+    ALTSEGM* asP;
+    UInt16 t;
+
+    for (t = 0; t < mP->altSegmNum; t++)
+    {
+        asP = &mP->altSegm[t];
+        if (asP->regexP == regexP)
+            return asP;                                     // found
+    }
+
+    return 0;                                               // not found
+}
+
+
+
+
+// get ptr to active alternative segment regexBaseP
+// parm
+//  regexP    ptr alternative segments base
+// ret
+//  ptr current alternative segment
+//  0 no alternative segment found
+
+const REGEXINST* AltSegmGet(MXREGEX_M* mP, const REGEXINST* regexP)
+{
+    ALTSEGM* asP;
+
+    asP = AltSegmFind(mP, regexP);
+    return asP != 0 ? asP->regexBaseP : 0;
+}
+
+
+
+
+// remove all alternative segments AFTER regexBaseP, remove empty
+// parm
+//  regexP  ptr after which descriptor will be removed  0 -> all
+
+void AltSegmRemoveAt(MXREGEX_M* mP, const REGEXINST* regexP)
+{
+    ALTSEGM* asP;
+    UInt16 t;
+    UInt16 t1;
+
+    t1 = 0;
+    for (t = 0; t < mP->altSegmNum; t++)
+    {
+        asP = &mP->altSegm[t];
+        if (asP->regexP > regexP                        // if to be removed or empty: remove
+            || asP->regexP == 0)
+        {
+            TRACE(mP, REGEXTRACE_ALTSEGM_REMOVE, mP->traceRecurseNum, 0, regexP, RegexOfs(mP, asP->regexP));
+            continue;
+        }
+        if (t1 != t)
+        {
+            mP->altSegm[t1].regexP = asP->regexP;
+            mP->altSegm[t1].regexBaseP = asP->regexBaseP;
+            mP->altSegm[t1].regexNextP = asP->regexNextP;
+        }
+        t1++;
     }
 
-    while (1)
-    {
+    if (t1 != t)
+    {
+        mP->altSegmNum = t1;                                  // adj if changed
+        mP->altSegmChanged = 1;
+    }
+
+    return;
+}
+
+
+
+
+// search for alternative segment
+// nested brackets are skipped using compiled jump idx
+//
+// parm
+//  segmentP
+//  mode 0: search for ')', 1: search for '|' or ')',
+// ret
+//  0 no further alt segment (EOS reached)
+//  1 found ')', mP->atom.minOcc mP->atom.maxOcc set to bracket quantifier
+//  2 found '|'
+//  segmentP->regexParseP updated to atom after closing element
+
+UInt8 AltSegmSearch(MXREGEX_M* mP, SEGMENT* segmentP, UInt8 mode)
+{
+    const REGEXINST* iP;
+
+    iP = segmentP->regexParseP;
+
+    while (1)
+    {
+        switch (iP->type)
+        {
+        case ATOMTYPE_EOS:                              // if EOS reached, search end
+            segmentP->regexParseP = iP;
+            return 0;                                   // element not found
+
+        case ATOMTYPE_PIPE:
+            if (mode == 1)                              // if found | start alternative block on current nesting level
+            {
+                segmentP->regexParseP = iP + 1;         // resume regex from atom after |
+                return 2;                               // got |
+            }
+            iP = &mP->progP->inst[iP->jump];              // move to next | or closing bracket on same level
+            continue;
+
+        case ATOMTYPE_BRACKETOPEN:                      // skip nested brackets
+            iP = &mP->progP->inst[iP->jump] + 1;
+            continue;
+
+        case ATOMTYPE_BRACKETCLOSE:                     // closing bracket of current level
+            mP->atom.minOcc = iP->minOcc;                 // get bracket quantifier
+            mP->atom.maxOcc = iP->maxOcc;
+            segmentP->regexParseP = iP + 1;
+            return 1;
+
+        default:
+            iP++;
+            break;
+        }
+    }//while 1
+
+}
+
+
+
+
+// search altSegm for next iteration: rightmost bracket (i.e. nested first) between regexP and regexEndP (excluded),
+// with a following alternative segment
+// parm
+//  regexP      ptr from where alt segments are considered
+//  regexEndP   ptr end of alt segments considered
+// ret
+//  ptr to alt segment, 0 if none
+
+ALTSEGM* AltSegmNext(MXREGEX_M* mP, const REGEXINST* regexP, const REGEXINST* regexEndP)
+{
+    ALTSEGM* asP;
+    ALTSEGM* retP;
+    UInt16 t1;
+
+    retP = 0;
+
+    for (t1 = 0; t1 < mP->altSegmNum; t1++)
+    {
+        asP = &mP->altSegm[t1];
+        if (asP->regexP >= regexP && asP->regexP < regexEndP        // if valid range
+            && asP->regexNextP > asP->regexBaseP                    //  and valid alt segment
+            && (retP == 0 || asP->regexP > retP->regexP))           //  and at the right: tag
+            retP = asP;
+    }
+
+    return retP;
+}
+
+
+
+// update altSegm for next iteration: move to next alternative segment,
+// restart alt segments and backtracks at the right of bracket (they will be reevaluated)
+// parm
+//  asP     alt segment, see AltSegmNext()
+
+void AltSegmIterate(MXREGEX_M* mP, ALTSEGM* asP)
+{
+    const REGEXINST* regexP;
+    UInt16 t1;
+
+    TRACE(mP, REGEXTRACE_ALTSEGM_ITERATE, mP->traceRecurseNum, 0, asP->regexP, RegexOfs(mP, asP->regexNextP));
+    asP->regexBaseP = asP->regexNextP;
+    regexP = asP->regexP;
+    AltSegmRemoveAt(mP, regexP);                                    // remove alt segments after this point
+
+    for (t1 = 0; t1 < mP->backtrackNum; t1++)
+        if (mP->backtrack[t1].regexParseP > regexP)
+            mP->backtrack[t1].maxOcc = BACKTRACK_MAXOCC;
+
+    STATS_INC(mP, altSegmRetryNum);
+    return;
+}
+
+
+
+
+// iterate rightmost choice point between regexP and regexEndP (excluded), leftmost first order:
+// a quantifier gives back one occurrence (backtrack), or a bracket moves to next alternative segment
+// ret
+//  1 updated, require reparse
+//  0 no choice left
+
+UInt8 ChoiceIterate(MXREGEX_M* mP, const REGEXINST* regexP, const REGEXINST* regexEndP)
+{
+    BACKTRACK* bP;
+    ALTSEGM* asP;
+
+    bP = BacktrackNext(mP, regexP, regexEndP);
+    asP = AltSegmNext(mP, regexP, regexEndP);
+
+    if (asP != 0 && (bP == 0 || bP->regexParseP <= asP->regexP))  // backtrack within bracket or at the right of it goes first
+    {
+        AltSegmIterate(mP, asP);
+        return 1;
+    }
+
+    if (bP != 0)
+    {
+        BacktrackIterate(mP, bP);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+
+
+
+// init segment vars
+// parm
+//  recurseNum  nesting level
+//  strP        ptr base str
+//  regexP      ptr base regex
+//  mode        regex flags
+//  isCap       capturing segment
+// ret
+//  REGEXSTS_OK: ok
+//  else fatal error
+
+REGEX_STS SegmentInit(MXREGEX_M* mP, const UInt16 recurseNum, const char* strP, const REGEXINST* regexP, const UInt16 mode, UInt8 isCap)
+{
+    SEGMENT* segmentP;
+
+    if (recurseNum >= mP->limit.recurseNum)     // recurse overfflow, fail
+        return REGEXSTS_RECURSE_OVF;
+
+    // init dati branch
+
+    segmentP = &mP->segment[recurseNum];
+
+    segmentP->strP = strP;                      // ptr str base
+    segmentP->strParseP = strP;                 // ptr str in parsing
+    segmentP->regexP = regexP;                  // ptr regex base
+    segmentP->regexParseP = regexP;             // ptr regex in parsing
+    segmentP->strCapP = strP;                   // ptr capture str
+    segmentP->mode = mode;                      // segment mode
+    segmentP->isCap = isCap;                    // is a capture
+
+    return REGEXSTS_OK;
+}
+
+
+
+
+// save caps if is capture
+// ret
+// 1 ok, 0 fail (see retSts)
+// NOTE caps[0] is reserved to match, start from caps[1]
+
+UInt8 CapsSave(MXREGEX_M* mP, SEGMENT* segmentP)
+{
+    CAPS* capsP;
+    UInt16 t;
+
+    if (segmentP->isCap)                                    // IF IS CAPTURE, SAVE TO CAPS
+    {
+        capsP = 0;
+        for (t = 1; t < mP->capsNum; t++)                     // check if parsepoint already present (one bracket pair may add only one caps)
+        {
+            capsP = &mP->caps[t];
+            if (capsP->regexP == segmentP->regexP           // is caps already present or null: overwrite
+                || capsP->regexP == 0)
+                goto BR_SAVE;
+        }
+
+        if (mP->capsNum >= mP->limit.capsNum)             	// check for ovf, add new caps
+        {
+            mP->retSts = REGEXSTS_CAPS_OVS;
+            return 0;
+        }
+
+        capsP = &mP->caps[mP->capsNum++];                       // add new caps
+
+    BR_SAVE:
+
+        capsP->regexP = segmentP->regexP;
+        capsP->strP = segmentP->strCapP;
+        capsP->len = segmentP->strParseP - segmentP->strCapP;
+
+        TRACE(mP, REGEXTRACE_CAPS_SAVE, mP->traceRecurseNum, capsP->strP, capsP->regexP, t);
+    }
+
+    return 1;
+}
+
+
+
+// remove all caps after regexP (included)
+
+void CapsRemove(MXREGEX_M* mP, const REGEXINST* regexP)
+{
+    CAPS* cP;
+    UInt16 t;
+
+    for (t = 0; t < mP->capsNum; t++)
+    {
+        cP = &mP->caps[t];
+        if (cP->regexP >= regexP)
+        {
+            TRACE(mP, REGEXTRACE_CAPS_REMOVE, mP->traceRecurseNum, 0, cP->regexP, t);
+            cP->regexP = 0;
+        }
+    }
+
+    return;
+}
+
+
+
+
+
+
+// recursive regex parser
+// possible captures will be saved to caps, incrementing capsNum
+// parm:
+//  recurseNum: recursion depth; bound check in MxRegex_init
+// ret
+//  1 regex match
+//  0 fail, check retSts for fatal errors
+
+UInt8 MxRegex_(MXREGEX_M* mP, UInt16 recurseNum)
+{
+    SEGMENT* segmentP;
+    BACKTRACK* backtrackP;
+
+    REGEXOFS t;
+    const REGEXINST* cP;
+
+    segmentP = &mP->segment[recurseNum];
+    STATS_PEAK(mP, recursePeak, recurseNum + 1);
+
+    segmentP->segmNumOcc = 0;
+    segmentP->parseFailed = 0;
+    segmentP->isEnoughOcc = 0;
+    segmentP->strCharAcquired = 0;                                  // clear flag char acquired
+
+
+    if ((cP = AltSegmGet(mP, segmentP->regexP)))                        // get current alternative segment (0 = not found).
+    {
+        segmentP->regexParseP = cP;                                 // if exists, set parser
+        TRACE(mP, REGEXTRACE_ALTSEGM_GET, recurseNum, segmentP->strParseP, segmentP->regexP, RegexOfs(mP, cP));
+    }
+
+    while (1)
+    {
+
+        segmentP->atomNumOcc = 0;                                   // restart counting atom occurrencies
+        backtrackP = 0;                                             // no backtrack. Will be updated on regex CHAR or METACLASS
+
+        TRACE(mP, REGEXTRACE_STEP, recurseNum, segmentP->strParseP, segmentP->regexParseP, RegexOfs(mP, segmentP->regexP));
+
+        if (mP->iterateCnt++ >= MAX_ITERATE)                          // watchdog
+        {
+            mP->retSts = REGEXSTS_MAXITERATE_OVF;
+            TRACE(mP, REGEXTRACE_MAXITERATE_OVF, recurseNum, segmentP->strParseP, segmentP->regexParseP, 0);
+            return 0;
+        }
+
+        STATS_INC(mP, atomNum);
+        STATS_FAR(mP, segmentP->strParseP);
+        Atom_fetch(mP, segmentP->regexParseP, segmentP->segmNumOcc);    // get next atom (compiled, always valid)
+        mP->retSts = REGEXSTS_OK;                                     // backtrack ovf is not fatal here, atom won't backtrack
+
+        segmentP->regexParseP++;                                    // move regex parser AFTER atom
+
+
+
+    BR_MULTIPLE_OCC:                                                // *** entrypoint multiple occurrences for same atom
+
+        switch (mP->atom.type)
+        {
+
+
+        case ATOMTYPE_EOS:                                          // end of regex \0 EOS
+
+            TRACE(mP, REGEXTRACE_EOS, recurseNum, segmentP->strParseP, segmentP->regexParseP, 0);
+
+            if (recurseNum > 0)                                     // if nested, missing ), fatal
+            {
+                mP->retSts = REGEXSTS_SYNTAX;
+                return 0;
+            }
+            return 1;                                               // REGEX MATCH, complete
+
+
+
+        case ATOMTYPE_PIPE:                                         // | alternative segment, here only if there was a match
+
+            TRACE(mP, REGEXTRACE_PIPE, recurseNum, segmentP->strParseP, segmentP->regexParseP, 0);
+
+            if (recurseNum == 0)                                    // if NOT nested
+            {
+                segmentP->regexParseP--;                            // remove | from result
+                return 1;                                           // REGEX MATCH, complete
+            }
+
+            // here recurseNum > 0, it's a nested alternative segment i.e. between (..):
+            // we save the the pointer where to resume regex parsing if same segment is re-evaluated.
+
+            if (!CapsSave(mP, segmentP))                                // save caps if is capture
+                return 0;
+
+            // save starting point for next iteration
+
+            AltSegmAdd(mP, segmentP->regexP, segmentP->regexParseP);    // save next segment, if follows
+
+            if (AltSegmSearch(mP, segmentP, 0))                         // search for closing bracket, if found:
+                goto BR_BRACKETCLOSE;                               // handle as bracket close with quantifier
+
+            // no closing bracket, fatal
+
+            mP->retSts = REGEXSTS_SYNTAX;
+            return 0;
+
+
+
+        case ATOMTYPE_METACLASS:                                    // charset
+
+            if (mP->atom.maxOcc > segmentP->atomNumOcc + 2)           // quantified: take run of chars in charset at once (greedy)
+            {
+                t = mP->atom.maxOcc;
+                if ((REGEXOFS)(mP->strEndP - segmentP->strParseP) < t - segmentP->atomNumOcc)     // limited by end of str
+                    t = (REGEXOFS)(mP->strEndP - segmentP->strParseP) + segmentP->atomNumOcc;
+                backtrackP = 0;
+                if (mP->atom.minOcc < mP->atom.maxOcc)                // limited by backtrack
+                    if ((backtrackP = BacktrackGet(mP, segmentP->regexParseP, segmentP->segmNumOcc)) != 0 && backtrackP->maxOcc < t)
+                        t = backtrackP->maxOcc;
+
+                if (t > segmentP->atomNumOcc + 1)
+                {
+                    t = Charset_span(mP->atom.charsetLutP, segmentP->strParseP, t - segmentP->atomNumOcc);
+
+                    if (t > 1)                                      // leave last char to single char test below, that ends the run
+                    {
+                        t--;
+                        segmentP->atomNumOcc += t;
+                        segmentP->strParseP += t;
+                        segmentP->strCharAcquired = 1;
+                        if (backtrackP != 0 && mP->atom.maxOcc > backtrackP->maxOcc)
+                            mP->atom.maxOcc = backtrackP->maxOcc;
+                    }
+                }
+            }
+
+            if (segmentP->strParseP >= mP->strEndP)                   // if str at EOS, fail
+                t = 0;
+            else                                                    // case insensitive charset is folded by compiler
+                t = Atom_charInCharset(mP->atom.charsetP, *segmentP->strParseP) ? 1 : 0;  // t=1 if char in charset
+            goto BR_CHECK_MATCH_ATOM;
+
+
+
+        case ATOMTYPE_CHAR:                                         // simple char
+
+            if (segmentP->strParseP >= mP->strEndP)                   // if str at EOS, fail (atom char may be \x00)
+                t = 0;
+            else                                                    // case insensitive: char or its other case
+                t = (*segmentP->strParseP == mP->atom.c || *segmentP->strParseP == mP->atom.cFold) ? 1 : 0;
+
+        BR_CHECK_MATCH_ATOM:                                        // *** entrypoint char/charclass match test
+
+            if (mP->atom.minOcc < mP->atom.maxOcc)                       // if potential backtrack, get descriptor
+            {
+                backtrackP = BacktrackGet(mP, segmentP->regexParseP, segmentP->segmNumOcc);    // GET BACKTRACK descriptor (should always be present)
+
+                if (backtrackP != 0)
+                    if (backtrackP->maxOcc < mP->atom.minOcc || backtrackP->maxOcc == 0)    // if should fail anyway (below min: fails segment iteration)
+                        t = 0;                                       // invalidate match
+            }
+
+            if (t == 0)
+            {
+                //
+                // HERE WE HAVE A CHAR/CHARSET NO MATCH CONDITION, THERE COULD BE ALTERNATIVE SEGMENTS
+                //
+
+                // ADJ BACKTRACK FOR POSSIBLE NEXT ITERATION
+
+                if (mP->atom.minOcc < segmentP->atomNumOcc)           // if there could have been less occurrencies
+                {
+                    if (backtrackP != 0)                            // if backtrack present (should always be)
+                    {
+                        backtrackP->maxOcc = segmentP->atomNumOcc;  // update max occurrencies for next round (if needed)
+                        TRACE(mP, REGEXTRACE_BACKTRACK_MAXOCC, recurseNum, segmentP->strParseP, backtrackP->regexParseP, backtrackP->maxOcc);
+                    }
+                }
+
+                if (segmentP->atomNumOcc >= mP->atom.minOcc)          // IF MINIMUM OCCURRENCE SATISFIED, IT IS A MATCH ANYWAY
+                    break;                                          // move to next atom on same str char
+
+
+                // here regex failed search on current segment, check if follows an alternative segment |
+                // if present: restart regex parse from 1st atom of alternative segment,
+                // otherwhise: im possible, skip to ) for current nidification and evaluate quantifier for further processing
+
+            BR_SEGMENT_MATCH_FAIL:                                  // *** entrypoint segment match fail, check for alternate segments
+
+                TRACE(mP, REGEXTRACE_SEGMENT_FAIL, recurseNum, segmentP->strParseP, segmentP->regexParseP, 0);
+
+                // check for alternative segments
+
+                t = AltSegmSearch(mP, segmentP, 1);                     // check for alt segments or closing bracket
+
+                if (t == 2)                                         // if |
+                {
+                    if ((cP = AltSegmGet(mP, segmentP->regexP)) == 0)   // current alternative segment
+                        cP = segmentP->regexP;
+
+                    if (ChoiceIterate(mP, cP, segmentP->regexParseP))   // retry choice points of current alternative first
+                        goto BR_RETRY;
+
+                    if (!AltSegmAdd(mP, segmentP->regexP, segmentP->regexParseP))  // save next segment
+                        return 0;
+                    AltSegmIterate(mP, AltSegmFind(mP, segmentP->regexP));
+                    segmentP->strParseP = segmentP->strP;           // restart str parsing for this segment
+                    segmentP->strCapP = segmentP->strP;
+                    goto BR_RETRY;
+                }
+
+                if (t == 1)                                         // )
+                {
+                    segmentP->parseFailed = 1;                      // report segment fail
+                    goto BR_BRACKETCLOSE;                           // handle bracket close with quantifier
+                }
+
+                // here there is no alternate segment nor closing bracket
+
+                if (mP->retSts != REGEXSTS_OK)                        // check for fatal error condition
+                    return 0;
+
+
+                //
+                // HERE WE HAVE A REGEX NO MATCH CONDITION ON CURRENT SEGMENT
+                //
+
+                if (!segmentP->isEnoughOcc)                         // if not enough occurrences collected check for backtrack and altSegm
+                {
+                    if (ChoiceIterate(mP, segmentP->regexP, &mP->progP->inst[mP->progP->instNum]))
+                        goto BR_RETRY;
+                }
+
+                if (recurseNum > 0)                                 // if nested, remove alt segm descriptor for this segment and return no match
+                {
+                    return 0;
+                }
+
+                //
+                // here is the base segment (i.e. recurseNum == 0)
+                //
+
+                if (segmentP->strP >= mP->strEndP)                  // if str EOS reached, REGEX NO MATCH
+                {
+                    TRACE(mP, REGEXTRACE_STR_END, recurseNum, segmentP->strP, segmentP->regexP, 0);
+                    return 0;
+                }
+
+                if (mP->altSegmChanged)                               // if alternate segments changed (quantified brackets)
+                {
+                    mP->altSegmChanged = 0;
+                    mP->capsNum = 1;                              // clear all caps  (keep caps[0] as matched string, if it's a match)
+                    goto BR_RETRY;                              // repeat iteration
+                }
+
+
+                // HERE WE CAN MOVE NO NEXT STR CHAR
+
+                segmentP->strP++;                               // move to next char
+
+                if ((segmentP->strP = Prog_startFind(mP, segmentP->strP)) == 0)    // skip to next line start or position with literal prefix
+                    return 0;                                   // not found, REGEX NO MATCH
+
+                mP->backtrackNum = 0;                             // clear all backtrack
+                mP->altSegmNum = 0;                               // clear all alternate segments
+                mP->iterateCnt = 0;                               // restart watchdog
+                mP->capsNum = 1;                                  // clear all caps  (keep caps[0] as matched string, if it's a match)
+                STATS_INC(mP, startNum);
+
+                TRACE(mP, REGEXTRACE_NEXT_CHAR, recurseNum, segmentP->strP, segmentP->regexP, 0);
+
+
+            BR_RETRY:                                           // *** entrypoint retry regex on str
+
+                TRACE(mP, REGEXTRACE_RETRY, recurseNum, segmentP->strP, segmentP->regexP, 0);
+                //AltSegmRemoveAt(segmentP->regexP);
+                if ((cP = AltSegmGet(mP, segmentP->regexP)))                        // get current alternative segment (0 = not found).
+                {
+                    segmentP->regexParseP = cP;                                 // if exists, set parser
+                    TRACE(mP, REGEXTRACE_ALTSEGM_GET, recurseNum, segmentP->strP, segmentP->regexP, RegexOfs(mP, cP));
+                }
+                else
+                    segmentP->regexParseP = segmentP->regexP;   // restart regex parser
+
+                segmentP->strCharAcquired = 0;                  // clear flag char acquired
+                segmentP->parseFailed = 0;                      // clear error status for this segment
+                segmentP->strParseP = segmentP->strP;           // restart parsing
+                segmentP->strCapP = segmentP->strP;
+                if (!segmentP->isEnoughOcc)                     // str base is segment begin: occurrences restart too
+                    segmentP->segmNumOcc = 0;
+
+                CapsRemove(mP, segmentP->regexP);
+                break;                                          // continue (or restart) evaluation
+
+            }// if match fail
+
+
+            //
+            // HERE WE HAVE A MATCH CONDITION
+            //
+
+            // check if there are multiple occurrences (greedy): if not, move to next str char
+
+            segmentP->atomNumOcc++;                                 // ++nr occurrencies found
+
+            if (backtrackP != 0)                                    // if backtrack present
+            {
+                if (mP->atom.maxOcc > backtrackP->maxOcc)
+                {
+                    mP->atom.maxOcc = backtrackP->maxOcc;             // adj maxOcc
+                    TRACE(mP, REGEXTRACE_BACKTRACK_MAXOCC, recurseNum, segmentP->strParseP, backtrackP->regexParseP, backtrackP->maxOcc);
+                }
+            }
+
+            segmentP->strParseP++;                                  // move to next str char (THIS IS THE ONLY PLACE WHERE IT HAPPENS)
+            segmentP->strCharAcquired = 1;                          // set flag
+
+            if (segmentP->atomNumOcc < mP->atom.maxOcc)               // if max occurrencies NOT reached, repeat test on next str char
+                goto BR_MULTIPLE_OCC;
+
+            //
+            // HERE QUANTIFIER IS FULLFILLED
+            //
+
+            // ADJ BACKTRACK FOR NEXT ITERATION
+
+            if (mP->atom.minOcc < segmentP->atomNumOcc)               // if there could have been less occurrencies
+            {
+                if ((backtrackP = BacktrackGet(mP, segmentP->regexParseP, segmentP->segmNumOcc)))     // if backtrack present (should always be)
+                {
+                    backtrackP->maxOcc = segmentP->atomNumOcc;      // update max occurrencies for next round (if needed)
+                    TRACE(mP, REGEXTRACE_BACKTRACK_MAXOCC, recurseNum, segmentP->strParseP, backtrackP->regexParseP, backtrackP->maxOcc);
+                }
+            }
+
+            break;                                                  // move to next atom
+
+
+
+        case ATOMTYPE_ANCHOR:                                       // anchor ^ $ \b ..
+
+            if (mP->atom.c == '^')                                    // ^ match only from str begin
+            {
+                if (segmentP->strParseP == mP->strOrigP)              // if 1st char: ok
+                    break;
+
+                if (mP->isMultiLine)                                  // if multiline: ok also if preceding char was \r or \n
+                {
+                    if (segmentP->strParseP[-1] == '\r' || segmentP->strParseP[-1] == '\n')
+                        break;
+                }
+                TRACE(mP, REGEXTRACE_ANCHOR_FAIL, recurseNum, segmentP->strParseP, segmentP->regexParseP - 1, '^');
+                goto BR_SEGMENT_MATCH_FAIL;                         // fail
+            }
+
+            if (mP->atom.c == '$')                                    // $ end of string EOS
+            {
+                // check char following current one
+
+                if (mP->isMultiLine)                                  // multiline EOS \n \r  if no match, move to next str char
+                {
+                    if (segmentP->strParseP < mP->strEndP
+                        && *segmentP->strParseP != '\r'
+                        && *segmentP->strParseP != '\n')
+                    {
+                        TRACE(mP, REGEXTRACE_ANCHOR_FAIL, recurseNum, segmentP->strParseP, segmentP->regexParseP - 1, '$');
+                        goto BR_SEGMENT_MATCH_FAIL;                         // fail
+                    }
+                }
+                else
+                {
+                    if (segmentP->strParseP < mP->strEndP)          // singleline EOS
+                    {
+                        TRACE(mP, REGEXTRACE_ANCHOR_FAIL, recurseNum, segmentP->strParseP, segmentP->regexParseP - 1, '$');
+                        goto BR_SEGMENT_MATCH_FAIL;                         // fail
+                    }
+                }
+                break;
+            }
+
+            if (mP->atom.c == 'b')                                    // \b word boundary   transition \W->\w or \w->\W
+            {
+                if (IsWordBefore(mP, segmentP->strParseP) != IsWordAt(mP, segmentP->strParseP))   // if transition from preceding char (begin of str is \W), ok
+                    break;
+
+                goto BR_SEGMENT_MATCH_FAIL;                         // no match, move to next str char
+
+            }
+
+            if (mP->atom.c == 'B')                                    // \B non-word boundary
+            {
+                if (IsWordBefore(mP, segmentP->strParseP) == IsWordAt(mP, segmentP->strParseP))   // if no transition from preceding char, ok
+                    break;
+
+                goto BR_SEGMENT_MATCH_FAIL;                         // no match, move to next str char
+            }
 
-        segmentP->atomNumOcc = 0;                                   // restart counting atom occurrencies
-        backtrackP = 0;                                             // no backtrack. Will be updated on regex CHAR or METACLASS
+            // unhandled anchor, ignore and treat as a match
 
-#if MXREGEX_DEBUG
-        snprintf(buf, sizeof(buf), "%4d %2d %-50s %-70s %-50s %-70s\r\n",
-            ++step,
-            recurseNum,
-            segmentP->strParseP,
-            segmentP->regexParseP,
-            segmentP->strP,
-            segmentP->regexP
-        );
-        OutputDebugStringA((LPCSTR)buf);
-        if (step == 1)
-        {
-            Nop();                                                  // breakpoint at step n
-        }
-#endif
+            break;
 
-        if (m.iterateCnt++ >= MAX_ITERATE)                          // watchdog
-        {
-            m.retSts = REGEXSTS_MAXITERATE_OVF;
-            return 0;
-        }
 
-        if ((m.retSts = GetRegexAtom(segmentP->regexParseP, segmentP->isCI, segmentP->segmNumOcc)) != REGEXSTS_OK)    // get next atom
-            return 0;                                                           // if errors reported, fail
 
-        segmentP->regexParseP = m.atom.endP;                        // move regex parser AFTER atom
+        case ATOMTYPE_BRACKETOPEN:                                  // (  inizio sub-regex
 
+            TRACE(mP, REGEXTRACE_BRACKET_OPEN, recurseNum, segmentP->strParseP, segmentP->regexParseP - 1, 0);
 
+            t = segmentP->regexParseP[-1].isCap;                    // check if capture (non-capture (?: already skipped by compiler)
 
-    BR_MULTIPLE_OCC:                                                // *** entrypoint multiple occurrences for same atom
+            if ((mP->retSts = SegmentInit(mP, recurseNum + 1, segmentP->strParseP, segmentP->regexParseP, segmentP->mode, t)) != REGEXSTS_OK)
+                return 0;                                           // init parser, exit on error
 
-        switch (m.atom.type)
-        {
+            if (!MxRegex_(mP, recurseNum + 1))                          // INVOKE NESTED REGEX
+            {
+                if (mP->retSts != REGEXSTS_OK)                        // if any fatal error
+                {
+                    segmentP->regexParseP = mP->segment[recurseNum + 1].regexParseP;  // save error position
+                    return 0;                                                       // and fail
+                }
 
+                segmentP->regexParseP = mP->segment[recurseNum + 1].regexParseP;
+                goto BR_SEGMENT_MATCH_FAIL;
+            }
 
-        case ATOMTYPE_EOS:                                          // end of regex \0 EOS
+            // sub reges success, adj str and regex parsing point, continue eval from there
 
-#if MXREGEX_DEBUG
-            snprintf(buf, sizeof(buf), "- lev = %d EOS\r\n", recurseNum);
-            OutputDebugStringA((LPCSTR)buf);
-#endif
+            segmentP->strParseP = mP->segment[recurseNum + 1].strParseP;
+            segmentP->regexParseP = mP->segment[recurseNum + 1].regexParseP;
 
-            if (recurseNum > 0)                                     // if nested, missing ), fatal
+            break;
+
+
+
+        case ATOMTYPE_BRACKETCLOSE:                                 // ) end of nested regex, here only if there was a match
+
+        BR_BRACKETCLOSE:                                            // *** entrypoint parse bracket close after pipe |  (match or non match)
+
+            TRACE(mP, REGEXTRACE_BRACKET_CLOSE, recurseNum, segmentP->strParseP, segmentP->regexParseP - 1, 0);
+
+            if (recurseNum == 0)                                    // if not nested, not allowed
             {
-                m.retSts = REGEXSTS_SYNTAX;
+                mP->retSts = REGEXSTS_SYNTAX;
                 return 0;
             }
-            return 1;                                               // REGEX MATCH, complete
-
 
+            if (mP->atom.minOcc < mP->atom.maxOcc)                      // if it's a possible trackback position, add if necessary
+                BacktrackAdd(mP, segmentP->regexParseP, 0);
 
-        case ATOMTYPE_PIPE:                                         // | alternative segment, here only if there was a match
+            backtrackP = BacktrackGet(mP, segmentP->regexParseP, 0);    // GET BACKTRACK descriptor (should always be present)
 
-#if MXREGEX_DEBUG
-            snprintf(buf, sizeof(buf), "- lev = %d PIPE\r\n", recurseNum);
-            OutputDebugStringA((LPCSTR)buf);
-#endif
+            if (mP->atom.minOcc < mP->atom.maxOcc)                      // if potential backtrack, get descriptor
+            {
+                if (backtrackP != 0)
+                    if (backtrackP->maxOcc == 0 || backtrackP->maxOcc < mP->atom.minOcc)   // if should fail anyway (below min occurrencies)..
+                        return 0;                                   // return no match
+            }
 
-            if (recurseNum == 0)                                    // if NOT nested
+            if (segmentP->parseFailed)                              // if no match
             {
-                segmentP->regexParseP--;                            // remove | from result
-                return 1;                                           // REGEX MATCH, complete
+                if (mP->atom.minOcc <= segmentP->segmNumOcc)          // if ENOUGH occurrencies according to quantifier, success
+                {
+                    if (backtrackP != 0)
+                    {
+                        backtrackP->maxOcc = segmentP->segmNumOcc;  // update max occurrencies for next round (if needed)
+                        TRACE(mP, REGEXTRACE_BACKTRACK_MAXOCC, recurseNum, segmentP->strParseP, backtrackP->regexParseP, backtrackP->maxOcc);
+                    }
+                    TRACE(mP, REGEXTRACE_BRACKET_MATCH, recurseNum, segmentP->strCapP, segmentP->regexP, mP->atom.minOcc);
+                    // restore possible parsed str chars if last iteration failed
+                    segmentP->strParseP = segmentP->strCapP;
+                    return 1;
+                }
+
+
+                TRACE(mP, REGEXTRACE_BRACKET_FAIL, recurseNum, segmentP->strParseP, segmentP->regexP, 0);
+
+                return 0;                                           // otherwise fail
             }
 
-            // here recurseNum > 0, it's a nested alternative segment i.e. between (..):
-            // we save the the pointer where to resume regex parsing if same segment is re-evaluated.
 
-            if (!CapsSave(segmentP))                                // save caps if is capture
+
+            // HERE WE HAVE A SEGMENT MATCH.
+            // If capture, save result (only last one). See also PIPE
+
+
+            if (!CapsSave(mP, segmentP))                                // fail to save: fatal REGEXSTS_CAPS_OVS
                 return 0;
 
-            // save starting point for next iteration
+            segmentP->segmNumOcc++;                                 // INCREMENT NR OCCURRENCIES
 
-#if MXREGEX_DEBUG
-            snprintf(buf, sizeof(buf), "- Pipe MATCH: lev = %d, set alternative segment to %s\r\n", recurseNum, segmentP->regexParseP);
-            OutputDebugStringA((LPCSTR)buf);
-#endif
+            if (backtrackP != 0)                                    // if backtrack present
+            {
+                if (mP->atom.maxOcc > backtrackP->maxOcc)
+                {
+                    mP->atom.maxOcc = backtrackP->maxOcc;             // adj maxOcc
+                    TRACE(mP, REGEXTRACE_BACKTRACK_MAXOCC, recurseNum, segmentP->strParseP, backtrackP->regexParseP, backtrackP->maxOcc);
+                }
+            }
+
+            // check quantifier
+
+            if (segmentP->segmNumOcc >= mP->atom.maxOcc)               // if reached max occurrencies according to quantifier: success
+                return 1;
 
-            AltSegmAdd(segmentP->regexP, segmentP->regexParseP);    // save next segment, if follows
+            if (!segmentP->strCharAcquired)                         // if minOcc == 0 and no char captured, cannot be greedy
+                return 1;
+
+            segmentP->strCharAcquired = 0;                          // retrig flag char acquired
 
-            if (AltSegmSearch(segmentP, 0))                         // search for closing bracket, if found:
+            if (segmentP->segmNumOcc >= mP->atom.minOcc)              // if got minocc, enough occurrences for segment match, no backtrack
             {
-                if (Atom_ParseQtf(segmentP->regexParseP, &t))       // if valid quantifier: save and skip it
-                    segmentP->regexParseP += t;
-                goto BR_BRACKETCLOSE;                               // handle as bracket close with quantifier
+                segmentP->strP = segmentP->strParseP;               // update base str: parsed chars are definitive
+                segmentP->isEnoughOcc = 1;
+                TRACE(mP, REGEXTRACE_ENOUGH_OCC, recurseNum, segmentP->strParseP, segmentP->regexP, 0);
             }
 
-            // no closing bracket, fatal
+            // quantifier requires more iteration, restart parser and set potential new caps start
 
-            m.retSts = REGEXSTS_SYNTAX;
-            return 0;
+            segmentP->strCapP = segmentP->strP;                     // update caps base if next iteration is a match
+            segmentP->regexParseP = segmentP->regexP;
+            break;
 
+        }// switch
 
+    }// while 1 (passa ad atom successivo)
 
-        case ATOMTYPE_METACLASS:                                    // charset
+    mP->retSts = REGEXSTS_SYNTAX;                                     // should never reach this point, fail
+    return 0;
 
-            if (segmentP->isCI)                                     // fix 1.04
-                t = Atom_charInCharset(&m.atom.charset, Upper(*segmentP->strParseP)) ? 1 : 0;  // t=1 if char in charset. NOTE if str at EOS \0, fail
-            else
-                t = Atom_charInCharset(&m.atom.charset, *segmentP->strParseP) ? 1 : 0;  // t=1 if char in charset. NOTE if str at EOS \0, fail
-            goto BR_CHECK_MATCH_ATOM;
+}// MxRegex_
+
+
+
+
+
+// clear regex parser descriptors
+
+void ClearDescriptors(MXREGEX_M* mP)
+{
+#if MXREGEX_DEBUG
+
+    UInt16 t;
+
+    // not necessary, just useful for debugging
+
+    for (t = 0; t < mP->limit.altSegmNum; t++)  // clear alternative segment info
+    {
+        mP->altSegm[t].regexP = 0;
+        mP->altSegm[t].regexBaseP = 0;
+        mP->altSegm[t].regexNextP = 0;
+    }
+
+    for (t = 0; t < mP->limit.capsNum; t++)     // clear caps info
+    {
+        mP->caps[t].len = 0;
+        mP->caps[t].strP = 0;
+    }
+
+    for (t = 0; t < mP->limit.backtrackNum; t++)    // clear backtrack info
+    {
+        mP->backtrack[t].maxOcc = 0;
+        mP->backtrack[t].minOcc = 0;
+        mP->backtrack[t].regexParseP = 0;
+    }
+
+#endif
+
+    mP->altSegmNum = 0;
+    mP->capsNum = 0;
+    mP->backtrackNum = 0;
+
+    return;
+}
+
+
+
+
+
+
+//
+// PUBLIC METHODS
+//
+
+
+// Init regex machine
+// MUST be called once at startup
+
+void MxRegex_init()
+{
+
+#if !CONST_CHARSET
+
+    REGEXATOM atom;
+    REGEXATOM* atomP;
+
+    // prepare predefined charset
+    // used for code optimization in case of complex sets
+    // could be hardcoded in order to save RAM (160 bytes)
+
+    atomP = &atom;
+
+    Atom_charsetResetAll(atomP);                                         // . (include \r\n)
+    Atom_charsetInvert(atomP);
+    Atom_charsetExport(atomP, &charset_dot);
 
+    Atom_charsetResetAll(atomP);                                         // \w
+    Atom_charsetAddStr(atomP, C_WORD_CHARSET_STR);
+    Atom_charsetExport(atomP, &charset_word);
 
+    Atom_charsetResetAll(atomP);                                         // \d
+    Atom_charsetAddStr(atomP, C_DIGIT_CHARSET_STR);
+    Atom_charsetExport(atomP, &charset_digit);
 
+    Atom_charsetResetAll(atomP);                                         // \s
+    Atom_charsetAddStr(atomP, C_WHITESPACE_CHARSET_STR);
+    Atom_charsetExport(atomP, &charset_whitespace);
+
+#endif
+
+    return;
+}
+
+
+
+
+
+
+
+// Compile regex
+// Regex string is parsed once, result may be used many times with MxRegex_exec()
+// Syntax errors are detected here on the whole regex.
+//
+// parm
+//  regexP      ptr to regex pattern string (\0 terminated)
+//  mode        bitfld REGEX_MODE
+//  progP       RET compiled regex
+// ret
+//  REGEXSTS_OK ok
+//  else        error, progP->retRegexErrOfs is the offset of failed atom in regex string
+
+REGEX_STS MxRegex_compile(const char* regexP, const UInt16 mode, REGEXPROG* progP)
+{
+    UInt16 openIdx[MAX_PROG_RECURSE];                               // idx of open bracket, for each nesting level
+    UInt16 pipeIdx[MAX_PROG_RECURSE];                               // idx of last pipe, for each nesting level
+    UInt16 level;
+    UInt8 isCI;
+    const char* charP;
+    REGEXINST* iP;
+    REGEX_STS sts;
+    REGEXATOM atom;                                                 // atom parser
+    REGEXATOM* atomP;
+
+    progP->instNum = 0;
+    progP->charsetNum = 0;
+    progP->capsNum = 1;                                             // caps[0] is the match
+    progP->mode = mode;
+    progP->retRegexErrOfs = 0;
+    progP->prefixLen = 0;
+    progP->isLineStart = 0;
+    progP->isEndAnchor = 0;
+    progP->minLen = 0;
+    progP->maxLen = REGEXOFS_MAX;
+    progP->mustLen = 0;
+    memset(&progP->need, 0, sizeof(progP->need));
+#if MXREGEX_JIT
+    Jit_release(progP);                                             // native code of a former regex compiled here
+    progP->jitP = 0;
+    progP->jitOwnerP = 0;
+    progP->jitSize = 0;
+    progP->execNum = 0;
+#endif
+
+    isCI = (mode & REGEXMODE_CASE_INSENSITIVE) ? 1 : 0;
+    atomP = &atom;
+
+    level = 0;
+    pipeIdx[0] = PROG_NO_JUMP;
+    charP = regexP;
+
+    while (1)
+    {
+        if (progP->instNum >= MAX_PROG_ATOM)                        // check ovf
+        {
+            sts = REGEXSTS_PROG_OVF;
+            goto BR_FAIL;
+        }
+
+        if ((sts = GetRegexAtom(atomP, charP, mode)) != REGEXSTS_OK)       // parse atom
+            goto BR_FAIL;
+
+        iP = &progP->inst[progP->instNum];
+        iP->type = (UInt8)atomP->type;
+        iP->c = atomP->c;
+        iP->cFold = atomP->c;
+        iP->isCap = 0;
+        iP->capsIdx = 0;
+        iP->charsetIdx = 0;
+        iP->minOcc = atomP->minOcc;
+        iP->maxOcc = atomP->maxOcc;
+        iP->jump = PROG_NO_JUMP;
+        iP->regexOfs = (UInt16)(charP - regexP);
+
+        switch (atomP->type)
+        {
         case ATOMTYPE_CHAR:                                         // simple char
 
-            if (segmentP->isCI)                                      // handle case insensitive, t=1 if char match
-                t = (Upper(*segmentP->strParseP) == Upper(m.atom.c)) ? 1 : 0;
-            else
-                t = (*segmentP->strParseP == m.atom.c) ? 1 : 0;
+            if (isCI)
+                iP->cFold = Fold(iP->c);                            // match both cases, no case conversion on str
+            break;
 
-        BR_CHECK_MATCH_ATOM:                                        // *** entrypoint char/charclass match test
 
-            if (m.atom.minOcc < m.atom.maxOcc)                       // if potential backtrack, get descriptor
+        case ATOMTYPE_METACLASS:                                    // charset, save to program
+
+            if ((iP->charsetIdx = Prog_charsetAdd(progP, atomP)) == 0xff)
             {
-                backtrackP = BacktrackGet(segmentP->regexParseP, segmentP->segmNumOcc);    // GET BACKTRACK descriptor (should always be present)
+                sts = REGEXSTS_PROG_OVF;
+                goto BR_FAIL;
+            }
+            break;
 
-                if (backtrackP != 0)
-                    if (backtrackP->maxOcc == 0)                     // if should fail anyway
-                        t = 0;                                       // invalidate match
+
+        case ATOMTYPE_BRACKETOPEN:                                  // ( open new nesting level
+
+            iP->isCap = (mode & REGEXMODE_NOCAPS) ? 0 : 1;
+            if (atomP->endP[0] == '?' && atomP->endP[1] == ':')     // check if non-capture
+            {
+                iP->isCap = 0;
+                atomP->endP += 2;                                   // skip mode
             }
 
-            if (t == 0)
+            if (++level >= MAX_PROG_RECURSE)                        // nesting ovf
             {
-                //
-                // HERE WE HAVE A CHAR/CHARSET NO MATCH CONDITION, THERE COULD BE ALTERNATIVE SEGMENTS
-                //
+                sts = REGEXSTS_RECURSE_OVF;
+                goto BR_FAIL;
+            }
+            openIdx[level] = progP->instNum;
+            pipeIdx[level] = PROG_NO_JUMP;
+            break;
 
-                // ADJ BACKTRACK FOR POSSIBLE NEXT ITERATION
 
-                if (m.atom.minOcc < segmentP->atomNumOcc)           // if there could have been less occurrencies
-                {
-                    if (backtrackP != 0)                            // if backtrack present (should always be)
-                    {
-                        backtrackP->maxOcc = segmentP->atomNumOcc;  // update max occurrencies for next round (if needed)
-#if MXREGEX_DEBUG
-                        snprintf(buf, sizeof(buf), "- backtrack atom set backtrack.maxOcc = %d\r\n", backtrackP->maxOcc);
-                        OutputDebugStringA((LPCSTR)buf);
+        case ATOMTYPE_PIPE:                                         // | link to previous pipe on same level
+
+            if (pipeIdx[level] != PROG_NO_JUMP)
+                progP->inst[pipeIdx[level]].jump = progP->instNum;
+            pipeIdx[level] = progP->instNum;
+            break;
+
+
+        case ATOMTYPE_BRACKETCLOSE:                                 // ) close nesting level, link open bracket and last pipe
+
+            if (level == 0)                                         // if not nested, not allowed
+            {
+                sts = REGEXSTS_SYNTAX;
+                goto BR_FAIL;
+            }
+
+            if (pipeIdx[level] != PROG_NO_JUMP)
+                progP->inst[pipeIdx[level]].jump = progP->instNum;
+            progP->inst[openIdx[level]].jump = progP->instNum;
+
+            if (progP->inst[openIdx[level]].isCap)                  // assign capture slot
+                progP->inst[openIdx[level]].capsIdx = progP->capsNum++;
+
+            level--;
+            break;
+
+
+        case ATOMTYPE_EOS:                                          // end of regex
+
+            if (level > 0)                                          // missing ), fail
+            {
+                sts = REGEXSTS_SYNTAX;
+                goto BR_FAIL;
+            }
+
+            if (pipeIdx[0] != PROG_NO_JUMP)
+                progP->inst[pipeIdx[0]].jump = progP->instNum;
+
+            progP->instNum++;
+            progP->retSts = REGEXSTS_OK;
+
+            Prog_prefix(progP);                                     // literal prefix, for start position search
+            Prog_lineStart(progP);                                  // line start anchor, for multiline start position search
+            Prog_len(progP);                                        // min and max match len, for start position pruning
+            Prog_need(progP);                                       // size of backtracking regex arrays
+
+#if MXREGEX_NFA
+            Nfa_compile(progP, regexP);                             // nfa for DFA engine
+
+            if ((mode & (REGEXMODE_LINEAR | REGEXMODE_MEMO)) && progP->nfaNum == 0)    // Pike VM or memo requested, regex too large for nfa (MAX_NFA_NODE)
+#else
+            if (mode & (REGEXMODE_LINEAR | REGEXMODE_MEMO))         // Pike VM or memo requested, no nfa engines
+#endif
+            {
+                sts = REGEXSTS_PROG_OVF;
+                goto BR_FAIL;
+            }
+            return REGEXSTS_OK;                                     // COMPILE OK
+
+
+        default:                                                    // anchor, nothing to do
+            break;
+        }
+
+        progP->instNum++;
+        charP = atomP->endP;                                        // move to next atom
+
+    }// while 1
+
+
+BR_FAIL:
+
+    progP->retSts = sts;
+    progP->retRegexErrOfs = (UInt16)(charP - regexP);              // offset of failed atom
+    progP->instNum = 0;
+
+    return sts;
+}
+
+
+
+
+// regex data allocation done: default regex data m is released when its thread exits
+
+static inline void Regex_alloc(const MXREGEX_M* mP)
+{
+    if (mP == &m)
+        mRelease.isUsed = 1;                                // constructs thread exit release
+    return;
+}
+
+
+
+// compiled regex of MxRegex_ex() in regex data, allocated on first use (MXREGEX_CACHE: regex not cached only)
+
+REGEXPROG* Regex_prog(MXREGEX_M* mP)
+{
+#if MXREGEX_CACHE
+    if (mP->progExP == 0)
+    {
+        mP->progExP = new REGEXPROG();
+        Regex_alloc(mP);
+    }
+    return mP->progExP;
+#else
+    return &mP->progEx;
 #endif
-                    }
-                }
+}
 
-                if (segmentP->atomNumOcc >= m.atom.minOcc)          // IF MINIMUM OCCURRENCE SATISFIED, IT IS A MATCH ANYWAY
-                    break;                                          // move to next atom on same str char
 
 
-                // here regex failed search on current segment, check if follows an alternative segment |
-                // if present: restart regex parse from 1st atom of alternative segment,
-                // otherwhise: im possible, skip to ) for current nidification and evaluate quantifier for further processing
+#if MXREGEX_NFA
 
-            BR_SEGMENT_MATCH_FAIL:                                  // *** entrypoint segment match fail, check for alternate segments
+// lazy DFA cache of regex data, allocated on first use
+
+REGEXDFA* Regex_dfa(MXREGEX_M* mP)
+{
+    if (mP->dfaP == 0)
+    {
+        mP->dfaP = new REGEXDFA();
+        Regex_alloc(mP);
+    }
+    return mP->dfaP;
+}
 
-#if MXREGEX_DEBUG
-                snprintf(buf, sizeof(buf), "SEGMENT MATCH FAIL lev = %d\r\n", recurseNum);
-                OutputDebugStringA((LPCSTR)buf);
 #endif
 
-                // check for alternative segments
 
-                t = AltSegmSearch(segmentP, 1);                     // check for alt segments or closing bracket
 
-                if (t == 2)                                         // if |
-                {
-                    AltSegmAdd(segmentP->regexP, segmentP->regexParseP);   // save next segment
-                    AltSegmIterate(segmentP->regexP);
-                    segmentP->strParseP = segmentP->strP;           // restart str parsing for this segment
-                    segmentP->strCapP = segmentP->strP;
-                    goto BR_RETRY;
-                }
+// Regex on compiled regex, using regex data mP
+// Reentrant: regex data mP is the only data written (but atomic promotion of compiled regex to native code, MXREGEX_JIT),
+// so threads with their own regex data may share the same compiled regex
+//
+// Regex on compiled regex, using regex data mP, search from str offset startOfs:
+// str before it is not matched, but it's seen by anchors ^ \b \B (see MxRegex_findNext())
+// parm
+//  strP        ptr to input string
+//  strLen      input string len
+//  startOfs    search start offset, 0..strLen
+// ret
+//  see MxRegex_exec_len_ex()
 
-                if (t == 1)                                         // )
-                {
-                    segmentP->parseFailed = 1;                      // report segment fail
-                    if (Atom_ParseQtf(segmentP->regexParseP, &t))   // if valid quantifier: save and skip it
-                        segmentP->regexParseP += t;
-                    goto BR_BRACKETCLOSE;                           // handle bracket close with quantifier
-                }
+UInt8 Regex_run(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const size_t strLen, const size_t startOfs)
+{
+    const char* startP;
+    UInt16 t;
+    UInt16 t1;
+    CAPS* cP;
 
-                // here there is no alternate segment nor closing bracket
+    // initialize regex parser
+    ClearDescriptors(mP);
 
-                if (m.retSts != REGEXSTS_OK)                        // check for fatal error condition
-                    return 0;
+    mP->retRegexErrOfs = 0;       // clear error position
+    mP->capsNum = 0;
 
-                if (segmentP->anchorSOSfail)                        // if anchor ^ failed: no need to check further
-                    return 0;
+    if (progP->retSts != REGEXSTS_OK)                       // regex not compiled, fail
+    {
+        mP->retSts = progP->retSts;
+        mP->retRegexErrOfs = progP->retRegexErrOfs;
+        return 0;
+    }
 
+    mP->progP = progP;
 
-                //
-                // HERE WE HAVE A REGEX NO MATCH CONDITION ON CURRENT SEGMENT
-                //
+    // store mode flags
+    mP->isMultiLine = (progP->mode & REGEXMODE_MULTILINE) ? 1 : 0;
+    mP->isSingleLine = (progP->mode & REGEXMODE_SINGLELINE) ? 1 : 0;
 
-                if (!segmentP->isEnoughOcc)                         // if not enough occurrences collected check for backtrack and altSegm
-                {
-                    if (BacktrackIterate(segmentP->regexP))
-                        goto BR_RETRY;
-                }
+    mP->strOrigP = strP;          // save ptr to original string
+    mP->strEndP = strP + strLen;  // and its end
 
-                if (recurseNum > 0)                                 // if nested, remove alt segm descriptor for this segment and return no match
-                {
-                    return 0;
-                }
+    if (strLen - startOfs < progP->minLen                   // str shorter than min match len, or required literal not in str: no engine needed
+        || (progP->mustLen && !Prog_mustFind(progP, strP + startOfs, mP->strEndP)))
+    {
+        STATS_FAR(mP, mP->strEndP);
+        mP->retSts = REGEXSTS_OK;
+        return 0;                                           // NO MATCH
+    }
 
-                //
-                // here is the base segment (i.e. recurseNum == 0)
-                //
+#if MXREGEX_NFA
+    if ((progP->mode & REGEXMODE_NOCAPS) && progP->isDfa)     // only caps[0] needed: lazy DFA, unless it gives up
+    {
+        STATS_FAR(mP, mP->strEndP);
+        if ((t = Dfa_exec(mP, progP, strP, strP + startOfs, mP->strEndP)) != DFA_FALLBACK)
+        {
+            mP->retSts = REGEXSTS_OK;
+            mP->capsNum = t;
+            return (UInt8)t;
+        }
+    }
 
-                if (*segmentP->strP == '\0')                        // if str EOS reached, REGEX NO MATCH
-                {
-#if MXREGEX_DEBUG
-                    snprintf(buf, sizeof(buf), "- str EOS REACHED %d\r\n", recurseNum);
-                    OutputDebugStringA((LPCSTR)buf);
+    if ((progP->mode & REGEXMODE_MEMO) && progP->nfaNum && strLen <= NFA_MAX_STR)     // linear time on short str: failure memo backtracker
+    {
+        mP->retSts = REGEXSTS_OK;
+        if ((t = Memo_exec(mP, progP, strP, strP + startOfs, mP->strEndP)) != MEMO_FALLBACK)
+        {
+            STATS_FAR(mP, mP->strEndP);
+            mP->capsNum = t;
+            return (UInt8)t;
+        }
+    }
+
+    if ((progP->mode & REGEXMODE_LINEAR) && progP->nfaNum && strLen <= NFA_MAX_STR)   // linear time: Pike VM
+    {
+        STATS_FAR(mP, mP->strEndP);
+        mP->retSts = REGEXSTS_OK;
+        mP->capsNum = Pike_exec(mP, progP, strP, strP + startOfs, mP->strEndP);
+        return (UInt8)mP->capsNum;
+    }
+
+    if (progP->isNfaFirst && strLen <= NFA_MAX_STR)         // quantified brackets: failure memo backtracker (short str) or Pike VM, same match of other modes
+    {
+        STATS_FAR(mP, mP->strEndP);
+        mP->retSts = REGEXSTS_OK;
+        if ((t = Memo_exec(mP, progP, strP, strP + startOfs, mP->strEndP)) == MEMO_FALLBACK)
+            t = Pike_exec(mP, progP, strP, strP + startOfs, mP->strEndP);
+        mP->capsNum = t;
+        return (UInt8)t;
+    }
 #endif
-                    return 0;
-                }
 
-                if (m.altSegmChanged)                               // if still alternate segments pending
-                {
-#if MXREGEX_DEBUG
-                    snprintf(buf, sizeof(buf), "- lev = %d altSegmChanged true, clear altSegmChanged, restart\r\n", recurseNum);
-                    OutputDebugStringA((LPCSTR)buf);
+#if MXREGEX_JIT
+    if ((t = Jit_exec(mP, progP, strP, strP + startOfs, mP->strEndP)) != JIT_FALLBACK)     // hot regex: native code
+    {
+        STATS_FAR(mP, mP->strEndP);
+        mP->retSts = REGEXSTS_OK;
+        mP->capsNum = t;
+        return (UInt8)t;
+    }
 #endif
 
-                    if (AltSegmIterate(segmentP->regexP))
-                    {
-                        goto BR_RETRY;
-                    }
+    mP->altSegmNum = 0;           // clear alternative segments descriptors
 
-                    m.altSegmChanged = 0;
-                    m.capsNum = 1;                              // clear all caps  (keep caps[0] as matched string, if it's a match)
-                    goto BR_RETRY;                              // repeat iteration
-                }
 
+    if ((startP = Prog_startFind(mP, strP + startOfs)) == 0)   // skip to 1st line start or position with literal prefix
+    {
+        mP->retSts = REGEXSTS_OK;
+        return 0;                                           // not found, NO MATCH
+    }
 
-                // HERE WE CAN MOVE NO NEXT STR CHAR
+    // init regex as segment[0], on base str. Here is always non-capture
+    if ((mP->retSts = SegmentInit(mP, 0, startP, &progP->inst[0], progP->mode, 0)) == REGEXSTS_OK)
+    {
+        mP->capsNum = 1;                                      // will populate caps starting at [1]
+        mP->altSegmChanged = 0;                               // clear alternate segments changed flag
+        mP->iterateCnt = 0;                                   // init watchdog
+        STATS_INC(mP, startNum);
 
-                segmentP->strP++;                               // move to next char
-                m.backtrackNum = 0;                             // clear all backtrack
-                m.altSegmNum = 0;                               // clear all alternate segments
-                m.iterateCnt = 0;                               // restart watchdog
-                m.capsNum = 1;                                  // clear all caps  (keep caps[0] as matched string, if it's a match)
+        // invoke first regex
 
-#if MXREGEX_DEBUG
-                snprintf(buf, sizeof(buf), "\r\n\r\n*** MOVE TO NEXT char, clear backtrack, altSegm, capsNum, iterationCnt; strP: %s\r\n", segmentP->strP);
-                OutputDebugStringA((LPCSTR)buf);
-#endif
+        if (MxRegex_(mP, 0))                                    // if success, set caps[0] to matched string
+        {
+            cP = &mP->caps[0];
+            cP->strP = mP->segment[0].strP;
+            cP->len = mP->segment[0].strParseP - mP->segment[0].strP;
+            cP->regexP = mP->segment[0].regexP;
 
+            // remove possible empty capsnum
 
-            BR_RETRY:                                           // *** entrypoint retry regex on str
+            t1 = 1;
+            for (t = 1; t < mP->capsNum; t++)
+            {
+                cP = &mP->caps[t];
+                if (cP->regexP == 0)                        // skip empty
+                    continue;
 
-#if MXREGEX_DEBUG
-                snprintf(buf, sizeof(buf), "\r\n*** RETRY regexP: %s\r\n", segmentP->regexP);
-                OutputDebugStringA((LPCSTR)buf);
-#endif
-                //AltSegmRemoveAt(segmentP->regexP);
-                if ((cP = AltSegmGet(segmentP->regexP)))                        // get current alternative segment (0 = not found).
+                if (t1 != t)                                // if need to move
                 {
-                    segmentP->regexParseP = cP;                                 // if exists, set parser
-#if MXREGEX_DEBUG
-                    snprintf(buf, sizeof(buf), "- retry AltSegmGet regexP: %s, regexParseP: %s\r\n", segmentP->regexP, segmentP->regexParseP);
-                    OutputDebugStringA((LPCSTR)buf);
-#endif
+                    mP->caps[t1].strP = cP->strP;
+                    mP->caps[t1].regexP = cP->regexP;
+                    mP->caps[t1].len = cP->len;
                 }
-                else
-                    segmentP->regexParseP = segmentP->regexP;   // restart regex parser
+                t1++;
+            }
+            mP->capsNum = t1;
+            return (UInt8)mP->capsNum;                        // MATCH
+        }
+    }
 
-                segmentP->strCharAcquired = 0;                  // clear flag char acquired
-                segmentP->parseFailed = 0;                      // clear error status for this segment
-                segmentP->strParseP = segmentP->strP;           // restart parsing
+    // no match / error
 
-                CapsRemove(segmentP->regexP);
-                break;                                          // continue (or restart) evaluation
+#if MXREGEX_NFA
+    if ((mP->retSts == REGEXSTS_MAXITERATE_OVF || mP->retSts == REGEXSTS_BACKTRACK_OVF || mP->retSts == REGEXSTS_ALTSEGM_OVF
+        || mP->retSts == REGEXSTS_RECURSE_OVF)
+        && (progP->mode & REGEXMODE_FALLBACK) && progP->nfaNum && strLen <= NFA_MAX_STR)   // backtracking gave up: retry with failure memo backtracker (short str) or Pike VM
+    {
+        STATS_INC(mP, fallbackNum);
+        STATS_FAR(mP, mP->strEndP);
+        mP->retSts = REGEXSTS_OK;
+        if ((t = Memo_exec(mP, progP, strP, strP + startOfs, mP->strEndP)) == MEMO_FALLBACK)
+            t = Pike_exec(mP, progP, strP, strP + startOfs, mP->strEndP);
+        mP->capsNum = t;
+        return (UInt8)t;
+    }
+#endif
 
-            }// if match fail
+    mP->retRegexErrOfs = RegexOfs(mP, mP->segment[0].regexParseP);  // on fail set error offset returned from Regex_
+    mP->capsNum = 0;                                          // reset capsnum
 
+    return 0;                                               // FAIL
 
-            //
-            // HERE WE HAVE A MATCH CONDITION
-            //
+}
 
-            // check if there are multiple occurrences (greedy): if not, move to next str char
 
-            segmentP->atomNumOcc++;                                 // ++nr occurrencies found
 
-            if (backtrackP != 0)                                    // if backtrack present
-            {
-                if (m.atom.maxOcc > backtrackP->maxOcc)
-                {
-                    m.atom.maxOcc = backtrackP->maxOcc;             // adj maxOcc
-#if MXREGEX_DEBUG
-                    snprintf(buf, sizeof(buf), "- backtrack match atom maxOcc = %d\r\n", backtrackP->maxOcc);
-                    OutputDebugStringA((LPCSTR)buf);
-#endif
-                }
-            }
 
-            segmentP->strParseP++;                                  // move to next str char (THIS IS THE ONLY PLACE WHERE IT HAPPENS)
-            segmentP->strCharAcquired = 1;                          // set flag
+// set backtracking regex arrays of regex data: own ones (MAX_RECURSE..), or carved from caller arena, sized by need of compiled regex
+// set on each call, regex data may be not initialized
+// parm
+//  arenaP      caller arena, 0 use own arrays
+//  arenaSize   arena size, what is left after segments, alternative segments and captures is used for backtracks
+// ret
+//  1 ok, 0 arena too small (not even one backtrack)
 
-            if (segmentP->atomNumOcc < m.atom.maxOcc)               // if max occurrencies NOT reached, repeat test on next str char
-                goto BR_MULTIPLE_OCC;
+UInt8 Regex_data(MXREGEX_M* mP, const REGEXPROG* progP, void* arenaP, const size_t arenaSize)
+{
+    size_t ofs;
+    size_t len;
 
-            //
-            // HERE QUANTIFIER IS FULLFILLED
-            //
+    if (arenaP == 0)
+    {
+        mP->segment = mP->segmentOwn;
+        mP->altSegm = mP->altSegmOwn;
+        mP->caps = mP->capsOwn;
+        mP->backtrack = mP->backtrackOwn;
+
+        mP->limit.recurseNum = MAX_RECURSE;
+        mP->limit.altSegmNum = MAX_ALTSEG;
+        mP->limit.capsNum = MAX_CAPS;
+        mP->limit.backtrackNum = MAX_BACKTRACK - 1;
+        return 1;
+    }
 
-            // ADJ BACKTRACK FOR NEXT ITERATION
+    mP->limit = progP->need;
+    if (mP->limit.capsNum == 0)                                     // regex not compiled: caps[0] anyway
+        mP->limit.capsNum = 1;
 
-            if (m.atom.minOcc < segmentP->atomNumOcc)               // if there could have been less occurrencies
-            {
-                if ((backtrackP = BacktrackGet(segmentP->regexParseP, segmentP->segmNumOcc)))     // if backtrack present (should always be)
-                {
-                    backtrackP->maxOcc = segmentP->atomNumOcc;      // update max occurrencies for next round (if needed)
-#if MXREGEX_DEBUG
-                    snprintf(buf, sizeof(buf), "- backtrack atom set backtrack.maxOcc = %d\r\n", backtrackP->maxOcc);
-                    OutputDebugStringA((LPCSTR)buf);
-#endif
-                }
-            }
+    ofs = (sizeof(void*) - ((size_t)arenaP & (sizeof(void*) - 1))) & (sizeof(void*) - 1);    // align to ptr, like the arrays
+    len = mP->limit.recurseNum * sizeof(SEGMENT) + mP->limit.altSegmNum * sizeof(ALTSEGM) + mP->limit.capsNum * sizeof(CAPS);
 
-            break;                                                  // move to next atom
+    if (arenaSize < ofs + len + sizeof(BACKTRACK))
+        return 0;
 
+    mP->segment = (SEGMENT*)((char*)arenaP + ofs);
+    mP->altSegm = (ALTSEGM*)(mP->segment + mP->limit.recurseNum);
+    mP->caps = (CAPS*)(mP->altSegm + mP->limit.altSegmNum);
+    mP->backtrack = (BACKTRACK*)(mP->caps + mP->limit.capsNum);
 
+    len = (arenaSize - ofs - len) / sizeof(BACKTRACK);              // all the rest
+    mP->limit.backtrackNum = (len >= BACKTRACK_UNBOUNDED) ? BACKTRACK_UNBOUNDED - 1 : (UInt16)len;
 
-        case ATOMTYPE_ANCHOR:                                       // anchor ^ $ \b ..
+    return 1;
+}
 
-            if (m.atom.c == '^')                                    // ^ match only from str begin
-            {
-                if (segmentP->strParseP == m.strOrigP)              // if 1st char: ok
-                    break;
 
-                if (m.isMultiLine)                                  // if multiline: ok also if preceding char was \r or \n
-                {
-                    if (segmentP->strParseP[-1] == '\r' || segmentP->strParseP[-1] == '\n')
-                        break;
-                }
-                else
-                {
-                    segmentP->anchorSOSfail = 1;                    // don't check further on segment
-                }
-#if MXREGEX_DEBUG
-                snprintf(buf, sizeof(buf), "- anchor ^ failed\r\n");
-                OutputDebugStringA((LPCSTR)buf);
+
+
+// Regex on compiled regex, from str offset startOfs, with hot path counters (MXREGEX_STATS) and trace hook (MXREGEX_TRACE)
+// see Regex_run(), Regex_data()
+
+UInt8 Regex_exec(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const size_t strLen, const size_t startOfs, void* arenaP, const size_t arenaSize)
+{
+#if MXREGEX_STATS
+    REGEXSTATS* sumP;
+    UInt8 ret;
 #endif
-                goto BR_SEGMENT_MATCH_FAIL;                         // fail
-            }
 
-            if (m.atom.c == '$')                                    // $ end of string \0 EOS
-            {
-                // check char following current one
+    if (!Regex_data(mP, progP, arenaP, arenaSize))
+    {
+        mP->retSts = REGEXSTS_ARENA_OVF;
+        mP->retRegexErrOfs = 0;
+        mP->capsNum = 0;
+        return 0;
+    }
 
-                if (m.isMultiLine)                                  // multiline \0 \n \r  if no match, move to next str char
-                {
-                    if (*segmentP->strParseP != '\0'
-                        && *segmentP->strParseP != '\r'
-                        && *segmentP->strParseP != '\n')
-                    {
-#if MXREGEX_DEBUG
-                        snprintf(buf, sizeof(buf), "- anchor $ multiline failed\r\n");
-                        OutputDebugStringA((LPCSTR)buf);
+#if MXREGEX_TRACE
+    mP->traceHookP = traceHookP;                            // hook of calling thread, regex data may be not initialized
+    mP->traceCtxP = traceCtxP;
+    mP->traceStep = 0;
+    mP->traceRecurseNum = 0;
 #endif
-                        goto BR_SEGMENT_MATCH_FAIL;                         // fail
-                    }
-                }
-                else
-                {
-                    if (*segmentP->strParseP != '\0')               // singleline \0
-                    {
-#if MXREGEX_DEBUG
-                        snprintf(buf, sizeof(buf), "- anchor $ singleline failed\r\n");
-                        OutputDebugStringA((LPCSTR)buf);
+
+#if MXREGEX_STATS
+    memset(&mP->stats, 0, sizeof(mP->stats));
+    mP->stats.callNum = 1;
+    mP->statsFarP = strP + startOfs;
+
+    ret = Regex_run(mP, progP, strP, strLen, startOfs);
+
+    mP->stats.byteNum = (size_t)(mP->statsFarP - (strP + startOfs));
+
+    sumP = &mP->statsSum;                                   // sum of calls, peaks are max
+    sumP->callNum++;
+    sumP->startNum += mP->stats.startNum;
+    sumP->atomNum += mP->stats.atomNum;
+    sumP->backtrackRetryNum += mP->stats.backtrackRetryNum;
+    sumP->altSegmRetryNum += mP->stats.altSegmRetryNum;
+    sumP->fallbackNum += mP->stats.fallbackNum;
+    if (mP->stats.backtrackPeak > sumP->backtrackPeak)
+        sumP->backtrackPeak = mP->stats.backtrackPeak;
+    if (mP->stats.altSegmPeak > sumP->altSegmPeak)
+        sumP->altSegmPeak = mP->stats.altSegmPeak;
+    if (mP->stats.recursePeak > sumP->recursePeak)
+        sumP->recursePeak = mP->stats.recursePeak;
+    sumP->byteNum += mP->stats.byteNum;
+
+    return ret;
+#else
+    return Regex_run(mP, progP, strP, strLen, startOfs);
 #endif
-                        goto BR_SEGMENT_MATCH_FAIL;                         // fail
-                    }
-                }
-                break;
-            }
+}
 
-            if (m.atom.c == 'b')                                    // \b word boundary   transition \W->\w or \w->\W
-            {
-                if (segmentP->strParseP == segmentP->strP)          // if str first char, ok
-                    break;
 
-                if (IsWord(segmentP->strParseP[-1]) && !IsWord(segmentP->strParseP[0]))     // if transition \w->\W from preceding, ok
-                    break;
 
-                if (!IsWord(segmentP->strParseP[-1]) && IsWord(segmentP->strParseP[0]))      // if transition \W->\w, ok
-                    break;
 
-                goto BR_SEGMENT_MATCH_FAIL;                         // no match, move to next str char
+// Regex on compiled regex, length delimited input string, using regex data mP
+// Reentrant: regex data mP is the only data written, so threads with their own regex data
+// may share the same compiled regex
+// Input string is length delimited: \0 is a normal char (may be matched by \x00 . [^..]),
+// chars after strP[strLen - 1] are never read by regex (except SIMD aligned loads, within the same page)
+//
+// parm
+//  mP          regex data
+//  progP       ptr to compiled regex, see MxRegex_compile()
+//  strP        ptr to input string
+//  strLen      input string len
+// ret
+//  0           regex fail or errors detected (you may check mP->retSts, mP->retRegexOfs for error description)
+//  n           regex match, number of captures. caps[0] is always the match, caps[1..maxCaps-1] are the captures
 
-            }
+UInt8 MxRegex_exec_len_ex(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const size_t strLen)
+{
+    return Regex_exec(mP, progP, strP, strLen, 0, 0, 0);
+}
 
-            if (m.atom.c == 'B')                                    // \B non-word boundary
-            {
-                if (segmentP->strParseP == segmentP->strP)          // if str first char, fail
-                    goto BR_SEGMENT_MATCH_FAIL;
 
-                if (IsWord(segmentP->strParseP[-1]) && IsWord(segmentP->strParseP[0]))       // if no transition \w->\W from preceding, ok
-                    break;
 
-                if (!IsWord(segmentP->strParseP[-1]) && !IsWord(segmentP->strParseP[0]))     // if no transizione \W->\w, ok
-                    break;
 
-                goto BR_SEGMENT_MATCH_FAIL;                         // no match, move to next str char
-            }
+// Regex on compiled regex, using regex data mP
+// see MxRegex_exec_len_ex()
+//
+// parm
+//  mP          regex data
+//  progP       ptr to compiled regex, see MxRegex_compile()
+//  strP        ptr to input string (\0 terminated)
+// ret
+//  0           regex fail or errors detected (you may check mP->retSts, mP->retRegexOfs for error description)
+//  n           regex match, number of captures. caps[0] is always the match, caps[1..maxCaps-1] are the captures
 
-            // unhandled anchor, ignore and treat as a match
+UInt8 MxRegex_exec_ex(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP)
+{
+    return MxRegex_exec_len_ex(mP, progP, strP, strlen(strP));
+}
 
-            break;
 
 
 
-        case ATOMTYPE_BRACKETOPEN:                                  // (  inizio sub-regex
+// Size of caller arena for a compiled regex, see MxRegex_exec_arena()
+// Segments, alternative segments and captures are the exact need of the regex (progP->need),
+// backtracks depend on str if a quantifier is within a bracket with no max occurrences, e.g. (\d+,)*
+//
+// parm
+//  progP           ptr to compiled regex
+//  backtrackNum    backtracks, 0 need of regex (MAX_BACKTRACK if BACKTRACK_UNBOUNDED)
+// ret
+//  arena size (bytes), including alignment to ptr
 
-#if MXREGEX_DEBUG
-            snprintf(buf, sizeof(buf), "- lev = %d BRACKET OPEN\r\n", recurseNum);
-            OutputDebugStringA((LPCSTR)buf);
-#endif
+size_t MxRegex_arenaSize(const REGEXPROG* progP, const UInt16 backtrackNum)
+{
+    size_t n;
+
+    n = backtrackNum;
+    if (n == 0)
+        n = (progP->need.backtrackNum == BACKTRACK_UNBOUNDED) ? MAX_BACKTRACK : progP->need.backtrackNum;
+    if (n == 0)
+        n = 1;
+
+    return sizeof(void*) - 1
+        + progP->need.recurseNum * sizeof(SEGMENT)
+        + progP->need.altSegmNum * sizeof(ALTSEGM)
+        + ((progP->need.capsNum) ? progP->need.capsNum : 1) * sizeof(CAPS)
+        + n * sizeof(BACKTRACK);
+}
 
-            t = segmentP->regexParseP[0] == '?' && segmentP->regexParseP[1] == ':';      // check if non-capture
-            if (t)
-                segmentP->regexParseP += 2;                          // skip mode
 
-            if ((m.retSts = SegmentInit(recurseNum + 1, segmentP->strParseP, segmentP->regexParseP, segmentP->mode, t == 0)) != REGEXSTS_OK)
-                return 0;                                           // init parser, exit on error
 
-            if (!MxRegex_(recurseNum + 1))                          // INVOKE NESTED REGEX
-            {
-                if (m.retSts != REGEXSTS_OK)                        // if any fatal error
-                {
-                    segmentP->regexParseP = m.segment[recurseNum + 1].regexParseP;  // save error position
-                    return 0;                                                       // and fail
-                }
 
-                segmentP->regexParseP = m.segment[recurseNum + 1].regexParseP;
-                goto BR_SEGMENT_MATCH_FAIL;
-            }
+// Regex on compiled regex, length delimited input string, using regex data mP and backtracking regex arrays carved from caller arena,
+// sized for this regex instead of MAX_RECURSE MAX_ALTSEG MAX_CAPS MAX_BACKTRACK: complex regex may run on small regex data,
+// or a pool of regex data may allocate scratch tightly for each regex. Rest of regex data is used as by MxRegex_exec_len_ex().
+// Captures are in the arena: keep it until MxRegex_getCaps_ex()
+// Note: lazy DFA, failure memo and Pike VM engines don't use the arena, Pike VM still needs captures <= MAX_CAPS
+//
+// parm
+//  mP          regex data
+//  progP       ptr to compiled regex, see MxRegex_compile()
+//  strP        ptr to input string
+//  strLen      input string len
+//  arenaP      caller arena, any alignment
+//  arenaSize   arena size, at least MxRegex_arenaSize(progP, 1): what is left after segments, alternative segments and captures is used for backtracks
+// ret
+//  see MxRegex_exec_len_ex(), REGEXSTS_ARENA_OVF if arena too small
 
-            // sub reges success, adj str and regex parsing point, continue eval from there
+UInt8 MxRegex_exec_arena(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const size_t strLen, void* arenaP, const size_t arenaSize)
+{
+    return Regex_exec(mP, progP, strP, strLen, 0, arenaP, arenaSize);
+}
 
-            segmentP->strParseP = m.segment[recurseNum + 1].strParseP;
-            segmentP->regexParseP = m.segment[recurseNum + 1].regexParseP;
 
-            break;
 
 
+// Regex on compiled regex, using default regex data (thread local)
+// see MxRegex_exec_ex()
 
-        case ATOMTYPE_BRACKETCLOSE:                                 // ) end of nested regex, here only if there was a match
+UInt8 MxRegex_exec(const REGEXPROG* progP, const char* strP)
+{
+    return MxRegex_exec_ex(&m, progP, strP);
+}
 
-        BR_BRACKETCLOSE:                                            // *** entrypoint parse bracket close after pipe |  (match or non match)
 
-#if MXREGEX_DEBUG
-            snprintf(buf, sizeof(buf), "- lev = %d BRACKET CLOSE\r\n", recurseNum);
-            OutputDebugStringA((LPCSTR)buf);
-#endif
 
-            if (recurseNum == 0)                                    // if not nested, not allowed
-            {
-                m.retSts = REGEXSTS_SYNTAX;
-                return 0;
-            }
 
-            if (m.atom.minOcc < m.atom.maxOcc)                      // if it's a possible trackback position, add if necessary
-                BacktrackAdd(segmentP->regexParseP, 0);
+// Regex on compiled regex, length delimited input string, using default regex data (thread local)
+// see MxRegex_exec_len_ex()
 
-            backtrackP = BacktrackGet(segmentP->regexParseP, 0);    // GET BACKTRACK descriptor (should always be present)
+UInt8 MxRegex_exec_len(const REGEXPROG* progP, const char* strP, const size_t strLen)
+{
+    return MxRegex_exec_len_ex(&m, progP, strP, strLen);
+}
 
-            if (m.atom.minOcc < m.atom.maxOcc)                      // if potential backtrack, get descriptor
-            {
-                if (backtrackP != 0)
-                    if (backtrackP->maxOcc == 0)                    // if should fail anyway..
-                        return 0;                                   // return no match
-            }
 
-            if (segmentP->parseFailed)                              // if no match
-            {
-                if (m.atom.minOcc <= segmentP->segmNumOcc)          // if ENOUGH occurrencies according to quantifier, success
-                {
-                    if (backtrackP != 0)
-                    {
-                        backtrackP->maxOcc = segmentP->segmNumOcc;  // update max occurrencies for next round (if needed)
-#if MXREGEX_DEBUG
-                        snprintf(buf, sizeof(buf), "- backtrack bracket close set backtrack.maxOcc = %d\r\n", backtrackP->maxOcc);
-                        OutputDebugStringA((LPCSTR)buf);
-#endif
-                    }
-#if MXREGEX_DEBUG
-                    snprintf(buf, sizeof(buf), "- bracket close segment MATCH enough occurrences minOcc = %d restore strParseP\r\n", m.atom.minOcc);
-                    OutputDebugStringA((LPCSTR)buf);
-#endif
-                    // restore possible parsed str chars if last iteration failed
-                    segmentP->strParseP = segmentP->strCapP;
-                    return 1;
-                }
 
 
-#if MXREGEX_DEBUG
-                snprintf(buf, sizeof(buf), "- bracket close FAIL regexP: %s\r\n", segmentP->regexP);
-                OutputDebugStringA((LPCSTR)buf);
-#endif
+// Regex, using regex data mP
+// regex string is taken from compiled regex cache (MXREGEX_CACHE), else compiled on each call to mP->progEx:
+// use MxRegex_compile() and MxRegex_exec_ex() if regex is used many times
+//
+// parm
+//  mP          regex data
+//  regexP      ptr to regex pattern string (\0 terminated)
+//  strP        ptr to input string (\0 terminated)
+//  mode        bitfld REGEX_MODE (currently available: case insensitive)
+// ret
+//  0           regex fail or errors detected (you may check mP->retSts, mP->retRegexOfs for error description)
+//  n           regex match, number of captures. caps[0] is always the match, caps[1..maxCaps-1] are the captures
 
-                return 0;                                           // otherwise fail
-            }
+UInt8 MxRegex_ex(MXREGEX_M* mP, const char* regexP, const char* strP, const UInt16 mode)
+{
+    return MxRegex_len_ex(mP, regexP, strP, strlen(strP), mode);
+}
 
 
 
-            // HERE WE HAVE A SEGMENT MATCH.
-            // If capture, save result (only last one). See also PIPE
 
+// Regex, length delimited input string, using regex data mP
+// see MxRegex_ex(), MxRegex_exec_len_ex()
 
-            if (!CapsSave(segmentP))                                // fail to save: fatal REGEXSTS_CAPS_OVS
-                return 0;
+UInt8 MxRegex_len_ex(MXREGEX_M* mP, const char* regexP, const char* strP, const size_t strLen, const UInt16 mode)
+{
+#if MXREGEX_CACHE
+    return Cache_exec(mP, regexP, strP, strLen, mode);
+#else
+    MxRegex_compile(regexP, mode, &mP->progEx);            // on error, MxRegex_exec_ex() will report it
+    return MxRegex_exec_len_ex(mP, &mP->progEx, strP, strLen);
+#endif
+}
 
-            segmentP->segmNumOcc++;                                 // INCREMENT NR OCCURRENCIES
 
-            if (backtrackP != 0)                                    // if backtrack present
-            {
-                if (m.atom.maxOcc > backtrackP->maxOcc)
-                {
-                    m.atom.maxOcc = backtrackP->maxOcc;             // adj maxOcc
-#if MXREGEX_DEBUG
-                    snprintf(buf, sizeof(buf), "- backtrack bracket close set atom.maxOcc = %d\r\n", backtrackP->maxOcc);
-                    OutputDebugStringA((LPCSTR)buf);
-#endif
-                }
-            }
 
-            // check quantifier
 
-            if (segmentP->segmNumOcc >= m.atom.maxOcc)               // if reached max occurrencies according to quantifier: success
-                return 1;
+// Regex, using default regex data (thread local)
+// see MxRegex_ex()
 
-            if (!segmentP->strCharAcquired)                         // if minOcc == 0 and no char captured, cannot be greedy
-                return 1;
+UInt8 MxRegex(const char* regexP, const char* strP, const UInt16 mode)
+{
+    return MxRegex_ex(&m, regexP, strP, mode);
+}
 
-            segmentP->strCharAcquired = 0;                          // retrig flag char acquired
 
-            if (segmentP->segmNumOcc >= m.atom.minOcc)              // if got minocc, enough occurrences for segment match, no backtrack
-            {
-                segmentP->strP = segmentP->strParseP;               // update base str: parsed chars are definitive
-                segmentP->isEnoughOcc = 1;
-#if MXREGEX_DEBUG
-                snprintf(buf, sizeof(buf), "- lev = %d set isEnoughOcc\r\n", recurseNum);
-                OutputDebugStringA((LPCSTR)buf);
-#endif
-            }
 
-            // quantifier requires more iteration, restart parser and set potential new caps start
 
-            segmentP->strCapP = segmentP->strP;                     // update caps base if next iteration is a match
-            segmentP->regexParseP = segmentP->regexP;
-            break;
+// Regex, length delimited input string, using default regex data (thread local)
+// see MxRegex_len_ex()
 
-        }// switch
+UInt8 MxRegex_len(const char* regexP, const char* strP, const size_t strLen, const UInt16 mode)
+{
+    return MxRegex_len_ex(&m, regexP, strP, strLen, mode);
+}
 
-    }// while 1 (passa ad atom successivo)
 
-    m.retSts = REGEXSTS_SYNTAX;                                     // should never reach this point, fail
-    return 0;
 
-}// MxRegex_
 
+// Begin find all: init iterator for MxRegex_findNext()
+// parm
+//  itP         RET iterator
+//  progP       ptr to compiled regex, see MxRegex_compile()
+//  strP        ptr to input string (\0 is a normal char)
+//  strLen      input string len
+//  capsP       caller array of MAX_CAPS elements, set by MxRegex_findNext() on each match
 
+void MxRegex_findBegin(REGEXITER* itP, const REGEXPROG* progP, const char* strP, const size_t strLen, REGEXSPAN* capsP)
+{
+    itP->progP = progP;
+    itP->strP = strP;
+    itP->strLen = strLen;
+    itP->ofs = 0;
+    itP->capsP = capsP;
+    itP->isDone = 0;
+    return;
+}
 
 
 
-// clear regex parser descriptors
+// Find next match, from the end of the previous one.
+// Anchors ^ \b \B see the whole string, so e.g. "\bab" finds "ab" in "ab ab" but not in "abab".
+// After an empty match, next search starts one char later (so "a*" on "baa" finds (0,0) (1,3) (3,3)).
+//
+// parm
+//  mP          regex data
+//  itP         iterator, see MxRegex_findBegin()
+// ret
+//  0           no more matches, or errors detected (you may check mP->retSts)
+//  n           regex match, number of captures. itP->capsP[0] is the match, [1..n-1] the captures (offsets from str begin)
 
-void ClearDescriptors()
+UInt8 MxRegex_findNext(MXREGEX_M* mP, REGEXITER* itP)
 {
-#if MXREGEX_DEBUG
-
+    UInt16 capsNum;
     UInt16 t;
 
-    // not necessary, just useful for debugging
+    if (itP->isDone)
+        return 0;
 
-    for (t = 0; t < MAX_ALTSEG; t++)            // clear alternative segment info
+    if ((capsNum = Regex_exec(mP, itP->progP, itP->strP, itP->strLen, itP->ofs, 0, 0)) == 0)
     {
-        m.altSegm[t].regexP = 0;
-        m.altSegm[t].regexBaseP = 0;
-        m.altSegm[t].regexNextP = 0;
+        itP->isDone = 1;
+        return 0;
     }
 
-    for (t = 0; t < MAX_CAPS; t++)              // clear caps info
+    for (t = 0; t < capsNum; t++)
     {
-        m.caps[t].len = 0;
-        m.caps[t].strP = 0;
+        itP->capsP[t].ofs = (size_t)(mP->caps[t].strP - itP->strP);
+        itP->capsP[t].len = mP->caps[t].len;
     }
 
-    for (t = 0; t < MAX_BACKTRACK; t++)         // clear backtrack info
+    itP->ofs = itP->capsP[0].ofs + itP->capsP[0].len;         // go on from match end
+    if (itP->capsP[0].len == 0)                                 // empty match: skip a char, or done at end of str
     {
-        m.backtrack[t].maxOcc = 0;
-        m.backtrack[t].minOcc = 0;
-        m.backtrack[t].regexParseP = 0;
+        if (itP->ofs >= itP->strLen)
+            itP->isDone = 1;
+        itP->ofs++;
     }
 
-#endif
+    return (UInt8)capsNum;
+}
 
-    m.altSegmNum = 0;
-    m.capsNum = 0;
-    m.backtrackNum = 0;
 
-    return;
+
+// get regex capture results (match) from regex data mP
+// parm:
+//  mP: regex data
+//  capsNum: capture position, 0 is the whole match, 1..n are the capturing brackets
+//  retStr: RET pointer to capture within parsed string (i.e. no \0 termination)
+//  retLen: RET capture length
+// ret:
+//  1: success, 0: capture not available, or longer than 65535 chars (see MxRegex_getCapsOfs_ex())
+
+UInt8 MxRegex_getCaps_ex(const MXREGEX_M* mP, const UInt16 capsNum, char** retStr, UInt16* retLen)
+{
+    REGEXOFS len;
+
+    if (!MxRegex_getCapsOfs_ex(mP, capsNum, retStr, &len) || len != (UInt16)len)      // not available, or longer than 65535
+    {
+        *retStr = 0;
+        *retLen = 0;
+        return 0;
+    }
+
+    *retLen = (UInt16)len;
+
+    return 1;
 }
 
 
 
+// get regex capture results (match) from regex data mP, capture length as REGEXOFS
+// see MxRegex_getCaps_ex()
 
+UInt8 MxRegex_getCapsOfs_ex(const MXREGEX_M* mP, const UInt16 capsNum, char** retStr, REGEXOFS* retLen)
+{
+    if (capsNum >= mP->capsNum)
+    {
+        *retStr = 0;
+        *retLen = 0;
+        return 0;
+    }
 
+    *retStr = (char*)(mP->caps[capsNum].strP);
+    *retLen = mP->caps[capsNum].len;
 
-//
-// PUBLIC METHODS
-//
+    return 1;
+}
 
 
-// Init regex machine
-// MUST be called once at startup
 
-void MxRegex_init()
+// get regex capture results (match) from default regex data (thread local)
+// see MxRegex_getCaps_ex()
+
+UInt8 MxRegex_getCaps(const UInt16 capsNum, char** retStr, UInt16* retLen)
 {
+    return MxRegex_getCaps_ex(&m, capsNum, retStr, retLen);
+}
+
+
+
+// get regex capture results (match) from default regex data (thread local), capture length as REGEXOFS
+// see MxRegex_getCapsOfs_ex()
+
+UInt8 MxRegex_getCapsOfs(const UInt16 capsNum, char** retStr, REGEXOFS* retLen)
+{
+    return MxRegex_getCapsOfs_ex(&m, capsNum, retStr, retLen);
+}
 
-#if !CONST_CHARSET
 
-    // prepare predefined charset
-    // used for code optimization in case of complex sets
-    // could be hardcoded in order to save RAM (160 bytes)
 
-    Atom_charsetResetAll();                                         // . (include \r\n)
-    Atom_charsetInvert();
-    Atom_charsetExport(&m.charset_dot);
+// get regex public vars of default regex data (thread local)
+// usually for debug only
+// ret:
+//  mP:     ptr to MXREGEX_M m
+// useful elements
+//  mP->m.retSts        if regex fail, get reason (REGEXSTS_OK: simply no match)
+//  mp->m.retRegexOfs   if not REGEXSTS_OK, error position in regex
+//  mp->m.capsNum       nr of captures available
+
+const MXREGEX_M* MxRegex_getData()
+{
+    return &m;
+}
 
-    Atom_charsetResetAll();                                         // \w
-    Atom_charsetAddStr(C_WORD_CHARSET_STR);
-    Atom_charsetExport(&m.charset_word);
 
-    Atom_charsetResetAll();                                         // \d
-    Atom_charsetAddStr(C_DIGIT_CHARSET_STR);
-    Atom_charsetExport(&m.charset_digit);
 
-    Atom_charsetResetAll();                                         // \s
-    Atom_charsetAddStr(C_WHITESPACE_CHARSET_STR);
-    Atom_charsetExport(&m.charset_whitespace);
+// release allocations of regex data: DFA cache and compiled regex of MxRegex_ex(), allocated on first use.
+// Regex data stays usable (allocated again if needed). Default regex data is released when its thread exits
+// parm:
+//  mP: regex data
+
+void MxRegex_release_ex(MXREGEX_M* mP)
+{
+#if MXREGEX_CACHE
+    if (mP->progExP != 0)
+    {
+#if MXREGEX_JIT
+        MxRegex_jitFree(mP->progExP);
+#endif
+        delete mP->progExP;
+        mP->progExP = 0;
+    }
+#elif MXREGEX_JIT
+    MxRegex_jitFree(&mP->progEx);
+#endif
 
+#if MXREGEX_NFA
+    delete mP->dfaP;
+    mP->dfaP = 0;
 #endif
 
     return;
@@ -2092,127 +3813,145 @@ void MxRegex_init()
 
 
 
+#if MXREGEX_STATS
 
+// get hot path counters of regex data mP
+// parm
+//  mP          regex data
+//  lastP       RET counters of last regex call (may be 0)
+//  sumP        RET counters of all calls since MxRegex_resetStats_ex() (may be 0)
 
+void MxRegex_getStats_ex(const MXREGEX_M* mP, REGEXSTATS* lastP, REGEXSTATS* sumP)
+{
+    if (lastP != 0)
+        *lastP = mP->stats;
+    if (sumP != 0)
+        *sumP = mP->statsSum;
+    return;
+}
 
 
-// Regex
-//
-// parm
-//  regexP      ptr to regex pattern string (\0 terminated)
-//  strP        ptr to input string (\0 terminated)
-//  mode        bitfld REGEX_MODE (currently available: case insensitive)
-// ret
-//  0           regex fail or errors detected (you may check m.retSts, m.retRegexOfs for error description)
-//  n           regex match, number of captures. caps[0] is always the match, caps[1..maxCaps-1] are the captures
 
-UInt8 MxRegex(const char* regexP, const char* strP, const UInt16 mode)
+// get hot path counters of default regex data (thread local)
+// see MxRegex_getStats_ex()
+
+void MxRegex_getStats(REGEXSTATS* lastP, REGEXSTATS* sumP)
 {
-    UInt16 t;
-    UInt16 t1;
-    CAPS* cP;
+    MxRegex_getStats_ex(&m, lastP, sumP);
+    return;
+}
 
-    // initialize regex parser
-    ClearDescriptors();
 
-    // store mode flags
-    m.isMultiLine = (mode & REGEXMODE_MULTILINE) ? 1 : 0;
-    m.isSingleLine = (mode & REGEXMODE_SINGLELINE) ? 1 : 0;
 
-    m.retRegexErrOfs = 0;       // clear error position
-    m.strOrigP = strP;          // save ptr to original string
+// clear counters sum of regex data mP
 
-    m.altSegmNum = 0;           // clear alternative segments descriptors
+void MxRegex_resetStats_ex(MXREGEX_M* mP)
+{
+    memset(&mP->statsSum, 0, sizeof(mP->statsSum));
+    return;
+}
 
+#endif
 
-    // init regex as segment[0], on base str. Here is always non-capture
-    if ((m.retSts = SegmentInit(0, strP, regexP, mode, 0)) == REGEXSTS_OK)
-    {
-        m.capsNum = 1;                                      // will populate caps starting at [1]
-        m.altSegmChanged = 0;                               // clear alternate segments changed flag
-        m.iterateCnt = 0;                                   // init watchdog
 
-        // invoke first regex
 
-        if (MxRegex_(0))                                    // if success, set caps[0] to matched string
-        {
-            cP = &m.caps[0];
-            cP->strP = m.segment[0].strP;
-            cP->len = m.segment[0].strParseP - m.segment[0].strP;
-            cP->regexP = m.segment[0].regexP;
+#if MXREGEX_TRACE
 
-            // remove possible empty capsnum
+// set trace hook of backtracking engine, for all regex data used by the calling thread
+// hook is invoked on each parse step and on backtrack, alternative segment, capture, bracket events (see REGEXTRACE_KIND)
+// DFA and Pike VM engines are not traced
+// parm
+//  hookP       hook, 0 = no trace (one branch for each event)
+//  ctxP        hook context, passed as 1st parm (e.g. REGEXTRACE_RING* for MxRegex_traceRing())
 
-            t1 = 1;
-            for (t = 1; t < m.capsNum; t++)
-            {
-                cP = &m.caps[t];
-                if (cP->regexP == 0)                        // skip empty
-                    continue;
+void MxRegex_setTrace(REGEXTRACE_HOOK hookP, void* ctxP)
+{
+    traceHookP = hookP;
+    traceCtxP = ctxP;
+    return;
+}
 
-                if (t1 != t)                                // if need to move
-                {
-                    m.caps[t1].strP = cP->strP;
-                    m.caps[t1].regexP = cP->regexP;
-                    m.caps[t1].len = cP->len;
-                }
-                t1++;
-            }
-            m.capsNum = t1;
-            return (UInt8)m.capsNum;                        // MATCH
-        }
-    }
 
-    // no match / error
 
-    m.retRegexErrOfs = m.segment[0].regexParseP - m.segment[0].regexP;    // on fail set error offset returned from Regex_
-    m.capsNum = 0;                                          // reset capsnum
+// format trace event to a text line
+// ret
+//  nr of chars, like snprintf()
 
-    return 0;                                               // FAIL
+int MxRegex_traceFormat(const REGEXTRACE_EVENT* eP, char* bufP, const size_t len)
+{
+    static const char* const kindName[REGEXTRACE_KIND_NUM] = {
+        "STEP", "BACKTRACK_ADD", "BACKTRACK_ITERATE", "BACKTRACK_MAXOCC",
+        "ALTSEGM_ADD", "ALTSEGM_REMOVE", "ALTSEGM_ITERATE", "ALTSEGM_GET",
+        "CAPS_SAVE", "CAPS_REMOVE", "EOS", "PIPE", "SEGMENT_FAIL", "STR_END", "NEXT_CHAR", "RETRY",
+        "ANCHOR_FAIL", "BRACKET_OPEN", "BRACKET_CLOSE", "BRACKET_MATCH", "BRACKET_FAIL", "ENOUGH_OCC",
+        "MAXITERATE_OVF"
+    };
+
+    return snprintf(bufP, len, "%6lu %2u %-17s str %5lu regex %4u arg %u\n",
+        (unsigned long)eP->step,
+        (unsigned)eP->recurseNum,
+        eP->kind < REGEXTRACE_KIND_NUM ? kindName[eP->kind] : "?",
+        (unsigned long)eP->strOfs,
+        (unsigned)eP->regexOfs,
+        (unsigned)eP->arg
+    );
+}
+
+
+
+// init ring buffer trace sink
+// parm
+//  ringP       ring buffer
+//  dumpP       output of each dump line (e.g. fputs to a log), called on REGEXTRACE_MAXITERATE_OVF; 0 = no dump
 
+void MxRegex_traceRingInit(REGEXTRACE_RING* ringP, void (*dumpP)(const char* lineP))
+{
+    ringP->eventNum = 0;
+    ringP->dumpP = dumpP;
+    return;
 }
 
 
 
-// get regex capture results (match)
-// parm:
-//  capsNum: capture position, 0 is the whole match, 1..n are the capturing brackets
-//  retStr: RET pointer to capture within parsed string (i.e. no \0 termination)
-//  retLen: RET capture length
-// ret:
-//  1: success, 0: capture not available
+// ring buffer trace sink, a REGEXTRACE_HOOK: keeps last TRACE_RING_SIZE events
+// on watchdog (REGEXSTS_MAXITERATE_OVF) the events leading to it are dumped
+// parm
+//  ringP       REGEXTRACE_RING*, see MxRegex_traceRingInit()
 
-UInt8 MxRegex_getCaps(const UInt16 capsNum, char** retStr, UInt16* retLen)
+void MxRegex_traceRing(void* ringP, const REGEXTRACE_EVENT* eP)
 {
-    if (capsNum >= m.capsNum)
-    {
-        *retStr = 0;
-        *retLen = 0;
-        return 0;
-    }
+    REGEXTRACE_RING* rP;
 
-    *retStr = (char*)(m.caps[capsNum].strP);
-    *retLen = m.caps[capsNum].len;
+    rP = (REGEXTRACE_RING*)ringP;
+    rP->event[rP->eventNum % TRACE_RING_SIZE] = *eP;
+    rP->eventNum++;
 
-    return 1;
+    if (eP->kind == REGEXTRACE_MAXITERATE_OVF && rP->dumpP != 0)
+        MxRegex_traceDump(rP, rP->dumpP);
+    return;
 }
 
 
 
-// get regex public vars
-// usually for debug only
-// ret:
-//  mP:     ptr to MXREGEX_M m
-// useful elements
-//  mP->m.retSts        if regex fail, get reason (REGEXSTS_OK: simply no match)
-//  mp->m.retRegexOfs   if not REGEXSTS_OK, error position in regex
-//  mp->m.capsNum       nr of captures available
+// dump events kept by ring buffer, oldest first
 
-const MXREGEX_M* MxRegex_getData()
+void MxRegex_traceDump(const REGEXTRACE_RING* ringP, void (*dumpP)(const char* lineP))
 {
-    return &m;
+    char line[128];
+    UInt32 t;
+
+    t = ringP->eventNum > TRACE_RING_SIZE ? ringP->eventNum - TRACE_RING_SIZE : 0;
+
+    for (; t < ringP->eventNum; t++)
+    {
+        MxRegex_traceFormat(&ringP->event[t % TRACE_RING_SIZE], line, sizeof(line));
+        dumpP(line);
+    }
+    return;
 }
 
+#endif
+
 
 
 
@@ -2225,13 +3964,25 @@ const MXREGEX_M* MxRegex_getData()
 
 #if MXREGEX_DEBUG
 
+#if MXREGEX_TRACE
+
+void Trace_debugOut(void* ctxP, const REGEXTRACE_EVENT* eP)
+{
+    MxRegex_traceFormat(eP, buf, sizeof(buf));
+    OutputDebugStringA((LPCSTR)buf);
+}
+
+#endif
+
 int main()
 {
 
     UInt8 b;
     UInt16 t;
 
-    step = 0;
+#if MXREGEX_TRACE
+    MxRegex_setTrace(Trace_debugOut, 0);
+#endif
     snprintf(buf, sizeof(buf), "\r\n\n\n");
     OutputDebugStringA((LPCSTR)buf);
 
@@ -2251,7 +4002,7 @@ int main()
     //b = MxRegex("(.a|.b).*|.*(.a|.b)", "xa", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE);       // (0,2)(0,2)
     //b = MxRegex("a+b+c", "aabbabc", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE);       // (4,7)
     //b = MxRegex("([abc])*bcd", "abcd", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE);      // (0,4)(0,1)
-    //b = MxRegex("(...|aa)*a", "aa", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE);         // (0,1) | (1,2)
+    //b = MxRegex("(...|aa)*a", "aa", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE);         // (0,1)
     //b = MxRegex("(a*)(a|aa)", "aaaa", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE);      // (0,4)(0,3)(3,4)
     //b = MxRegex("(a*)(b{0,1})(b{1,})b{3}", "aaabbbbbbb", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE);      // (0,10)(0,3)(3,4)(4,7)
     //b = MxRegex("((foo)|(bar))!bas", "foo!bar!bas", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE);      // (4,11)(4,7)(?,?)(4,7) ***
@@ -2267,6 +4018,8 @@ int main()
     //b = MxRegex("^\\s*(GET|POST)\\s+(\\S+)\\s+HTTP/(\\d)\\.(\\d)", " GET /index.html HTTP/1.0\r\n\r\n", 
     //                                  REGEXMODE_CASE_INSENSITIVE | REGEXMODE_SINGLELINE);                 //(0,25)(1,4)(5,16)(22,23)(24,25)
     //b = MxRegex("[.]","a", REGEXMODE_SINGLELINE);  // fail
+    //b = MxRegex("^[ab]?[^a]|c", "baaxxbcaxa", 0);  // (0,1)
+    //b = MxRegex(".{2,}b", " b 1c", 0);         // fail
 
     snprintf(buf, sizeof(buf), "\r\nResponse: %s\r\nstatus code: %d \r\ncapsNum: %d\r\n\r", b ? "OK" : "FAIL", m.retSts, m.capsNum);
     OutputDebugStringA((LPCSTR)buf);
@@ -2278,7 +4031,7 @@ int main()
             m.caps[t].strP - m.strOrigP,
             m.caps[t].strP - m.strOrigP + m.caps[t].len,
             m.caps[t].strP,
-            m.caps[t].len);
+            (int)m.caps[t].len);
         OutputDebugStringA((LPCSTR)buf);
         if (t == 0)
             OutputDebugStringA("\r\n");
@@ -29,12 +29,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #define MXREGEX_H
 
 
+#include <stddef.h>
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
-#define VER "1.05"                              // version
+#define VER "1.06"                              // version
 
 
 
@@ -43,16 +46,56 @@ extern "C" {
 #define MAX_RECURSE 4                           // max regex nesting i.e. brackets within brackets.
 #define MAX_ALTSEG 16                           // max number of alternative segments (a|b)
 #define MAX_CAPS 10                             // max number of capturing brackets, including base caps[0] on regex match.
-#define MAX_BACKTRACK 32                        // max backtracks
+#define MAX_BACKTRACK 32                        // max backtracks (4 above: arrays of regex data, or sized for each compiled regex by a caller arena, see MxRegex_exec_arena())
 
 #define MAX_ITERATE 1024                        // max iterations on same string (watchdog)
 
+#define MAX_PROG_ATOM 96                        // max atoms in a compiled regex, see MxRegex_compile()
+#define MAX_PROG_CHARSET 16                     // max distinct charsets in a compiled regex, like [a-z] \d .
+#define MAX_PROG_PREFIX 16                      // max len of literal prefix of a compiled regex (start position search)
+#define MAX_PROG_MUST 16                        // max len of literal every match of a compiled regex contains (input rejection)
+#define MAX_PROG_RECURSE 16                     // max regex nesting in a compiled regex, regex data with less (MAX_RECURSE) need REGEXMODE_FALLBACK or an arena
+
+#define MXREGEX_NFA 1                           // compile regex also to nfa, used by lazy DFA and Pike VM engines (0 on small RAM targets)
+#define MAX_NFA_NODE 256                        // max nfa nodes in a compiled regex (forward and reverse nfa); if more, nfa engines are not used
+#define DFA_MAX_STATE 64                        // max cached DFA states for each regex data, cache is flushed when full
+#define DFA_MAX_TRANS 2048                      // max cached DFA transitions (each state takes nr of byte classes)
+#define DFA_MAX_LIST 1024                       // max nfa nodes in all cached DFA states
+#define DFA_MAX_FLUSH 8                         // max cache flushes on same string, then fallback to backtracking regex
+#define MEMO_MAX_BITS 131072                    // failure memo backtracker: max nfa nodes * (str len + 1), visited bitmap on stack (16K); else Pike VM
+#define MEMO_MAX_STACK 2048                     // failure memo backtracker: max pending alternatives and captures (16K of stack); else Pike VM
+
 #define CONST_CHARSET 1                         // use hardcoded charset: if true, there is no need to call MxRegex_init()
 
+#define MXREGEX_SIMD 1                          // SSSE3/AVX2 charset span on quantified charsets, if enabled in compiler target (else scalar)
+
+#define MXREGEX_TLS 1                           // default regex data of MxRegex() is thread local (0 if target has no thread local storage)
+
+#define MXREGEX_CACHE 1                         // MxRegex() takes compiled regex from a shared cache, see mxRegexCache.h (requires C++11 atomics, 0 on small RAM targets)
+
+#define MXREGEX_STATS 1                         // hot path counters of each regex call, see MxRegex_getStats() (0: compiled out, no cost)
+
+#define MXREGEX_TRACE 1                         // trace hook of backtracking engine, see MxRegex_setTrace() (0: compiled out)
+#define TRACE_RING_SIZE 64                      // events kept by ring buffer sink REGEXTRACE_RING
+
+#define MXREGEX_JIT 1                           // x86-64 native code of hot compiled regex, see MxRegex_jit() (other targets: regex stay interpreted)
+#define JIT_HOT 64                              // executions of a compiled regex with REGEXMODE_JIT, then it's compiled to native code
+#define JIT_MAX_BYTES (4 * 1024 * 1024)         // native code pages of all regex, then regex stay interpreted
+
+#define MXREGEX_OFS16 0                         // str offsets, lengths and occurrences are 16 bit: compact regex data on small RAM targets, matches up to 64K (0: size_t)
+
     typedef unsigned long UInt32;
     typedef unsigned short UInt16;
     typedef unsigned char UInt8;
 
+#if MXREGEX_OFS16
+    typedef UInt16 REGEXOFS;                    // str offset or len, nr of occurrences
+#define REGEXOFS_MAX 0xffff
+#else
+    typedef size_t REGEXOFS;
+#define REGEXOFS_MAX ((size_t)-1)
+#endif
+
 #define sizeidx_(x) (sizeof(x)/sizeof(x[0]))    // nr of elements of an array
 
 
@@ -66,7 +109,12 @@ extern "C" {
         REGEXMODE_NONE = 0x0000,
         REGEXMODE_CASE_INSENSITIVE = 0x0001,        // comparison is case insensitive
         REGEXMODE_MULTILINE = 0x0002,               // anchor ^$ will also match [\r\n]
-        REGEXMODE_SINGLELINE = 0x0004               // metaclass . will match ^[0]; if not set will match [^\r\n\0]
+        REGEXMODE_SINGLELINE = 0x0004,              // metaclass . will match any char; if not set will match [^\r\n]
+        REGEXMODE_NOCAPS = 0x0008,                  // no captures needed, only caps[0] (match): brackets are non capturing, lazy DFA is used if possible
+        REGEXMODE_LINEAR = 0x0010,                  // linear time: use Pike VM instead of backtracking regex
+        REGEXMODE_MEMO = 0x0020,                    // linear time on short str: failure memo backtracker (see MEMO_MAX_BITS), no watchdog
+        REGEXMODE_JIT = 0x0040,                     // promoted to native code on JIT_HOT execution (MXREGEX_JIT), else only by MxRegex_jit()
+        REGEXMODE_FALLBACK = 0x0080                 // backtracking regex gave up (watchdog, overflow): retry on failure memo backtracker or Pike VM
 
     } REGEX_MODE;
 
@@ -85,7 +133,9 @@ extern "C" {
         REGEXSTS_RECURSE_OVF,                                   // nesting overdlow i.e. brackets within brackets
         REGEXSTS_ALTSEGM_OVF,                                   // alternative segments overflow i.e. total nr of active branches (a|b|c..)
         REGEXSTS_BACKTRACK_OVF,                                 // backtrack ovf
-        REGEXSTS_MAXITERATE_OVF                                 // too many iteration (watchdog, critical)
+        REGEXSTS_MAXITERATE_OVF,                                // too many iteration (watchdog, critical)
+        REGEXSTS_PROG_OVF,                                      // compiled regex overflow i.e. too many atoms or charsets, or nfa nodes with REGEXMODE_LINEAR MEMO
+        REGEXSTS_ARENA_OVF                                      // caller arena too small for compiled regex, see MxRegex_arenaSize()
 
     } REGEX_STS;
 
@@ -113,6 +163,7 @@ extern "C" {
 
     // charset ISO 8859-1
     // 256 bit, bit[ASC(char)] == 1 -> char in set
+    // case insensitive regex: closed under case folding (both cases in set)
     // note: no big difference if using UInt16 or UInt8 on 16 bit ARM
 
     typedef struct
@@ -133,12 +184,15 @@ extern "C" {
         ATOM_TYPE type;                             // atom type
 
         char    c;                                  // char (if simple char)
+        char    cFold;                              // other case of simple char if case insensitive, else c
 
-        UInt16  minOcc;                             // min occurrences
-        UInt16  maxOcc;                             // max occurrences
+        REGEXOFS minOcc;                            // min occurrences
+        REGEXOFS maxOcc;                            // max occurrences, BACKTRACK_MAXOCC no limit
         const char* endP;                           // ptr to char after atom (i.e. after quantifier, if present)
 
         CHARSET charset;                            // charset
+        const CHARSET* charsetP;                    // charset used by matcher (compiled regex)
+        const UInt8* charsetLutP;                   // charset span lookup table (compiled regex)
         UInt8 charsetIsNegate : 1;                  // use negated charset [^
 
         UInt8 charsetAllowNegate : 1;               // charset parser: accept negation [^
@@ -149,27 +203,182 @@ extern "C" {
 
 
 
+    // compiled regex atom, see MxRegex_compile()
+    // atoms are stored in regex order, so comparing ptrs to atoms is like comparing ptrs to regex chars
+
+#define PROG_NO_JUMP 0xffff                     // no jump target
+
+    typedef struct
+    {
+        UInt8   type;                               // ATOM_TYPE
+        char    c;                                  // simple char or anchor char
+        char    cFold;                              // simple char: other case if case insensitive (ISO 8859-1), else c
+
+        UInt8   isCap;                              // ATOMTYPE_BRACKETOPEN: capturing bracket
+        UInt8   capsIdx;                            // ATOMTYPE_BRACKETOPEN: capture slot 1..n (closing bracket order), 0 if non capturing
+        UInt8   charsetIdx;                         // ATOMTYPE_METACLASS: index of REGEXPROG.charset[]
+
+        REGEXOFS minOcc;                            // quantifier (char, metaclass and closing bracket)
+        REGEXOFS maxOcc;
+        UInt16  jump;                               // ATOMTYPE_BRACKETOPEN: idx of closing bracket; ATOMTYPE_PIPE: idx of next | or closing bracket or EOS
+        UInt16  regexOfs;                           // offset of atom in regex string (error report, debug)
+
+    } REGEXINST;
+
+
+
+    // nfa node (Thompson), built from compiled regex atoms, see Nfa_compile()
+
+    typedef enum
+    {
+        NFAOP_CHAR = 0,                                         // consume char arg
+        NFAOP_CHARCI,                                           // consume char arg or its other case y (case insensitive)
+        NFAOP_SET,                                              // consume char in charset[arg] (case folded by compiler)
+        NFAOP_SPLIT,                                            // go to x, then (lower priority) to y
+        NFAOP_SAVE,                                             // capture slot arg (2n begin, 2n+1 end), go to x
+        NFAOP_BEGIN,                                            // assert begin of text, go to x
+        NFAOP_END,                                              // assert end of text, go to x
+        NFAOP_ASSERT,                                           // other anchor arg (\b \B, multiline ^ $), go to x
+        NFAOP_MATCH                                             // regex match
+
+    } NFA_OP;
+
+
+    typedef struct
+    {
+        UInt8   op;                                 // NFA_OP
+        UInt8   arg;                                // char, charset idx, caps slot or anchor char
+        UInt16  x;                                  // next node
+        UInt16  y;                                  // NFAOP_SPLIT: alternative node; NFAOP_CHARCI: other case of arg
+
+    } NFANODE;
+
+
+
+    // sizes of backtracking regex arrays: need of a compiled regex (set by MxRegex_compile()), or limits of regex data in use
+
+#define BACKTRACK_UNBOUNDED 0xffff              // REGEXLIMITS.backtrackNum: depends on str, i.e. a quantifier within a bracket with no max occurrences
+
+    typedef struct
+    {
+        UInt16 recurseNum;                          // segments: max nesting + 1
+        UInt16 altSegmNum;                          // alternative segments: segments with |
+        UInt16 capsNum;                             // captures, including caps[0]
+        UInt16 backtrackNum;                        // backtracks: quantifiers with min != max, times max occurrences of their bracket
+
+    } REGEXLIMITS;
+
+
+
+    // compiled regex
+
+    typedef struct
+    {
+        REGEXINST inst[MAX_PROG_ATOM];              // atoms, last one is always ATOMTYPE_EOS
+        CHARSET charset[MAX_PROG_CHARSET];          // pre-built charsets
+        UInt8 charsetLut[MAX_PROG_CHARSET][32];     // charsets as nibble lookup tables, see Charset_span()
+
+        UInt16 instNum;                             // element counters
+        UInt8 charsetNum;
+        UInt8 capsNum;                              // nr of capturing brackets + 1 (caps[0])
+
+        UInt16 mode;                                // regex mode flags
+        REGEX_STS retSts;                           // compile status
+        UInt16 retRegexErrOfs;                      // in case of error, offset of failed atom in regex
+
+        char prefix[MAX_PROG_PREFIX];               // literal every match starts with
+        char prefixFold[MAX_PROG_PREFIX];           // other case of prefix chars if case insensitive, else prefix
+        UInt8 prefixLen;                            // 0 no prefix
+        UInt8 isLineStart;                          // every alternative on base level starts with ^: multiline start positions are line starts only
+        UInt8 isEndAnchor;                          // every alternative on base level ends with $: match ends at end of str (if not multiline)
+
+        REGEXOFS minLen;                            // min match len
+        REGEXOFS maxLen;                            // max match len, REGEXOFS_MAX no limit
+
+        char must[MAX_PROG_MUST];                   // literal every match contains, anywhere in match (requires MXREGEX_NFA)
+        char mustFold[MAX_PROG_MUST];               // other case of must chars if case insensitive, else must
+        UInt8 mustLen;                              // 0 no literal
+        UInt8 mustRare;                             // idx of rarest char of must, searched first
+
+        REGEXLIMITS need;                           // exact size of backtracking regex arrays, see MxRegex_arenaSize()
+
+#if MXREGEX_JIT
+        void* jitP;                                 // native code, 0 none yet (written on promotion, atomic), see MxRegex_jit()
+        const void* jitOwnerP;                      // compiled regex jitP was compiled for: a copy of it doesn't run (or release) that code
+        UInt32 jitSize;                             // native code mapped bytes
+        UInt32 execNum;                             // executions till promotion to native code (REGEXMODE_JIT, JIT_HOT, atomic)
+#endif
+
+#if MXREGEX_NFA
+        NFANODE nfa[MAX_NFA_NODE];                  // forward and reverse nfa
+        UInt16 nfaNum;                              // nr of nfa nodes, 0 if nfa not available (too many nodes)
+        UInt16 nfaStart;                            // start node of forward nfa
+        UInt16 nfaRevStart;                         // start node of reverse nfa (reverse regex, used to find match begin)
+        UInt8 byteClass[256];                       // byte -> class, bytes of same class are never told apart by the nfa
+        UInt16 byteClassNum;                        // nr of byte classes
+        UInt8 isDfa;                                // DFA engine available (no \b \B or multiline anchors)
+        UInt8 isNfaFirst;                           // quantified brackets: run on failure memo backtracker or Pike VM (leftmost first)
+        UInt32 hash;                                // regex string and mode hash, identifies regex in DFA cache
+#endif
+
+    } REGEXPROG;
+
+
+
+    // lazy DFA state: ordered list of nfa nodes (thread priority order)
+
+#define DFA_TRANS_UNKNOWN 0xffff                // transition not yet computed
+#define DFA_TRANS_DEAD 0xfffe                   // no thread left
+
+    typedef struct
+    {
+        UInt16 listIdx;                             // idx of first node in REGEXDFA.list[]
+        UInt16 listNum;                             // nr of nodes
+        UInt16 hash;                                // list hash
+        UInt8 flags;                                // bitfld DFAF_*
+
+    } DFASTATE;
+
+
+
+    // lazy DFA cache, one for each regex data
+
+    typedef struct
+    {
+        const REGEXPROG* progP;                     // compiled regex of cached states
+        UInt32 progHash;
+        DFASTATE state[DFA_MAX_STATE];
+        UInt16 trans[DFA_MAX_TRANS];                // transitions, [state * byteClassNum + class] -> state
+        UInt16 list[DFA_MAX_LIST];                  // nfa nodes of states
+        UInt16 start[4];                            // start states (forward, reverse, reverse at end of text, forward after begin of text)
+        UInt16 stateNum;                            // element counters
+        UInt16 stateMax;                            // max states, depending on nr of byte classes
+        UInt16 listNum;
+        UInt32 flushNum;                            // nr of cache flushes (statistics)
+
+    } REGEXDFA;
+
+
+
     // segment evaluated by recursive regex.
     // Base segment [0] is the whole string, otherwise is the nested segment between regex brackets
 
     typedef struct
     {
-        const char* regexP;                         // ptr base regex
-        const char* regexParseP;                    // ptr regex parser
+        const REGEXINST* regexP;                    // ptr base regex
+        const REGEXINST* regexParseP;               // ptr regex parser
         const char* strP;                           // ptr base str
         const char* strParseP;                      // ptr str parser
         const char* strCapP;                        // ptr last capture str, in case of brackets with quantifier
 
-        UInt16  atomNumOcc;                         // atom occurrencies a{n}
-        UInt16  segmNumOcc;                         // segment occurrenties (..){n}
+        REGEXOFS atomNumOcc;                        // atom occurrencies a{n}
+        REGEXOFS segmNumOcc;                        // segment occurrenties (..){n}
 
         UInt16 mode;                                // regex mode flags
-        UInt8 isCI : 1;                             // flag case insensitive
         UInt8 isCap : 1;                            // flag capture segment
         UInt8 parseFailed : 1;                      // flag no match condition (not considering quantifier)
         UInt8 isEnoughOcc : 1;                      // flag got enough occurrences for segment match, no need for backtrack
         UInt8 strCharAcquired : 1;                  // flat at least 1 char acquired from str. Avoid lookup on empty regex like "([ab]*)*a"
-        UInt8 anchorSOSfail : 1;                    // flag anchor start of string ^ failed in NOT multiline (optimize)
 
     } SEGMENT;
 
@@ -179,9 +388,9 @@ extern "C" {
 
     typedef struct
     {
-        const char* regexP;                         // ptr segment (reference)
-        const char* regexBaseP;                     // ptr original alternative segment
-        const char* regexNextP;                     // ptr to next alternative segment
+        const REGEXINST* regexP;                    // ptr segment (reference)
+        const REGEXINST* regexBaseP;                // ptr original alternative segment
+        const REGEXINST* regexNextP;                // ptr to next alternative segment
 
     } ALTSEGM;
 
@@ -192,8 +401,8 @@ extern "C" {
     typedef struct
     {
         const char* strP;                           // captured string ptr
-        const char* regexP;                         // regex segment
-        UInt16  len;                                // captured string len
+        const REGEXINST* regexP;                    // regex segment
+        REGEXOFS len;                               // captured string len
 
     } CAPS;
 
@@ -201,34 +410,160 @@ extern "C" {
 
     // backtrack
 
-#define BACKTRACK_MAXOCC 0xffff                 // no limit to nr of occurrences
+#define BACKTRACK_MAXOCC REGEXOFS_MAX           // no limit to nr of occurrences
 
     typedef struct
     {
-        const char* regexParseP;                    // backtrack position (ptr to 1st char after atom)
-        UInt16 minOcc;                              // current counters
-        UInt16 maxOcc;
-        UInt16 iteration;                           // iterations within segment e.g. (\\d+)+
+        const REGEXINST* regexParseP;               // backtrack position (ptr to 1st atom after atom)
+        REGEXOFS minOcc;                            // current counters
+        REGEXOFS maxOcc;
+        REGEXOFS iteration;                         // iterations within segment e.g. (\\d+)+
 
     } BACKTRACK;
 
 
 
 
-    // all static data
+    // span of str (match or capture), offset from str begin
+
+    typedef struct
+    {
+        size_t ofs;                                 // offset
+        size_t len;                                 // len
+
+    } REGEXSPAN;
+
+
+
+    // find all iterator, see MxRegex_findNext()
+
+    typedef struct
+    {
+        const REGEXPROG* progP;                     // compiled regex
+        const char* strP;                           // input string
+        size_t strLen;
+        size_t ofs;                                 // next search start offset
+        REGEXSPAN* capsP;                           // caller array (MAX_CAPS elements): match and captures
+        UInt8 isDone;                               // no more matches
+
+    } REGEXITER;
+
+
+
+    // streaming regex state, see MxRegex_streamBegin()
+
+    typedef struct MxRegexStream MXREGEX_STREAM;
+
+
+
+
+    // regex counters, see MxRegex_getStats(). Backtracking engine, except byteNum
+
+    typedef struct
+    {
+        UInt32 callNum;                                     // nr of regex calls (1 for last call)
+        UInt32 startNum;                                    // start positions tried
+        UInt32 atomNum;                                     // atoms evaluated
+        UInt32 backtrackRetryNum;                           // retries by BacktrackIterate()
+        UInt32 altSegmRetryNum;                             // retries by AltSegmIterate()
+        UInt16 backtrackPeak;                               // max backtrackNum
+        UInt16 altSegmPeak;                                 // max altSegmNum
+        UInt16 recursePeak;                                 // max recursion depth (nested brackets)
+        UInt32 fallbackNum;                                 // calls retried on failure memo backtracker or Pike VM (REGEXMODE_FALLBACK)
+        size_t byteNum;                                     // str bytes examined, from start offset to farthest char read (DFA, Pike VM: to end of str)
+
+    } REGEXSTATS;
+
+
+
+
+    // trace event kind, see REGEXTRACE_EVENT (arg meaning in brackets)
+
+    typedef enum
+    {
+        REGEXTRACE_STEP = 0,                                    // atom parse step, step is incremented (arg: regex ofs of segment)
+        REGEXTRACE_BACKTRACK_ADD,                               // backtrack added (arg: backtrack nr)
+        REGEXTRACE_BACKTRACK_ITERATE,                           // backtrack retry, alt segments reset (arg: new maxOcc)
+        REGEXTRACE_BACKTRACK_MAXOCC,                            // backtrack max occurrences set or applied to atom (arg: maxOcc)
+        REGEXTRACE_ALTSEGM_ADD,                                 // alternative segment added or updated (arg: regex ofs of next segment)
+        REGEXTRACE_ALTSEGM_REMOVE,                              // alternative segment removed (arg: regex ofs of removed group)
+        REGEXTRACE_ALTSEGM_ITERATE,                             // alternative segment retry (arg: regex ofs of new segment)
+        REGEXTRACE_ALTSEGM_GET,                                 // parser set to active alternative segment (arg: regex ofs of segment)
+        REGEXTRACE_CAPS_SAVE,                                   // capture saved, str ofs is capture begin (arg: caps nr)
+        REGEXTRACE_CAPS_REMOVE,                                 // capture removed (arg: caps nr)
+        REGEXTRACE_EOS,                                         // end of regex
+        REGEXTRACE_PIPE,                                        // | after a segment match
+        REGEXTRACE_SEGMENT_FAIL,                                // segment match fail
+        REGEXTRACE_STR_END,                                     // end of str reached, no match
+        REGEXTRACE_NEXT_CHAR,                                   // regex restarts from next str char
+        REGEXTRACE_RETRY,                                       // regex retried on same str position
+        REGEXTRACE_ANCHOR_FAIL,                                 // anchor failed (arg: anchor char)
+        REGEXTRACE_BRACKET_OPEN,                                // ( nested segment
+        REGEXTRACE_BRACKET_CLOSE,                               // ) end of nested segment
+        REGEXTRACE_BRACKET_MATCH,                               // ) segment match with enough occurrences (arg: minOcc)
+        REGEXTRACE_BRACKET_FAIL,                                // ) segment fail
+        REGEXTRACE_ENOUGH_OCC,                                  // ) quantifier satisfied, parsed chars are definitive
+        REGEXTRACE_MAXITERATE_OVF,                              // watchdog, regex stopped with REGEXSTS_MAXITERATE_OVF
+        REGEXTRACE_KIND_NUM
+
+    } REGEXTRACE_KIND;
+
+
+
+
+    // trace event of backtracking engine, passed to the hook set by MxRegex_setTrace()
+
+    typedef struct
+    {
+        UInt32 step;                                        // parse step in regex call, from 1 (0 before first step)
+        UInt16 recurseNum;                                  // recursion level (nested brackets)
+        UInt16 kind;                                        // REGEXTRACE_KIND
+        size_t strOfs;                                      // str offset of parser, from str begin
+        UInt16 regexOfs;                                    // regex offset
+        UInt16 arg;                                         // depends on kind, see REGEXTRACE_KIND
+
+    } REGEXTRACE_EVENT;
+
+    typedef void (*REGEXTRACE_HOOK)(void* ctxP, const REGEXTRACE_EVENT* eP);
+
+
+
+
+    // ring buffer trace sink: keeps last TRACE_RING_SIZE events, dumped on REGEXTRACE_MAXITERATE_OVF
+    // see MxRegex_traceRingInit()
+
+    typedef struct
+    {
+        REGEXTRACE_EVENT event[TRACE_RING_SIZE];            // last events, circular
+        UInt32 eventNum;                                    // events received (next one at eventNum % TRACE_RING_SIZE)
+        void (*dumpP)(const char* lineP);                   // dump line output, 0 no dump
+
+    } REGEXTRACE_RING;
+
+
+
+
+    // all regex data. One for each thread, see MxRegex_ex(). Must be zero initialized (static, new MXREGEX_M(), or = {})
 
     typedef struct
     {
-        SEGMENT segment[MAX_RECURSE];                       // data for recursive regex
-        ALTSEGM altSegm[MAX_ALTSEG];                        // alternative segment pointers
-        CAPS caps[MAX_CAPS];                                // captures. If success, [0] is the whole match, [1..n] are the capturing bracket
-        BACKTRACK backtrack[MAX_BACKTRACK];                 // backtrack handler
+        SEGMENT* segment;                                   // data for recursive regex
+        ALTSEGM* altSegm;                                   // alternative segment pointers
+        CAPS* caps;                                         // captures. If success, [0] is the whole match, [1..n] are the capturing bracket
+        BACKTRACK* backtrack;                               // backtrack handler
+        REGEXLIMITS limit;                                  // size of arrays above, set on each regex call: own arrays below or caller arena
+
+        SEGMENT segmentOwn[MAX_RECURSE];                    // own arrays, used if no arena
+        ALTSEGM altSegmOwn[MAX_ALTSEG];
+        CAPS capsOwn[MAX_CAPS];
+        BACKTRACK backtrackOwn[MAX_BACKTRACK];
 
         UInt16 altSegmNum;                                  // element counters
         UInt16 capsNum;
         UInt16 backtrackNum;
 
         REGEXATOM atom;                                     // used by atom parser
+        const REGEXPROG* progP;                             // compiled regex in use
 
         UInt8 isMultiLine : 1;                              // multi line regex mode (see REGEXMODE_MULTILINE)
         UInt8 isSingleLine : 1;                             // single line regex mode
@@ -236,17 +571,33 @@ extern "C" {
         REGEX_STS  retSts;                                  // regex status
         UInt16 retRegexErrOfs;                              // in case of error, ptr to regex failed char
         const char* strOrigP;                               // ptr to original string
+        const char* strEndP;                                // ptr to end of original string (\0 is a normal char)
 
         UInt8 altSegmChanged : 1;                           // flag: alternative segments changed, must re-evaluate regex
 
-        UInt16 iterateCnt;                                  // watchdog
+        UInt32 iterateCnt;                                  // watchdog
+
+#if MXREGEX_CACHE
+        REGEXPROG* progExP;                                 // compiled regex used by MxRegex_ex() if not cached, allocated on first use (0 none)
+#else
+        REGEXPROG progEx;                                   // compiled regex used by MxRegex_ex()
+#endif
+
+#if MXREGEX_NFA
+        REGEXDFA* dfaP;                                     // lazy DFA cache, allocated on first use (0 none)
+#endif
+
+#if MXREGEX_STATS
+        REGEXSTATS stats;                                   // counters of last regex call
+        REGEXSTATS statsSum;                                // counters of all calls, since MxRegex_resetStats_ex()
+        const char* statsFarP;                              // farthest str char read in last call
+#endif
 
-        // for code optimization, can be hardcoded to save RAM (128 bytes). See MxRegex_init()
-#if !CONST_CHARSET
-        CHARSET charset_dot;                                // . non singleline, including \r\n
-        CHARSET charset_word;                               // \w
-        CHARSET charset_digit;                              // \d
-        CHARSET charset_whitespace;                         // \s
+#if MXREGEX_TRACE
+        REGEXTRACE_HOOK traceHookP;                         // trace hook of regex call (from thread hook, see MxRegex_setTrace()), 0 none
+        void* traceCtxP;                                    // trace hook context
+        UInt32 traceStep;                                   // parse step
+        UInt16 traceRecurseNum;                             // recursion level of last event
 #endif
 
     } MXREGEX_M;
@@ -258,9 +609,70 @@ extern "C" {
 
     extern void MxRegex_init();                                                         // init charsets, invoked once at startup
     extern UInt8 MxRegex(const char* strP, const char* regexP, const UInt16 mode);      // regex
-    extern UInt8 MxRegex_getCaps(const UInt16 capsNum, char** retStr, UInt16* retLen);  // get captures after regex match
+    extern REGEX_STS MxRegex_compile(const char* regexP, const UInt16 mode, REGEXPROG* progP);  // compile regex once
+    extern UInt8 MxRegex_exec(const REGEXPROG* progP, const char* strP);                // regex on compiled regex
+    extern UInt8 MxRegex_getCaps(const UInt16 capsNum, char** retStr, UInt16* retLen);      // get captures after regex match
+    extern UInt8 MxRegex_getCapsOfs(const UInt16 capsNum, char** retStr, REGEXOFS* retLen); // same, capture len as REGEXOFS (longer than 65535 chars)
     extern const MXREGEX_M* MxRegex_getData();                                          // get all regex data
 
+    // reentrant methods, regex data mP is provided by caller (one for each thread)
+
+    extern UInt8 MxRegex_ex(MXREGEX_M* mP, const char* regexP, const char* strP, const UInt16 mode);
+    extern UInt8 MxRegex_exec_ex(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP);
+    extern UInt8 MxRegex_getCaps_ex(const MXREGEX_M* mP, const UInt16 capsNum, char** retStr, UInt16* retLen);
+    extern UInt8 MxRegex_getCapsOfs_ex(const MXREGEX_M* mP, const UInt16 capsNum, char** retStr, REGEXOFS* retLen);
+    extern void MxRegex_release_ex(MXREGEX_M* mP);                                      // release allocations of regex data (default one: at thread exit)
+
+    // length delimited input string (not \0 terminated, \0 is a normal char)
+
+    extern UInt8 MxRegex_len(const char* regexP, const char* strP, const size_t strLen, const UInt16 mode);
+    extern UInt8 MxRegex_exec_len(const REGEXPROG* progP, const char* strP, const size_t strLen);
+    extern UInt8 MxRegex_len_ex(MXREGEX_M* mP, const char* regexP, const char* strP, const size_t strLen, const UInt16 mode);
+    extern UInt8 MxRegex_exec_len_ex(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const size_t strLen);
+
+    // caller arena: backtracking regex arrays sized for each compiled regex
+
+    extern size_t MxRegex_arenaSize(const REGEXPROG* progP, const UInt16 backtrackNum);
+    extern UInt8 MxRegex_exec_arena(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const size_t strLen, void* arenaP, const size_t arenaSize);
+
+    // find all matches, each one from the end of the previous one
+
+    extern void MxRegex_findBegin(REGEXITER* itP, const REGEXPROG* progP, const char* strP, const size_t strLen, REGEXSPAN* capsP);
+    extern UInt8 MxRegex_findNext(MXREGEX_M* mP, REGEXITER* itP);
+
+    // hot path counters (requires MXREGEX_STATS)
+
+#if MXREGEX_STATS
+    extern void MxRegex_getStats(REGEXSTATS* lastP, REGEXSTATS* sumP);
+    extern void MxRegex_getStats_ex(const MXREGEX_M* mP, REGEXSTATS* lastP, REGEXSTATS* sumP);
+    extern void MxRegex_resetStats_ex(MXREGEX_M* mP);
+#endif
+
+    // trace hook of backtracking engine (requires MXREGEX_TRACE)
+
+#if MXREGEX_TRACE
+    extern void MxRegex_setTrace(REGEXTRACE_HOOK hookP, void* ctxP);                    // hook of calling thread, 0 none
+    extern void MxRegex_traceRingInit(REGEXTRACE_RING* ringP, void (*dumpP)(const char* lineP));
+    extern void MxRegex_traceRing(void* ringP, const REGEXTRACE_EVENT* eP);             // ring buffer sink, hook with ctxP = REGEXTRACE_RING*
+    extern void MxRegex_traceDump(const REGEXTRACE_RING* ringP, void (*dumpP)(const char* lineP));
+    extern int MxRegex_traceFormat(const REGEXTRACE_EVENT* eP, char* bufP, const size_t len);
+#endif
+
+    // x86-64 native code of compiled regex (requires MXREGEX_JIT): done now, or on JIT_HOT execution with REGEXMODE_JIT
+
+#if MXREGEX_JIT
+    extern UInt8 MxRegex_jit(REGEXPROG* progP);
+    extern void MxRegex_jitFree(REGEXPROG* progP);                                      // no thread may be running the regex
+#endif
+
+    // streaming regex, input str fed in chunks (Pike VM, requires MXREGEX_NFA)
+
+#if MXREGEX_NFA
+    extern MXREGEX_STREAM* MxRegex_streamBegin(const REGEXPROG* progP);
+    extern UInt8 MxRegex_streamFeed(MXREGEX_STREAM* sP, const char* chunkP, const size_t len);
+    extern UInt8 MxRegex_streamEnd(MXREGEX_STREAM* sP, REGEXSPAN* capsP);
+#endif
+
 
 
 
@@ -269,4 +681,19 @@ extern "C" {
 #endif
 
 
+
+    // C++17 std::string_view input string (length delimited)
+
+#if defined(__cplusplus) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+
+#include <string_view>
+
+inline UInt8 MxRegex(const char* regexP, const std::string_view str, const UInt16 mode) { return MxRegex_len(regexP, str.data(), str.size(), mode); }
+inline UInt8 MxRegex_exec(const REGEXPROG* progP, const std::string_view str) { return MxRegex_exec_len(progP, str.data(), str.size()); }
+inline UInt8 MxRegex_ex(MXREGEX_M* mP, const char* regexP, const std::string_view str, const UInt16 mode) { return MxRegex_len_ex(mP, regexP, str.data(), str.size(), mode); }
+inline UInt8 MxRegex_exec_ex(MXREGEX_M* mP, const REGEXPROG* progP, const std::string_view str) { return MxRegex_exec_len_ex(mP, progP, str.data(), str.size()); }
+
+#endif
+
+
 #endif // #ifndef MXREGEX_H
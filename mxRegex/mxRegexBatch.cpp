@@ -0,0 +1,527 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// Batch regex: one compiled regex on many records, on a work stealing thread pool.
+//
+// Records are split in equal ranges, one for each worker thread.
+// Each worker takes BATCH_GRAIN records at once from the front of its own range;
+// when its range is empty, it steals the back half of the largest range left.
+// Each worker has its own regex data MXREGEX_M, compiled regex is shared (read only).
+//
+// Lines regex: one compiled regex on each line of a str (e.g. a config dump), see MxRegex_lines().
+// Str is split in chunks of LINES_GRAIN bytes at line starts, taken in order by the workers;
+// line ends are found by a vectorized scan, and each line is matched on its own.
+
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+#include "mxRegexBatch.h"
+#include "mxRegexInt.h"
+
+
+
+
+
+// worker range of records [beginIdx, endIdx)
+
+typedef struct
+{
+    std::mutex lock;
+    UInt32 beginIdx;                                // next record for owner
+    UInt32 endIdx;                                  // end of range, moved back by thieves
+
+} BATCH_QUEUE;
+
+
+
+// batch shared data
+
+typedef struct
+{
+    const REGEXPROG* progP;                         // compiled regex
+    const char* const* strP;                        // records
+    BATCH_RESULT* resP;                             // results
+    UInt16 threadNum;                               // nr of workers
+    BATCH_QUEUE queue[BATCH_MAX_THREAD];            // one for each worker
+    UInt32 matchNum[BATCH_MAX_THREAD];              // nr of matching records, for each worker
+
+} BATCH;
+
+
+
+
+
+// regex on records [beginIdx, endIdx), save results
+// ret
+//  nr of matching records
+
+UInt32 Batch_exec(BATCH* bP, MXREGEX_M* mP, UInt32 beginIdx, const UInt32 endIdx)
+{
+    BATCH_RESULT* rP;
+    const char* strP;
+    UInt32 matchNum;
+    UInt16 t;
+
+    matchNum = 0;
+
+    for (; beginIdx < endIdx; beginIdx++)
+    {
+        strP = bP->strP[beginIdx];
+        rP = &bP->resP[beginIdx];
+
+        rP->capsNum = MxRegex_exec_ex(mP, bP->progP, strP);
+        rP->retSts = (UInt8)mP->retSts;
+
+        for (t = 0; t < rP->capsNum; t++)
+        {
+            rP->caps[t].ofs = (REGEXOFS)(mP->caps[t].strP - strP);
+            rP->caps[t].len = mP->caps[t].len;
+        }
+
+        if (rP->capsNum)
+            matchNum++;
+    }
+
+    return matchNum;
+}
+
+
+
+// take next records from own range
+// ret
+//  1 ok, range in retBeginIdx retEndIdx
+//  0 own range is empty
+
+UInt8 Batch_take(BATCH_QUEUE* qP, UInt32* retBeginIdx, UInt32* retEndIdx)
+{
+    std::lock_guard<std::mutex> guard(qP->lock);
+
+    if (qP->beginIdx >= qP->endIdx)
+        return 0;
+
+    *retBeginIdx = qP->beginIdx;
+    qP->beginIdx += (qP->endIdx - qP->beginIdx < BATCH_GRAIN) ? qP->endIdx - qP->beginIdx : BATCH_GRAIN;
+    *retEndIdx = qP->beginIdx;
+
+    return 1;
+}
+
+
+
+// steal back half of the largest range left, move it to own range
+// parm
+//  workerIdx   thief
+// ret
+//  1 ok, own range updated
+//  0 no records left
+
+UInt8 Batch_steal(BATCH* bP, const UInt16 workerIdx)
+{
+    BATCH_QUEUE* qP;
+    UInt32 beginIdx;
+    UInt32 endIdx;
+    UInt32 t;
+    UInt16 victimIdx;
+    UInt16 t1;
+
+    while (1)
+    {
+        // search for largest range
+
+        victimIdx = workerIdx;
+        t = 0;
+
+        for (t1 = 0; t1 < bP->threadNum; t1++)
+        {
+            if (t1 == workerIdx)
+                continue;
+
+            qP = &bP->queue[t1];
+            std::lock_guard<std::mutex> guard(qP->lock);
+
+            if (qP->endIdx > qP->beginIdx && qP->endIdx - qP->beginIdx > t)
+            {
+                t = qP->endIdx - qP->beginIdx;
+                victimIdx = t1;
+            }
+        }
+
+        if (victimIdx == workerIdx)                                 // no records left: done
+            return 0;
+
+        // steal back half
+
+        qP = &bP->queue[victimIdx];
+        {
+            std::lock_guard<std::mutex> guard(qP->lock);
+
+            if (qP->beginIdx >= qP->endIdx)                         // emptied in the meantime, retry
+                continue;
+
+            endIdx = qP->endIdx;
+            beginIdx = endIdx - (endIdx - qP->beginIdx + 1) / 2;
+            qP->endIdx = beginIdx;
+        }
+
+        qP = &bP->queue[workerIdx];
+        {
+            std::lock_guard<std::mutex> guard(qP->lock);
+            qP->beginIdx = beginIdx;
+            qP->endIdx = endIdx;
+        }
+
+        return 1;
+    }
+}
+
+
+
+// worker thread
+
+void Batch_worker(BATCH* bP, const UInt16 workerIdx)
+{
+    MXREGEX_M* mP;
+    UInt32 beginIdx;
+    UInt32 endIdx;
+
+    mP = new MXREGEX_M();                                           // own regex data (zero initialized)
+    bP->matchNum[workerIdx] = 0;
+
+    do
+    {
+        while (Batch_take(&bP->queue[workerIdx], &beginIdx, &endIdx))
+            bP->matchNum[workerIdx] += Batch_exec(bP, mP, beginIdx, endIdx);
+
+    } while (Batch_steal(bP, workerIdx));
+
+    MxRegex_release_ex(mP);
+    delete mP;
+    return;
+}
+
+
+
+
+
+//
+// PUBLIC METHODS
+//
+
+
+// Batch regex
+// Same compiled regex on many records, using a work stealing thread pool.
+// Calling thread is worker #0.
+//
+// parm
+//  progP       ptr to compiled regex, see MxRegex_compile()
+//  strP        ptr to records (\0 terminated)
+//  strNum      nr of records
+//  resP        RET results, one for each record
+//  threadNum   nr of worker threads, 0 = nr of cores
+// ret
+//  nr of matching records
+
+UInt32 MxRegex_batch(const REGEXPROG* progP, const char* const* strP, const UInt32 strNum, BATCH_RESULT* resP, UInt16 threadNum)
+{
+    BATCH* bP;
+    std::thread* threadP[BATCH_MAX_THREAD];
+    UInt16 threadStarted;
+    UInt32 matchNum;
+    UInt16 t;
+
+    if (threadNum == 0)                                             // default: one for each core
+        threadNum = (UInt16)std::thread::hardware_concurrency();
+
+    if (threadNum > (strNum + BATCH_GRAIN - 1) / BATCH_GRAIN)      // no more threads than records
+        threadNum = (UInt16)((strNum + BATCH_GRAIN - 1) / BATCH_GRAIN);
+
+    if (threadNum > BATCH_MAX_THREAD)
+        threadNum = BATCH_MAX_THREAD;
+
+    if (threadNum == 0)
+        threadNum = 1;
+
+    // split records in equal ranges
+
+    bP = new BATCH;
+    bP->progP = progP;
+    bP->strP = strP;
+    bP->resP = resP;
+    bP->threadNum = threadNum;
+
+    for (t = 0; t < threadNum; t++)
+    {
+        bP->queue[t].beginIdx = (UInt32)((unsigned long long)strNum * t / threadNum);
+        bP->queue[t].endIdx = (UInt32)((unsigned long long)strNum * (t + 1) / threadNum);
+        bP->matchNum[t] = 0;
+    }
+
+    // start workers #1..n. If a thread can't be started, its records will be stolen
+
+    for (threadStarted = 1; threadStarted < threadNum; threadStarted++)
+    {
+        try
+        {
+            threadP[threadStarted] = new std::thread(Batch_worker, bP, threadStarted);
+        }
+        catch (...)
+        {
+            break;
+        }
+    }
+
+    Batch_worker(bP, 0);                                            // worker #0
+
+    matchNum = bP->matchNum[0];
+    for (t = 1; t < threadStarted; t++)
+    {
+        threadP[t]->join();
+        delete threadP[t];
+        matchNum += bP->matchNum[t];
+    }
+
+    delete bP;
+    return matchNum;
+}
+
+
+
+
+
+//
+// LINES
+//
+
+
+// lines shared data
+
+typedef struct
+{
+    const REGEXPROG* progP;                         // compiled regex
+    const char* strP;                               // str
+    const char* endP;                               // end of str
+    size_t resNum;                                  // max results
+    UInt32 chunkNum;                                // nr of chunks of LINES_GRAIN bytes
+    std::atomic<UInt32> chunkIdx;                   // next chunk to take
+    std::atomic<UInt32> stopIdx;                    // chunks from here are not needed: enough matching lines before
+    std::mutex lock;                                // for done chunks
+    UInt32 doneIdx;                                 // chunks [0, doneIdx) are done
+    size_t doneMatchNum;                            // nr of matching lines in chunks [0, doneIdx)
+    std::vector<UInt8> isDone;                      // chunk done, for each chunk
+    std::vector<std::vector<LINES_RESULT> > res;    // matching lines, for each chunk
+
+} LINES;
+
+
+
+// line end \r \n or \r\n
+// ret
+//  ptr to next line start (endP if none)
+
+const char* Lines_next(const char* eolP, const char* endP)
+{
+    if (eolP >= endP)
+        return endP;
+
+    if (eolP[0] == '\r' && eolP + 1 < endP && eolP[1] == '\n')
+        return eolP + 2;
+
+    return eolP + 1;
+}
+
+
+
+// begin of chunk: 1st line start at or after chunk offset
+
+const char* Lines_chunkBegin(const LINES* lP, const UInt32 chunkIdx)
+{
+    const char* p;
+
+    p = lP->strP + (size_t)chunkIdx * LINES_GRAIN;
+    if (p >= lP->endP)
+        return lP->endP;
+
+    if (p == lP->strP || p[-1] == '\n' || (p[-1] == '\r' && *p != '\n'))   // already at line start
+        return p;
+
+    return Lines_next(StrNewline(p, lP->endP), lP->endP);
+}
+
+
+
+// regex on lines starting in chunk, save results (up to resNum)
+
+void Lines_exec(LINES* lP, MXREGEX_M* mP, const UInt32 chunkIdx)
+{
+    std::vector<LINES_RESULT>* resP;
+    LINES_RESULT* rP;
+    const char* lineP;
+    const char* eolP;
+    const char* chunkEndP;
+    UInt8 capsNum;
+    UInt8 t;
+
+    resP = &lP->res[chunkIdx];
+    chunkEndP = Lines_chunkBegin(lP, chunkIdx + 1);
+
+    for (lineP = Lines_chunkBegin(lP, chunkIdx); lineP < chunkEndP; lineP = Lines_next(eolP, lP->endP))
+    {
+        eolP = StrNewline(lineP, lP->endP);
+
+        if ((capsNum = MxRegex_exec_len_ex(mP, lP->progP, lineP, eolP - lineP)) == 0)
+            continue;
+
+        resP->resize(resP->size() + 1);
+        rP = &resP->back();
+        rP->lineOfs = lineP - lP->strP;
+        rP->lineLen = eolP - lineP;
+        rP->capsNum = capsNum;
+
+        for (t = 0; t < capsNum; t++)
+        {
+            rP->caps[t].ofs = mP->caps[t].strP - lP->strP;
+            rP->caps[t].len = mP->caps[t].len;
+        }
+
+        if (resP->size() >= lP->resNum)                             // enough for any chunk
+            break;
+    }
+
+    return;
+}
+
+
+
+// worker thread
+
+void Lines_worker(LINES* lP)
+{
+    MXREGEX_M* mP;
+    UInt32 chunkIdx;
+
+    mP = new MXREGEX_M();                                           // own regex data (zero initialized)
+
+    while ((chunkIdx = lP->chunkIdx++) < lP->chunkNum && chunkIdx < lP->stopIdx)
+    {
+        Lines_exec(lP, mP, chunkIdx);
+
+        std::lock_guard<std::mutex> guard(lP->lock);
+
+        lP->isDone[chunkIdx] = 1;
+        while (lP->doneIdx < lP->chunkNum && lP->isDone[lP->doneIdx])        // matching lines in done chunks, in str order
+            lP->doneMatchNum += lP->res[lP->doneIdx++].size();
+
+        if (lP->doneMatchNum >= lP->resNum)                         // enough: following chunks are not needed
+            lP->stopIdx = lP->doneIdx;
+    }
+
+    MxRegex_release_ex(mP);
+    delete mP;
+    return;
+}
+
+
+
+// Lines regex
+// Same compiled regex on each line of str, lines spread on a thread pool. Line ends are \r \n or \r\n, lines are matched
+// on their own (a match never spans lines): anchors ^ $ are line begin and end, in any mode.
+// Matching lines are returned in str order: resNum 1 returns the first matching line (remaining chunks are skipped).
+// Calling thread is a worker too.
+//
+// parm
+//  progP       ptr to compiled regex, see MxRegex_compile()
+//  strP        ptr to str
+//  strLen      str len
+//  resP        RET matching lines, in str order
+//  resNum      max nr of matching lines returned (resP elements)
+//  threadNum   nr of worker threads, 0 = nr of cores
+// ret
+//  nr of matching lines in resP
+
+size_t MxRegex_lines(const REGEXPROG* progP, const char* strP, const size_t strLen, LINES_RESULT* resP, const size_t resNum, UInt16 threadNum)
+{
+    LINES* lP;
+    std::thread* threadP[BATCH_MAX_THREAD];
+    UInt16 threadStarted;
+    size_t matchNum;
+    size_t t1;
+    UInt32 t;
+
+    if (progP->retSts != REGEXSTS_OK || resNum == 0 || strLen == 0)
+        return 0;
+
+    lP = new LINES;
+    lP->progP = progP;
+    lP->strP = strP;
+    lP->endP = strP + strLen;
+    lP->resNum = resNum;
+    lP->chunkNum = (UInt32)((strLen + LINES_GRAIN - 1) / LINES_GRAIN);
+    lP->chunkIdx = 0;
+    lP->stopIdx = lP->chunkNum;
+    lP->doneIdx = 0;
+    lP->doneMatchNum = 0;
+    lP->isDone.assign(lP->chunkNum, 0);
+    lP->res.resize(lP->chunkNum);
+
+    if (threadNum == 0)                                             // default: one for each core
+        threadNum = (UInt16)std::thread::hardware_concurrency();
+
+    if (threadNum > lP->chunkNum)                                   // no more threads than chunks
+        threadNum = (UInt16)lP->chunkNum;
+
+    if (threadNum > BATCH_MAX_THREAD)
+        threadNum = BATCH_MAX_THREAD;
+
+    // start workers #1..n. If a thread can't be started, chunks are taken by the others
+
+    for (threadStarted = 1; threadStarted < threadNum; threadStarted++)
+    {
+        try
+        {
+            threadP[threadStarted] = new std::thread(Lines_worker, lP);
+        }
+        catch (...)
+        {
+            break;
+        }
+    }
+
+    Lines_worker(lP);                                               // worker #0
+
+    for (t = 1; t < threadStarted; t++)
+    {
+        threadP[t]->join();
+        delete threadP[t];
+    }
+
+    matchNum = 0;                                                   // collect in str order
+    for (t = 0; t < lP->chunkNum && matchNum < resNum; t++)
+    {
+        for (t1 = 0; t1 < lP->res[t].size() && matchNum < resNum; t1++)
+            resP[matchNum++] = lP->res[t][t1];
+    }
+
+    delete lP;
+    return matchNum;
+}
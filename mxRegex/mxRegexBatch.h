@@ -0,0 +1,100 @@
+/*
+
+This file is part of "MxRegex" library
+(C) 2022 Massimo Celeghin
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+
+
+#pragma once
+
+#ifndef MXREGEXBATCH_H
+#define MXREGEXBATCH_H
+
+
+#include "mxRegex.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+    // DEFS
+
+#define BATCH_GRAIN 64                          // nr of records taken at once by a worker thread
+#define BATCH_MAX_THREAD 64                     // max worker threads
+#define LINES_GRAIN 16384                       // bytes of lines taken at once by a worker thread, see MxRegex_lines()
+
+
+
+
+    // batch captures, offset from record begin
+
+    typedef struct
+    {
+        REGEXOFS ofs;                               // captured string offset
+        REGEXOFS len;                               // captured string len
+
+    } BATCH_CAPS;
+
+
+
+    // batch result, one for each record
+
+    typedef struct
+    {
+        UInt8 capsNum;                              // 0 no match, n regex match: nr of captures in caps[]
+        UInt8 retSts;                               // regex status REGEX_STS
+        BATCH_CAPS caps[MAX_CAPS];                  // [0] is the whole match, [1..capsNum-1] are the captures
+
+    } BATCH_RESULT;
+
+
+
+    // matching line, see MxRegex_lines()
+
+    typedef struct
+    {
+        size_t lineOfs;                             // line begin, offset from str begin
+        size_t lineLen;                             // line len, without line end
+        UInt8 capsNum;                              // nr of captures in caps[]
+        REGEXSPAN caps[MAX_CAPS];                   // [0] is the whole match, [1..capsNum-1] are the captures; offsets from str begin
+
+    } LINES_RESULT;
+
+
+
+
+    // PUBLIC METHODS
+
+    extern UInt32 MxRegex_batch(const REGEXPROG* progP, const char* const* strP, const UInt32 strNum, BATCH_RESULT* resP, UInt16 threadNum);
+    extern size_t MxRegex_lines(const REGEXPROG* progP, const char* strP, const size_t strLen, LINES_RESULT* resP, const size_t resNum, UInt16 threadNum);
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif // #ifndef MXREGEXBATCH_H
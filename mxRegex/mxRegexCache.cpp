@@ -0,0 +1,347 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+// Compiled regex cache: MxRegex() and MxRegex_ex() take compiled regex from here, instead of compiling on each call.
+//
+// Key is regex string and mode. Each thread first looks up the regex ptr in its own slots (no hash),
+// then the string hash in the cache shard. Lookup is lock free: a reader pins the entry (atomic counter)
+// while running the regex, and checks regex string and mode, so a reused ptr with other content is a miss.
+// Inserts take the shard lock and replace an entry not pinned, chosen by CLOCK (second chance on recent hit).
+
+
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "mxRegexCache.h"
+#include "mxRegexInt.h"
+
+
+#if MXREGEX_CACHE
+
+
+
+// DEFS
+
+#define CACHE_BUSY 0x80000000UL                 // CACHE_ENTRY.pin: entry being replaced, readers keep out
+
+
+
+
+// cached regex
+
+typedef struct
+{
+    std::atomic<UInt32> pin;                        // nr of readers running the regex, | CACHE_BUSY when being replaced
+    std::atomic<UInt32> hash;                       // regex and mode hash, 0 empty entry
+    std::atomic<UInt8> isRef;                       // CLOCK reference flag, set on hit
+    UInt16 mode;
+    const char* regexP;                             // regex ptr it was inserted from: a lookup with the same ptr skips the string compare (CACHE_PTR_KEY)
+    char regex[CACHE_MAX_REGEX + 1];                // regex string
+    REGEXPROG prog;                                 // compiled regex
+
+} CACHE_ENTRY;
+
+#define CACHE_SHARD_ENTRY ((CACHE_MAX_ENTRY + CACHE_SHARD_NUM - 1) / CACHE_SHARD_NUM)
+
+
+
+// cache shard
+
+typedef struct
+{
+    std::mutex lock;                                // inserts only, lookup is lock free
+    UInt16 hand;                                    // CLOCK hand, next entry to check for eviction
+    std::atomic<UInt32> hitNum;                     // counters
+    std::atomic<UInt32> missNum;
+    std::atomic<UInt32> evictNum;
+    CACHE_ENTRY entry[CACHE_SHARD_ENTRY];
+
+} CACHE_SHARD;
+
+
+
+// regex ptr lookup slot, one set for each thread
+
+typedef struct
+{
+    const char* regexP;                             // regex ptr of last lookup
+    CACHE_ENTRY* entryP;                            // cached regex found (content is checked again on use)
+    UInt32 hash;
+
+} CACHE_SLOT;
+
+
+
+
+// VARS
+
+static CACHE_SHARD shard[CACHE_SHARD_NUM];
+static thread_local CACHE_SLOT slot[CACHE_THREAD_SLOT];
+
+
+
+
+
+// regex and mode hash (FNV-1a), never 0
+// ret
+//  hash, 0 if regex too long to be cached
+
+UInt32 Cache_hash(const char* regexP, const UInt16 mode)
+{
+    UInt32 hash;
+    UInt16 len;
+
+    hash = 2166136261UL ^ mode;
+    for (len = 0; regexP[len] != 0; len++)
+    {
+        if (len >= CACHE_MAX_REGEX)
+            return 0;
+
+        hash = ((hash ^ (UInt8)regexP[len]) * 16777619UL) & 0xffffffffUL;
+    }
+
+    return (hash != 0) ? hash : 1;
+}
+
+
+
+// pin cached regex, if it is regex string with mode
+// same regex ptr of the insert is the same regex string (CACHE_PTR_KEY), else strings are compared
+// ret
+//  1 pinned (unpin with Cache_unpin), 0 other regex or being replaced
+
+UInt8 Cache_pin(CACHE_ENTRY* eP, const UInt32 hash, const char* regexP, const UInt16 mode)
+{
+    if (eP->hash.load(std::memory_order_relaxed) != hash)
+        return 0;
+
+    if (eP->pin.fetch_add(1, std::memory_order_acquire) & CACHE_BUSY)   // writer owns it
+    {
+        eP->pin.fetch_sub(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    if (eP->hash.load(std::memory_order_relaxed) == hash && eP->mode == mode
+        && ((CACHE_PTR_KEY && eP->regexP == regexP) || strcmp(eP->regex, regexP) == 0))
+    {
+        if (!eP->isRef.load(std::memory_order_relaxed))         // avoid writing shared line on each hit
+            eP->isRef.store(1, std::memory_order_relaxed);
+        return 1;
+    }
+
+    eP->pin.fetch_sub(1, std::memory_order_release);
+    return 0;
+}
+
+
+
+// unpin cached regex
+
+inline void Cache_unpin(CACHE_ENTRY* eP)
+{
+    eP->pin.fetch_sub(1, std::memory_order_release);
+    return;
+}
+
+
+
+// find regex in shard, and pin it
+// ret
+//  ptr to cached regex, 0 not found
+
+CACHE_ENTRY* Cache_find(CACHE_SHARD* sP, const UInt32 hash, const char* regexP, const UInt16 mode)
+{
+    UInt16 t;
+
+    for (t = 0; t < CACHE_SHARD_ENTRY; t++)
+    {
+        if (Cache_pin(&sP->entry[t], hash, regexP, mode))
+            return &sP->entry[t];
+    }
+
+    return 0;
+}
+
+
+
+// compile regex into shard, replacing an entry not in use (CLOCK), and pin it
+// the entry is taken under shard lock, the regex is compiled after it: inserts of other regex don't wait
+// ret
+//  ptr to cached regex, 0 all entries pinned or regex being compiled by another thread (regex not cached)
+
+CACHE_ENTRY* Cache_insert(CACHE_SHARD* sP, const UInt32 hash, const char* regexP, const UInt16 mode)
+{
+    CACHE_ENTRY* eP;
+    UInt32 pin;
+    UInt16 t;
+
+    {
+        std::lock_guard<std::mutex> guard(sP->lock);
+
+        if ((eP = Cache_find(sP, hash, regexP, mode)) != 0)    // inserted by another thread meanwhile
+        {
+            sP->hitNum.fetch_add(1, std::memory_order_relaxed);
+            return eP;
+        }
+
+        for (t = 0; t < CACHE_SHARD_ENTRY; t++)                 // being compiled by another thread: not cached twice
+        {
+            eP = &sP->entry[t];
+            if ((eP->pin.load(std::memory_order_relaxed) & CACHE_BUSY) && eP->hash.load(std::memory_order_relaxed) == hash
+                && eP->mode == mode && strcmp(eP->regex, regexP) == 0)
+                return 0;
+        }
+
+        for (t = 0; t < 2 * CACHE_SHARD_ENTRY + 1; t++)         // 2 rounds: reference flags are cleared on 1st one
+        {
+            eP = &sP->entry[sP->hand];
+            sP->hand = (UInt16)((sP->hand + 1) % CACHE_SHARD_ENTRY);
+
+            if (eP->isRef.load(std::memory_order_relaxed))      // recently used: second chance
+            {
+                eP->isRef.store(0, std::memory_order_relaxed);
+                continue;
+            }
+
+            pin = 0;
+            if (eP->pin.compare_exchange_strong(pin, CACHE_BUSY, std::memory_order_acquire))
+                break;
+        }
+
+        if (t == 2 * CACHE_SHARD_ENTRY + 1)                     // all in use
+            return 0;
+
+        if (eP->hash.load(std::memory_order_relaxed) != 0)
+            sP->evictNum.fetch_add(1, std::memory_order_relaxed);
+        sP->missNum.fetch_add(1, std::memory_order_relaxed);
+
+        eP->hash.store(hash, std::memory_order_relaxed);        // readers keep out (CACHE_BUSY), inserts see it being compiled
+        eP->mode = mode;
+        eP->regexP = regexP;
+        strcpy(eP->regex, regexP);
+    }
+
+#if MXREGEX_JIT
+    MxRegex_jitFree(&eP->prog);                                 // not pinned: no reader runs its native code
+#endif
+    MxRegex_compile(regexP, mode, &eP->prog);                   // on error, cached anyway: MxRegex_exec_ex() will report it
+    eP->isRef.store(1, std::memory_order_relaxed);
+    eP->pin.fetch_add(1 - CACHE_BUSY, std::memory_order_release);   // publish, pinned by this thread
+
+    return eP;
+}
+
+
+
+// regex with compiled regex from cache, invoked by MxRegex_len_ex()
+// see MxRegex_len_ex()
+
+UInt8 Cache_exec(MXREGEX_M* mP, const char* regexP, const char* strP, const size_t strLen, const UInt16 mode)
+{
+    CACHE_SLOT* slotP;
+    CACHE_SHARD* sP;
+    CACHE_ENTRY* eP;
+    REGEXPROG* progP;
+    UInt32 hash;
+    UInt8 ret;
+
+    slotP = &slot[(((size_t)regexP >> 3) ^ mode) % CACHE_THREAD_SLOT];
+
+    if (slotP->regexP == regexP && slotP->entryP != 0 && Cache_pin(slotP->entryP, slotP->hash, regexP, mode))
+    {
+        eP = slotP->entryP;                                     // same regex ptr of last call, content checked
+        shard[slotP->hash % CACHE_SHARD_NUM].hitNum.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        if ((hash = Cache_hash(regexP, mode)) == 0)             // too long: not cached
+        {
+            progP = Regex_prog(mP);
+            MxRegex_compile(regexP, mode, progP);
+            return MxRegex_exec_len_ex(mP, progP, strP, strLen);
+        }
+
+        sP = &shard[hash % CACHE_SHARD_NUM];
+
+        if ((eP = Cache_find(sP, hash, regexP, mode)) != 0)
+            sP->hitNum.fetch_add(1, std::memory_order_relaxed);
+        else if ((eP = Cache_insert(sP, hash, regexP, mode)) == 0)
+        {
+            progP = Regex_prog(mP);                             // cache full of regex in use, or regex being cached by another thread
+            MxRegex_compile(regexP, mode, progP);
+            return MxRegex_exec_len_ex(mP, progP, strP, strLen);
+        }
+
+        slotP->regexP = regexP;
+        slotP->entryP = eP;
+        slotP->hash = hash;
+    }
+
+    ret = MxRegex_exec_len_ex(mP, &eP->prog, strP, strLen);
+    Cache_unpin(eP);
+
+    return ret;
+}
+
+
+
+
+
+
+//
+// PUBLIC METHODS
+//
+
+
+// get compiled regex cache counters, for cache sizing (CACHE_MAX_ENTRY)
+// parm
+//  statsP      RET counters
+
+void MxRegexCache_getStats(REGEXCACHE_STATS* statsP)
+{
+    UInt16 s;
+    UInt16 t;
+
+    memset(statsP, 0, sizeof(REGEXCACHE_STATS));
+
+    for (s = 0; s < CACHE_SHARD_NUM; s++)
+    {
+        statsP->hitNum += shard[s].hitNum.load(std::memory_order_relaxed);
+        statsP->missNum += shard[s].missNum.load(std::memory_order_relaxed);
+        statsP->evictNum += shard[s].evictNum.load(std::memory_order_relaxed);
+
+        for (t = 0; t < CACHE_SHARD_ENTRY; t++)
+        {
+            if (shard[s].entry[t].hash.load(std::memory_order_relaxed) != 0)
+                statsP->entryNum++;
+        }
+    }
+
+    statsP->entryMax = CACHE_SHARD_NUM * CACHE_SHARD_ENTRY;
+    return;
+}
+
+
+
+#endif // #if MXREGEX_CACHE
@@ -0,0 +1,81 @@
+/*
+
+This file is part of "MxRegex" library
+(C) 2022 Massimo Celeghin
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+
+
+#pragma once
+
+#ifndef MXREGEXCACHE_H
+#define MXREGEXCACHE_H
+
+
+#include "mxRegex.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+    // DEFS
+
+#define CACHE_MAX_ENTRY 96                       // regex in compiled regex cache (about 6.7K each on x86-64, 632K): a hot set up to about 2/3 of it, shards are not even
+#define CACHE_SHARD_NUM 8                       // cache shards, by regex hash: each one has its own CLOCK eviction and insert lock
+#define CACHE_MAX_REGEX 128                     // max regex len cached, longer regex are compiled on each call
+#define CACHE_THREAD_SLOT 16                    // regex ptr -> cached regex, lookup slots of each thread
+#define CACHE_PTR_KEY 1                         // same regex ptr is the same regex string while cached, not compared (0: regex buffers are rewritten)
+
+
+
+
+    // cache counters, since startup
+
+    typedef struct
+    {
+        UInt32 hitNum;                              // regex found in cache
+        UInt32 missNum;                             // regex compiled and added to cache
+        UInt32 evictNum;                            // regex dropped from cache to make room
+        UInt32 entryNum;                            // regex in cache now
+        UInt32 entryMax;                            // max regex in cache (CACHE_MAX_ENTRY)
+
+    } REGEXCACHE_STATS;
+
+
+
+
+    // PUBLIC METHODS (require MXREGEX_CACHE)
+
+#if MXREGEX_CACHE
+    extern void MxRegexCache_getStats(REGEXCACHE_STATS* statsP);
+#endif
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif // #ifndef MXREGEXCACHE_H
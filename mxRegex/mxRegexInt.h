@@ -0,0 +1,115 @@
+/*
+
+This file is part of "MxRegex" library
+(C) 2022 Massimo Celeghin
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+
+
+#pragma once
+
+#ifndef MXREGEXINT_H
+#define MXREGEXINT_H
+
+
+#include "mxRegex.h"
+
+
+// internal methods shared by library modules (not public)
+
+
+
+    // DEFS
+
+#define DFA_FALLBACK 0xff                       // Dfa_exec(): DFA can't be used, use backtracking regex
+#define MEMO_FALLBACK 0xff                      // Memo_exec(): str too long for visited bitmap (or stack ovf), use Pike VM
+#define NFA_MAX_STR 0xffffffffUL                // Pike VM, failure memo: max str len (32 bit offsets), longer str use backtracking regex
+
+
+
+    // Pike VM str position: offset and chars around it, for anchors.
+    // Str is not needed as a whole, so the Pike VM may run on chunks (see MxRegex_streamFeed())
+
+    typedef struct
+    {
+        UInt32 ofs;                                 // offset from str begin
+        char prevC;                                 // char at ofs - 1 (if ofs > 0)
+        char c;                                     // char at ofs (if not isEnd)
+        UInt8 isEnd;                                // ofs is end of str
+
+    } PIKEAT;
+
+
+
+
+    // mxRegex.cpp
+
+extern const UInt8 C_CASE_FOLD[256];
+
+char Upper(const char c);
+char Fold(const char c);
+UInt8 Atom_charInCharset(const CHARSET* charsetP, const char c);
+UInt8 IsWord(const char c);
+const char* StrNewline(const char* strP, const char* endP);
+const char* Prog_startFind(const MXREGEX_M* mP, const char* strP);
+REGEXPROG* Regex_prog(MXREGEX_M* mP);
+#if MXREGEX_NFA
+REGEXDFA* Regex_dfa(MXREGEX_M* mP);
+#endif
+
+
+    // mxRegexNfa.cpp
+
+#if MXREGEX_NFA
+
+void Nfa_compile(REGEXPROG* progP, const char* regexP);
+UInt8 Nfa_accept(const REGEXPROG* progP, const NFANODE* nP, const char c);
+UInt8 Nfa_isRequired(const REGEXPROG* progP, const UInt16 n);
+UInt8 Dfa_exec(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const char* startP, const char* endP);
+UInt8 Pike_exec(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const char* startP, const char* endP);
+UInt8 Memo_exec(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const char* startP, const char* endP);
+UInt8 Pike_assert(const char c, const PIKEAT* atP);
+void Pike_at(PIKEAT* atP, const char* strP, const UInt32 ofs, const UInt32 strLen);
+
+#endif
+
+
+    // mxRegexJit.cpp
+
+#if MXREGEX_JIT
+
+#define JIT_FALLBACK 0xff                       // Jit_exec(): no native code, or too many backtracks: use backtracking regex
+
+UInt8 Jit_exec(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const char* startP, const char* endP);
+void Jit_release(REGEXPROG* progP);
+
+#endif
+
+
+    // mxRegexCache.cpp
+
+#if MXREGEX_CACHE
+
+UInt8 Cache_exec(MXREGEX_M* mP, const char* regexP, const char* strP, const size_t strLen, const UInt16 mode);
+
+#endif
+
+
+#endif // #ifndef MXREGEXINT_H
@@ -0,0 +1,1267 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// JIT: x86-64 native code of a hot compiled regex.
+//
+// A compiled regex is translated to native code (Jit_compile) by MxRegex_jit(), or on its JIT_HOT run if compiled with REGEXMODE_JIT,
+// in its own mapped pages (read + exec).
+// Code is a backtracking matcher in regex order, leftmost first: on the supported regex (below) same matches and captures as the
+// backtracking regex, Pike VM and failure memo;
+// chars are compared inline, charsets are tested on 256 bit maps stored after the code.
+// Quantifiers are greedy loops; each quantifier with min != max is a retry point, keeping its first and current end
+// on the native stack: on failure, code jumps to the last retry point, which gives back one char and goes on.
+// Alternatives (a|b) keep their start and the retry point of the alternative taken (a code address), so retry points are static:
+// there is no backtrack stack to overflow.
+// Supported: chars, charsets, anchors, brackets and alternatives, quantifiers on chars and charsets only.
+// Other regex (quantified brackets) are not compiled: they run on failure memo backtracker or Pike VM (see REGEXPROG.isNfaFirst),
+// or on backtracking regex without nfa, whose results on them are not leftmost first.
+// Backtracks at each start position are bounded (JIT_MAX_RETRY): then native code gives up, and the regex runs on
+// the backtracking regex (watchdog, fallback to failure memo backtracker or Pike VM).
+// Native code is used on x86-64 POSIX targets only (System V calling convention, mmap), elsewhere regex stay interpreted.
+
+
+#include <string.h>
+
+#include "mxRegexInt.h"
+
+
+#if MXREGEX_JIT
+
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(__CYGWIN__)
+#define JIT_X64 1
+#else
+#define JIT_X64 0
+#endif
+
+
+#if JIT_X64
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+
+// DEFS
+
+#define JIT_NONE ((void*)1)                     // REGEXPROG.jitP: regex not compiled to native code (not supported, or being compiled)
+
+#define JIT_MAX_CODE 16384                      // max native code and charset maps of a regex
+#define JIT_MAX_LABEL 640                       // max labels of a regex
+#define JIT_MAX_FIX 1024                        // max rel32 to resolve
+#define JIT_MAX_RETRY 4096                      // max backtracks at each start position, then native code gives up
+#define JIT_MAX_OCC 0x7fffffffUL                // max quantifier handled (min, and max if not unbounded)
+#define JIT_UNROLL 4                            // fixed occurrences up to 4 are unrolled, else a loop
+#define JIT_MAX_MAP (JIT_MAX_BYTES / 4096)      // max mapped native code of all regex (one page each at least)
+
+#define JIT_LABEL_UNSET 0xffffffffUL
+
+#define JR_AX 0                                 // x86-64 registers
+#define JR_CX 1
+#define JR_DX 2
+#define JR_BX 3
+#define JR_SP 4
+#define JR_SI 6
+#define JR_DI 7
+#define JR_8 8
+#define JR_9 9
+#define JR_10 10
+#define JR_11 11
+#define JR_12 12
+
+#define JCC_B 0x82                              // jcc rel32 (0x0f xx)
+#define JCC_AE 0x83
+#define JCC_E 0x84
+#define JCC_NE 0x85
+#define JCC_BE 0x86
+
+// native code registers:
+// rdi  start position of attempt
+// rsi  str position
+// rdx  end of str
+// r8   capture slots (JITRUN.slotP)
+// r9   last start position
+// r10  backtracks left at this start position
+// r11  str begin
+// rbx  charset maps
+// rax rcx r12  scratch
+// [rsp + 8 * n]  retry points: quantifier first end and current end, alternatives start and retry address
+
+
+
+
+// native code arguments
+
+typedef struct
+{
+    const char* strOrigP;                           // ptr to str begin (anchors)
+    const char* strEndP;                            // ptr to end of str
+    const char* startP;                             // first start position
+    const char* lastP;                              // last start position
+    const char** slotP;                             // capture slots: [2n] [2n + 1] begin and end of capture n, [2n] 0 capture not in match
+
+} JITRUN;
+
+typedef long (*JITCODE)(JITRUN* runP);              // ret 1 match, 0 no match, -1 too many backtracks
+
+
+
+// rel32 to resolve: code offset and target label
+
+typedef struct
+{
+    UInt32 ofs;
+    UInt16 label;
+
+} JITFIX;
+
+
+
+// native code builder
+
+typedef struct
+{
+    const REGEXPROG* progP;
+    UInt8 code[JIT_MAX_CODE];
+    UInt32 len;                                     // bytes of code
+    UInt32 label[JIT_MAX_LABEL];                    // label code offset, JIT_LABEL_UNSET not yet bound
+    UInt16 labelNum;
+    JITFIX fix[JIT_MAX_FIX];
+    UInt16 fixNum;
+    UInt16 varNum;                                  // native stack slots of retry points
+    UInt16 budgetLabel;                             // too many backtracks
+    UInt8 isFail;                                   // regex not supported, or code too large
+
+} JITBUILD;
+
+
+
+// mapped native code of a regex
+
+typedef struct
+{
+    const REGEXPROG* progP;                         // compiled regex it was mapped for (MxRegex_jit)
+    void* codeP;                                    // 0 free entry
+    UInt32 size;                                    // mapped bytes
+
+} JITMAP;
+
+
+
+
+// VARS
+
+static size_t jitBytes;                             // mapped bytes of native code of all regex, up to JIT_MAX_BYTES
+static JITMAP jitMap[JIT_MAX_MAP];                  // mapped native code of all regex, codeP 0 free
+static UInt8 jitMapLock;
+
+
+
+
+
+
+//
+// MAPPED PAGES
+//
+
+
+// native code pages of regex, own entry of jitMap[]: 1 done, 0 table full
+// parm: compiled regex (owner), code, bytes
+
+static UInt8 Jit_mapAdd(const REGEXPROG* progP, void* codeP, const UInt32 size)
+{
+    UInt16 t;
+
+    while (__atomic_test_and_set(&jitMapLock, __ATOMIC_ACQUIRE))
+        ;
+
+    for (t = 0; t < JIT_MAX_MAP && jitMap[t].codeP != 0; t++)
+        ;
+    if (t < JIT_MAX_MAP)
+    {
+        jitMap[t].progP = progP;
+        jitMap[t].codeP = codeP;
+        jitMap[t].size = size;
+    }
+
+    __atomic_clear(&jitMapLock, __ATOMIC_RELEASE);
+    return (t < JIT_MAX_MAP) ? 1 : 0;
+}
+
+
+
+// release native code pages, if mapped for progP
+// A code ptr not in jitMap[] (already released, not initialized, or mapped for another compiled regex) is ignored.
+// parm: code, owner
+
+static void Jit_unmap(void* codeP, const REGEXPROG* progP)
+{
+    UInt32 size;
+    UInt16 t;
+
+    while (__atomic_test_and_set(&jitMapLock, __ATOMIC_ACQUIRE))
+        ;
+
+    size = 0;
+    for (t = 0; t < JIT_MAX_MAP; t++)
+    {
+        if (jitMap[t].codeP == codeP && jitMap[t].progP == progP)
+        {
+            size = jitMap[t].size;
+            jitMap[t].codeP = 0;
+            break;
+        }
+    }
+
+    __atomic_clear(&jitMapLock, __ATOMIC_RELEASE);
+
+    if (size != 0)
+    {
+        munmap(codeP, size);
+        __atomic_sub_fetch(&jitBytes, (size_t)size, __ATOMIC_RELAXED);
+    }
+}
+
+
+
+
+
+
+//
+// CODE EMITTER
+//
+
+
+void Jit_byte(JITBUILD* bP, const UInt8 b)
+{
+    if (bP->len >= JIT_MAX_CODE)
+    {
+        bP->isFail = 1;
+        return;
+    }
+    bP->code[bP->len++] = b;
+}
+
+
+
+void Jit_u32(JITBUILD* bP, const UInt32 v)
+{
+    Jit_byte(bP, (UInt8)v);
+    Jit_byte(bP, (UInt8)(v >> 8));
+    Jit_byte(bP, (UInt8)(v >> 16));
+    Jit_byte(bP, (UInt8)(v >> 24));
+}
+
+
+
+// REX prefix (if needed) and opcode, 0x0fxx is a two byte opcode
+// parm
+//  w       64 bit operand
+//  reg     modrm reg field (register or opcode extension)
+//  rm      modrm rm field (register or base register)
+
+void Jit_op(JITBUILD* bP, const UInt8 w, const UInt8 reg, const UInt8 rm, const UInt16 op)
+{
+    UInt8 rex;
+
+    rex = (UInt8)(0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0));
+    if (rex != 0x40)
+        Jit_byte(bP, rex);
+    if (op > 0xff)
+        Jit_byte(bP, (UInt8)(op >> 8));
+    Jit_byte(bP, (UInt8)op);
+}
+
+
+
+// op reg, rm: register operands
+
+void Jit_rr(JITBUILD* bP, const UInt8 w, const UInt16 op, const UInt8 reg, const UInt8 rm)
+{
+    Jit_op(bP, w, reg, rm, op);
+    Jit_byte(bP, (UInt8)(0xc0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+
+
+// op reg, [base + disp32]
+
+void Jit_rm(JITBUILD* bP, const UInt8 w, const UInt16 op, const UInt8 reg, const UInt8 base, const long disp)
+{
+    Jit_op(bP, w, reg, base, op);
+    Jit_byte(bP, (UInt8)(0x80 | ((reg & 7) << 3) | (base & 7)));
+    if ((base & 7) == JR_SP)                                    // rsp r12 base: SIB
+        Jit_byte(bP, 0x24);
+    Jit_u32(bP, (UInt32)disp);
+}
+
+
+
+UInt16 Jit_label(JITBUILD* bP)
+{
+    if (bP->labelNum >= JIT_MAX_LABEL)
+    {
+        bP->isFail = 1;
+        return 0;
+    }
+    bP->label[bP->labelNum] = JIT_LABEL_UNSET;
+    return bP->labelNum++;
+}
+
+
+
+void Jit_bind(JITBUILD* bP, const UInt16 label)
+{
+    bP->label[label] = bP->len;
+}
+
+
+
+// rel32 to label, resolved by Jit_resolve()
+
+void Jit_rel(JITBUILD* bP, const UInt16 label)
+{
+    if (bP->fixNum >= JIT_MAX_FIX)
+    {
+        bP->isFail = 1;
+        return;
+    }
+    bP->fix[bP->fixNum].ofs = bP->len;
+    bP->fix[bP->fixNum].label = label;
+    bP->fixNum++;
+    Jit_u32(bP, 0);
+}
+
+
+
+void Jit_jmp(JITBUILD* bP, const UInt16 label)
+{
+    Jit_byte(bP, 0xe9);
+    Jit_rel(bP, label);
+}
+
+
+
+void Jit_jcc(JITBUILD* bP, const UInt8 cc, const UInt16 label)
+{
+    Jit_byte(bP, 0x0f);
+    Jit_byte(bP, cc);
+    Jit_rel(bP, label);
+}
+
+
+
+// lea reg, [rip + label]
+
+void Jit_lea(JITBUILD* bP, const UInt8 reg, const UInt16 label)
+{
+    Jit_op(bP, 1, reg, 0, 0x8d);
+    Jit_byte(bP, (UInt8)(0x05 | ((reg & 7) << 3)));
+    Jit_rel(bP, label);
+}
+
+
+
+// resolve rel32 of jumps and lea, all labels must be bound
+
+void Jit_resolve(JITBUILD* bP)
+{
+    UInt32 ofs;
+    UInt32 rel;
+    UInt16 t;
+
+    for (t = 0; t < bP->fixNum; t++)
+    {
+        if ((ofs = bP->label[bP->fix[t].label]) == JIT_LABEL_UNSET)
+        {
+            bP->isFail = 1;
+            return;
+        }
+        rel = ofs - (bP->fix[t].ofs + 4);
+        memcpy(&bP->code[bP->fix[t].ofs], &rel, 4);
+    }
+}
+
+
+
+
+
+
+//
+// REGEX TRANSLATION
+//
+
+
+// check if charset has all 256 chars (like . in single line mode): no test needed
+
+UInt8 Jit_isFull(const CHARSET* charsetP)
+{
+    UInt16 t;
+
+    for (t = 0; t < 256; t++)
+        if (!Atom_charInCharset(charsetP, (char)t))
+            return 0;
+    return 1;
+}
+
+
+
+// bit test of char in ecx on 256 bit map at rbx + ofs: CF set if char is in map
+
+void Jit_bitTest(JITBUILD* bP, const UInt32 ofs)
+{
+    Jit_rr(bP, 0, 0x89, JR_CX, JR_AX);                          // mov eax, ecx
+    Jit_rr(bP, 0, 0xc1, 5, JR_AX);                              // shr eax, 5
+    Jit_byte(bP, 5);
+    Jit_byte(bP, 0x8b);                                         // mov eax, [rbx + rax * 4 + ofs]
+    Jit_byte(bP, 0x84);
+    Jit_byte(bP, 0x83);
+    Jit_u32(bP, ofs);
+    Jit_rr(bP, 0, 0x0fa3, JR_CX, JR_AX);                        // bt eax, ecx
+}
+
+
+
+// test str char at [base + disp] against char or charset atom, jump to label fail if not matched
+// str len is checked by caller
+
+void Jit_test(JITBUILD* bP, const REGEXINST* iP, const UInt8 base, const long disp, const UInt16 fail)
+{
+    UInt16 ok;
+
+    if (iP->type == ATOMTYPE_CHAR)
+    {
+        Jit_rm(bP, 0, 0x80, 7, base, disp);                     // cmp byte [base + disp], c
+        Jit_byte(bP, (UInt8)iP->c);
+        if (iP->cFold == iP->c)
+        {
+            Jit_jcc(bP, JCC_NE, fail);
+            return;
+        }
+        ok = Jit_label(bP);                                     // case insensitive: other case
+        Jit_jcc(bP, JCC_E, ok);
+        Jit_rm(bP, 0, 0x80, 7, base, disp);
+        Jit_byte(bP, (UInt8)iP->cFold);
+        Jit_jcc(bP, JCC_NE, fail);
+        Jit_bind(bP, ok);
+        return;
+    }
+
+    if (Jit_isFull(&bP->progP->charset[iP->charsetIdx]))
+        return;
+
+    Jit_rm(bP, 0, 0x0fb6, JR_CX, base, disp);                   // movzx ecx, byte [base + disp]
+    Jit_bitTest(bP, (UInt32)iP->charsetIdx * 32);
+    Jit_jcc(bP, JCC_AE, fail);                                  // jnc fail
+}
+
+
+
+// budget of backtracks: dec r10, too many gives up
+
+void Jit_retry(JITBUILD* bP)
+{
+    Jit_rr(bP, 1, 0xff, 1, JR_10);                              // dec r10
+    Jit_jcc(bP, JCC_E, bP->budgetLabel);
+}
+
+
+
+// char or charset atom with quantifier: min occurrences, then greedy up to max
+// ret
+//  label to jump to on failure after the atom: its retry point, or fail if min == max
+
+UInt16 Jit_atom(JITBUILD* bP, const UInt16 idx, UInt16 fail)
+{
+    const REGEXINST* iP;
+    const REGEXINST* nextP;
+    REGEXOFS n;
+    UInt16 loop;
+    UInt16 done;
+    UInt16 retry;
+    UInt16 ok;
+    UInt8 isFull;
+    long lo;
+    long cur;
+
+    iP = &bP->progP->inst[idx];
+    isFull = (iP->type == ATOMTYPE_METACLASS && Jit_isFull(&bP->progP->charset[iP->charsetIdx])) ? 1 : 0;
+
+    if (iP->minOcc > JIT_MAX_OCC || (iP->maxOcc != BACKTRACK_MAXOCC && iP->maxOcc > JIT_MAX_OCC) || iP->maxOcc < iP->minOcc)
+    {
+        bP->isFail = 1;
+        return fail;
+    }
+
+    // min occurrences
+
+    n = iP->minOcc;
+    if (n == 1)
+    {
+        Jit_rr(bP, 1, 0x39, JR_DX, JR_SI);                      // cmp rsi, rdx
+        Jit_jcc(bP, JCC_AE, fail);
+    }
+    else if (n > 1)
+    {
+        Jit_rr(bP, 1, 0x89, JR_DX, JR_AX);                      // mov rax, rdx
+        Jit_rr(bP, 1, 0x29, JR_SI, JR_AX);                      // sub rax, rsi
+        Jit_rr(bP, 1, 0x81, 7, JR_AX);                          // cmp rax, n
+        Jit_u32(bP, (UInt32)n);
+        Jit_jcc(bP, JCC_B, fail);
+    }
+
+    if (isFull || n <= JIT_UNROLL)
+    {
+        if (!isFull)
+            for (REGEXOFS t = 0; t < n; t++)
+                Jit_test(bP, iP, JR_SI, (long)t, fail);
+        if (n)
+        {
+            Jit_rr(bP, 1, 0x81, 0, JR_SI);                      // add rsi, n
+            Jit_u32(bP, (UInt32)n);
+        }
+    }
+    else
+    {
+        Jit_rm(bP, 1, 0x8d, JR_12, JR_SI, (long)n);             // lea r12, [rsi + n]
+        loop = Jit_label(bP);
+        Jit_bind(bP, loop);
+        Jit_test(bP, iP, JR_SI, 0, fail);
+        Jit_rr(bP, 1, 0xff, 0, JR_SI);                          // inc rsi
+        Jit_rr(bP, 1, 0x39, JR_12, JR_SI);                      // cmp rsi, r12
+        Jit_jcc(bP, JCC_B, loop);
+    }
+
+    if (iP->maxOcc == iP->minOcc)
+        return fail;
+
+    // greedy up to max, limit in r12 (rdx if no max)
+
+    lo = (long)bP->varNum * 8;
+    cur = lo + 8;
+    bP->varNum += 2;
+
+    Jit_rm(bP, 1, 0x89, JR_SI, JR_SP, lo);                      // mov [rsp + lo], rsi
+
+    if (iP->maxOcc != BACKTRACK_MAXOCC)
+    {
+        Jit_rr(bP, 1, 0x89, JR_DX, JR_AX);                      // mov rax, rdx
+        Jit_rr(bP, 1, 0x29, JR_SI, JR_AX);                      // sub rax, rsi
+        Jit_op(bP, 1, 0, JR_12, 0xbc);                          // mov r12, max - min
+        Jit_u32(bP, (UInt32)(iP->maxOcc - iP->minOcc));
+        Jit_u32(bP, 0);
+        Jit_rr(bP, 1, 0x39, JR_12, JR_AX);                      // cmp rax, r12
+        Jit_rr(bP, 1, 0x0f42, JR_12, JR_AX);                    // cmovb r12, rax
+        Jit_rr(bP, 1, 0x01, JR_SI, JR_12);                      // add r12, rsi
+    }
+
+    if (isFull)
+        Jit_rr(bP, 1, 0x89, (iP->maxOcc != BACKTRACK_MAXOCC) ? JR_12 : JR_DX, JR_SI);     // mov rsi, limit
+    else
+    {
+        loop = Jit_label(bP);
+        done = Jit_label(bP);
+        Jit_rr(bP, 1, 0x39, (iP->maxOcc != BACKTRACK_MAXOCC) ? JR_12 : JR_DX, JR_SI);     // cmp rsi, limit
+        Jit_jcc(bP, JCC_AE, done);
+        Jit_bind(bP, loop);
+        Jit_test(bP, iP, JR_SI, 0, done);
+        Jit_rr(bP, 1, 0xff, 0, JR_SI);                          // inc rsi
+        Jit_rr(bP, 1, 0x39, (iP->maxOcc != BACKTRACK_MAXOCC) ? JR_12 : JR_DX, JR_SI);
+        Jit_jcc(bP, JCC_B, loop);
+        Jit_bind(bP, done);
+    }
+
+    // retry point: give back one char. If a char follows, positions where it doesn't match are skipped
+
+    done = Jit_label(bP);
+    retry = Jit_label(bP);
+    loop = Jit_label(bP);
+
+    Jit_rm(bP, 1, 0x89, JR_SI, JR_SP, cur);                     // mov [rsp + cur], rsi
+    Jit_jmp(bP, done);
+
+    Jit_bind(bP, retry);
+    Jit_retry(bP);
+    Jit_rm(bP, 1, 0x8b, JR_SI, JR_SP, cur);                     // mov rsi, [rsp + cur]
+    Jit_bind(bP, loop);
+    Jit_rm(bP, 1, 0x3b, JR_SI, JR_SP, lo);                      // cmp rsi, [rsp + lo]
+    Jit_jcc(bP, JCC_BE, fail);
+    Jit_rr(bP, 1, 0xff, 1, JR_SI);                              // dec rsi
+
+    nextP = iP + 1;
+    if (nextP->type == ATOMTYPE_CHAR && nextP->minOcc >= 1)
+    {
+        Jit_rm(bP, 0, 0x80, 7, JR_SI, 0);                       // cmp byte [rsi], c
+        Jit_byte(bP, (UInt8)nextP->c);
+        if (nextP->cFold == nextP->c)
+            Jit_jcc(bP, JCC_NE, loop);
+        else
+        {
+            ok = Jit_label(bP);
+            Jit_jcc(bP, JCC_E, ok);
+            Jit_rm(bP, 0, 0x80, 7, JR_SI, 0);
+            Jit_byte(bP, (UInt8)nextP->cFold);
+            Jit_jcc(bP, JCC_NE, loop);
+            Jit_bind(bP, ok);
+        }
+    }
+
+    Jit_rm(bP, 1, 0x89, JR_SI, JR_SP, cur);                     // mov [rsp + cur], rsi
+    Jit_bind(bP, done);
+
+    return retry;
+}
+
+
+
+// anchor ^ $ \b \B, jump to label fail if not matched
+
+void Jit_anchor(JITBUILD* bP, const REGEXINST* iP, const UInt16 fail)
+{
+    UInt16 ok;
+    UInt16 skip;
+    UInt8 isMultiLine;
+
+    isMultiLine = (bP->progP->mode & REGEXMODE_MULTILINE) ? 1 : 0;
+
+    switch (iP->c)
+    {
+    case '^':                                                   // begin of str, multiline also after \r \n
+        Jit_rr(bP, 1, 0x39, JR_11, JR_SI);                      // cmp rsi, r11
+        if (!isMultiLine)
+        {
+            Jit_jcc(bP, JCC_NE, fail);
+            return;
+        }
+        ok = Jit_label(bP);
+        Jit_jcc(bP, JCC_E, ok);
+        Jit_rm(bP, 0, 0x0fb6, JR_AX, JR_SI, -1);                // movzx eax, byte [rsi - 1]
+        break;
+
+    case '$':                                                   // end of str, multiline also before \r \n
+        Jit_rr(bP, 1, 0x39, JR_DX, JR_SI);                      // cmp rsi, rdx
+        if (!isMultiLine)
+        {
+            Jit_jcc(bP, JCC_NE, fail);
+            return;
+        }
+        ok = Jit_label(bP);
+        Jit_jcc(bP, JCC_E, ok);
+        Jit_rm(bP, 0, 0x0fb6, JR_AX, JR_SI, 0);                 // movzx eax, byte [rsi]
+        break;
+
+    case 'b':                                                   // word boundary: r12 = nr of word chars around, begin and end of str are \W
+    case 'B':
+        Jit_rr(bP, 0, 0x31, JR_12, JR_12);                      // xor r12d, r12d
+        skip = Jit_label(bP);
+        Jit_rr(bP, 1, 0x39, JR_11, JR_SI);                      // cmp rsi, r11
+        Jit_jcc(bP, JCC_BE, skip);
+        Jit_rm(bP, 0, 0x0fb6, JR_CX, JR_SI, -1);                // movzx ecx, byte [rsi - 1]
+        Jit_bitTest(bP, (UInt32)bP->progP->charsetNum * 32);
+        Jit_rr(bP, 0, 0x83, 2, JR_12);                          // adc r12d, 0
+        Jit_byte(bP, 0);
+        Jit_bind(bP, skip);
+        skip = Jit_label(bP);
+        Jit_rr(bP, 1, 0x39, JR_DX, JR_SI);                      // cmp rsi, rdx
+        Jit_jcc(bP, JCC_AE, skip);
+        Jit_rm(bP, 0, 0x0fb6, JR_CX, JR_SI, 0);                 // movzx ecx, byte [rsi]
+        Jit_bitTest(bP, (UInt32)bP->progP->charsetNum * 32);
+        Jit_rr(bP, 0, 0x83, 2, JR_12);
+        Jit_byte(bP, 0);
+        Jit_bind(bP, skip);
+        Jit_rr(bP, 0, 0x83, 7, JR_12);                          // cmp r12d, 1
+        Jit_byte(bP, 1);
+        Jit_jcc(bP, (iP->c == 'b') ? JCC_NE : JCC_E, fail);
+        return;
+
+    default:                                                    // unhandled anchor, ignore
+        return;
+    }
+
+    Jit_byte(bP, 0x3c);                                         // cmp al, '\n'
+    Jit_byte(bP, '\n');
+    Jit_jcc(bP, JCC_E, ok);
+    Jit_byte(bP, 0x3c);                                         // cmp al, '\r'
+    Jit_byte(bP, '\r');
+    Jit_jcc(bP, JCC_NE, fail);
+    Jit_bind(bP, ok);
+}
+
+
+
+// check if atoms beginIdx..endIdx - 1 have a | on their level
+
+UInt8 Jit_hasPipe(const REGEXPROG* progP, UInt16 idx, const UInt16 endIdx)
+{
+    while (idx < endIdx)
+    {
+        if (progP->inst[idx].type == ATOMTYPE_PIPE)
+            return 1;
+        idx = (progP->inst[idx].type == ATOMTYPE_BRACKETOPEN) ? progP->inst[idx].jump + 1 : idx + 1;
+    }
+    return 0;
+}
+
+
+
+// capture slots of brackets in atoms beginIdx..endIdx - 1 are cleared: alternative left on failure
+
+void Jit_capsClear(JITBUILD* bP, const UInt16 beginIdx, const UInt16 endIdx)
+{
+    const REGEXINST* iP;
+    UInt16 t;
+
+    for (t = beginIdx; t < endIdx; t++)
+    {
+        iP = &bP->progP->inst[t];
+        if (iP->type == ATOMTYPE_BRACKETOPEN && iP->isCap && iP->capsIdx)
+        {
+            Jit_rm(bP, 1, 0xc7, 0, JR_8, (long)iP->capsIdx * 16);  // mov qword [r8 + 16n], 0
+            Jit_u32(bP, 0);
+        }
+    }
+}
+
+
+
+UInt16 Jit_alt(JITBUILD* bP, const UInt16 beginIdx, const UInt16 endIdx, UInt16 fail);
+
+
+
+// atoms beginIdx..endIdx - 1, with no | on their level
+// ret
+//  label to jump to on failure after the atoms: last retry point, or fail if none
+
+UInt16 Jit_seq(JITBUILD* bP, UInt16 idx, const UInt16 endIdx, UInt16 fail)
+{
+    const REGEXINST* iP;
+    const REGEXINST* closeP;
+
+    while (idx < endIdx && !bP->isFail)
+    {
+        iP = &bP->progP->inst[idx];
+
+        switch (iP->type)
+        {
+        case ATOMTYPE_CHAR:
+        case ATOMTYPE_METACLASS:
+            fail = Jit_atom(bP, idx, fail);
+            idx++;
+            break;
+
+        case ATOMTYPE_ANCHOR:
+            Jit_anchor(bP, iP, fail);
+            idx++;
+            break;
+
+        case ATOMTYPE_BRACKETOPEN:
+            closeP = &bP->progP->inst[iP->jump];
+            if (closeP->minOcc != 1 || closeP->maxOcc != 1)     // quantified bracket: not supported
+            {
+                bP->isFail = 1;
+                break;
+            }
+
+            if (iP->isCap && iP->capsIdx)
+                Jit_rm(bP, 1, 0x89, JR_SI, JR_8, (long)iP->capsIdx * 16);       // mov [r8 + 16n], rsi
+            fail = Jit_alt(bP, idx + 1, iP->jump, fail);
+            if (iP->isCap && iP->capsIdx)
+                Jit_rm(bP, 1, 0x89, JR_SI, JR_8, (long)iP->capsIdx * 16 + 8);   // mov [r8 + 16n + 8], rsi
+            idx = iP->jump + 1;
+            break;
+
+        default:
+            bP->isFail = 1;
+            break;
+        }
+    }
+
+    return fail;
+}
+
+
+
+// alternatives in atoms beginIdx..endIdx - 1: each one from the same start, in order;
+// the retry point of the alternative taken is stored, so a failure after the alternatives goes back into it
+// ret
+//  label to jump to on failure after the alternatives
+
+UInt16 Jit_alt(JITBUILD* bP, const UInt16 beginIdx, const UInt16 endIdx, UInt16 fail)
+{
+    UInt16 idx;
+    UInt16 altIdx;
+    UInt16 join;
+    UInt16 next;
+    UInt16 retry;
+    UInt16 altRetry;
+    long pos;
+    long addr;
+
+    if (!Jit_hasPipe(bP->progP, beginIdx, endIdx))
+        return Jit_seq(bP, beginIdx, endIdx, fail);
+
+    pos = (long)bP->varNum * 8;
+    addr = pos + 8;
+    bP->varNum += 2;
+
+    join = Jit_label(bP);
+    retry = Jit_label(bP);
+
+    Jit_rm(bP, 1, 0x89, JR_SI, JR_SP, pos);                     // mov [rsp + pos], rsi
+
+    altIdx = beginIdx;
+    while (!bP->isFail)                                         // last alternative may be empty
+    {
+        idx = altIdx;                                           // end of alternative: next | on this level
+        while (idx < endIdx && bP->progP->inst[idx].type != ATOMTYPE_PIPE)
+            idx = (bP->progP->inst[idx].type == ATOMTYPE_BRACKETOPEN) ? bP->progP->inst[idx].jump + 1 : idx + 1;
+
+        next = Jit_label(bP);
+        altRetry = Jit_seq(bP, altIdx, idx, next);
+
+        Jit_lea(bP, JR_AX, altRetry);                           // lea rax, [rip + retry point of alternative]
+        Jit_rm(bP, 1, 0x89, JR_AX, JR_SP, addr);                // mov [rsp + addr], rax
+        Jit_jmp(bP, join);
+
+        Jit_bind(bP, next);                                     // alternative failed: clear its captures, next one
+        Jit_retry(bP);
+        Jit_capsClear(bP, altIdx, idx);
+        if (idx >= endIdx)
+        {
+            Jit_jmp(bP, fail);
+            break;
+        }
+        Jit_rm(bP, 1, 0x8b, JR_SI, JR_SP, pos);                 // mov rsi, [rsp + pos]
+        altIdx = idx + 1;
+    }
+
+    Jit_bind(bP, retry);
+    Jit_rm(bP, 0, 0xff, 4, JR_SP, addr);                        // jmp [rsp + addr]
+    Jit_bind(bP, join);
+
+    return retry;
+}
+
+
+
+// translate compiled regex to native code, see JITCODE
+// parm
+//  retSize     RET mapped bytes
+// ret
+//  code in mapped pages (read + exec), 0 regex not supported, code too large or no memory
+
+void* Jit_compile(const REGEXPROG* progP, UInt32* retSize)
+{
+    JITBUILD build;                                             // about 30K of stack
+    JITBUILD* bP;
+    const REGEXINST* iP;
+    UInt32 frameOfs;
+    UInt32 frame;
+    UInt32 map;
+    UInt16 start;
+    UInt16 advance;
+    UInt16 noMatch;
+    UInt16 done;
+    UInt16 data;
+    UInt16 scan;
+    UInt16 next;
+    UInt16 go;
+    UInt16 t;
+    UInt16 c;
+    size_t size;
+    long pageSize;
+    void* codeP;
+
+    bP = &build;
+    bP->progP = progP;
+    bP->len = 0;
+    bP->labelNum = 0;
+    bP->fixNum = 0;
+    bP->varNum = 0;
+    bP->isFail = (progP->capsNum > MAX_CAPS) ? 1 : 0;
+
+    start = Jit_label(bP);
+    advance = Jit_label(bP);
+    noMatch = Jit_label(bP);
+    done = Jit_label(bP);
+    data = Jit_label(bP);
+    bP->budgetLabel = Jit_label(bP);
+
+    // prologue: args from JITRUN
+
+    Jit_byte(bP, 0x53);                                         // push rbx
+    Jit_byte(bP, 0x41);                                         // push r12
+    Jit_byte(bP, 0x54);
+    Jit_rr(bP, 1, 0x81, 5, JR_SP);                              // sub rsp, frame (set at end)
+    frameOfs = bP->len;
+    Jit_u32(bP, 0);
+    Jit_rm(bP, 1, 0x8b, JR_11, JR_DI, 0);                       // mov r11, [rdi + strOrigP]
+    Jit_rm(bP, 1, 0x8b, JR_DX, JR_DI, 8);                       // mov rdx, [rdi + strEndP]
+    Jit_rm(bP, 1, 0x8b, JR_9, JR_DI, 24);                       // mov r9, [rdi + lastP]
+    Jit_rm(bP, 1, 0x8b, JR_8, JR_DI, 32);                       // mov r8, [rdi + slotP]
+    Jit_rm(bP, 1, 0x8b, JR_DI, JR_DI, 16);                      // mov rdi, [rdi + startP]
+    Jit_lea(bP, JR_BX, data);                                   // lea rbx, [rip + charset maps]
+
+    // start position: if regex starts with a char or charset (maybe in brackets), positions not matching it are skipped
+
+    Jit_bind(bP, start);
+
+    t = 0;
+    while (progP->inst[t].type == ATOMTYPE_BRACKETOPEN && !Jit_hasPipe(progP, t + 1, progP->inst[t].jump))
+        t++;
+    iP = &progP->inst[t];
+
+    if ((iP->type == ATOMTYPE_CHAR || iP->type == ATOMTYPE_METACLASS) && iP->minOcc >= 1 && !Jit_hasPipe(progP, 0, progP->instNum - 1)
+        && !(iP->type == ATOMTYPE_METACLASS && Jit_isFull(&progP->charset[iP->charsetIdx])))
+    {
+        scan = Jit_label(bP);
+        next = Jit_label(bP);
+        go = Jit_label(bP);
+        Jit_bind(bP, scan);
+        Jit_rr(bP, 1, 0x39, JR_DX, JR_DI);                      // cmp rdi, rdx
+        Jit_jcc(bP, JCC_AE, noMatch);
+        Jit_test(bP, iP, JR_DI, 0, next);
+        Jit_jmp(bP, go);
+        Jit_bind(bP, next);
+        Jit_rr(bP, 1, 0xff, 0, JR_DI);                          // inc rdi
+        Jit_rr(bP, 1, 0x39, JR_9, JR_DI);                       // cmp rdi, r9
+        Jit_jcc(bP, JCC_BE, scan);
+        Jit_jmp(bP, noMatch);
+        Jit_bind(bP, go);
+    }
+
+    Jit_byte(bP, 0x41);                                         // mov r10d, JIT_MAX_RETRY
+    Jit_byte(bP, 0xba);
+    Jit_u32(bP, JIT_MAX_RETRY);
+    Jit_rr(bP, 1, 0x89, JR_DI, JR_SI);                          // mov rsi, rdi
+
+    Jit_alt(bP, 0, progP->instNum - 1, advance);                // all atoms but EOS
+
+    // match: slots [0] [1]
+
+    Jit_rm(bP, 1, 0x89, JR_DI, JR_8, 0);                        // mov [r8], rdi
+    Jit_rm(bP, 1, 0x89, JR_SI, JR_8, 8);                        // mov [r8 + 8], rsi
+    Jit_byte(bP, 0xb8);                                         // mov eax, 1
+    Jit_u32(bP, 1);
+    Jit_jmp(bP, done);
+
+    Jit_bind(bP, advance);                                      // no match here: next start position
+    Jit_rr(bP, 1, 0xff, 0, JR_DI);                              // inc rdi
+    Jit_rr(bP, 1, 0x39, JR_9, JR_DI);                           // cmp rdi, r9
+    Jit_jcc(bP, JCC_BE, start);
+
+    Jit_bind(bP, noMatch);
+    Jit_rr(bP, 0, 0x31, JR_AX, JR_AX);                          // xor eax, eax
+    Jit_jmp(bP, done);
+
+    Jit_bind(bP, bP->budgetLabel);                              // too many backtracks
+    Jit_rr(bP, 1, 0xc7, 0, JR_AX);                              // mov rax, -1
+    Jit_u32(bP, 0xffffffffUL);
+
+    Jit_bind(bP, done);
+    Jit_rr(bP, 1, 0x81, 0, JR_SP);                              // add rsp, frame
+    frame = (UInt32)bP->varNum * 8;
+    if ((frame & 15) == 0)                                      // rsp aligned to 16 after 2 push and return address
+        frame += 8;
+    Jit_u32(bP, frame);
+    Jit_byte(bP, 0x41);                                         // pop r12
+    Jit_byte(bP, 0x5c);
+    Jit_byte(bP, 0x5b);                                         // pop rbx
+    Jit_byte(bP, 0xc3);                                         // ret
+
+    // charset maps, then \w map for \b \B
+
+    while (bP->len & 15)
+        Jit_byte(bP, 0xcc);                                     // int3
+    Jit_bind(bP, data);
+    for (t = 0; t <= progP->charsetNum; t++)
+    {
+        for (c = 0; c < 256; c += 32)
+        {
+            map = 0;
+            for (UInt16 b = 0; b < 32; b++)
+                if ((t < progP->charsetNum) ? Atom_charInCharset(&progP->charset[t], (char)(c + b)) : IsWord((char)(c + b)))
+                    map |= 1UL << b;
+            Jit_u32(bP, map);
+        }
+    }
+
+    Jit_resolve(bP);
+    if (bP->isFail)
+        return 0;
+    memcpy(&bP->code[frameOfs], &frame, 4);
+
+    // own pages: written, then read + exec
+
+    pageSize = sysconf(_SC_PAGESIZE);
+    size = ((size_t)bP->len + (size_t)pageSize - 1) & ~((size_t)pageSize - 1);
+
+    if (__atomic_add_fetch(&jitBytes, size, __ATOMIC_RELAXED) > JIT_MAX_BYTES)
+    {
+        __atomic_sub_fetch(&jitBytes, size, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    codeP = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (codeP == MAP_FAILED)
+    {
+        __atomic_sub_fetch(&jitBytes, size, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    memcpy(codeP, bP->code, bP->len);
+    if (mprotect(codeP, size, PROT_READ | PROT_EXEC) != 0 || !Jit_mapAdd(progP, codeP, (UInt32)size))
+    {
+        munmap(codeP, size);
+        __atomic_sub_fetch(&jitBytes, size, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    *retSize = (UInt32)size;
+    return codeP;
+}
+
+
+
+
+
+
+
+//
+// PUBLIC METHODS AND REGEX ON NATIVE CODE
+//
+
+
+// set caps from capture slots of match, like backtracking regex:
+// [0] the match, then captures that took part to the match (closing bracket order)
+// ret
+//  nr of captures
+
+UInt8 Jit_caps(MXREGEX_M* mP, const REGEXPROG* progP, const char** slotP)
+{
+    UInt16 capsNum;
+    UInt16 n;
+    UInt16 t;
+
+    mP->caps[0].strP = slotP[0];
+    mP->caps[0].len = (REGEXOFS)(slotP[1] - slotP[0]);
+    mP->caps[0].regexP = &progP->inst[0];
+    capsNum = 1;
+
+    for (t = 0; t < progP->instNum; t++)
+    {
+        n = progP->inst[t].capsIdx;
+        if (progP->inst[t].type != ATOMTYPE_BRACKETOPEN || n == 0 || slotP[n * 2] == 0)
+            continue;
+
+        mP->caps[n].strP = slotP[n * 2];
+        mP->caps[n].len = (REGEXOFS)(slotP[n * 2 + 1] - slotP[n * 2]);
+        mP->caps[n].regexP = &progP->inst[t];
+    }
+
+    for (t = 1; t < progP->capsNum; t++)                        // compact, in closing bracket order
+    {
+        if (slotP[t * 2] == 0)
+            continue;
+
+        if (capsNum != t)
+            mP->caps[capsNum] = mP->caps[t];
+        capsNum++;
+    }
+
+    return (UInt8)capsNum;
+}
+
+
+
+// regex on native code, invoked by MxRegex_exec_ex(): compiled regex with REGEXMODE_JIT is promoted to native code on its JIT_HOT execution
+// parm
+//  strP    ptr to str begin (anchors)
+//  startP  search start
+//  endP    ptr to end of str
+// ret
+//  0 no match, n match (nr of caps)
+//  JIT_FALLBACK no native code (not hot yet, not REGEXMODE_JIT, not supported, trace hook set) or too many backtracks: use backtracking regex
+
+UInt8 Jit_exec(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const char* startP, const char* endP)
+{
+    const char* slot[MAX_CAPS * 2];
+    JITRUN run;
+    JITCODE codeP;
+    UInt8 isSkip;
+    long ret;
+
+#if MXREGEX_TRACE
+    if (mP->traceHookP)                                         // traced: backtracking regex reports each step
+        return JIT_FALLBACK;
+#endif
+
+    codeP = 0;
+    if (__atomic_load_n(&progP->jitOwnerP, __ATOMIC_ACQUIRE) == progP)     // else a copy of another compiled regex: not its code
+        codeP = (JITCODE)__atomic_load_n(&progP->jitP, __ATOMIC_ACQUIRE);
+
+    if (codeP == 0)
+    {
+        if (!(progP->mode & REGEXMODE_JIT)
+            || __atomic_add_fetch(&((REGEXPROG*)progP)->execNum, 1, __ATOMIC_RELAXED) != JIT_HOT
+            || !MxRegex_jit((REGEXPROG*)progP))
+            return JIT_FALLBACK;
+        codeP = (JITCODE)__atomic_load_n(&progP->jitP, __ATOMIC_ACQUIRE);
+    }
+
+    if ((void*)codeP == JIT_NONE)
+        return JIT_FALLBACK;
+
+    memset(slot, 0, progP->capsNum * 2 * sizeof(slot[0]));
+    run.strOrigP = strP;
+    run.strEndP = endP;
+    run.slotP = slot;
+
+    // start positions: with literal prefix or at line starts, each one found by Prog_startFind(); else all in one run
+
+    isSkip = (progP->prefixLen || (progP->isLineStart && mP->isMultiLine)) ? 1 : 0;
+    ret = 0;
+
+    while ((startP = Prog_startFind(mP, startP)) != 0)
+    {
+        run.startP = startP;
+        if (isSkip || (progP->isLineStart && !mP->isMultiLine))  // anchored by ^: one start position
+            run.lastP = startP;
+        else
+            run.lastP = endP - progP->minLen;
+
+        if ((ret = codeP(&run)) != 0 || !isSkip || startP >= endP)
+            break;
+        startP++;
+    }
+
+    if (ret < 0)
+        return JIT_FALLBACK;
+    if (ret == 0)
+        return 0;                                               // NO MATCH
+
+    return Jit_caps(mP, progP, slot);                           // MATCH
+}
+
+
+
+// compile regex to native code now (with REGEXMODE_JIT, it's also done on its JIT_HOT execution)
+// Native code is in its own mapped pages, released by MxRegex_jitFree(), or by MxRegex_compile() of the same compiled regex:
+// compiled regex has no destructor, so pages of all regex are bounded by JIT_MAX_BYTES, then regex stay interpreted.
+// Only the compiled regex native code was compiled for runs and releases it: a copy of it (struct copy) stays interpreted,
+// or gets its own native code from MxRegex_jit(), so it is not left with unmapped code when the original is released.
+// Regex with quantified brackets, and targets other than x86-64 POSIX, stay interpreted.
+// parm
+//  progP       compiled regex, see MxRegex_compile()
+// ret
+//  1 regex runs on native code, 0 regex stays interpreted (or being compiled by another thread)
+
+UInt8 MxRegex_jit(REGEXPROG* progP)
+{
+    void* codeP;
+    void* expP;
+    UInt32 size;
+
+    if (progP->retSts != REGEXSTS_OK)
+        return 0;
+
+    expP = __atomic_load_n(&progP->jitP, __ATOMIC_ACQUIRE);
+    if (expP != 0 && __atomic_load_n(&progP->jitOwnerP, __ATOMIC_ACQUIRE) != progP)     // copy of another compiled regex: own code
+        __atomic_compare_exchange_n(&progP->jitP, &expP, (void*)0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+
+    expP = 0;
+    if (!__atomic_compare_exchange_n(&progP->jitP, &expP, JIT_NONE, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return (expP != JIT_NONE) ? 1 : 0;                      // already compiled, or not supported
+    __atomic_store_n(&progP->jitOwnerP, (const void*)progP, __ATOMIC_RELEASE);    // after jitP left the code of the original
+
+    if ((codeP = Jit_compile(progP, &size)) == 0)
+        return 0;                                               // stays JIT_NONE
+
+    progP->jitSize = size;
+    __atomic_store_n(&progP->jitP, codeP, __ATOMIC_RELEASE);
+    return 1;
+}
+
+
+
+// release native code of compiled regex: no thread may be running the regex.
+// Only the compiled regex native code was compiled for releases it: on a copy, native code of the original is left mapped.
+// With REGEXMODE_JIT, it's promoted again after JIT_HOT executions
+
+void MxRegex_jitFree(REGEXPROG* progP)
+{
+    if (progP->jitP != 0 && progP->jitP != JIT_NONE)
+        Jit_unmap(progP->jitP, progP);
+    progP->jitP = 0;
+    progP->jitOwnerP = 0;
+    progP->jitSize = 0;
+    progP->execNum = 0;
+}
+
+
+
+// release native code of a compiled regex compiled again, invoked by MxRegex_compile() (also on a REGEXPROG never compiled:
+// its jitP is not in jitMap[]). As MxRegex_jitFree(), only pages mapped for this compiled regex are released
+
+void Jit_release(REGEXPROG* progP)
+{
+    if (progP->jitP != 0 && progP->jitP != JIT_NONE)
+        Jit_unmap(progP->jitP, progP);
+}
+
+
+
+#else // JIT_X64
+
+
+
+// no native code on this target: regex stay interpreted
+
+UInt8 Jit_exec(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const char* startP, const char* endP)
+{
+    return JIT_FALLBACK;
+}
+
+
+
+UInt8 MxRegex_jit(REGEXPROG* progP)
+{
+    return 0;
+}
+
+
+
+void MxRegex_jitFree(REGEXPROG* progP)
+{
+    progP->jitP = 0;
+    progP->jitOwnerP = 0;
+    progP->jitSize = 0;
+    progP->execNum = 0;
+}
+
+
+
+void Jit_release(REGEXPROG* progP)
+{
+}
+
+
+#endif // JIT_X64
+#endif // MXREGEX_JIT
@@ -0,0 +1,1587 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// NFA engines: lazy DFA and Pike VM.
+//
+// Compiled regex atoms are translated to a Thompson nfa (Nfa_compile), built twice:
+// forward, and reverse (for the reverse regex).
+// Lazy DFA: each DFA state is the ordered list of nfa threads alive at a str position,
+// built on demand and cached in regex data (REGEXDFA); cache is flushed when full.
+// Forward DFA, leftmost first like backtracking regex, finds the end of the match in one pass;
+// then reverse DFA, longest match, runs back from the end to find the begin of the match.
+// No captures: used for REGEXMODE_NOCAPS, see MxRegex_exec_ex().
+// Pike VM: runs all nfa threads in lock step on the forward nfa, each thread with its own capture slots;
+// threads are kept in priority order, so the match is the same leftmost first match of backtracking regex.
+// Time is O(nfa nodes * str len): used for REGEXMODE_LINEAR, or when backtracking regex gives up (REGEXMODE_FALLBACK).
+// Pike VM steps one char at a time, with its threads in PIKEWORK: streaming regex keeps them between chunks.
+// Failure memo backtracker (bit-state): depth first on the forward nfa, in priority order like backtracking regex,
+// with a visited bitmap of (nfa node, str offset): a pair already visited has failed, so it is not explored again.
+// Time is O(nfa nodes * str len), on short str only (bitmap on stack): used for REGEXMODE_MEMO, regex with quantified brackets, or REGEXMODE_FALLBACK.
+
+
+#include <string.h>
+
+#include "mxRegexInt.h"
+
+
+#if MXREGEX_NFA
+
+
+
+// DEFS
+
+#define DFAF_MATCH 0x01                         // state list has a match node
+#define DFAF_BEGIN 0x02                         // state at begin of text (first state only)
+#define DFAF_LONGEST 0x04                       // longest match (reverse DFA), else leftmost first
+#define DFAF_EOS_KNOWN 0x08                     // end of text match evaluated
+#define DFAF_EOS_MATCH 0x10                     // end of text match
+#define DFAF_END 0x20                           // closure only: at end of text
+
+#define DFAF_KEY (DFAF_BEGIN | DFAF_LONGEST)    // flags identifying a state (with node list)
+
+#define DFA_LIST_LOOP 0xffff                    // list marker: unanchored search, start new thread at each position
+
+#define DFA_START_FWD 0                         // start states, see REGEXDFA.start[]
+#define DFA_START_REV 1
+#define DFA_START_REV_BEGIN 2
+#define DFA_START_FWD_MID 3                     // forward, from a position after begin of text (see MxRegex_findNext())
+
+#define PIKE_UNSET 0xffffffffUL                 // capture slot not set
+#define PIKE_RESTORE 0xffff                     // Pike_add() stack: restore capture slot
+
+
+
+
+// byte frequency rank in typical input (source code, text, logs, binaries), 0 rarest .. 255 most common
+// the rarest char of the required literal is searched first, see Nfa_must()
+
+const UInt8 C_BYTE_FREQ[256] = {
+    242, 180, 158, 143, 150, 165, 134, 136, 170, 208, 243, 135, 122, 127, 177, 185,
+    162,  89, 138,  95, 104, 113,  62,  47, 148,  58,  64,  52,  78,  77,  28, 157,
+    255, 121, 221, 181, 178, 141, 172, 147, 210, 209, 214, 154, 212, 227, 244, 246,
+    239, 241, 230, 226, 228, 222, 215, 211, 213, 216, 199, 193, 191, 183, 192,  92,
+    187, 206, 188, 207, 194, 220, 186, 196, 224, 219, 131, 166, 204, 189, 205, 198,
+    223, 118, 202, 218, 235, 195, 155, 163, 190, 160, 173, 153, 156, 151,  94, 250,
+    130, 251, 225, 238, 234, 254, 229, 233, 232, 252, 144, 182, 240, 236, 247, 245,
+    237, 168, 248, 249, 253, 231, 200, 197, 201, 217, 167, 174, 140, 175,  87,  74,
+    145,  79,  46, 169, 164, 171,  99,  48, 100, 184,  23, 179,  90, 159,  76,  73,
+    119,  11,  24,   8,  91,  42,  22,  15,  72,  26,  25,  19,  45,  18,  14,  20,
+     65,  21,   4,   7,  43,   6,   5,   0,  66,  39,  16,  17,  55,  10,   3,   9,
+     67,  12,   1,  13,  63,   2, 125,  29,  93,  60,  98,  57,  69,  37, 102, 105,
+    161, 108, 112, 142, 129, 111, 126, 146,  84,  97,  61,  27,  51,  38,  30,  40,
+    101,  44, 115,  56,  54,  33,  34,  36,  88,  32,  59,  96,  31,  35,  75, 110,
+    107,  49,  85,  41,  81,  50,  71,  83, 176, 152,  70, 123, 103, 106,  80, 117,
+    114,  53,  68,  82, 109,  86, 139, 120, 133, 116, 128, 132, 124, 137, 149, 203
+};
+
+
+
+// nfa builder
+
+typedef struct
+{
+    REGEXPROG* progP;
+    UInt8 isRev;                                    // build reverse nfa
+    UInt8 isOvf;                                    // too many nodes
+
+} NFABUILD;
+
+
+
+// DFA working list, for state being built
+
+typedef struct
+{
+    UInt16 node[MAX_NFA_NODE + 1];                  // nodes in priority order (+ loop marker)
+    UInt16 num;
+    UInt8 visited[(MAX_NFA_NODE + 7) / 8];          // nodes already in list
+    UInt16 stack[MAX_NFA_NODE];                     // closure stack
+
+} DFAWORK;
+
+
+
+// Pike VM thread list, sparse set of nfa nodes in priority order
+
+typedef struct
+{
+    UInt16 sparse[MAX_NFA_NODE];                    // node -> idx in dense[]
+    UInt16 dense[MAX_NFA_NODE];                     // nodes (threads)
+    UInt16 num;
+    UInt32 slot[MAX_NFA_NODE * MAX_CAPS * 2];       // capture offsets, slotNum for each thread
+
+} PIKELIST;
+
+
+
+// Pike_add() stack element: node to follow, or capture slot to restore
+
+typedef struct
+{
+    UInt16 node;                                    // PIKE_RESTORE: restore slot
+    UInt8 slot;
+    UInt32 ofs;
+
+} PIKESTACK;
+
+
+
+// Pike VM working data
+
+typedef struct
+{
+    PIKELIST list[2];                               // current and next thread list
+    PIKELIST* cP;                                   // current thread list (at str position being stepped)
+    PIKELIST* nP;                                   // next thread list
+    PIKESTACK stack[MAX_NFA_NODE * 2];
+    UInt32 cur[MAX_CAPS * 2];                       // captures of thread being added
+    UInt32 match[MAX_CAPS * 2];                     // captures of matching thread
+    UInt16 slotNum;                                 // nr of capture slots (2 for each capture)
+    UInt8 isMatch;                                  // got a match, no new threads
+
+} PIKEWORK;
+
+
+
+// streaming regex (Pike VM on chunks), see MxRegex_streamBegin()
+
+struct MxRegexStream
+{
+    const REGEXPROG* progP;                         // compiled regex
+    PIKEWORK work;
+    PIKEAT at;                                      // pending position: its char is known, next char is not yet
+    UInt8 hasAt;                                    // got 1st char
+    UInt8 isDone;                                   // match found, no threads left
+
+};
+
+
+
+
+
+//
+// NFA BUILDER
+//
+// nfa is built backward: each function gets the node to continue with (next) and returns its first node
+//
+
+
+
+// add node
+// ret
+//  node idx (0 if ovf, see bP->isOvf)
+
+UInt16 Nfa_node(NFABUILD* bP, const UInt8 op, const UInt8 arg, const UInt16 x, const UInt16 y)
+{
+    NFANODE* nP;
+
+    if (bP->progP->nfaNum >= MAX_NFA_NODE)
+    {
+        bP->isOvf = 1;
+        return 0;
+    }
+
+    nP = &bP->progP->nfa[bP->progP->nfaNum];
+    nP->op = op;
+    nP->arg = arg;
+    nP->x = x;
+    nP->y = y;
+
+    return bP->progP->nfaNum++;
+}
+
+
+
+UInt16 Nfa_alt(NFABUILD* bP, const UInt16 beginIdx, const UInt16 endIdx, const UInt16 next);
+
+
+
+// anchor atom
+
+UInt16 Nfa_anchor(NFABUILD* bP, const REGEXINST* iP, const UInt16 next)
+{
+    char c;
+
+    c = iP->c;
+
+    if (c == '^' || c == '$')
+    {
+        if (bP->isRev)                                          // reverse regex: ^ and $ are swapped
+            c = (c == '^') ? '$' : '^';
+
+        if (!(bP->progP->mode & REGEXMODE_MULTILINE))
+            return Nfa_node(bP, (c == '^') ? NFAOP_BEGIN : NFAOP_END, 0, next, 0);
+    }
+
+    return Nfa_node(bP, NFAOP_ASSERT, (UInt8)c, next, 0);       // \b \B, multiline ^ $
+}
+
+
+
+// one occurrence of atom, no quantifier
+
+UInt16 Nfa_one(NFABUILD* bP, const UInt16 idx, UInt16 next)
+{
+    const REGEXINST* iP;
+
+    iP = &bP->progP->inst[idx];
+
+    switch (iP->type)
+    {
+    case ATOMTYPE_CHAR:
+
+        if (iP->cFold != iP->c)                                 // case insensitive letter
+            return Nfa_node(bP, NFAOP_CHARCI, (UInt8)iP->c, next, (UInt8)iP->cFold);
+        return Nfa_node(bP, NFAOP_CHAR, (UInt8)iP->c, next, 0);
+
+
+    case ATOMTYPE_METACLASS:                                    // case insensitive charset is folded by compiler
+
+        return Nfa_node(bP, NFAOP_SET, iP->charsetIdx, next, 0);
+
+
+    case ATOMTYPE_BRACKETOPEN:
+
+        if (iP->isCap && !bP->isRev)                            // capture slots around brackets (forward only)
+        {
+            next = Nfa_node(bP, NFAOP_SAVE, (UInt8)(iP->capsIdx * 2 + 1), next, 0);
+            next = Nfa_alt(bP, idx + 1, iP->jump, next);
+            return Nfa_node(bP, NFAOP_SAVE, (UInt8)(iP->capsIdx * 2), next, 0);
+        }
+        return Nfa_alt(bP, idx + 1, iP->jump, next);
+    }
+
+    return next;
+}
+
+
+
+// atom with quantifier {min,max}: min copies, then (max - min) optional copies or a loop
+// greedy: one more occurrence has priority
+
+UInt16 Nfa_atom(NFABUILD* bP, const UInt16 idx, UInt16 next)
+{
+    const REGEXINST* iP;
+    const REGEXINST* qP;
+    UInt16 exitNode;
+    UInt16 loop;
+    UInt16 t;
+
+    iP = &bP->progP->inst[idx];
+
+    if (iP->type == ATOMTYPE_ANCHOR)
+        return Nfa_anchor(bP, iP, next);
+
+    qP = (iP->type == ATOMTYPE_BRACKETOPEN) ? &bP->progP->inst[iP->jump] : iP;     // brackets: quantifier on closing bracket
+
+    if (qP->minOcc > MAX_NFA_NODE || (qP->maxOcc != BACKTRACK_MAXOCC && qP->maxOcc - qP->minOcc > MAX_NFA_NODE))
+    {
+        bP->isOvf = 1;                                          // would never fit
+        return 0;
+    }
+
+    exitNode = next;
+
+    if (qP->maxOcc == BACKTRACK_MAXOCC)                         // {min,} loop
+    {
+        loop = Nfa_node(bP, NFAOP_SPLIT, 0, 0, exitNode);
+        t = Nfa_one(bP, idx, loop);
+        if (bP->isOvf)
+            return 0;
+        bP->progP->nfa[loop].x = t;
+        next = loop;
+    }
+    else                                                        // {min,max} nested optionals
+    {
+        for (t = qP->minOcc; t < qP->maxOcc && !bP->isOvf; t++)
+            next = Nfa_node(bP, NFAOP_SPLIT, 0, Nfa_one(bP, idx, next), exitNode);
+    }
+
+    for (t = 0; t < qP->minOcc && !bP->isOvf; t++)
+        next = Nfa_one(bP, idx, next);
+
+    return next;
+}
+
+
+
+// sequence of atoms [beginIdx, endIdx) on same nesting level
+
+UInt16 Nfa_seq(NFABUILD* bP, const UInt16 beginIdx, const UInt16 endIdx, const UInt16 next)
+{
+    const REGEXINST* iP;
+    UInt16 atomEndIdx;
+
+    if (beginIdx >= endIdx || bP->isOvf)
+        return next;
+
+    iP = &bP->progP->inst[beginIdx];
+    atomEndIdx = (iP->type == ATOMTYPE_BRACKETOPEN) ? iP->jump + 1 : beginIdx + 1;
+
+    if (bP->isRev)                                              // reverse: last atom first
+        return Nfa_seq(bP, atomEndIdx, endIdx, Nfa_atom(bP, beginIdx, next));
+
+    return Nfa_atom(bP, beginIdx, Nfa_seq(bP, atomEndIdx, endIdx, next));
+}
+
+
+
+// alternatives a|b|c in [beginIdx, endIdx) on same nesting level, first one has priority
+
+UInt16 Nfa_alt(NFABUILD* bP, const UInt16 beginIdx, const UInt16 endIdx, const UInt16 next)
+{
+    const REGEXINST* iP;
+    UInt16 idx;
+    UInt16 first;
+
+    for (idx = beginIdx; idx < endIdx; idx++)                   // search for pipe on this level
+    {
+        iP = &bP->progP->inst[idx];
+        if (iP->type == ATOMTYPE_PIPE)
+            break;
+        if (iP->type == ATOMTYPE_BRACKETOPEN)
+            idx = iP->jump;
+    }
+
+    first = Nfa_seq(bP, beginIdx, idx, next);
+    if (idx >= endIdx || bP->isOvf)
+        return first;
+
+    return Nfa_node(bP, NFAOP_SPLIT, 0, first, Nfa_alt(bP, idx + 1, endIdx, next));
+}
+
+
+
+// split bytes in classes: bytes of same class are accepted by the same nfa nodes
+
+void Nfa_byteClass(REGEXPROG* progP)
+{
+    UInt16 remap[256][2];                                       // old class, accepted -> new class
+    const NFANODE* nP;
+    UInt16 classNum;
+    UInt16 k;
+    UInt16 t;
+    UInt16 t1;
+    UInt8 in;
+
+    for (t = 0; t < 256; t++)
+        progP->byteClass[t] = 0;
+    classNum = 1;
+
+    for (t = 0; t < progP->nfaNum; t++)
+    {
+        nP = &progP->nfa[t];
+        if (nP->op > NFAOP_SET)                                 // consuming nodes only
+            continue;
+
+        for (t1 = 0; t1 < t; t1++)                              // skip if same test already done
+            if (progP->nfa[t1].op == nP->op && progP->nfa[t1].arg == nP->arg)
+                break;
+        if (t1 < t)
+            continue;
+
+        for (k = 0; k < classNum; k++)
+            remap[k][0] = remap[k][1] = 0xffff;
+
+        classNum = 0;
+        for (t1 = 0; t1 < 256; t1++)
+        {
+            k = progP->byteClass[t1];
+            in = Nfa_accept(progP, nP, (char)t1);
+            if (remap[k][in] == 0xffff)
+                remap[k][in] = classNum++;
+            progP->byteClass[t1] = (UInt8)remap[k][in];
+        }
+    }
+
+    progP->byteClassNum = classNum;
+    return;
+}
+
+
+
+// regex hash (FNV-1a), identifies regex in DFA cache
+
+UInt32 Nfa_hash(const char* regexP, const UInt16 mode)
+{
+    UInt32 h;
+
+    h = 2166136261UL;
+    for (; *regexP != '\0'; regexP++)
+        h = ((h ^ (UInt8)*regexP) * 16777619UL) & 0xffffffffUL;
+
+    return ((h ^ mode) * 16777619UL) & 0xffffffffUL;
+}
+
+
+
+// check if nfa node consumes char c
+
+UInt8 Nfa_accept(const REGEXPROG* progP, const NFANODE* nP, const char c)
+{
+    switch (nP->op)
+    {
+    case NFAOP_CHAR:
+        return (c == (char)nP->arg) ? 1 : 0;
+
+    case NFAOP_CHARCI:
+        return (c == (char)nP->arg || c == (char)nP->y) ? 1 : 0;
+
+    case NFAOP_SET:
+        return Atom_charInCharset(&progP->charset[nP->arg], c);
+    }
+
+    return 0;
+}
+
+
+
+// check if every match goes through nfa node n (anchors may pass): n is removed, and a path from start to match is searched
+
+UInt8 Nfa_isRequired(const REGEXPROG* progP, const UInt16 n)
+{
+    UInt32 bits[(MAX_NFA_NODE + 31) / 32];
+    UInt16 stack[MAX_NFA_NODE];
+    const NFANODE* nP;
+    UInt16 sp;
+    UInt16 t;
+
+    memset(bits, 0, sizeof(bits));
+    bits[n >> 5] |= 1UL << (n & 31);                            // node n removed
+    sp = 0;
+    t = progP->nfaStart;
+
+    while (1)
+    {
+        if (!(bits[t >> 5] & (1UL << (t & 31))))
+        {
+            bits[t >> 5] |= 1UL << (t & 31);
+            nP = &progP->nfa[t];
+
+            if (nP->op == NFAOP_MATCH)                          // match reached without n
+                return 0;
+
+            if (nP->op == NFAOP_SPLIT)
+                stack[sp++] = nP->y;
+
+            t = nP->x;
+            continue;
+        }
+
+        if (sp == 0)
+            return 1;
+
+        t = stack[--sp];
+    }
+}
+
+
+
+// required literal: run of chars every match goes through, anywhere in match (e.g. "@" in "^[\w.]+@[\w.]+$"),
+// with the rarest char by C_BYTE_FREQ (a case insensitive letter by its more common case); longer literal if same rarity.
+// Regex is then rejected by a memchr() of the rarest char, see Prog_mustFind()
+// parm
+//  fwdNum  nr of forward nfa nodes
+
+void Nfa_must(REGEXPROG* progP, const UInt16 fwdNum)
+{
+    char lit[MAX_PROG_MUST];
+    char litFold[MAX_PROG_MUST];
+    UInt16 bestFreq;
+    UInt16 freq;
+    UInt16 charFreq;
+    UInt16 n;
+    UInt16 t;
+    UInt8 len;
+    UInt8 rare;
+
+    bestFreq = 0xffff;
+
+    for (n = 0; n < fwdNum; n++)
+    {
+        for (t = n, len = 0; len < MAX_PROG_MUST; len++)            // chars chained by x (captures may be in between)
+        {
+            if (progP->nfa[t].op == NFAOP_CHAR)
+                lit[len] = litFold[len] = (char)progP->nfa[t].arg;
+            else if (progP->nfa[t].op == NFAOP_CHARCI)
+            {
+                lit[len] = (char)progP->nfa[t].arg;
+                litFold[len] = (char)progP->nfa[t].y;
+            }
+            else
+                break;
+
+            for (t = progP->nfa[t].x; progP->nfa[t].op == NFAOP_SAVE; t = progP->nfa[t].x)
+                ;
+        }
+
+        if (len == 0)
+            continue;
+
+        for (t = 0, rare = 0, freq = 0xffff; t < len; t++)          // rarest char
+        {
+            charFreq = C_BYTE_FREQ[(UInt8)lit[t]];
+            if (C_BYTE_FREQ[(UInt8)litFold[t]] > charFreq)          // case insensitive: more common case
+                charFreq = C_BYTE_FREQ[(UInt8)litFold[t]];
+            if (charFreq < freq)
+            {
+                freq = charFreq;
+                rare = (UInt8)t;
+            }
+        }
+
+        if ((freq < bestFreq || (freq == bestFreq && len > progP->mustLen)) && Nfa_isRequired(progP, n))
+        {
+            memcpy(progP->must, lit, len);
+            memcpy(progP->mustFold, litFold, len);
+            progP->mustLen = len;
+            progP->mustRare = rare;
+            bestFreq = freq;
+        }
+    }
+
+    return;
+}
+
+
+
+// build forward and reverse nfa from compiled regex atoms, invoked by MxRegex_compile()
+// if too many nodes, nfa is not available (progP->nfaNum = 0)
+
+void Nfa_compile(REGEXPROG* progP, const char* regexP)
+{
+    NFABUILD b;
+    UInt16 t;
+
+    progP->nfaNum = 0;
+    progP->byteClassNum = 0;
+    progP->isDfa = 0;
+    progP->isNfaFirst = 0;
+    progP->mustLen = 0;
+    progP->hash = Nfa_hash(regexP, progP->mode);
+
+    b.progP = progP;
+    b.isOvf = 0;
+
+    b.isRev = 0;
+    t = Nfa_node(&b, NFAOP_MATCH, 0, 0, 0);
+    progP->nfaStart = Nfa_alt(&b, 0, progP->instNum - 1, t);
+
+    b.isRev = 1;
+    t = Nfa_node(&b, NFAOP_MATCH, 0, 0, 0);
+    progP->nfaRevStart = Nfa_alt(&b, 0, progP->instNum - 1, t);
+
+    if (b.isOvf)
+    {
+        progP->nfaNum = 0;
+        return;
+    }
+
+    Nfa_byteClass(progP);
+    Nfa_must(progP, t);                                         // forward nodes are [0, reverse match node)
+
+    progP->isDfa = 1;
+    for (t = 0; t < progP->nfaNum; t++)                         // anchors needing context are not handled by DFA
+        if (progP->nfa[t].op == NFAOP_ASSERT)
+            progP->isDfa = 0;
+
+    for (t = 0; t < progP->instNum; t++)                        // backtracking regex iterates quantified brackets as a whole: not leftmost first
+        if (progP->inst[t].type == ATOMTYPE_BRACKETCLOSE && (progP->inst[t].minOcc != 1 || progP->inst[t].maxOcc != 1))
+            progP->isNfaFirst = 1;
+
+    return;
+}
+
+
+
+
+
+//
+// LAZY DFA
+//
+
+
+// flush DFA cache
+
+void Dfa_flush(REGEXDFA* dP)
+{
+    dP->stateNum = 0;
+    dP->listNum = 0;
+    dP->start[DFA_START_FWD] = DFA_TRANS_UNKNOWN;
+    dP->start[DFA_START_REV] = DFA_TRANS_UNKNOWN;
+    dP->start[DFA_START_REV_BEGIN] = DFA_TRANS_UNKNOWN;
+    dP->start[DFA_START_FWD_MID] = DFA_TRANS_UNKNOWN;
+    dP->flushNum++;
+    return;
+}
+
+
+
+// clear working list
+
+void Dfa_workClear(DFAWORK* wP)
+{
+    wP->num = 0;
+    memset(wP->visited, 0, sizeof(wP->visited));
+    return;
+}
+
+
+
+// add to working list all threads reachable from node n without consuming chars, in priority order
+// parm
+//  ctx     DFAF_BEGIN: at begin of text, DFAF_END: at end of text
+
+void Dfa_closure(const REGEXPROG* progP, DFAWORK* wP, UInt16 n, const UInt8 ctx)
+{
+    const NFANODE* nP;
+    UInt16 sp;
+
+    sp = 0;
+
+    while (1)
+    {
+        if (!(wP->visited[n / 8] & (1 << (n & 7))))
+        {
+            wP->visited[n / 8] |= 1 << (n & 7);
+            nP = &progP->nfa[n];
+
+            switch (nP->op)
+            {
+            case NFAOP_SPLIT:                                   // x first, y later
+                wP->stack[sp++] = nP->y;
+                n = nP->x;
+                continue;
+
+            case NFAOP_SAVE:                                    // no captures here
+                n = nP->x;
+                continue;
+
+            case NFAOP_BEGIN:
+                if (ctx & DFAF_BEGIN)
+                {
+                    n = nP->x;
+                    continue;
+                }
+                break;                                          // thread dies
+
+            case NFAOP_END:
+                if (ctx & DFAF_END)
+                {
+                    n = nP->x;
+                    continue;
+                }
+                wP->node[wP->num++] = n;                        // wait for end of text
+                break;
+
+            case NFAOP_ASSERT:                                  // not used by DFA (see REGEXPROG.isDfa)
+                break;
+
+            default:                                            // consuming nodes, match
+                wP->node[wP->num++] = n;
+                break;
+            }
+        }
+
+        if (sp == 0)
+            return;
+        n = wP->stack[--sp];
+    }
+}
+
+
+
+// get state of working list: search in cache, add if not found (flush cache if full)
+// ret
+//  state idx, DFA_TRANS_DEAD if no threads
+
+UInt16 Dfa_state(REGEXDFA* dP, const REGEXPROG* progP, DFAWORK* wP, UInt8 flags)
+{
+    DFASTATE* sP;
+    UInt16 hash;
+    UInt16 t;
+
+    for (t = 0; t < wP->num; t++)
+    {
+        if (wP->node[t] != DFA_LIST_LOOP && progP->nfa[wP->node[t]].op == NFAOP_MATCH)
+        {
+            flags |= DFAF_MATCH;
+            if (!(flags & DFAF_LONGEST))                        // leftmost first: threads after match have lower priority, drop them
+                wP->num = t + 1;
+            break;
+        }
+    }
+
+    if (wP->num == 0)
+        return DFA_TRANS_DEAD;
+
+    hash = flags;
+    for (t = 0; t < wP->num; t++)
+        hash = (UInt16)(hash * 31 + wP->node[t]);
+
+    for (t = 0; t < dP->stateNum; t++)                          // search in cache
+    {
+        sP = &dP->state[t];
+        if (sP->hash == hash && sP->listNum == wP->num && (sP->flags & DFAF_KEY) == (flags & DFAF_KEY)
+            && memcmp(&dP->list[sP->listIdx], wP->node, wP->num * sizeof(UInt16)) == 0)
+            return t;
+    }
+
+    if (dP->stateNum >= dP->stateMax || dP->listNum + wP->num > DFA_MAX_LIST)     // cache full
+        Dfa_flush(dP);
+
+    sP = &dP->state[dP->stateNum];
+    sP->listIdx = dP->listNum;
+    sP->listNum = wP->num;
+    sP->hash = hash;
+    sP->flags = flags;
+    memcpy(&dP->list[dP->listNum], wP->node, wP->num * sizeof(UInt16));
+    dP->listNum += wP->num;
+
+    for (t = 0; t < progP->byteClassNum; t++)
+        dP->trans[dP->stateNum * progP->byteClassNum + t] = DFA_TRANS_UNKNOWN;
+
+    return dP->stateNum++;
+}
+
+
+
+// get start state
+// parm
+//  startIdx    DFA_START_FWD: forward unanchored, DFA_START_REV[_BEGIN]: reverse anchored (at end of text)
+
+UInt16 Dfa_start(REGEXDFA* dP, const REGEXPROG* progP, DFAWORK* wP, const UInt8 startIdx)
+{
+    Dfa_workClear(wP);
+
+    if (dP->start[startIdx] == DFA_TRANS_UNKNOWN)
+    {
+        if (startIdx == DFA_START_FWD || startIdx == DFA_START_FWD_MID)
+        {
+            Dfa_closure(progP, wP, progP->nfaStart, (startIdx == DFA_START_FWD) ? DFAF_BEGIN : 0);
+            wP->node[wP->num++] = DFA_LIST_LOOP;
+            dP->start[startIdx] = Dfa_state(dP, progP, wP, (startIdx == DFA_START_FWD) ? DFAF_BEGIN : 0);
+        }
+        else
+        {
+            Dfa_closure(progP, wP, progP->nfaRevStart, (startIdx == DFA_START_REV_BEGIN) ? DFAF_BEGIN : 0);
+            dP->start[startIdx] = Dfa_state(dP, progP, wP, DFAF_LONGEST | ((startIdx == DFA_START_REV_BEGIN) ? DFAF_BEGIN : 0));
+        }
+    }
+
+    return dP->start[startIdx];
+}
+
+
+
+// compute transition of state on char c, save it to cache
+// ret
+//  next state idx, DFA_TRANS_DEAD if no threads left
+
+UInt16 Dfa_next(REGEXDFA* dP, const REGEXPROG* progP, DFAWORK* wP, const UInt16 stateIdx, const char c)
+{
+    const DFASTATE* sP;
+    const NFANODE* nP;
+    UInt32 flushNum;
+    UInt16 nextIdx;
+    UInt16 n;
+    UInt16 t;
+
+    sP = &dP->state[stateIdx];
+    Dfa_workClear(wP);
+
+    for (t = 0; t < sP->listNum; t++)
+    {
+        n = dP->list[sP->listIdx + t];
+
+        if (n == DFA_LIST_LOOP)                                 // new thread at next position, lowest priority
+        {
+            Dfa_closure(progP, wP, progP->nfaStart, 0);
+            wP->node[wP->num++] = DFA_LIST_LOOP;
+            continue;
+        }
+
+        nP = &progP->nfa[n];
+        if (Nfa_accept(progP, nP, c))
+            Dfa_closure(progP, wP, nP->x, 0);
+    }
+
+    flushNum = dP->flushNum;
+    nextIdx = Dfa_state(dP, progP, wP, sP->flags & DFAF_LONGEST);
+
+    if (dP->flushNum == flushNum)                               // if state still in cache, save transition
+        dP->trans[stateIdx * progP->byteClassNum + progP->byteClass[(UInt8)c]] = nextIdx;
+
+    return nextIdx;
+}
+
+
+
+// check match at end of text
+// ret
+//  1 match
+
+UInt8 Dfa_eos(REGEXDFA* dP, const REGEXPROG* progP, DFAWORK* wP, const UInt16 stateIdx)
+{
+    DFASTATE* sP;
+    const NFANODE* nP;
+    UInt16 n;
+    UInt16 t;
+
+    sP = &dP->state[stateIdx];
+
+    if (!(sP->flags & DFAF_EOS_KNOWN))
+    {
+        Dfa_workClear(wP);
+
+        for (t = 0; t < sP->listNum; t++)                       // only threads waiting for end of text may go on
+        {
+            n = dP->list[sP->listIdx + t];
+            if (n == DFA_LIST_LOOP)
+                continue;
+
+            nP = &progP->nfa[n];
+            if (nP->op == NFAOP_END)
+                Dfa_closure(progP, wP, nP->x, DFAF_END | (sP->flags & DFAF_BEGIN));
+        }
+
+        sP->flags |= DFAF_EOS_KNOWN;
+        if (sP->flags & DFAF_MATCH)
+            sP->flags |= DFAF_EOS_MATCH;
+
+        for (t = 0; t < wP->num; t++)
+            if (progP->nfa[wP->node[t]].op == NFAOP_MATCH)
+                sP->flags |= DFAF_EOS_MATCH;
+    }
+
+    return (sP->flags & DFAF_EOS_MATCH) ? 1 : 0;
+}
+
+
+
+// regex with lazy DFA, invoked by MxRegex_exec_ex()
+// on match, set caps[0]
+// parm
+//  strP    ptr to str
+//  startP  ptr to search start, from strP on (str before it is not matched)
+//  endP    ptr to end of str (\0 is a normal char)
+// ret
+//  0 no match, 1 match
+//  DFA_FALLBACK cache is too small for this regex, use backtracking regex
+
+UInt8 Dfa_exec(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const char* startP, const char* endP)
+{
+    REGEXDFA* dP;
+    DFAWORK work;
+    const char* p;
+    const char* matchP;
+    const char* beginP;
+    UInt32 flushNum;
+    UInt16 s;
+    UInt16 t;
+    UInt8 c;
+
+    dP = Regex_dfa(mP);
+
+    if (dP->progP != progP || dP->progHash != progP->hash)     // other regex: clear cache
+    {
+        dP->progP = progP;
+        dP->progHash = progP->hash;
+        dP->stateMax = DFA_MAX_TRANS / progP->byteClassNum;
+        if (dP->stateMax > DFA_MAX_STATE)
+            dP->stateMax = DFA_MAX_STATE;
+        Dfa_flush(dP);
+    }
+
+    flushNum = dP->flushNum;
+
+    // forward, leftmost first: end of match
+
+    s = Dfa_start(dP, progP, &work, (startP == strP) ? DFA_START_FWD : DFA_START_FWD_MID);
+    matchP = (dP->state[s].flags & DFAF_MATCH) ? startP : 0;
+
+    for (p = startP; p < endP; p++)
+    {
+        c = (UInt8)*p;
+        t = dP->trans[s * progP->byteClassNum + progP->byteClass[c]];
+
+        if (t >= DFA_TRANS_DEAD)
+        {
+            if (t == DFA_TRANS_DEAD)
+                break;
+
+            if (dP->flushNum - flushNum > DFA_MAX_FLUSH)        // cache thrashing
+                return DFA_FALLBACK;
+
+            if ((t = Dfa_next(dP, progP, &work, s, (char)c)) == DFA_TRANS_DEAD)
+                break;
+        }
+
+        s = t;
+        if (dP->state[s].flags & DFAF_MATCH)
+            matchP = p + 1;
+    }
+
+    if (p == endP && Dfa_eos(dP, progP, &work, s))
+        matchP = p;
+
+    if (matchP == 0)
+        return 0;                                               // NO MATCH
+
+    // reverse, longest: begin of match
+
+    s = Dfa_start(dP, progP, &work, (matchP == endP) ? DFA_START_REV_BEGIN : DFA_START_REV);
+    beginP = (dP->state[s].flags & DFAF_MATCH) ? matchP : 0;
+
+    for (p = matchP; p > startP; p--)
+    {
+        c = (UInt8)p[-1];
+        t = dP->trans[s * progP->byteClassNum + progP->byteClass[c]];
+
+        if (t >= DFA_TRANS_DEAD)
+        {
+            if (t == DFA_TRANS_DEAD)
+                break;
+
+            if (dP->flushNum - flushNum > DFA_MAX_FLUSH)
+                return DFA_FALLBACK;
+
+            if ((t = Dfa_next(dP, progP, &work, s, (char)c)) == DFA_TRANS_DEAD)
+                break;
+        }
+
+        s = t;
+        if (dP->state[s].flags & DFAF_MATCH)
+            beginP = p - 1;
+    }
+
+    if (p == strP && Dfa_eos(dP, progP, &work, s))             // begin of text (not just search start)
+        beginP = strP;
+
+    if (beginP == 0)                                            // should never happen
+        return DFA_FALLBACK;
+
+    mP->caps[0].strP = beginP;
+    mP->caps[0].len = (REGEXOFS)(matchP - beginP);
+    mP->caps[0].regexP = &progP->inst[0];
+
+    return 1;                                                   // MATCH
+}
+
+
+
+
+
+
+//
+// PIKE VM
+//
+
+
+// check anchor \b \B, multiline ^ $ at str position atP
+
+UInt8 Pike_assert(const char c, const PIKEAT* atP)
+{
+    switch (c)
+    {
+    case '^':                                                   // multiline: begin of str or after \r \n
+        return (atP->ofs == 0 || atP->prevC == '\r' || atP->prevC == '\n') ? 1 : 0;
+
+    case '$':                                                   // multiline: end of str or \r \n follows
+        return (atP->isEnd || atP->c == '\r' || atP->c == '\n') ? 1 : 0;
+
+    case 'b':                                                   // word boundary, begin and end of str are \W
+        return ((atP->ofs > 0 && IsWord(atP->prevC)) != (!atP->isEnd && IsWord(atP->c))) ? 1 : 0;
+
+    case 'B':
+        return ((atP->ofs > 0 && IsWord(atP->prevC)) == (!atP->isEnd && IsWord(atP->c))) ? 1 : 0;
+    }
+
+    return 1;                                                   // unhandled anchor, ignore
+}
+
+
+
+// add thread n to list, following empty transitions in priority order, at str position atP
+// captures wP->cur are updated while following, then restored
+
+void Pike_add(const REGEXPROG* progP, PIKEWORK* wP, PIKELIST* lP, UInt16 n, const PIKEAT* atP)
+{
+    const NFANODE* nP;
+    PIKESTACK* sP;
+    UInt16 sp;
+    UInt16 t;
+
+    sp = 0;
+
+    while (1)
+    {
+        t = lP->sparse[n];
+        if (t >= lP->num || lP->dense[t] != n)                  // if not in list
+        {
+            lP->sparse[n] = lP->num;
+            lP->dense[lP->num] = n;
+            t = lP->num++;
+            nP = &progP->nfa[n];
+
+            switch (nP->op)
+            {
+            case NFAOP_SPLIT:                                   // x first, y later
+                sP = &wP->stack[sp++];
+                sP->node = nP->y;
+                n = nP->x;
+                continue;
+
+            case NFAOP_SAVE:
+                if (nP->arg < wP->slotNum)
+                {
+                    sP = &wP->stack[sp++];                      // restore slot when done
+                    sP->node = PIKE_RESTORE;
+                    sP->slot = nP->arg;
+                    sP->ofs = wP->cur[nP->arg];
+                    wP->cur[nP->arg] = atP->ofs;
+                }
+                n = nP->x;
+                continue;
+
+            case NFAOP_BEGIN:
+                if (atP->ofs == 0)
+                {
+                    n = nP->x;
+                    continue;
+                }
+                break;
+
+            case NFAOP_END:
+                if (atP->isEnd)
+                {
+                    n = nP->x;
+                    continue;
+                }
+                break;
+
+            case NFAOP_ASSERT:
+                if (Pike_assert((char)nP->arg, atP))
+                {
+                    n = nP->x;
+                    continue;
+                }
+                break;
+
+            default:                                            // consuming nodes, match: save captures
+                memcpy(&lP->slot[t * wP->slotNum], wP->cur, wP->slotNum * sizeof(UInt32));
+                break;
+            }
+        }
+
+        while (1)                                               // next from stack
+        {
+            if (sp == 0)
+                return;
+
+            sP = &wP->stack[--sp];
+            if (sP->node != PIKE_RESTORE)
+            {
+                n = sP->node;
+                break;
+            }
+            wP->cur[sP->slot] = sP->ofs;
+        }
+    }
+}
+
+
+
+// init Pike VM working data, no threads
+
+void Pike_init(const REGEXPROG* progP, PIKEWORK* wP)
+{
+    wP->slotNum = progP->capsNum * 2;
+    wP->cP = &wP->list[0];
+    wP->nP = &wP->list[1];
+    wP->cP->num = 0;
+    wP->isMatch = 0;
+    return;
+}
+
+
+
+// Pike VM step on char at str position atP: threads of current list consume it, going to next list
+// parm
+//  atP     str position (char atP->c)
+//  nextP   next str position (char atP->c is nextP->prevC), not used if atP->isEnd
+// ret
+//  0 go on with next position
+//  1 done: end of str, or match found and no threads left (match in wP->match if wP->isMatch)
+
+UInt8 Pike_step(const REGEXPROG* progP, PIKEWORK* wP, const PIKEAT* atP, const PIKEAT* nextP)
+{
+    const NFANODE* nodeP;
+    PIKELIST* tP;
+    UInt16 n;
+    UInt16 t;
+
+    if (!wP->isMatch)                                           // new thread at this position, lowest priority
+    {
+        for (t = 0; t < wP->slotNum; t++)
+            wP->cur[t] = PIKE_UNSET;
+        wP->cur[0] = atP->ofs;                                  // slot 0: match begin
+        Pike_add(progP, wP, wP->cP, progP->nfaStart, atP);
+    }
+
+    if (wP->cP->num == 0 && (wP->isMatch || atP->isEnd))       // no threads left
+        return 1;
+
+    wP->nP->num = 0;
+
+    for (t = 0; t < wP->cP->num; t++)
+    {
+        n = wP->cP->dense[t];
+        nodeP = &progP->nfa[n];
+
+        if (nodeP->op == NFAOP_MATCH)                           // match: drop lower priority threads
+        {
+            memcpy(wP->match, &wP->cP->slot[t * wP->slotNum], wP->slotNum * sizeof(UInt32));
+            wP->match[1] = atP->ofs;
+            wP->isMatch = 1;
+            break;
+        }
+
+        if (!atP->isEnd && Nfa_accept(progP, nodeP, atP->c))
+        {
+            memcpy(wP->cur, &wP->cP->slot[t * wP->slotNum], wP->slotNum * sizeof(UInt32));
+            Pike_add(progP, wP, wP->nP, nodeP->x, nextP);
+        }
+    }
+
+    tP = wP->cP;                                                // swap lists
+    wP->cP = wP->nP;
+    wP->nP = tP;
+
+    return atP->isEnd;
+}
+
+
+
+// str position ofs of str with len strLen
+
+void Pike_at(PIKEAT* atP, const char* strP, const UInt32 ofs, const UInt32 strLen)
+{
+    atP->ofs = ofs;
+    atP->prevC = (ofs > 0) ? strP[ofs - 1] : '\0';
+    atP->isEnd = (ofs == strLen) ? 1 : 0;
+    atP->c = atP->isEnd ? '\0' : strP[ofs];
+    return;
+}
+
+
+
+// set caps from capture slots of match, like backtracking regex:
+// [0] the match, then captures that took part to the match (closing bracket order)
+// parm
+//  slotP   capture offsets (2 for each capture, PIKE_UNSET not set), [0] [1] the match
+// ret
+//  nr of captures
+
+UInt8 Pike_caps(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const UInt32* slotP)
+{
+    UInt16 capsNum;
+    UInt16 n;
+    UInt16 t;
+
+    mP->caps[0].strP = strP + slotP[0];
+    mP->caps[0].len = (REGEXOFS)(slotP[1] - slotP[0]);
+    mP->caps[0].regexP = &progP->inst[0];
+    capsNum = 1;
+
+    for (t = 0; t < progP->instNum; t++)
+    {
+        n = progP->inst[t].capsIdx;
+        if (progP->inst[t].type != ATOMTYPE_BRACKETOPEN || n == 0)
+            continue;
+
+        if (slotP[n * 2] == PIKE_UNSET || slotP[n * 2 + 1] == PIKE_UNSET)         // bracket not in match
+            continue;
+
+        mP->caps[n].strP = strP + slotP[n * 2];
+        mP->caps[n].len = (REGEXOFS)(slotP[n * 2 + 1] - slotP[n * 2]);
+        mP->caps[n].regexP = &progP->inst[t];
+    }
+
+    for (t = 1; t < progP->capsNum; t++)                        // compact, in closing bracket order
+    {
+        if (slotP[t * 2] == PIKE_UNSET || slotP[t * 2 + 1] == PIKE_UNSET)
+            continue;
+
+        if (capsNum != t)
+            mP->caps[capsNum] = mP->caps[t];
+        capsNum++;
+    }
+
+    return (UInt8)capsNum;
+}
+
+
+
+// regex with Pike VM, invoked by MxRegex_exec_ex()
+// on match, set caps like backtracking regex: [0] the match, then captures that took part to the match (closing bracket order)
+// parm
+//  strP    ptr to str
+//  startP  ptr to search start, from strP on (str before it is only seen by anchors)
+//  endP    ptr to end of str (\0 is a normal char)
+// ret
+//  0 no match, n nr of captures
+
+UInt8 Pike_exec(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const char* startP, const char* endP)
+{
+    PIKEWORK* wP;
+    PIKEWORK work;
+    PIKEAT at[2];
+    UInt32 ofs;
+    UInt32 strLen;
+
+    if (progP->capsNum > MAX_CAPS)
+    {
+        mP->retSts = REGEXSTS_CAPS_OVS;
+        return 0;
+    }
+
+    strLen = (UInt32)(endP - strP);
+    wP = &work;
+    Pike_init(progP, wP);
+
+    ofs = (UInt32)(startP - strP);
+    Pike_at(&at[ofs & 1], strP, ofs, strLen);
+
+    for (; ; ofs++)
+    {
+        if (!at[ofs & 1].isEnd)
+            Pike_at(&at[(ofs + 1) & 1], strP, ofs + 1, strLen);
+
+        if (Pike_step(progP, wP, &at[ofs & 1], &at[(ofs + 1) & 1]))
+            break;
+    }
+
+    if (!wP->isMatch)
+        return 0;                                               // NO MATCH
+
+    return Pike_caps(mP, progP, strP, wP->match);               // MATCH
+}
+
+
+
+
+
+
+//
+// FAILURE MEMO BACKTRACKER
+//
+
+
+// regex with failure memo backtracker, invoked by MxRegex_exec_ex()
+// Depth first from each start position, alternatives and capture restores on a stack (PIKESTACK, like Pike_add()).
+// A visited (nfa node, str offset) pair is never explored again: if it had led to a match, search would be over.
+// The bitmap is kept between start positions too, as a failure does not depend on the start (no backreferences).
+// Same match and captures of Pike VM (leftmost first on the nfa), without watchdog; backtracking regex iterates quantified
+// brackets as a whole, not leftmost first: regex with quantified brackets run here (REGEXPROG.isNfaFirst).
+// parm
+//  strP    ptr to str
+//  startP  ptr to search start, from strP on (str before it is only seen by anchors)
+//  endP    ptr to end of str (\0 is a normal char)
+// ret
+//  0 no match, n nr of captures
+//  MEMO_FALLBACK str too long for bitmap (see MEMO_MAX_BITS) or stack ovf, use Pike VM
+
+UInt8 Memo_exec(MXREGEX_M* mP, const REGEXPROG* progP, const char* strP, const char* startP, const char* endP)
+{
+    UInt32 visited[MEMO_MAX_BITS / 32];
+    PIKESTACK stack[MEMO_MAX_STACK];
+    UInt32 cur[MAX_CAPS * 2];
+    const NFANODE* nP;
+    PIKEAT at;
+    UInt32 strLen;
+    UInt32 startOfs;
+    UInt32 span;
+    UInt32 start;
+    UInt32 ofs;
+    UInt32 k;
+    UInt16 slotNum;
+    UInt16 sp;
+    UInt16 n;
+    UInt16 t;
+
+    if (progP->capsNum > MAX_CAPS)
+    {
+        mP->retSts = REGEXSTS_CAPS_OVS;
+        return 0;
+    }
+
+    strLen = (UInt32)(endP - strP);
+    startOfs = (UInt32)(startP - strP);
+    span = strLen - startOfs + 1;                               // str offsets from start to end included
+
+    if ((size_t)(endP - startP) >= MEMO_MAX_BITS || (size_t)progP->nfaNum * span > MEMO_MAX_BITS)
+        return MEMO_FALLBACK;
+
+    memset(visited, 0, ((progP->nfaNum * span + 31) / 32) * sizeof(UInt32));
+    slotNum = progP->capsNum * 2;
+
+    for (start = startOfs; start <= strLen; start++)
+    {
+        for (t = 0; t < slotNum; t++)
+            cur[t] = PIKE_UNSET;
+        cur[0] = start;                                         // slot 0: match begin
+
+        n = progP->nfaStart;
+        ofs = start;
+        sp = 0;
+
+        while (1)
+        {
+            k = n * span + (ofs - startOfs);
+            if (visited[k / 32] & (1UL << (k & 31)))            // already explored: failed
+                goto BR_NEXT;
+            visited[k / 32] |= 1UL << (k & 31);
+
+            nP = &progP->nfa[n];
+
+            switch (nP->op)
+            {
+            case NFAOP_SPLIT:                                   // x first, y later
+                if (sp >= MEMO_MAX_STACK)
+                    return MEMO_FALLBACK;
+                stack[sp].node = nP->y;
+                stack[sp++].ofs = ofs;
+                n = nP->x;
+                continue;
+
+            case NFAOP_SAVE:
+                if (nP->arg < slotNum)
+                {
+                    if (sp >= MEMO_MAX_STACK)
+                        return MEMO_FALLBACK;
+                    stack[sp].node = PIKE_RESTORE;              // restore slot on the way back
+                    stack[sp].slot = nP->arg;
+                    stack[sp++].ofs = cur[nP->arg];
+                    cur[nP->arg] = ofs;
+                }
+                n = nP->x;
+                continue;
+
+            case NFAOP_BEGIN:
+                if (ofs == 0)
+                {
+                    n = nP->x;
+                    continue;
+                }
+                break;
+
+            case NFAOP_END:
+                if (ofs == strLen)
+                {
+                    n = nP->x;
+                    continue;
+                }
+                break;
+
+            case NFAOP_ASSERT:
+                Pike_at(&at, strP, ofs, strLen);
+                if (Pike_assert((char)nP->arg, &at))
+                {
+                    n = nP->x;
+                    continue;
+                }
+                break;
+
+            case NFAOP_MATCH:                                   // 1st match found is the leftmost first one
+                cur[1] = ofs;
+                return Pike_caps(mP, progP, strP, cur);
+
+            default:                                            // consuming nodes
+                if (ofs < strLen && Nfa_accept(progP, nP, strP[ofs]))
+                {
+                    n = nP->x;
+                    ofs++;
+                    continue;
+                }
+                break;
+            }
+
+        BR_NEXT:                                                // *** entrypoint thread failed, next alternative from stack
+
+            while (sp > 0 && stack[sp - 1].node == PIKE_RESTORE)
+            {
+                sp--;
+                cur[stack[sp].slot] = stack[sp].ofs;
+            }
+
+            if (sp == 0)
+                break;                                          // no match at this start position
+
+            sp--;
+            n = stack[sp].node;
+            ofs = stack[sp].ofs;
+        }
+    }
+
+    return 0;                                                   // NO MATCH
+}
+
+
+
+
+
+
+//
+// PUBLIC METHODS (streaming regex)
+//
+
+
+// Begin streaming regex: input str is fed in chunks, see MxRegex_streamFeed() MxRegex_streamEnd()
+// Pike VM threads are kept between chunks, so each char is read once, no matter how the str is split.
+// Same match and captures of the Pike VM (REGEXMODE_LINEAR: leftmost first on the nfa), with offsets from stream begin;
+// same results of MxRegex_exec(), but on regex over MAX_NFA_NODE (backtracking regex only).
+//
+// parm
+//  progP       ptr to compiled regex, see MxRegex_compile(). Must be valid until MxRegex_streamEnd()
+// ret
+//  stream state (about 45K, allocated), 0 if regex not compiled or too large for nfa (more than MAX_NFA_NODE nodes)
+
+MXREGEX_STREAM* MxRegex_streamBegin(const REGEXPROG* progP)
+{
+    MXREGEX_STREAM* sP;
+
+    if (progP->retSts != REGEXSTS_OK || progP->nfaNum == 0 || progP->capsNum > MAX_CAPS)
+        return 0;
+
+    sP = new MXREGEX_STREAM;
+    sP->progP = progP;
+    Pike_init(progP, &sP->work);
+    sP->hasAt = 0;
+    sP->isDone = 0;
+
+    return sP;
+}
+
+
+
+// Feed next chunk of streaming regex.
+// Last char of chunk is pending (stepped when next char, or end of stream, is known: $ \b look at it)
+//
+// parm
+//  sP          stream state, see MxRegex_streamBegin()
+//  chunkP      ptr to chunk (\0 is a normal char)
+//  len         chunk len
+// ret
+//  0           go on
+//  1           match found, following chars can't change it: caller may call MxRegex_streamEnd() at once
+
+UInt8 MxRegex_streamFeed(MXREGEX_STREAM* sP, const char* chunkP, const size_t len)
+{
+    PIKEAT next;
+    size_t t;
+
+    if (sP->isDone)
+        return 1;
+
+    for (t = 0; t < len; t++)
+    {
+        if (!sP->hasAt)                                         // 1st char of stream
+        {
+            sP->at.ofs = 0;
+            sP->at.prevC = '\0';
+            sP->at.c = chunkP[t];
+            sP->at.isEnd = 0;
+            sP->hasAt = 1;
+            continue;
+        }
+
+        next.ofs = sP->at.ofs + 1;
+        next.prevC = sP->at.c;
+        next.c = chunkP[t];
+        next.isEnd = 0;
+
+        if (Pike_step(sP->progP, &sP->work, &sP->at, &next))
+        {
+            sP->isDone = 1;
+            return 1;
+        }
+
+        sP->at = next;
+    }
+
+    return 0;
+}
+
+
+
+// End streaming regex: step pending char and end of stream, get result, free stream state
+// parm
+//  sP          stream state, see MxRegex_streamBegin()
+//  capsP       RET match and captures (offset from stream begin), MAX_CAPS elements; may be 0
+// ret
+//  0           no match
+//  n           regex match, number of captures. capsP[0] is the match, [1..n-1] the captures (like MxRegex_exec())
+
+UInt8 MxRegex_streamEnd(MXREGEX_STREAM* sP, REGEXSPAN* capsP)
+{
+    PIKEWORK* wP;
+    PIKEAT end;
+    UInt16 capsNum;
+    UInt16 t;
+
+    wP = &sP->work;
+
+    if (!sP->isDone)
+    {
+        end.ofs = sP->hasAt ? sP->at.ofs + 1 : 0;
+        end.prevC = sP->hasAt ? sP->at.c : '\0';
+        end.c = '\0';
+        end.isEnd = 1;
+
+        if (!sP->hasAt || !Pike_step(sP->progP, wP, &sP->at, &end))
+            Pike_step(sP->progP, wP, &end, &end);
+    }
+
+    capsNum = 0;
+
+    if (wP->isMatch)
+    {
+        for (t = 0; t < sP->progP->capsNum; t++)                // [0] the match, then captures in closing bracket order
+        {
+            if (wP->match[t * 2] == PIKE_UNSET || wP->match[t * 2 + 1] == PIKE_UNSET)
+                continue;
+
+            if (capsP != 0)
+            {
+                capsP[capsNum].ofs = wP->match[t * 2];
+                capsP[capsNum].len = wP->match[t * 2 + 1] - wP->match[t * 2];
+            }
+            capsNum++;
+        }
+    }
+
+    delete sP;
+    return (UInt8)capsNum;
+}
+
+
+#endif // #if MXREGEX_NFA
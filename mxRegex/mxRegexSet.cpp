@@ -0,0 +1,905 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// Regex set: many patterns on the same str, in one pass.
+//
+// Each pattern is compiled to its own nfa (see Nfa_compile), with its own mode.
+// All nfa run in lock step on each str char, threads kept as a bitset of nfa nodes for each pattern:
+// no captures and no thread priority, only "pattern matches somewhere".
+// A pattern is dropped when it matches, or when it can't match any more (anchored ^ with no threads left),
+// so a dispatcher set of ^...$ commands usually stops after a few chars.
+// Large sets may be screened first by a literal prefilter (see MxRegexSet_prefilter): an aho-corasick automaton
+// finds the required literal of each pattern in one pass over str, and only patterns with their literal in str are run.
+// Patterns and automaton are allocated and grown with the set; working data of each run is allocated too, not on stack.
+
+
+#include <string.h>
+
+#include "mxRegexSet.h"
+#include "mxRegexInt.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+#if MXREGEX_NFA
+
+
+
+// DEFS
+
+#define SET_WORDS ((MAX_NFA_NODE + 31) / 32)    // nfa node bitset size
+#define SET_BATCH 64                            // max patterns run together in lock step
+#define SET_GROW 16                             // patterns allocated by the first MxRegexSet_add(), then doubled
+
+#define SETADD_MATCH 0x01                       // Set_add(): match node reached
+
+#define SETSTART_THREAD 0x01                    // Set_start(): consuming node reached
+#define SETSTART_MATCH 0x02                     // Set_start(): match node reached (empty match)
+
+
+
+
+// set working data (allocated by Set_run)
+
+typedef struct
+{
+    UInt32 node[2][SET_BATCH][SET_WORDS];           // nfa threads of each batch pattern, at current and next str position
+    UInt16 stack[MAX_NFA_NODE];                     // Set_add() stack
+    UInt8 isMatch[SET_BATCH];                       // pattern matches
+    UInt8 isDead[SET_BATCH];                        // pattern can't match any more
+    UInt8 alive[SET_BATCH];                         // patterns still running (not matched or dropped)
+
+} SETWORK;
+
+
+
+
+
+// index of lowest set bit (bits != 0)
+
+static inline UInt16 Set_lowBit(const UInt32 bits)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, bits);
+    return (UInt16)i;
+#else
+    return (UInt16)__builtin_ctzl(bits);
+#endif
+}
+
+
+
+// check if char at str position may start a match of pattern p
+
+static inline UInt8 Set_isFirst(const MXREGEX_SET* setP, const UInt16 p, const PIKEAT* atP)
+{
+    return !atP->isEnd && (setP->first[p][(UInt8)atP->c >> 3] & (1 << ((UInt8)atP->c & 7)));
+}
+
+
+
+// add thread n to nfa node bitset, following empty transitions, at str position atP
+// ret
+//  bitfld SETADD_*
+
+UInt8 Set_add(const REGEXPROG* progP, UInt32* bitsP, UInt16 n, const PIKEAT* atP, UInt16* stackP)
+{
+    const NFANODE* nP;
+    UInt16 sp;
+    UInt8 ret;
+
+    sp = 0;
+    ret = 0;
+
+    while (1)
+    {
+        if (!(bitsP[n >> 5] & (1UL << (n & 31))))               // if not in bitset
+        {
+            bitsP[n >> 5] |= 1UL << (n & 31);
+            nP = &progP->nfa[n];
+
+            switch (nP->op)
+            {
+            case NFAOP_SPLIT:
+                stackP[sp++] = nP->y;
+                n = nP->x;
+                continue;
+
+            case NFAOP_SAVE:                                    // no captures
+                n = nP->x;
+                continue;
+
+            case NFAOP_BEGIN:
+                if (atP->ofs == 0)
+                {
+                    n = nP->x;
+                    continue;
+                }
+                break;
+
+            case NFAOP_END:
+                if (atP->isEnd)
+                {
+                    n = nP->x;
+                    continue;
+                }
+                break;
+
+            case NFAOP_ASSERT:
+                if (Pike_assert((char)nP->arg, atP))
+                {
+                    n = nP->x;
+                    continue;
+                }
+                break;
+
+            case NFAOP_MATCH:
+                ret |= SETADD_MATCH;
+                break;
+
+            default:                                            // consuming node: thread
+                break;
+            }
+        }
+
+        if (sp == 0)
+            return ret;
+
+        n = stackP[--sp];
+    }
+}
+
+
+
+// follow empty transitions from start node, anchors may pass (except ^ after str begin)
+// parm
+//  isAfterBegin    ^ (not multiline) blocks the path
+//  firstP          RET if not 0, bitset of chars consumed by first nodes reached (must be cleared)
+// ret
+//  bitfld SETSTART_*
+
+UInt8 Set_start(const REGEXPROG* progP, const UInt8 isAfterBegin, UInt8* firstP)
+{
+    UInt32 bits[SET_WORDS];
+    UInt16 stack[MAX_NFA_NODE];
+    const NFANODE* nP;
+    UInt16 sp;
+    UInt16 n;
+    UInt16 c;
+    UInt8 ret;
+
+    memset(bits, 0, sizeof(bits));
+    sp = 0;
+    ret = 0;
+    n = progP->nfaStart;
+
+    while (1)
+    {
+        if (!(bits[n >> 5] & (1UL << (n & 31))))
+        {
+            bits[n >> 5] |= 1UL << (n & 31);
+            nP = &progP->nfa[n];
+
+            switch (nP->op)
+            {
+            case NFAOP_SPLIT:
+                stack[sp++] = nP->y;
+                n = nP->x;
+                continue;
+
+            case NFAOP_BEGIN:                                   // path blocked after str begin
+                if (isAfterBegin)
+                    break;
+                n = nP->x;
+                continue;
+
+            case NFAOP_SAVE:
+            case NFAOP_END:                                     // other anchors may pass
+            case NFAOP_ASSERT:
+                n = nP->x;
+                continue;
+
+            case NFAOP_MATCH:
+                ret |= SETSTART_MATCH;
+                break;
+
+            default:                                            // consuming node
+                ret |= SETSTART_THREAD;
+                if (firstP != 0)
+                {
+                    for (c = 0; c < 256; c++)
+                        if (Nfa_accept(progP, nP, (char)c))
+                            firstP[c >> 3] |= 1 << (c & 7);
+                }
+                break;
+            }
+        }
+
+        if (sp == 0)
+            return ret;
+
+        n = stack[--sp];
+    }
+}
+
+
+
+// extract required literal of pattern: longest run of literal chars every match goes through
+// parm
+//  litP        RET literal, uppercase (MAX_SET_LITERAL chars)
+// ret
+//  literal len, 0 if none
+
+UInt8 Set_literal(const REGEXPROG* progP, char* litP)
+{
+    char lit[MAX_SET_LITERAL];
+    UInt16 n;
+    UInt16 t;
+    UInt8 len;
+    UInt8 bestLen;
+
+    bestLen = 0;
+
+    for (n = 0; n < progP->nfaNum; n++)
+    {
+        for (t = n, len = 0; len < MAX_SET_LITERAL; len++)          // chars chained by x (captures may be in between)
+        {
+            if (progP->nfa[t].op == NFAOP_CHAR || progP->nfa[t].op == NFAOP_CHARCI)
+                lit[len] = Upper((char)progP->nfa[t].arg);
+            else
+                break;
+
+            for (t = progP->nfa[t].x; progP->nfa[t].op == NFAOP_SAVE; t = progP->nfa[t].x)
+                ;
+        }
+
+        if (len > bestLen && Nfa_isRequired(progP, n))
+        {
+            memcpy(litP, lit, len);
+            bestLen = len;
+        }
+    }
+
+    return bestLen;
+}
+
+
+
+// prefilter automaton transition from node s on char c (uppercase)
+// ret
+//  next node, 0 if s has no child on c
+
+static inline UInt32 Set_acChild(const MXREGEX_SET* setP, const UInt32 s, const UInt8 c)
+{
+    const SETACNODE* nP;
+    UInt32 t;
+
+    if (s == 0)
+        return setP->acRoot[c];
+
+    nP = &setP->acNode[s];
+    for (t = nP->child; t < nP->child + nP->childNum; t++)      // children sorted by char
+    {
+        if (setP->acNode[t].c >= c)
+            return (setP->acNode[t].c == c) ? t : 0;
+    }
+
+    return 0;
+}
+
+
+
+// prefilter: find required literals of set patterns in str, with the aho-corasick automaton
+// parm
+//  isCandP     RET for each pattern, 1: literal found in str (progNum elements)
+
+void Set_prefilter(const MXREGEX_SET* setP, const char* strP, const size_t strLen, UInt8* isCandP)
+{
+    const SETACNODE* nP;
+    size_t i;
+    UInt32 s;
+    UInt32 t;
+    UInt32 o;
+    UInt16 p;
+    UInt8 c;
+
+    memset(isCandP, 0, setP->progNum);
+    s = 0;
+
+    for (i = 0; i < strLen; i++)
+    {
+        c = (UInt8)strP[i];
+        if (C_CASE_FOLD[c] < c)                                 // uppercase, like Upper()
+            c = C_CASE_FOLD[c];
+
+        if (s == 0)                                             // root: dense table
+            s = setP->acRoot[c];
+        else
+        {
+            while ((t = Set_acChild(setP, s, c)) == 0 && s != 0)    // follow failure links
+                s = setP->acNode[s].fail;
+            s = t;
+        }
+
+        if (s == 0)
+            continue;
+
+        nP = &setP->acNode[s];
+        for (o = (nP->id != SET_NO_MATCH) ? s : nP->outLink; o != 0; o = setP->acNode[o].outLink)   // literals ending here
+        {
+            for (p = setP->acNode[o].id; p != SET_NO_MATCH; p = setP->litNext[p])
+                isCandP[p] = 1;
+        }
+    }
+
+    return;
+}
+
+
+
+// compare required literals of patterns a and b (prefilter build)
+
+int Set_literalCmp(const MXREGEX_SET* setP, const UInt16 a, const UInt16 b)
+{
+    UInt8 t;
+
+    for (t = 0; t < setP->literalLen[a] && t < setP->literalLen[b]; t++)
+    {
+        if (setP->literal[a][t] != setP->literal[b][t])
+            return ((UInt8)setP->literal[a][t] < (UInt8)setP->literal[b][t]) ? -1 : 1;
+    }
+
+    return (int)setP->literalLen[a] - (int)setP->literalLen[b];
+}
+
+
+
+// run a batch of set patterns on str
+// parm
+//  idP         pattern IDs, ascending
+//  idNum       nr of IDs (max SET_BATCH)
+//  isFirst     stop as soon as the lowest matching ID is known
+//  retIdP      RET matching IDs, ascending (may be 0)
+//  wP          working data
+// ret
+//  nr of matching patterns (isFirst: 1, or 0 if no match)
+
+UInt16 Set_exec(const MXREGEX_SET* setP, const UInt16* idP, const UInt16 idNum, const char* strP, const size_t strLen, const UInt8 isFirst, UInt16* retIdP, SETWORK* wP)
+{
+    const REGEXPROG* progP;
+    const NFANODE* nodeP;
+    UInt32* bitsP;
+    UInt32* nextBitsP;
+    PIKEAT at[2];
+    UInt32 ofs;
+    UInt32 bits;
+    UInt16 matchNum;
+    UInt16 aliveNum;
+    UInt16 wordNum;
+    UInt16 i;
+    UInt16 s;
+    UInt16 p;
+    UInt16 t;
+    UInt16 n;
+    UInt8 cur;
+    UInt8 ret;
+
+    memset(wP->isMatch, 0, idNum);
+    memset(wP->isDead, 0, idNum);
+
+    matchNum = 0;
+    aliveNum = 0;
+    Pike_at(&at[0], strP, 0, (UInt32)strLen);
+
+    for (s = 0; s < idNum; s++)                                 // str begin: anchored patterns not starting with 1st char are dropped
+    {
+        p = idP[s];
+        if (setP->isAnchored[p] && !setP->isNullable[p] && !Set_isFirst(setP, p, &at[0]))
+            wP->isDead[s] = 1;
+        else
+        {
+            for (t = 0; t < (setP->prog[p].nfaNum + 31) / 32; t++)
+                wP->node[0][s][t] = 0;
+            wP->alive[aliveNum++] = (UInt8)s;
+        }
+    }
+
+    for (ofs = 0; aliveNum != 0; ofs++)
+    {
+        cur = (UInt8)(ofs & 1);
+        if (!at[cur].isEnd)
+            Pike_at(&at[cur ^ 1], strP, ofs + 1, (UInt32)strLen);
+
+        for (i = 0, n = aliveNum, aliveNum = 0; i < n; i++)      // alive patterns, list compacted while running
+        {
+            s = wP->alive[i];
+            p = idP[s];
+            progP = &setP->prog[p];
+            bitsP = wP->node[cur][s];
+            nextBitsP = wP->node[cur ^ 1][s];
+            wordNum = (UInt16)((progP->nfaNum + 31) / 32);
+
+            ret = 0;
+            if ((ofs == 0 || !setP->isAnchored[p])              // new thread at this position, if char may start a match
+                && (setP->isNullable[p] || Set_isFirst(setP, p, &at[cur])))
+                ret = Set_add(progP, bitsP, progP->nfaStart, &at[cur], wP->stack);
+
+            for (t = 0; t < wordNum; t++)
+                nextBitsP[t] = 0;
+
+            if (!(ret & SETADD_MATCH) && !at[cur].isEnd)        // step threads on char
+            {
+                for (t = 0; t < wordNum && !(ret & SETADD_MATCH); t++)
+                {
+                    for (bits = bitsP[t]; bits != 0; bits &= bits - 1)
+                    {
+                        nodeP = &progP->nfa[t * 32 + Set_lowBit(bits)];
+                        if (nodeP->op > NFAOP_SET || !Nfa_accept(progP, nodeP, at[cur].c))
+                            continue;
+
+                        if ((ret = Set_add(progP, nextBitsP, nodeP->x, &at[cur ^ 1], wP->stack)) & SETADD_MATCH)
+                            break;
+                    }
+                }
+            }
+
+            if (ret & SETADD_MATCH)                             // MATCH
+            {
+                wP->isMatch[s] = 1;
+                matchNum++;
+                continue;
+            }
+
+            if (setP->isAnchored[p])                            // no threads, can't restart: pattern dropped
+            {
+                for (t = 0; t < wordNum; t++)
+                    if (nextBitsP[t] != 0)
+                        break;
+
+                if (t == wordNum)
+                {
+                    wP->isDead[s] = 1;
+                    continue;
+                }
+            }
+
+            wP->alive[aliveNum++] = (UInt8)s;
+        }
+
+        if (isFirst)                                            // lowest ID matching, if lower ones are dropped
+        {
+            for (s = 0; s < idNum; s++)
+            {
+                if (wP->isMatch[s])
+                {
+                    if (retIdP != 0)
+                        *retIdP = idP[s];
+                    return 1;
+                }
+                if (!wP->isDead[s])
+                    break;
+            }
+        }
+
+        if (at[cur].isEnd)                                      // end of str
+            break;
+    }
+
+    if (isFirst)                                                // end of str: lowest ID matching
+    {
+        for (s = 0; s < idNum; s++)
+        {
+            if (wP->isMatch[s])
+            {
+                if (retIdP != 0)
+                    *retIdP = idP[s];
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    if (retIdP != 0)
+    {
+        for (s = 0, t = 0; s < idNum; s++)
+            if (wP->isMatch[s])
+                retIdP[t++] = idP[s];
+    }
+
+    return matchNum;
+}
+
+
+
+// run set on str: patterns passing the literal prefilter (all, if no prefilter), in batches
+// parm
+//  isFirst     stop as soon as the lowest matching ID is known
+//  retIdP      RET matching IDs, ascending (may be 0)
+// ret
+//  nr of matching patterns (isFirst: 1, or 0 if no match)
+
+UInt16 Set_run(const MXREGEX_SET* setP, const char* strP, const size_t strLen, const UInt8 isFirst, UInt16* retIdP)
+{
+    SETWORK* wP;
+    UInt8* isCandP;
+    UInt16 id[SET_BATCH];
+    UInt16 idNum;
+    UInt16 matchNum;
+    UInt16 p;
+
+    if (setP->progNum == 0)
+        return 0;
+
+    wP = new SETWORK;
+    isCandP = 0;
+
+    if (setP->acNodeNum != 0)                                   // literals found in str
+    {
+        isCandP = new UInt8[setP->progNum];
+        Set_prefilter(setP, strP, strLen, isCandP);
+    }
+
+    matchNum = 0;
+    idNum = 0;
+
+    for (p = 0; p < setP->progNum; p++)
+    {
+        if (isCandP != 0 && setP->literalLen[p] != 0 && !isCandP[p])
+            continue;                                           // required literal not in str
+
+        id[idNum++] = p;
+
+        if (idNum == SET_BATCH)                                 // batch full
+        {
+            if (isFirst)
+            {
+                if (Set_exec(setP, id, idNum, strP, strLen, 1, retIdP, wP) != 0)
+                {
+                    matchNum = 1;
+                    idNum = 0;
+                    break;
+                }
+            }
+            else
+                matchNum += Set_exec(setP, id, idNum, strP, strLen, 0, (retIdP != 0) ? retIdP + matchNum : 0, wP);
+
+            idNum = 0;
+        }
+    }
+
+    if (idNum != 0)                                             // last batch
+    {
+        if (isFirst)
+            matchNum = Set_exec(setP, id, idNum, strP, strLen, 1, retIdP, wP);
+        else
+            matchNum += Set_exec(setP, id, idNum, strP, strLen, 0, (retIdP != 0) ? retIdP + matchNum : 0, wP);
+    }
+
+    delete[] isCandP;
+    delete wP;
+
+    return matchNum;
+}
+
+
+
+// grow pattern arrays of regex set (doubled), compiled patterns are moved
+// Native code of a pattern (REGEXMODE_JIT) is released first: it belongs to the moved compiled regex, promoted again on JIT_HOT execution
+
+void Set_grow(MXREGEX_SET* setP)
+{
+    REGEXPROG* progP;
+    UInt8* isAnchoredP;
+    UInt8* isNullableP;
+    UInt8 (*firstP)[32];
+    char (*literalP)[MAX_SET_LITERAL];
+    UInt8* literalLenP;
+    UInt16* litNextP;
+    UInt32 progMax;
+    UInt16 p;
+
+    progMax = (setP->progMax == 0) ? SET_GROW : (UInt32)setP->progMax * 2;
+    if (progMax > MAX_SET_PATTERN)
+        progMax = MAX_SET_PATTERN;
+
+    progP = new REGEXPROG[progMax];
+    isAnchoredP = new UInt8[progMax];
+    isNullableP = new UInt8[progMax];
+    firstP = new UInt8[progMax][32];
+    literalP = new char[progMax][MAX_SET_LITERAL];
+    literalLenP = new UInt8[progMax];
+    litNextP = new UInt16[progMax];
+
+    for (p = 0; p < setP->progNum; p++)
+    {
+#if MXREGEX_JIT
+        MxRegex_jitFree(&setP->prog[p]);
+#endif
+        memcpy(&progP[p], &setP->prog[p], sizeof(REGEXPROG));
+    }
+
+    if (setP->progNum != 0)
+    {
+        memcpy(isAnchoredP, setP->isAnchored, setP->progNum);
+        memcpy(isNullableP, setP->isNullable, setP->progNum);
+        memcpy(firstP, setP->first, setP->progNum * sizeof(firstP[0]));
+        memcpy(literalP, setP->literal, setP->progNum * sizeof(literalP[0]));
+        memcpy(literalLenP, setP->literalLen, setP->progNum);
+        memcpy(litNextP, setP->litNext, setP->progNum * sizeof(litNextP[0]));
+    }
+
+    delete[] setP->prog;
+    delete[] setP->isAnchored;
+    delete[] setP->isNullable;
+    delete[] setP->first;
+    delete[] setP->literal;
+    delete[] setP->literalLen;
+    delete[] setP->litNext;
+
+    setP->prog = progP;
+    setP->isAnchored = isAnchoredP;
+    setP->isNullable = isNullableP;
+    setP->first = firstP;
+    setP->literal = literalP;
+    setP->literalLen = literalLenP;
+    setP->litNext = litNextP;
+    setP->progMax = (UInt16)progMax;
+
+    return;
+}
+
+
+
+
+
+
+
+//
+// PUBLIC METHODS
+//
+
+
+// init empty regex set (nothing allocated yet)
+
+void MxRegexSet_init(MXREGEX_SET* setP)
+{
+    memset(setP, 0, sizeof(MXREGEX_SET));
+    return;
+}
+
+
+
+// release patterns and prefilter of regex set, then it's empty as after MxRegexSet_init()
+// parm
+//  setP        regex set, no thread may be running it
+
+void MxRegexSet_free(MXREGEX_SET* setP)
+{
+#if MXREGEX_JIT
+    UInt16 p;
+
+    for (p = 0; p < setP->progNum; p++)
+        MxRegex_jitFree(&setP->prog[p]);
+#endif
+
+    delete[] setP->prog;
+    delete[] setP->isAnchored;
+    delete[] setP->isNullable;
+    delete[] setP->first;
+    delete[] setP->literal;
+    delete[] setP->literalLen;
+    delete[] setP->litNext;
+    delete[] setP->acNode;
+
+    MxRegexSet_init(setP);
+    return;
+}
+
+
+
+// compile and add pattern to regex set. Pattern ID is the nr of patterns added before it
+// Pattern arrays are grown as needed: compiled patterns may move, don't keep ptrs to setP->prog[] across MxRegexSet_add()
+// parm
+//  setP        regex set
+//  regexP      ptr to regex pattern string (\0 terminated)
+//  mode        bitfld REGEX_MODE of this pattern
+// ret
+//  REGEXSTS_OK: ok, else compile error (pattern not added, see setP->prog[setP->progNum].retRegexErrOfs)
+//  REGEXSTS_PROG_OVF: too many patterns, or pattern too large for nfa (MAX_NFA_NODE)
+
+REGEX_STS MxRegexSet_add(MXREGEX_SET* setP, const char* regexP, const UInt16 mode)
+{
+    REGEXPROG* progP;
+    REGEX_STS sts;
+
+    if (setP->progNum >= MAX_SET_PATTERN)
+        return REGEXSTS_PROG_OVF;
+
+    if (setP->progNum == setP->progMax)
+        Set_grow(setP);
+
+    progP = &setP->prog[setP->progNum];
+
+    if ((sts = MxRegex_compile(regexP, mode, progP)) != REGEXSTS_OK)
+        return sts;
+
+    if (progP->nfaNum == 0)                                     // nfa not available
+        return REGEXSTS_PROG_OVF;
+
+    setP->isAnchored[setP->progNum] = (Set_start(progP, 1, 0) == 0) ? 1 : 0;     // nothing reachable after str begin
+    memset(setP->first[setP->progNum], 0, sizeof(setP->first[0]));
+    setP->isNullable[setP->progNum] = (Set_start(progP, 0, setP->first[setP->progNum]) & SETSTART_MATCH) ? 1 : 0;
+    setP->literalLen[setP->progNum] = Set_literal(progP, setP->literal[setP->progNum]);
+    setP->progNum++;
+    setP->acNodeNum = 0;                                        // prefilter to be built again
+
+    return REGEXSTS_OK;
+}
+
+
+
+// build literal prefilter of regex set, after all MxRegexSet_add(): an aho-corasick automaton of the required literal of each pattern
+// (e.g. " HTTP/1." in "GET \S+ HTTP/1\.[01]"). MxRegexSet_exec() and MxRegexSet_first() then run only patterns whose literal is in str,
+// and patterns without a required literal. Adding a pattern drops the prefilter.
+// parm
+//  setP        regex set
+// ret
+//  nr of patterns with a required literal
+
+UInt16 MxRegexSet_prefilter(MXREGEX_SET* setP)
+{
+    UInt16* orderP;
+    SETACNODE* uP;
+    SETACNODE* vP;
+    UInt32 nodeMax;
+    UInt32 u;
+    UInt32 v;
+    UInt32 f;
+    UInt16 orderNum;
+    UInt16 i;
+    UInt16 j;
+    UInt8 c;
+
+    orderP = new UInt16[setP->progNum + 1];
+    nodeMax = 1;
+
+    for (i = 0, orderNum = 0; i < setP->progNum; i++)           // patterns with literal, sorted by literal
+    {
+        if (setP->literalLen[i] == 0)
+            continue;
+
+        nodeMax += setP->literalLen[i];                         // a node for each literal char at most
+
+        for (j = orderNum; j > 0 && Set_literalCmp(setP, orderP[j - 1], i) > 0; j--)
+            orderP[j] = orderP[j - 1];
+        orderP[j] = i;
+        orderNum++;
+    }
+
+    delete[] setP->acNode;
+    setP->acNode = new SETACNODE[nodeMax];
+    memset(setP->acRoot, 0, sizeof(setP->acRoot));
+    uP = &setP->acNode[0];                                      // root: all literals
+    memset(uP, 0, sizeof(SETACNODE));
+    uP->id = SET_NO_MATCH;
+    uP->hi = orderNum;
+    setP->acNodeNum = 1;
+
+    for (u = 0; u < setP->acNodeNum; u++)                       // nodes are built breadth first: children of a node are consecutive
+    {
+        uP = &setP->acNode[u];
+
+        for (i = uP->lo; i < uP->hi && setP->literalLen[orderP[i]] == uP->depth; i++)
+        {
+            setP->litNext[orderP[i]] = uP->id;                  // literals ending here
+            uP->id = orderP[i];
+        }
+
+        uP->child = setP->acNodeNum;
+
+        for (; i < uP->hi; i = j)                               // a child for each next char (sorted)
+        {
+            c = (UInt8)setP->literal[orderP[i]][uP->depth];
+            for (j = i + 1; j < uP->hi && (UInt8)setP->literal[orderP[j]][uP->depth] == c; j++)
+                ;
+
+            v = setP->acNodeNum++;
+            vP = &setP->acNode[v];
+            memset(vP, 0, sizeof(SETACNODE));
+            vP->c = c;
+            vP->depth = uP->depth + 1;
+            vP->lo = i;
+            vP->hi = j;
+            vP->id = SET_NO_MATCH;
+            uP->childNum++;
+
+            if (u == 0)
+                setP->acRoot[c] = v;
+            else                                                // failure link: longest proper suffix in automaton
+            {
+                for (f = uP->fail; Set_acChild(setP, f, c) == 0 && f != 0; f = setP->acNode[f].fail)
+                    ;
+                vP->fail = Set_acChild(setP, f, c);
+            }
+        }
+    }
+
+    for (u = 1; u < setP->acNodeNum; u++)                       // output links (fail node is always before)
+    {
+        uP = &setP->acNode[u];
+        uP->outLink = (setP->acNode[uP->fail].id != SET_NO_MATCH) ? uP->fail : setP->acNode[uP->fail].outLink;
+    }
+
+    if (orderNum == 0)                                          // no literals: no prefilter
+        setP->acNodeNum = 0;
+
+    delete[] orderP;
+
+    return orderNum;
+}
+
+
+
+// Regex set: all patterns matching str, in one pass
+// Read only on set: threads may share the same set. Working data is allocated for each call (about 5K, and 1 byte each pattern with prefilter)
+//
+// parm
+//  setP        regex set, see MxRegexSet_add()
+//  strP        ptr to input string (\0 is a normal char)
+//  strLen      input string len
+//  retIdP      RET matching pattern IDs, ascending (setP->progNum elements, may be 0)
+// ret
+//  nr of matching patterns
+// NOTE to get captures, run MxRegex_exec() on setP->prog[id]
+
+UInt16 MxRegexSet_exec(const MXREGEX_SET* setP, const char* strP, const size_t strLen, UInt16* retIdP)
+{
+    return Set_run(setP, strP, strLen, 0, retIdP);
+}
+
+
+
+// Regex set: lowest ID of patterns matching str
+// Stops as soon as the lowest ID is known (e.g. when all lower ID anchored patterns failed)
+//
+// parm
+//  setP        regex set, see MxRegexSet_add()
+//  strP        ptr to input string (\0 is a normal char)
+//  strLen      input string len
+// ret
+//  pattern ID, SET_NO_MATCH if no pattern matches
+
+UInt16 MxRegexSet_first(const MXREGEX_SET* setP, const char* strP, const size_t strLen)
+{
+    UInt16 id;
+
+    if (Set_run(setP, strP, strLen, 1, &id) == 0)
+        return SET_NO_MATCH;
+
+    return id;
+}
+
+
+
+#endif // #if MXREGEX_NFA
@@ -0,0 +1,112 @@
+/*
+
+This file is part of "MxRegex" library
+(C) 2022 Massimo Celeghin
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+
+
+#pragma once
+
+#ifndef MXREGEXSET_H
+#define MXREGEXSET_H
+
+
+#include "mxRegex.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+    // DEFS
+
+#define MAX_SET_PATTERN 0xfffe                  // max patterns in a regex set (allocated, about 6.6K each on x86-64: compiled regex with its nfa)
+#define MAX_SET_LITERAL 16                      // max len of the required literal of a pattern (prefilter)
+#define SET_NO_MATCH 0xffff                     // MxRegexSet_first(): no pattern matches
+
+
+
+
+    // prefilter automaton node (aho-corasick), built by MxRegexSet_prefilter()
+
+    typedef struct
+    {
+        UInt32 child;                               // 1st child node, children are consecutive and sorted by char
+        UInt32 fail;                                // failure link: node of the longest proper suffix
+        UInt32 outLink;                             // next node on failure chain where a literal ends, 0 none
+        UInt16 childNum;                            // nr of children
+        UInt16 id;                                  // pattern with literal ending here (others on litNext[]), SET_NO_MATCH none
+        UInt16 lo;                                  // sorted literals with this prefix (build only)
+        UInt16 hi;
+        UInt8 c;                                    // char from parent node (uppercase)
+        UInt8 depth;                                // prefix len
+
+    } SETACNODE;
+
+
+
+
+    // regex set: patterns matched together in one pass over the input, see MxRegexSet_add()
+    // pattern ID is the order of MxRegexSet_add(); pattern arrays are allocated, grown by MxRegexSet_add(), released by MxRegexSet_free()
+
+    typedef struct
+    {
+        REGEXPROG* prog;                            // compiled patterns, each one with its own mode
+        UInt8* isAnchored;                          // pattern may only match at str begin (^ not multiline)
+        UInt8* isNullable;                          // pattern may match empty str
+        UInt8 (*first)[32];                         // bitset of chars a match may start with
+        char (*literal)[MAX_SET_LITERAL];           // literal every match contains (uppercase)
+        UInt8* literalLen;                          // 0 no required literal, pattern always run
+        UInt16* litNext;                            // next pattern with the same literal, SET_NO_MATCH none
+        UInt16 progNum;                             // nr of patterns
+        UInt16 progMax;                             // nr of patterns allocated
+
+        SETACNODE* acNode;                          // prefilter automaton, [0] root (allocated by MxRegexSet_prefilter())
+        UInt32 acRoot[256];                         // root transitions, dense (0 stay at root)
+        UInt32 acNodeNum;                           // nr of nodes, 0 no prefilter
+
+    } MXREGEX_SET;
+
+
+
+
+    // PUBLIC METHODS (require MXREGEX_NFA)
+
+#if MXREGEX_NFA
+    extern void MxRegexSet_init(MXREGEX_SET* setP);
+    extern void MxRegexSet_free(MXREGEX_SET* setP);
+    extern REGEX_STS MxRegexSet_add(MXREGEX_SET* setP, const char* regexP, const UInt16 mode);
+    extern UInt16 MxRegexSet_prefilter(MXREGEX_SET* setP);
+    extern UInt16 MxRegexSet_exec(const MXREGEX_SET* setP, const char* strP, const size_t strLen, UInt16* retIdP);
+    extern UInt16 MxRegexSet_first(const MXREGEX_SET* setP, const char* strP, const size_t strLen);
+#endif
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif // #ifndef MXREGEXSET_H
@@ -0,0 +1,177 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// MxRegex_arenaSize() / MxRegex_exec_arena() test
+// Match and captures on an arena of MxRegex_arenaSize() (unaligned too) must be the ones of MxRegex_exec_len_ex();
+// an arena too small fails with REGEXSTS_ARENA_OVF, before any write past it.
+//
+// usage: arenaTest (ret 0 if all passed)
+
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../mxRegex.h"
+
+
+
+typedef struct
+{
+    const char* regexP;
+    const char* strP;
+    UInt16 mode;
+
+} TEST_CASE;
+
+
+
+static const TEST_CASE C_CASE[] =
+{
+    { "^ip\\s*(\\d+(?:\\.\\d+){3})$", "ip 1.12.123.123", REGEXMODE_CASE_INSENSITIVE },
+    { "^SPK\\s*((?:\\s*[+-][VAP])+)$", "spk -v+a-p", REGEXMODE_CASE_INSENSITIVE | REGEXMODE_MULTILINE },
+    { "^123$|^456", "asd\n123\raaa", REGEXMODE_MULTILINE },
+    { "(a.*z|b.*y)*.*", "azbazbyc", 0 },
+    { "a(b)|c(d)|a(e)f", "aef", 0 },
+    { "(a|b)*c|(a|ab)*c", "xc", 0 },
+    { "(...|aa)*a", "aa", 0 },
+    { "(a*)(a|aa)", "aaaa", 0 },
+    { "(a*)(b{0,1})(b{1,})b{3}", "aaabbbbbbb", 0 },
+    { "^(([^!]+!)?([^!]+)|.+!([^!]+!)([^!]+))$", "foo!bar!bas", 0 },
+    { "(.?)*", "x", 0 },
+    { "(aba|ab|a)(aba|ab|a)(aba|ab|a)", "ababa", 0 },
+    { "(wee|week)(knights|night)(s*)", "weeknights", 0 },
+    { "^\\s*(GET|POST)\\s+(\\S+)\\s+HTTP/(\\d)\\.(\\d)", " GET /index.html HTTP/1.0\r\n\r\n", 0 },
+    { "(\\d+,)*x", "1,22,333,4444,x", 0 },
+    { "[.]", "a", 0 },
+    { "abc", "xabcx", 0 },
+};
+
+static MXREGEX_M m;                                 // zero initialized
+static REGEXPROG prog;
+static UInt32 errNum;
+
+
+
+
+// match and captures of last regex call, offsets from strP
+// ret
+//  capsNum
+
+static UInt8 Test_caps(const char* strP, const UInt8 capsNum, REGEXSPAN* capsP)
+{
+    char* capP;
+    REGEXOFS capLen;
+    UInt8 n;
+    UInt8 t;
+
+    for (t = n = 0; t < capsNum; t++)
+    {
+        if (!MxRegex_getCapsOfs_ex(&m, t, &capP, &capLen))
+            continue;
+
+        capsP[n].ofs = (size_t)(capP - strP);
+        capsP[n].len = capLen;
+        n++;
+    }
+
+    return n;
+}
+
+
+
+
+int main()
+{
+    REGEXSPAN exp[MAX_CAPS];
+    REGEXSPAN got[MAX_CAPS];
+    std::vector<unsigned char> arenaV;
+    const TEST_CASE* cP;
+    size_t len;
+    size_t size;
+    size_t align;
+    UInt32 checkNum;
+    UInt8 expNum;
+    UInt8 gotNum;
+    UInt8 t;
+
+    MxRegex_init();
+    errNum = checkNum = 0;
+
+    for (cP = C_CASE; cP < C_CASE + sizeof(C_CASE) / sizeof(C_CASE[0]); cP++)
+    {
+        if (MxRegex_compile(cP->regexP, cP->mode, &prog) != REGEXSTS_OK)
+        {
+            errNum++;
+            printf("FAIL /%s/ compile error %u\n", cP->regexP, prog.retSts);
+            continue;
+        }
+
+        len = strlen(cP->strP);
+        expNum = Test_caps(cP->strP, MxRegex_exec_len_ex(&m, &prog, cP->strP, len), exp);
+
+        size = MxRegex_arenaSize(&prog, 0);
+
+        for (align = 0; align < sizeof(void*); align++)             // unaligned arena
+        {
+            arenaV.assign(size + align + 16, 0xa5);
+            gotNum = Test_caps(cP->strP, MxRegex_exec_arena(&m, &prog, cP->strP, len, arenaV.data() + align, size), got);
+
+            for (t = 0; t < expNum && gotNum == expNum; t++)
+            {
+                if (got[t].ofs != exp[t].ofs || got[t].len != exp[t].len)
+                    break;
+            }
+
+            if (gotNum != expNum || t != expNum)
+            {
+                errNum++;
+                printf("FAIL /%s/ on \"%s\" arena %zu at +%zu: %u caps, expected %u\n", cP->regexP, cP->strP, size, align, gotNum, expNum);
+            }
+
+            for (t = 0; t < 16; t++)                                    // nothing written past arena
+            {
+                if (arenaV[align + size + t] != 0xa5)
+                {
+                    errNum++;
+                    printf("FAIL /%s/ arena %zu at +%zu: written past arena\n", cP->regexP, size, align);
+                    break;
+                }
+            }
+            checkNum++;
+        }
+
+        // too small: no captures room
+
+        arenaV.assign(size, 0xa5);
+        if (MxRegex_exec_arena(&m, &prog, cP->strP, len, arenaV.data(), sizeof(void*) - 1) != 0 || m.retSts != REGEXSTS_ARENA_OVF)
+        {
+            errNum++;
+            printf("FAIL /%s/ arena %zu: sts %u, REGEXSTS_ARENA_OVF expected\n", cP->regexP, sizeof(void*) - 1, m.retSts);
+        }
+        checkNum++;
+    }
+
+    printf("arenaTest: %u checks, %u failed\n", checkNum, errNum);
+
+    MxRegex_release_ex(&m);
+    return errNum != 0;
+}
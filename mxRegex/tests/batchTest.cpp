@@ -0,0 +1,172 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// MxRegex_batch() test
+// Results of each record (match, captures, status), on 1..n threads and record counts around BATCH_GRAIN,
+// must be the ones of MxRegex_exec_ex() on each record in turn.
+//
+// usage: batchTest (ret 0 if all passed)
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../mxRegexBatch.h"
+
+
+
+typedef struct
+{
+    const char* regexP;
+    UInt16 mode;
+
+} TEST_CASE;
+
+
+
+static const TEST_CASE C_CASE[] =
+{
+    { "^\\s*(GET|POST)\\s+(\\S+)\\s+HTTP/(\\d)\\.(\\d)", 0 },
+    { "(\\d+)\\.(\\d+)\\.(\\d+)\\.(\\d+)", 0 },
+    { "error", REGEXMODE_CASE_INSENSITIVE },
+    { "(a|b)*c", REGEXMODE_LINEAR },
+    { "x*", 0 },
+};
+
+static MXREGEX_M m;                                 // zero initialized
+static REGEXPROG prog;
+
+
+
+
+// random access log record, some without request line
+
+static std::string Test_record()
+{
+    static const char* const C_PATH[] = { "/", "/index.html", "/img/logo.png", "/api/v1/items?id=42" };
+    std::string rec;
+
+    rec = std::to_string(rand() % 256) + "." + std::to_string(rand() % 256) + "." + std::to_string(rand() % 256);
+    if (rand() % 4)
+        rec += "." + std::to_string(rand() % 256);
+    rec += (rand() % 3) ? " - - \"" : " abab c \"";
+    if (rand() % 5)
+        rec += (rand() % 2) ? "GET " : "POST ";
+    rec += C_PATH[rand() % 4];
+    rec += (rand() % 6) ? " HTTP/1.1\" 200" : " HTTP/x\" ERROR 500";
+
+    return rec;
+}
+
+
+
+
+int main()
+{
+    static const UInt16 C_THREAD[] = { 1, 3, 8, 0 };
+    static const UInt32 C_RECORD[] = { 0, 1, BATCH_GRAIN - 1, BATCH_GRAIN + 1, 5000 };
+    std::vector<std::string> recV;
+    std::vector<const char*> recPV;
+    std::vector<BATCH_RESULT> expV;
+    std::vector<BATCH_RESULT> resV;
+    const TEST_CASE* cP;
+    char* capP;
+    REGEXOFS capLen;
+    UInt32 errNum;
+    UInt32 expMatchNum;
+    UInt32 matchNum;
+    UInt32 r;
+    UInt16 t;
+    UInt16 k;
+    UInt8 c;
+
+    MxRegex_init();
+    errNum = 0;
+
+    srand(1);
+    for (r = 0; r < C_RECORD[sizeof(C_RECORD) / sizeof(C_RECORD[0]) - 1]; r++)
+        recV.push_back(Test_record());
+    for (r = 0; r < recV.size(); r++)
+        recPV.push_back(recV[r].c_str());
+
+    for (cP = C_CASE; cP < C_CASE + sizeof(C_CASE) / sizeof(C_CASE[0]); cP++)
+    {
+        if (MxRegex_compile(cP->regexP, cP->mode, &prog) != REGEXSTS_OK)
+        {
+            errNum++;
+            printf("FAIL /%s/ compile error %u\n", cP->regexP, prog.retSts);
+            continue;
+        }
+
+        expV.assign(recV.size(), BATCH_RESULT());
+        for (r = 0; r < recV.size(); r++)                                       // sequential
+        {
+            expV[r].capsNum = MxRegex_exec_ex(&m, &prog, recPV[r]);
+            expV[r].retSts = m.retSts;
+            for (c = 0; c < expV[r].capsNum; c++)
+            {
+                MxRegex_getCapsOfs_ex(&m, c, &capP, &capLen);
+                expV[r].caps[c].ofs = (REGEXOFS)(capP - recPV[r]);
+                expV[r].caps[c].len = capLen;
+            }
+        }
+
+        for (k = 0; k < sizeof(C_RECORD) / sizeof(C_RECORD[0]); k++)
+        {
+            for (expMatchNum = r = 0; r < C_RECORD[k]; r++)
+                expMatchNum += (expV[r].capsNum != 0);
+
+            for (t = 0; t < sizeof(C_THREAD) / sizeof(C_THREAD[0]); t++)
+            {
+                resV.assign(C_RECORD[k] + 1, BATCH_RESULT());
+                resV[C_RECORD[k]].capsNum = 0xee;                               // guard: not written
+                matchNum = MxRegex_batch(&prog, recPV.data(), C_RECORD[k], resV.data(), C_THREAD[t]);
+
+                for (r = 0; r < C_RECORD[k]; r++)
+                {
+                    if (resV[r].capsNum != expV[r].capsNum || resV[r].retSts != expV[r].retSts)
+                        break;
+                    for (c = 0; c < expV[r].capsNum; c++)
+                    {
+                        if (resV[r].caps[c].ofs != expV[r].caps[c].ofs || resV[r].caps[c].len != expV[r].caps[c].len)
+                            break;
+                    }
+                    if (c != expV[r].capsNum)
+                        break;
+                }
+
+                if (matchNum != expMatchNum || r != C_RECORD[k] || resV[C_RECORD[k]].capsNum != 0xee)
+                {
+                    errNum++;
+                    printf("FAIL /%s/ %u records, %u threads: %u matches, expected %u, record %u\n", cP->regexP, C_RECORD[k], C_THREAD[t], matchNum, expMatchNum, r);
+                }
+            }
+        }
+    }
+
+    printf("batchTest: %zu records, %u failed\n", recV.size(), errNum);
+
+    MxRegex_release_ex(&m);
+    return errNum != 0;
+}
@@ -0,0 +1,230 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// Compiled regex cache test (MXREGEX_CACHE)
+// Hit, miss and evict counters of MxRegexCache_getStats() on a hot set and on more regex than CACHE_MAX_ENTRY;
+// results of MxRegex() after eviction, and of threads sharing (pinning) and evicting the same entries,
+// must be the ones of the regex compiled alone.
+//
+// usage: cacheTest (ret 0 if all passed)
+
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../mxRegexCache.h"
+
+
+
+#define TEST_REGEX_NUM (CACHE_MAX_ENTRY * 4)        // distinct regex, more than the cache holds
+#define TEST_THREAD_NUM 8
+#define TEST_THREAD_RUN 20000
+
+typedef struct
+{
+    std::string regex;
+    std::string str;
+    UInt8 capsNum;                                  // expected result
+    size_t capOfs;                                  // expected capture 1
+    size_t capLen;
+
+} TEST_CASE;
+
+
+
+static std::vector<TEST_CASE> caseV;
+static std::atomic<UInt32> errNum;
+
+
+
+
+// regex key<n>=(\d+), str with a match (or not) and its result by a regex compiled alone
+
+static void Test_cases()
+{
+    static MXREGEX_M m;                             // zero initialized
+    static REGEXPROG prog;
+    TEST_CASE c;
+    char* capP;
+    REGEXOFS capLen;
+    UInt32 t;
+
+    for (t = 0; t < TEST_REGEX_NUM; t++)
+    {
+        c.regex = "key" + std::to_string(t) + "=(\\d+)";
+        c.str = "a key" + std::to_string(t + (t % 5 == 0)) + "=" + std::to_string(t * 7) + " b";
+
+        MxRegex_compile(c.regex.c_str(), 0, &prog);
+        c.capsNum = MxRegex_exec_len_ex(&m, &prog, c.str.data(), c.str.size());
+        c.capOfs = c.capLen = 0;
+        if (MxRegex_getCapsOfs_ex(&m, 1, &capP, &capLen))
+        {
+            c.capOfs = (size_t)(capP - c.str.data());
+            c.capLen = capLen;
+        }
+
+        caseV.push_back(c);
+    }
+
+    MxRegex_release_ex(&m);
+}
+
+
+
+// MxRegex() on case t, default regex data of calling thread
+// ret
+//  1 expected result
+
+static UInt8 Test_run(const UInt32 t)
+{
+    const TEST_CASE* cP = &caseV[t];
+    char* capP;
+    REGEXOFS capLen;
+
+    if (MxRegex_len(cP->regex.c_str(), cP->str.data(), cP->str.size(), 0) != cP->capsNum)
+        return 0;
+
+    if (cP->capsNum == 0)
+        return 1;
+
+    return (MxRegex_getCapsOfs(1, &capP, &capLen) && (size_t)(capP - cP->str.data()) == cP->capOfs && capLen == cP->capLen) ? 1 : 0;
+}
+
+
+
+static void Test_fail(const char* whatP, const UInt32 t)
+{
+    errNum++;
+    printf("FAIL %s: /%s/ on \"%s\"\n", whatP, caseV[t].regex.c_str(), caseV[t].str.c_str());
+}
+
+
+
+// threads running (pinning) regex of a set larger than the cache: entries are evicted under readers
+
+static void Test_thread(const UInt32 seed)
+{
+    UInt32 rnd;
+    UInt32 n;
+    UInt32 t;
+
+    rnd = seed * 2654435761UL + 1;
+
+    for (n = 0; n < TEST_THREAD_RUN; n++)
+    {
+        rnd = rnd * 1103515245UL + 12345;
+        t = (rnd >> 8) % ((n & 1) ? 16 : TEST_REGEX_NUM);          // hot set and cold regex
+
+        if (!Test_run(t))
+            Test_fail("thread", t);
+    }
+}
+
+
+
+
+int main()
+{
+    std::vector<std::thread> threadV;
+    REGEXCACHE_STATS stats0;
+    REGEXCACHE_STATS stats;
+    UInt32 t;
+    UInt32 n;
+
+    MxRegex_init();
+    Test_cases();
+
+    // hot set: one miss each regex, then hits
+
+    MxRegexCache_getStats(&stats0);
+
+    for (n = 0; n < 10; n++)
+    {
+        for (t = 0; t < 16; t++)
+        {
+            if (!Test_run(t))
+                Test_fail("hot set", t);
+        }
+    }
+
+    MxRegexCache_getStats(&stats);
+    if (stats.missNum - stats0.missNum != 16 || stats.hitNum - stats0.hitNum != 16 * 9 || stats.evictNum != stats0.evictNum || stats.entryNum != 16)
+    {
+        errNum++;
+        printf("FAIL hot set counters: %u miss %u hit %u evict %u entries\n", stats.missNum - stats0.missNum, stats.hitNum - stats0.hitNum, stats.evictNum - stats0.evictNum, stats.entryNum);
+    }
+
+    // same regex string at another ptr is a hit, same regex with other mode a miss
+
+    {
+        std::string regex = caseV[0].regex;
+        std::string upper = "KEY0=1";
+
+        MxRegexCache_getStats(&stats0);
+        if (MxRegex_len(regex.c_str(), caseV[0].str.data(), caseV[0].str.size(), 0) != caseV[0].capsNum)
+            Test_fail("other ptr", 0);
+        if (MxRegex(regex.c_str(), upper.c_str(), 0) != 0 || MxRegex(regex.c_str(), upper.c_str(), REGEXMODE_CASE_INSENSITIVE) != 2)
+            Test_fail("mode", 0);
+
+        MxRegexCache_getStats(&stats);
+        if (stats.hitNum - stats0.hitNum != 2 || stats.missNum - stats0.missNum != 1)
+        {
+            errNum++;
+            printf("FAIL ptr and mode counters: %u hit %u miss\n", stats.hitNum - stats0.hitNum, stats.missNum - stats0.missNum);
+        }
+    }
+
+    // more regex than the cache holds: evictions, results still right on the second pass
+
+    MxRegexCache_getStats(&stats0);
+
+    for (n = 0; n < 2; n++)
+    {
+        for (t = 0; t < TEST_REGEX_NUM; t++)
+        {
+            if (!Test_run(t))
+                Test_fail("evict", t);
+        }
+    }
+
+    MxRegexCache_getStats(&stats);
+    if (stats.evictNum - stats0.evictNum < TEST_REGEX_NUM || stats.entryNum > stats.entryMax || stats.entryMax < CACHE_MAX_ENTRY)
+    {
+        errNum++;
+        printf("FAIL evict counters: %u evict %u entries of %u\n", stats.evictNum - stats0.evictNum, stats.entryNum, stats.entryMax);
+    }
+
+    // threads
+
+    for (t = 0; t < TEST_THREAD_NUM; t++)
+        threadV.push_back(std::thread(Test_thread, t));
+    for (t = 0; t < TEST_THREAD_NUM; t++)
+        threadV[t].join();
+
+    MxRegexCache_getStats(&stats);
+    printf("cacheTest: %u hit %u miss %u evict %u entries of %u, %u failed\n", stats.hitNum, stats.missNum, stats.evictNum, stats.entryNum, stats.entryMax, errNum.load());
+
+    return errNum != 0;
+}
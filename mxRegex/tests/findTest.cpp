@@ -0,0 +1,136 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// MxRegex_findBegin() / MxRegex_findNext() test
+// Matches found (empty ones too, e.g. a* on "") must be the expected spans, on backtracking, memo and Pike VM engines.
+//
+// usage: findTest (ret 0 if all passed)
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../mxRegex.h"
+
+
+
+#define MAX_TEST_SPAN 8
+
+typedef struct
+{
+    const char* regexP;
+    const char* strP;
+    UInt16 mode;
+    int span[MAX_TEST_SPAN * 2 + 1];                // expected match ofs, len pairs, -1 terminated
+
+} TEST_CASE;
+
+
+
+static const TEST_CASE C_CASE[] =
+{
+    { "a*", "", 0, { 0, 0, -1 } },
+    { "a*", "baa", 0, { 0, 0, 1, 2, 3, 0, -1 } },
+    { "a*", "aaa", 0, { 0, 3, 3, 0, -1 } },
+    { "x*", "ab", 0, { 0, 0, 1, 0, 2, 0, -1 } },
+    { "x", "", 0, { -1 } },
+    { "x", "abc", 0, { -1 } },
+    { "(\\d+)", "a1 22 333", 0, { 1, 1, 3, 2, 6, 3, -1 } },
+    { "\\bab", "ab ab abab", 0, { 0, 2, 3, 2, 6, 2, -1 } },
+    { "^\\w+", "ab\ncd\n\nef", REGEXMODE_MULTILINE, { 0, 2, 3, 2, 7, 2, -1 } },
+    { "^\\w+", "ab\ncd", 0, { 0, 2, -1 } },
+    { "b|", "abc", 0, { 0, 0, 1, 1, 2, 0, 3, 0, -1 } },
+    { "aa", "aaaaa", 0, { 0, 2, 2, 2, -1 } },
+    { "[a-z]+@[a-z]+\\.com", "x@y.com, ab@cd.com; e@f.org", 0, { 0, 7, 9, 9, -1 } },
+};
+
+static const UInt16 C_ENGINE[] = { 0, REGEXMODE_MEMO, REGEXMODE_LINEAR };
+
+static MXREGEX_M m;                                 // zero initialized
+static REGEXPROG prog;
+
+
+
+
+int main()
+{
+    REGEXSPAN caps[MAX_CAPS];
+    REGEXITER it;
+    const TEST_CASE* cP;
+    UInt32 errNum;
+    UInt32 checkNum;
+    UInt16 engine;
+    UInt16 n;
+    UInt8 capsNum;
+
+    MxRegex_init();
+    errNum = checkNum = 0;
+
+    for (cP = C_CASE; cP < C_CASE + sizeof(C_CASE) / sizeof(C_CASE[0]); cP++)
+    {
+        for (engine = 0; engine < sizeof(C_ENGINE) / sizeof(C_ENGINE[0]); engine++)
+        {
+            if (MxRegex_compile(cP->regexP, cP->mode | C_ENGINE[engine], &prog) != REGEXSTS_OK)
+            {
+                errNum++;
+                printf("FAIL /%s/ mode %x compile error %u\n", cP->regexP, cP->mode | C_ENGINE[engine], prog.retSts);
+                continue;
+            }
+
+            MxRegex_findBegin(&it, &prog, cP->strP, strlen(cP->strP), caps);
+
+            for (n = 0; (capsNum = MxRegex_findNext(&m, &it)) != 0; n++)
+            {
+                if (n >= MAX_TEST_SPAN || cP->span[n * 2] < 0 || caps[0].ofs != (size_t)cP->span[n * 2] || caps[0].len != (size_t)cP->span[n * 2 + 1])
+                {
+                    errNum++;
+                    printf("FAIL /%s/ on \"%s\" mode %x: match %u at %zu,%zu\n", cP->regexP, cP->strP, cP->mode | C_ENGINE[engine], n, caps[0].ofs, caps[0].len);
+                    break;
+                }
+
+                if (capsNum > 1 && (caps[1].ofs != caps[0].ofs || caps[1].len != caps[0].len))     // (\d+): capture is the match
+                {
+                    errNum++;
+                    printf("FAIL /%s/ on \"%s\" mode %x: capture %zu,%zu\n", cP->regexP, cP->strP, cP->mode | C_ENGINE[engine], caps[1].ofs, caps[1].len);
+                    break;
+                }
+                checkNum++;
+            }
+
+            if (capsNum == 0 && n < MAX_TEST_SPAN && cP->span[n * 2] >= 0)
+            {
+                errNum++;
+                printf("FAIL /%s/ on \"%s\" mode %x: %u matches, more expected\n", cP->regexP, cP->strP, cP->mode | C_ENGINE[engine], n);
+            }
+
+            if (MxRegex_findNext(&m, &it) != 0)                         // done stays done
+            {
+                errNum++;
+                printf("FAIL /%s/ on \"%s\" mode %x: match after end\n", cP->regexP, cP->strP, cP->mode | C_ENGINE[engine]);
+            }
+        }
+    }
+
+    printf("findTest: %u matches checked, %u failed\n", checkNum, errNum);
+
+    MxRegex_release_ex(&m);
+    return errNum != 0;
+}
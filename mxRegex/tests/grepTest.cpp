@@ -0,0 +1,253 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// mxgrep tool test (POSIX)
+// mxgrep runs on a temp file of a few 1M chunks (lines across chunk edges, last line without \n):
+// output of plain, -c, -o and -i search, on 1..n threads, and exit code must be the ones of the regex on each line.
+//
+// usage: grepTest mxgrepPath (ret 0 if all passed)
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../mxRegex.h"
+
+
+
+#define TEST_FILE_LEN (3500 * 1024)                 // about 3.5 chunks of mxgrep
+
+typedef struct
+{
+    const char* regexP;                             // no ' (shell quoted)
+    const char* optP;                               // mxgrep options
+
+} TEST_CASE;
+
+
+
+static const TEST_CASE C_CASE[] =
+{
+    { "GET (\\S+) HTTP", "" },
+    { "GET (\\S+) HTTP", "-c" },
+    { "(\\d+)\\.(\\d+)\\.(\\d+)\\.(\\d+)", "-o" },
+    { "id=\\d+", "-o" },
+    { "error", "-i" },
+    { "error", "-i -c" },
+    { "^$", "-c" },
+    { "no such line", "" },
+};
+
+static MXREGEX_M m;                                 // zero initialized
+static REGEXPROG prog;
+
+
+
+
+// random log lines, some empty
+
+static std::string Test_file()
+{
+    static const char* const C_PATH[] = { "/", "/index.html", "/api?id=42&id=7", "/img/logo.png" };
+    std::string data;
+
+    srand(1);
+
+    while (data.size() < TEST_FILE_LEN)
+    {
+        switch (rand() % 5)
+        {
+        case 0:
+            break;                                                      // empty line
+        case 1:
+            data += "ERROR at id=" + std::to_string(rand()) + ", Error again";
+            break;
+        default:
+            data += std::to_string(rand() % 256) + "." + std::to_string(rand() % 256) + "." + std::to_string(rand() % 256) + "." + std::to_string(rand() % 256);
+            data += " \"GET ";
+            data += C_PATH[rand() % 4];
+            data += " HTTP/1.1\" 200";
+            break;
+        }
+        data += '\n';
+    }
+
+    data += "last error id=1";                                          // without \n
+
+    return data;
+}
+
+
+
+// expected mxgrep output: regex on each line
+// ret
+//  nr of matching lines
+
+static long long Test_expected(const std::string& data, const TEST_CASE* cP, std::string* outP)
+{
+    REGEXSPAN caps[MAX_CAPS];
+    REGEXITER it;
+    UInt16 mode;
+    long long matchNum;
+    size_t lineOfs;
+    size_t eolOfs;
+    UInt8 isOnlyCaps;
+    UInt8 n;
+    UInt8 t;
+
+    mode = REGEXMODE_SINGLELINE | REGEXMODE_FALLBACK;
+    if (strstr(cP->optP, "-i") != 0)
+        mode |= REGEXMODE_CASE_INSENSITIVE;
+    isOnlyCaps = (strstr(cP->optP, "-o") != 0);
+
+    MxRegex_compile(cP->regexP, mode, &prog);
+    matchNum = 0;
+    outP->clear();
+
+    for (lineOfs = 0; lineOfs < data.size(); lineOfs = eolOfs + 1)
+    {
+        if ((eolOfs = data.find('\n', lineOfs)) == std::string::npos)
+            eolOfs = data.size();
+
+        if (isOnlyCaps)
+        {
+            MxRegex_findBegin(&it, &prog, data.data() + lineOfs, eolOfs - lineOfs, caps);
+            for (n = 0; (t = MxRegex_findNext(&m, &it)) != 0; n = 1)
+            {
+                for (UInt8 t1 = (t > 1) ? 1 : 0; t1 < t; t1++)          // captures tab separated, or the match
+                {
+                    if (t1 > 1)
+                        *outP += '\t';
+                    outP->append(data, lineOfs + caps[t1].ofs, caps[t1].len);
+                }
+                *outP += '\n';
+            }
+            matchNum += n;
+        }
+        else if (MxRegex_exec_len_ex(&m, &prog, data.data() + lineOfs, eolOfs - lineOfs))
+        {
+            matchNum++;
+            outP->append(data, lineOfs, eolOfs - lineOfs);
+            *outP += '\n';
+        }
+    }
+
+    if (strstr(cP->optP, "-c") != 0)
+        *outP = std::to_string(matchNum) + "\n";
+
+    return matchNum;
+}
+
+
+
+// run mxgrep, read its output
+// ret
+//  exit code, -1 not run
+
+static int Test_grep(const char* grepP, const TEST_CASE* cP, const UInt16 threadNum, const char* fileP, std::string* outP)
+{
+    std::string cmd;
+    char buf[1 << 16];
+    FILE* pipeP;
+    size_t n;
+    int sts;
+
+    cmd = std::string(grepP) + " " + cP->optP + " -j " + std::to_string(threadNum) + " '" + cP->regexP + "' " + fileP + " 2>/dev/null";
+
+    if ((pipeP = popen(cmd.c_str(), "r")) == 0)
+        return -1;
+
+    outP->clear();
+    while ((n = fread(buf, 1, sizeof(buf), pipeP)) > 0)
+        outP->append(buf, n);
+
+    sts = pclose(pipeP);
+    return WIFEXITED(sts) ? WEXITSTATUS(sts) : -1;
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+    static const UInt16 C_THREAD[] = { 1, 3, 8 };
+    std::string data;
+    std::string exp;
+    std::string out;
+    std::string fileName;
+    const TEST_CASE* cP;
+    const char* tmpP;
+    long long expMatchNum;
+    UInt32 errNum;
+    UInt16 t;
+    int sts;
+    int fd;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: grepTest mxgrepPath\n");
+        return 2;
+    }
+
+    MxRegex_init();
+    errNum = 0;
+
+    if ((tmpP = getenv("TMPDIR")) == 0 || *tmpP == 0)
+        tmpP = "/tmp";
+    fileName = std::string(tmpP) + "/grepTestXXXXXX";
+
+    data = Test_file();
+    if ((fd = mkstemp(&fileName[0])) < 0 || write(fd, data.data(), data.size()) != (ssize_t)data.size())
+    {
+        printf("FAIL can't write %s\n", fileName.c_str());
+        return 1;
+    }
+    close(fd);
+
+    for (cP = C_CASE; cP < C_CASE + sizeof(C_CASE) / sizeof(C_CASE[0]); cP++)
+    {
+        expMatchNum = Test_expected(data, cP, &exp);
+
+        for (t = 0; t < sizeof(C_THREAD) / sizeof(C_THREAD[0]); t++)
+        {
+            sts = Test_grep(argv[1], cP, C_THREAD[t], fileName.c_str(), &out);
+
+            if (sts != (expMatchNum ? 0 : 1) || out != exp)
+            {
+                errNum++;
+                printf("FAIL mxgrep %s /%s/, %u threads: exit %d, %zu output bytes, expected %zu (%lld lines)\n", cP->optP, cP->regexP, C_THREAD[t], sts, out.size(), exp.size(), expMatchNum);
+            }
+        }
+    }
+
+    unlink(fileName.c_str());
+
+    printf("grepTest: %zu bytes, %u failed\n", data.size(), errNum);
+
+    MxRegex_release_ex(&m);
+    return errNum != 0;
+}
@@ -0,0 +1,264 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// MxRegex_lines() test
+// Lines of random len and line ends (\n \r\n \r); at chunk edges (LINES_GRAIN) a matching line straddles the edge,
+// a \r\n is split by it, or a line begins at it after a lone \r. Matching lines and captures, on 1..n threads and with few results, must be the ones
+// of MxRegex_exec_len_ex() on each line.
+//
+// usage: linesTest (ret 0 if all passed)
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../mxRegexBatch.h"
+
+
+
+#define TEST_STR_LEN (LINES_GRAIN * 10 + 100)
+
+typedef struct
+{
+    const char* regexP;
+    UInt16 mode;
+
+} TEST_CASE;
+
+
+
+static const TEST_CASE C_CASE[] =
+{
+    { "^(\\w+)=(\\d+)$", 0 },
+    { "^(\\w+)=(\\d+)$", REGEXMODE_MULTILINE },
+    { "=(\\d{3,})", 0 },
+    { "\\bedge\\b", REGEXMODE_CASE_INSENSITIVE },
+    { "z$", 0 },
+    { "(\\d{3,})", 0 },                                                   // tail of a line across chunk edge would match
+    { "^\\d*$", 0 },                                                      // empty line: \r\n across chunk edge is one line end
+};
+
+static const char* const C_EOL[] = { "\n", "\r\n", "\r" };
+
+static MXREGEX_M m;                                 // zero initialized
+static REGEXPROG prog;
+static UInt32 errNum;
+
+
+
+
+// random lines, a matching line across each chunk edge (or \r\n split by it)
+// ret
+//  nr of matching lines straddling a chunk edge
+
+static UInt32 Test_str(std::string* strP)
+{
+    static const char C_CHAR[] = "abcz=0123456789 ";
+    size_t edge;
+    size_t n;
+    UInt32 straddleNum;
+
+    srand(1);
+    straddleNum = 0;
+
+    while (strP->size() < TEST_STR_LEN)
+    {
+        edge = (strP->size() / LINES_GRAIN + 1) * LINES_GRAIN;
+
+        if (edge - strP->size() <= 64 && edge - strP->size() >= 8)
+        {
+            if ((edge / LINES_GRAIN) % 3 == 0)                                  // \r at edge - 1, \n at edge
+            {
+                strP->append(edge - 1 - strP->size(), 'z');
+                *strP += "\r\nedge=12345\n";
+            }
+            else if ((edge / LINES_GRAIN) % 3 == 1)                             // lone \r at edge - 1: line begins at edge
+            {
+                strP->append(edge - 1 - strP->size(), 'z');
+                *strP += "\redge=123\r";
+            }
+            else                                                                // line begins at edge - 6
+            {
+                strP->append(edge - 7 - strP->size(), 'b');
+                *strP += (strP->size() % 2) ? "\n" : "\r";
+                *strP += "Edge=1234567890";
+                *strP += C_EOL[edge / LINES_GRAIN % 3];
+                straddleNum++;
+            }
+            continue;
+        }
+
+        for (n = rand() % 40; n > 0; n--)
+            *strP += C_CHAR[rand() % (sizeof(C_CHAR) - 1)];
+
+        if (rand() % 4 == 0)
+            *strP += "key=" + std::to_string(rand());
+
+        *strP += C_EOL[rand() % 3];
+    }
+
+    strP->resize(strP->size() - 1);                                             // last line without line end (or \r of \r\n)
+
+    return straddleNum;
+}
+
+
+
+// expected matching lines: regex on each line
+
+static void Test_expected(const std::string& str, std::vector<LINES_RESULT>* resP)
+{
+    LINES_RESULT r;
+    size_t lineOfs;
+    size_t eolOfs;
+    UInt8 capsNum;
+    UInt8 t;
+
+    for (lineOfs = 0; lineOfs < str.size(); )
+    {
+        eolOfs = str.find_first_of("\r\n", lineOfs);
+        if (eolOfs == std::string::npos)
+            eolOfs = str.size();
+
+        if ((capsNum = MxRegex_exec_len_ex(&m, &prog, str.data() + lineOfs, eolOfs - lineOfs)) != 0)
+        {
+            memset(&r, 0, sizeof(r));
+            r.lineOfs = lineOfs;
+            r.lineLen = eolOfs - lineOfs;
+            r.capsNum = capsNum;
+            for (t = 0; t < capsNum; t++)
+            {
+                r.caps[t].ofs = m.caps[t].strP - str.data();
+                r.caps[t].len = m.caps[t].len;
+            }
+            resP->push_back(r);
+        }
+
+        lineOfs = eolOfs + ((eolOfs + 1 < str.size() && str[eolOfs] == '\r' && str[eolOfs + 1] == '\n') ? 2 : 1);
+    }
+}
+
+
+
+// compare n results
+
+static void Test_check(const TEST_CASE* cP, const UInt16 threadNum, const std::vector<LINES_RESULT>& expV, const LINES_RESULT* resP, const size_t resNum, const size_t n)
+{
+    size_t r;
+    UInt8 t;
+
+    if (n != ((expV.size() < resNum) ? expV.size() : resNum))
+    {
+        errNum++;
+        printf("FAIL /%s/ mode %x, %u threads, max %zu: %zu lines, expected %zu\n", cP->regexP, cP->mode, threadNum, resNum, n, expV.size());
+        return;
+    }
+
+    for (r = 0; r < n; r++)
+    {
+        const LINES_RESULT& e = expV[r];
+
+        if (resP[r].lineOfs != e.lineOfs || resP[r].lineLen != e.lineLen || resP[r].capsNum != e.capsNum)
+            break;
+        for (t = 0; t < e.capsNum; t++)
+        {
+            if (resP[r].caps[t].ofs != e.caps[t].ofs || resP[r].caps[t].len != e.caps[t].len)
+                break;
+        }
+        if (t != e.capsNum)
+            break;
+    }
+
+    if (r != n)
+    {
+        errNum++;
+        printf("FAIL /%s/ mode %x, %u threads, max %zu: line %zu at %zu, expected at %zu\n", cP->regexP, cP->mode, threadNum, resNum, r, resP[r].lineOfs, expV[r].lineOfs);
+    }
+}
+
+
+
+
+int main()
+{
+    static const UInt16 C_THREAD[] = { 1, 2, 4, 0 };
+    static const size_t C_RES[] = { 1, 10, TEST_STR_LEN };
+    std::vector<LINES_RESULT> expV;
+    std::vector<LINES_RESULT> resV;
+    std::string str;
+    const TEST_CASE* cP;
+    UInt32 straddleNum;
+    UInt32 found;
+    size_t n;
+    size_t r;
+    UInt16 t;
+    UInt16 k;
+
+    MxRegex_init();
+    errNum = 0;
+    straddleNum = Test_str(&str);
+
+    for (cP = C_CASE; cP < C_CASE + sizeof(C_CASE) / sizeof(C_CASE[0]); cP++)
+    {
+        if (MxRegex_compile(cP->regexP, cP->mode, &prog) != REGEXSTS_OK)
+        {
+            errNum++;
+            printf("FAIL /%s/ compile error %u\n", cP->regexP, prog.retSts);
+            continue;
+        }
+
+        expV.clear();
+        Test_expected(str, &expV);
+
+        for (t = 0; t < sizeof(C_THREAD) / sizeof(C_THREAD[0]); t++)
+        {
+            for (k = 0; k < sizeof(C_RES) / sizeof(C_RES[0]); k++)
+            {
+                resV.assign(expV.size() + 1, LINES_RESULT());
+                n = MxRegex_lines(&prog, str.data(), str.size(), resV.data(), (C_RES[k] < resV.size()) ? C_RES[k] : resV.size(), C_THREAD[t]);
+                Test_check(cP, C_THREAD[t], expV, resV.data(), (C_RES[k] < resV.size()) ? C_RES[k] : resV.size(), n);
+            }
+        }
+
+        if (cP == C_CASE)                                                       // matching lines across chunk edges are found
+        {
+            for (r = found = 0; r < expV.size(); r++)
+            {
+                if (expV[r].lineOfs / LINES_GRAIN != (expV[r].lineOfs + expV[r].lineLen - 1) / LINES_GRAIN && str[expV[r].lineOfs] == 'E')
+                    found++;
+            }
+
+            if (found != straddleNum || straddleNum == 0)
+            {
+                errNum++;
+                printf("FAIL lines across chunk edge: %u, expected %u\n", found, straddleNum);
+            }
+        }
+    }
+
+    printf("linesTest: %zu bytes, %u lines across chunk edges, %u failed\n", str.size(), straddleNum, errNum);
+
+    MxRegex_release_ex(&m);
+    return errNum != 0;
+}
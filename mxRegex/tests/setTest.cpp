@@ -0,0 +1,246 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// MxRegexSet_exec() / MxRegexSet_first() test
+// Patterns matching each str must be the ones matched by separate MxRegex_exec_len_ex() calls, each pattern compiled alone.
+// Same on literal prefilter MxRegexSet_prefilter(), and on a large set (literals sharing prefixes and suffixes, patterns without literal).
+//
+// usage: setTest (ret 0 if all passed)
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../mxRegexSet.h"
+
+
+
+typedef struct
+{
+    const char* regexP;
+    UInt16 mode;
+
+} TEST_PATTERN;
+
+
+
+static const TEST_PATTERN C_PATTERN[] =
+{
+    { "^\\s*(GET|POST)\\s+(\\S+)\\s+HTTP/(\\d)\\.(\\d)", 0 },
+    { "[a-z0-9._%-]+@[a-z0-9.-]+\\.[a-z]{2,6}", REGEXMODE_CASE_INSENSITIVE },
+    { "\\d+(\\.\\d+){3}", 0 },
+    { "error", REGEXMODE_CASE_INSENSITIVE },
+    { "^error", 0 },
+    { "error$", 0 },
+    { "^\\w+:", REGEXMODE_MULTILINE },
+    { "\\bid\\b", 0 },
+    { "(a|b)*c", 0 },
+    { "x*", 0 },
+    { "^$", 0 },
+    { "[^a-z ]{3}", 0 },
+    { "warn(ing)?", REGEXMODE_CASE_INSENSITIVE },
+    { "id=\\d{2,4}\\b", 0 },
+    { "\\.com$", REGEXMODE_MULTILINE },
+};
+
+static const char* const C_WORD[] =
+{
+    "GET", "POST", " ", "/index.html", "HTTP/1.0", "user@host.com", "1.12.123.123", "ERROR", "error", "Warning", "\n",
+    "id", "id=123", "id=7", "ab", "c", "x", "key:", "ABC", ".com", "\r\n",
+};
+
+#define LARGE_SET_KEY 300                       // large set: key<n>=\d+ patterns (more than 64, prefilter on)
+
+static MXREGEX_M m;                                 // zero initialized
+
+
+
+
+// random str of words
+static std::string Test_str()
+{
+    std::string str;
+    int n;
+
+    for (n = rand() % 8; n > 0; n--)
+        str += C_WORD[rand() % (sizeof(C_WORD) / sizeof(C_WORD[0]))];
+
+    return str;
+}
+
+
+
+// random str of large set words: key<n>=<digits>
+static std::string Test_keyStr()
+{
+    std::string str;
+    int n;
+
+    for (n = rand() % 6; n > 0; n--)
+    {
+        str += (rand() % 2) ? "key" : "KEY";
+        str += std::to_string(rand() % (LARGE_SET_KEY + 20));
+        str += (rand() % 4) ? "=" : ":";
+        str += std::to_string(rand() % 1000);
+        str += (rand() % 2) ? " " : "x";
+    }
+
+    return str;
+}
+
+
+
+// compare set results with separate regex calls
+// ret
+//  nr of failed str
+
+static UInt32 Test_set(const MXREGEX_SET* setP, const std::vector<REGEXPROG>& progV, const std::vector<std::string>& strV, const char* whatP)
+{
+    std::vector<UInt16> idV;
+    std::vector<UInt16> expV;
+    UInt32 errNum;
+    UInt32 matchNum;
+    UInt16 idNum;
+    UInt16 first;
+    UInt16 t;
+    size_t s;
+
+    idV.resize(setP->progNum);
+    errNum = matchNum = 0;
+
+    for (s = 0; s < strV.size(); s++)
+    {
+        const std::string& str = strV[s];
+
+        expV.clear();
+        for (t = 0; t < progV.size(); t++)
+        {
+            if (MxRegex_exec_len_ex(&m, &progV[t], str.data(), str.size()) != 0)
+                expV.push_back(t);
+        }
+
+        idNum = MxRegexSet_exec(setP, str.data(), str.size(), idV.data());
+        first = MxRegexSet_first(setP, str.data(), str.size());
+
+        if (idNum != expV.size() || !std::equal(expV.begin(), expV.end(), idV.begin()) || first != (expV.empty() ? SET_NO_MATCH : expV[0]))
+        {
+            errNum++;
+            printf("FAIL %s \"%s\": %u patterns, first %u, expected %zu, first %d\n", whatP, str.c_str(), idNum, first, expV.size(), expV.empty() ? -1 : expV[0]);
+        }
+        matchNum += idNum;
+    }
+
+    printf("setTest %s: %u patterns, %zu str, %u matches, %u failed\n", whatP, setP->progNum, strV.size(), matchNum, errNum);
+
+    return errNum;
+}
+
+
+
+
+int main()
+{
+    std::vector<REGEXPROG> progV;
+    std::vector<std::string> strV;
+    std::string regex;
+    MXREGEX_SET set;
+    UInt32 errNum;
+    UInt16 t;
+    size_t s;
+
+    MxRegex_init();
+    MxRegexSet_init(&set);
+    errNum = 0;
+
+    progV.resize(sizeof(C_PATTERN) / sizeof(C_PATTERN[0]));
+
+    for (t = 0; t < progV.size(); t++)
+    {
+        if (MxRegex_compile(C_PATTERN[t].regexP, C_PATTERN[t].mode, &progV[t]) != REGEXSTS_OK || MxRegexSet_add(&set, C_PATTERN[t].regexP, C_PATTERN[t].mode) != REGEXSTS_OK)
+        {
+            printf("FAIL /%s/ compile error\n", C_PATTERN[t].regexP);
+            return 1;
+        }
+    }
+
+    srand(1);
+    strV.push_back("");
+    strV.push_back("GET /index.html HTTP/1.0");
+    strV.push_back("error");
+    for (s = 0; s < 2000; s++)
+        strV.push_back(Test_str());
+
+    errNum += Test_set(&set, progV, strV, "small");
+
+    if (MxRegexSet_prefilter(&set) == 0)
+    {
+        errNum++;
+        printf("FAIL small set: no literal\n");
+    }
+    errNum += Test_set(&set, progV, strV, "small prefilter");
+
+    // large set: key1 is a prefix of key10, key0=1 a suffix of key10=1, case insensitive literals, last pattern without literal
+
+    MxRegexSet_free(&set);
+    MxRegexSet_init(&set);
+    progV.clear();
+    progV.resize(LARGE_SET_KEY + 2);
+
+    for (t = 0; t < LARGE_SET_KEY + 2; t++)
+    {
+        if (t == LARGE_SET_KEY)
+            regex = "^\\w+\\d=\\d{3}\\b";
+        else if (t == LARGE_SET_KEY + 1)
+            regex = "\\d{3}[a-z]";
+        else
+            regex = "key" + std::to_string(t) + ((t % 3) ? "=\\d+" : "[=:]1\\d*");
+
+        if (MxRegex_compile(regex.c_str(), (t % 2) ? REGEXMODE_CASE_INSENSITIVE : 0, &progV[t]) != REGEXSTS_OK || MxRegexSet_add(&set, regex.c_str(), (t % 2) ? REGEXMODE_CASE_INSENSITIVE : 0) != REGEXSTS_OK)
+        {
+            printf("FAIL /%s/ compile error\n", regex.c_str());
+            return 1;
+        }
+    }
+
+    strV.clear();
+    strV.push_back("");
+    strV.push_back("key1=1");
+    strV.push_back("KEY10=1");
+    for (s = 0; s < 2000; s++)
+        strV.push_back(Test_keyStr());
+
+    errNum += Test_set(&set, progV, strV, "large");
+
+    if (MxRegexSet_prefilter(&set) != LARGE_SET_KEY + 1)
+    {
+        errNum++;
+        printf("FAIL large set: literal of each pattern but the last one expected\n");
+    }
+    errNum += Test_set(&set, progV, strV, "large prefilter");
+
+    MxRegexSet_free(&set);
+    MxRegex_release_ex(&m);
+    return errNum != 0;
+}
@@ -0,0 +1,221 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// MxRegex_streamBegin() / Feed() / End() test
+// Input str fed whole, split in two at every offset (inside the match too) and one char at a time:
+// match and captures must be the ones of MxRegex_exec_len_ex() on the same REGEXMODE_LINEAR regex.
+//
+// usage: streamTest (ret 0 if all passed)
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../mxRegex.h"
+
+
+
+typedef struct
+{
+    const char* regexP;
+    const char* strP;
+    UInt16 mode;
+
+} TEST_CASE;
+
+
+
+static const TEST_CASE C_CASE[] =
+{
+    { "(\\d+)-(\\d+)", "id 123-4567 x", 0 },
+    { "([a-z0-9._%-]+)@([a-z0-9.-]+\\.[a-z]{2,6})", "mail to: address.ext@gmail.com, thanks", REGEXMODE_CASE_INSENSITIVE },
+    { "^\\s*(GET|POST)\\s+(\\S+)\\s+HTTP/(\\d)\\.(\\d)", " GET /index.html HTTP/1.0\r\n\r\n", 0 },
+    { "(a|b)*c", "xxababababcxx", 0 },
+    { "(wee|week)(knights|night)(s*)", "weeknights", 0 },
+    { "\\bend\\b", "endless bend end", 0 },
+    { "abc$", "abcabc", 0 },
+    { "^line(\\d)$", "first\nline7\nlast", REGEXMODE_MULTILINE },
+    { "x+y", "xxxxxxxxz", 0 },
+    { "a*", "", 0 },
+};
+
+static MXREGEX_M m;                                 // zero initialized
+static REGEXPROG prog;
+static UInt32 errNum;
+
+
+
+
+// match and captures of MxRegex_exec_len_ex(), offsets from strP
+// ret
+//  capsNum
+
+static UInt8 Test_exec(const char* strP, const size_t len, REGEXSPAN* capsP)
+{
+    UInt8 capsNum;
+    char* capP;
+    REGEXOFS capLen;
+    UInt8 n;
+    UInt8 t;
+
+    capsNum = MxRegex_exec_len_ex(&m, &prog, strP, len);
+
+    for (t = n = 0; t < capsNum; t++)
+    {
+        if (!MxRegex_getCapsOfs_ex(&m, t, &capP, &capLen))
+            continue;
+
+        capsP[n].ofs = (size_t)(capP - strP);
+        capsP[n].len = capLen;
+        n++;
+    }
+
+    return n;
+}
+
+
+
+// stream str in chunks of chunkLen, first chunk splitLen (0 same as the others)
+// ret
+//  see MxRegex_streamEnd()
+
+static UInt8 Test_stream(const char* strP, const size_t len, const size_t splitLen, const size_t chunkLen, REGEXSPAN* capsP)
+{
+    MXREGEX_STREAM* sP;
+    size_t ofs;
+    size_t n;
+
+    sP = MxRegex_streamBegin(&prog);
+    if (sP == 0)
+        return 0xff;
+
+    for (ofs = 0; ofs < len; ofs += n)
+    {
+        n = (ofs == 0 && splitLen != 0) ? splitLen : chunkLen;
+        if (n > len - ofs)
+            n = len - ofs;
+
+        if (MxRegex_streamFeed(sP, strP + ofs, n))
+            break;                                      // final, rest of str can't change it
+    }
+
+    return MxRegex_streamEnd(sP, capsP);
+}
+
+
+
+static void Test_check(const TEST_CASE* cP, const char* whatP, const size_t split, const UInt8 expNum, const REGEXSPAN* expP, const UInt8 gotNum, const REGEXSPAN* gotP)
+{
+    UInt8 t;
+
+    if (gotNum == expNum)
+    {
+        for (t = 0; t < expNum; t++)
+        {
+            if (gotP[t].ofs != expP[t].ofs || gotP[t].len != expP[t].len)
+                break;
+        }
+        if (t == expNum)
+            return;
+    }
+
+    errNum++;
+    printf("FAIL /%s/ on \"%s\", %s %zu: %u caps, expected %u", cP->regexP, cP->strP, whatP, split, gotNum, expNum);
+    for (t = 0; t < expNum && t < gotNum; t++)
+        printf(" [%u] %zu,%zu exp %zu,%zu", t, gotP[t].ofs, gotP[t].len, expP[t].ofs, expP[t].len);
+    printf("\n");
+}
+
+
+
+
+int main()
+{
+    REGEXSPAN exp[MAX_CAPS];
+    REGEXSPAN got[MAX_CAPS];
+    const TEST_CASE* cP;
+    UInt8 expNum;
+    UInt8 gotNum;
+    size_t len;
+    size_t split;
+    UInt32 checkNum;
+
+    MxRegex_init();
+    checkNum = 0;
+
+    for (cP = C_CASE; cP < C_CASE + sizeof(C_CASE) / sizeof(C_CASE[0]); cP++)
+    {
+        if (MxRegex_compile(cP->regexP, cP->mode | REGEXMODE_LINEAR, &prog) != REGEXSTS_OK)
+        {
+            errNum++;
+            printf("FAIL /%s/ compile error %u\n", cP->regexP, prog.retSts);
+            continue;
+        }
+
+        len = strlen(cP->strP);
+        expNum = Test_exec(cP->strP, len, exp);
+
+        gotNum = Test_stream(cP->strP, len, 0, len ? len : 1, got);     // whole
+        Test_check(cP, "whole", len, expNum, exp, gotNum, got);
+
+        for (split = 1; split < len; split++)                          // two chunks
+        {
+            gotNum = Test_stream(cP->strP, len, split, len, got);
+            Test_check(cP, "split at", split, expNum, exp, gotNum, got);
+        }
+
+        gotNum = Test_stream(cP->strP, len, 0, 1, got);                 // one char at a time
+        Test_check(cP, "chunk len", 1, expNum, exp, gotNum, got);
+
+        checkNum += (UInt32)len + 1;
+    }
+
+    // known result, split inside the match: "id 12|3-45|67 x"
+
+    if (MxRegex_compile("(\\d+)-(\\d+)", REGEXMODE_LINEAR, &prog) == REGEXSTS_OK)
+    {
+        MXREGEX_STREAM* sP = MxRegex_streamBegin(&prog);
+
+        if (sP != 0)
+        {
+            MxRegex_streamFeed(sP, "id 12", 5);
+            MxRegex_streamFeed(sP, "3-45", 4);
+            MxRegex_streamFeed(sP, "67 x", 4);
+            gotNum = MxRegex_streamEnd(sP, got);
+
+            if (gotNum != 3 || got[0].ofs != 3 || got[0].len != 8 || got[1].ofs != 3 || got[1].len != 3 || got[2].ofs != 7 || got[2].len != 4)
+            {
+                errNum++;
+                printf("FAIL split match: %u caps\n", gotNum);
+            }
+        }
+        else
+        {
+            errNum++;
+            printf("FAIL split match: no stream\n");
+        }
+    }
+
+    printf("streamTest: %u checks, %u failed\n", checkNum, errNum);
+
+    MxRegex_release_ex(&m);
+    return errNum != 0;
+}
@@ -0,0 +1,453 @@
+/*
+
+This file is part of "MxRegex" library
+
+"MxRegex" is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+// mxgrep: grep-like search of large files with the library regex (POSIX: mmap).
+//
+// Each file is memory mapped (sequential access) and split in line aligned chunks, matched on a thread pool,
+// each thread with its own regex data; the compiled regex is shared. Output of chunks is written in input order.
+// Only GREP_WINDOW chunks for each thread are in flight, pages of written chunks are dropped: files may be much larger than RAM.
+//
+// usage: mxgrep [-c] [-o] [-i] [-j threadNum] regex file...
+//  -c      count matching lines only
+//  -o      captures only: for each match, captures tab separated (the match if regex has no captures)
+//  -i      case insensitive
+//  -j      nr of threads, default one for each core
+// Matching lines are prefixed by file name if more than one file. Bytes/s are reported on stderr.
+// exit code 0 some line matched, 1 none, 2 error
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../mxRegex.h"
+
+
+
+#define GREP_CHUNK (1 << 20)                        // nominal chunk size, extended to end of line
+#define GREP_MAX_THREAD 64                          // max worker threads
+#define GREP_WINDOW 4                               // chunks in flight for each thread (output not yet written)
+
+
+
+// chunk of file, line aligned
+
+typedef struct
+{
+    const char* beginP;                             // 1st line
+    const char* endP;                               // after last '\n' (or end of file)
+    std::string out;                                // output lines
+    UInt32 matchNum;                                // nr of matching lines
+    UInt8 isDone;                                   // matched, output may be written
+
+} GREPCHUNK;
+
+
+
+// file search shared data
+
+typedef struct
+{
+    const REGEXPROG* progP;                         // compiled regex
+    const char* nameP;                              // file name prefix of output lines, 0 none
+    UInt8 isCount;                                  // -c
+    UInt8 isOnlyCaps;                               // -o
+
+    const char* dataP;                              // mapped file
+    size_t size;
+    size_t ofs;                                     // begin of next chunk
+
+    UInt32 chunkNum;                                // chunks taken by workers
+    UInt32 chunkOut;                                // chunks written
+    UInt32 slotNum;                                 // chunks in flight, ring of slot[]
+    GREPCHUNK slot[GREP_MAX_THREAD * GREP_WINDOW];
+
+    std::mutex lock;
+    std::condition_variable cond;
+
+} GREPFILE;
+
+
+
+
+
+// append one output line
+
+void Grep_out(GREPFILE* fP, GREPCHUNK* cP, const char* strP, const size_t len)
+{
+    if (fP->nameP)
+    {
+        cP->out += fP->nameP;
+        cP->out += ':';
+    }
+    cP->out.append(strP, len);
+    cP->out += '\n';
+
+    return;
+}
+
+
+
+// match lines of a chunk, save output
+// parm
+//  mP      regex data of worker
+
+void Grep_chunk(GREPFILE* fP, MXREGEX_M* mP, GREPCHUNK* cP)
+{
+    REGEXITER it;
+    REGEXSPAN caps[MAX_CAPS];
+    const char* lineP;
+    const char* eolP;
+    const char* nextP;
+    std::string col;
+    UInt8 n;
+    UInt8 t;
+
+    cP->out.clear();
+    cP->matchNum = 0;
+
+    for (lineP = cP->beginP; lineP < cP->endP; lineP = nextP)
+    {
+        if ((eolP = (const char*)memchr(lineP, '\n', cP->endP - lineP)) == 0)
+            eolP = cP->endP;
+        nextP = eolP + 1;
+
+        if (fP->isOnlyCaps)                                             // -o: all matches of line
+        {
+            MxRegex_findBegin(&it, fP->progP, lineP, eolP - lineP, caps);
+            n = 0;
+            while ((t = MxRegex_findNext(mP, &it)) != 0)
+            {
+                n = 1;
+                col.clear();
+                for (UInt8 t1 = (t > 1) ? 1 : 0; t1 < t; t1++)          // captures, or the match
+                {
+                    if (col.size() || t1 > 1)
+                        col += '\t';
+                    col.append(lineP + caps[t1].ofs, caps[t1].len);
+                }
+                Grep_out(fP, cP, col.data(), col.size());
+            }
+            cP->matchNum += n;
+        }
+        else if (MxRegex_exec_len_ex(mP, fP->progP, lineP, eolP - lineP))
+        {
+            cP->matchNum++;
+            if (!fP->isCount)
+                Grep_out(fP, cP, lineP, eolP - lineP);
+        }
+    }
+
+    return;
+}
+
+
+
+// worker thread: take next chunk, match it, until end of file
+
+void Grep_worker(GREPFILE* fP)
+{
+    MXREGEX_M* mP;
+    GREPCHUNK* cP;
+    const char* endP;
+
+    mP = new MXREGEX_M();                                               // own regex data (zero initialized)
+
+    while (1)
+    {
+        {
+            std::unique_lock<std::mutex> guard(fP->lock);
+
+            fP->cond.wait(guard, [fP] { return fP->ofs >= fP->size || fP->chunkNum - fP->chunkOut < fP->slotNum; });
+            if (fP->ofs >= fP->size)                                    // end of file
+                break;
+
+            cP = &fP->slot[fP->chunkNum++ % fP->slotNum];               // next chunk, to end of line
+            cP->beginP = fP->dataP + fP->ofs;
+            fP->ofs = (fP->size - fP->ofs > GREP_CHUNK) ? fP->ofs + GREP_CHUNK : fP->size;
+            if ((endP = (const char*)memchr(fP->dataP + fP->ofs, '\n', fP->size - fP->ofs)) != 0)
+                fP->ofs = endP + 1 - fP->dataP;
+            else
+                fP->ofs = fP->size;
+            cP->endP = fP->dataP + fP->ofs;
+            cP->isDone = 0;
+        }
+
+        Grep_chunk(fP, mP, cP);
+
+        {
+            std::lock_guard<std::mutex> guard(fP->lock);
+            cP->isDone = 1;
+        }
+        fP->cond.notify_all();
+    }
+
+    MxRegex_release_ex(mP);
+    delete mP;
+    return;
+}
+
+
+
+// search a file: workers match chunks, calling thread writes their output in order
+// parm
+//  nameP       file name
+//  fP          search data, regex and flags set
+//  threadNum   nr of worker threads
+//  retByteNum  RET file size
+// ret
+//  nr of matching lines, -1 file error
+
+long long Grep_file(const char* nameP, GREPFILE* fP, const UInt16 threadNum, size_t* retByteNum)
+{
+    std::thread* threadP[GREP_MAX_THREAD];
+    GREPCHUNK* cP;
+    struct stat st;
+    long long matchNum;
+    size_t pageSize;
+    size_t beginOfs;
+    size_t endOfs;
+    void* mapP;
+    UInt16 threadStarted;
+    UInt16 t;
+    int fd;
+
+    *retByteNum = 0;
+
+    if ((fd = open(nameP, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+    {
+        fprintf(stderr, "mxgrep: %s: %s\n", nameP, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    matchNum = 0;
+    fP->size = (size_t)st.st_size;
+    *retByteNum = fP->size;
+
+    if (fP->size == 0)                                                  // empty file, can't be mapped
+    {
+        close(fd);
+        return 0;
+    }
+
+    if ((mapP = mmap(0, fP->size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        fprintf(stderr, "mxgrep: %s: %s\n", nameP, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);                     // read ahead
+#endif
+    madvise(mapP, fP->size, MADV_SEQUENTIAL);
+
+    fP->dataP = (const char*)mapP;
+    fP->ofs = 0;
+    fP->chunkNum = 0;
+    fP->chunkOut = 0;
+    fP->slotNum = threadNum * GREP_WINDOW;
+
+    for (threadStarted = 0; threadStarted < threadNum; threadStarted++)
+    {
+        try
+        {
+            threadP[threadStarted] = new std::thread(Grep_worker, fP);
+        }
+        catch (...)
+        {
+            break;
+        }
+    }
+
+    if (threadStarted == 0)
+    {
+        fprintf(stderr, "mxgrep: can't start threads\n");
+        munmap(mapP, fP->size);
+        close(fd);
+        return -1;
+    }
+
+    pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+    while (1)                                                           // write chunks in order
+    {
+        {
+            std::unique_lock<std::mutex> guard(fP->lock);
+
+            fP->cond.wait(guard, [fP] { return (fP->chunkOut < fP->chunkNum && fP->slot[fP->chunkOut % fP->slotNum].isDone)
+                || (fP->ofs >= fP->size && fP->chunkOut == fP->chunkNum); });
+            if (fP->chunkOut == fP->chunkNum)                           // all written
+                break;
+            cP = &fP->slot[fP->chunkOut % fP->slotNum];
+        }
+
+        fwrite(cP->out.data(), 1, cP->out.size(), stdout);
+        matchNum += cP->matchNum;
+
+        beginOfs = (cP->beginP - fP->dataP) & ~(pageSize - 1);         // drop pages of chunk (not the one shared with next chunk)
+        endOfs = (cP->endP - fP->dataP) & ~(pageSize - 1);
+        if (endOfs > beginOfs)
+            madvise((char*)mapP + beginOfs, endOfs - beginOfs, MADV_DONTNEED);
+
+        {
+            std::lock_guard<std::mutex> guard(fP->lock);
+            fP->chunkOut++;
+        }
+        fP->cond.notify_all();
+    }
+
+    for (t = 0; t < threadStarted; t++)
+    {
+        threadP[t]->join();
+        delete threadP[t];
+    }
+
+    munmap(mapP, fP->size);
+    close(fd);
+
+    return matchNum;
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+    static char outBuf[1 << 16];
+    static REGEXPROG prog;
+    GREPFILE* fP;
+    const char* regexP;
+    long long matchNum;
+    long long fileMatchNum;
+    unsigned long long byteNum;
+    size_t fileByteNum;
+    double ms;
+    UInt16 mode;
+    UInt16 threadNum;
+    UInt8 isCount;
+    UInt8 isOnlyCaps;
+    UInt8 isError;
+    int argIdx;
+    int fileNum;
+
+    isCount = 0;
+    isOnlyCaps = 0;
+    mode = REGEXMODE_SINGLELINE | REGEXMODE_FALLBACK;                 // a line is not skipped when backtracking gives up
+    threadNum = (UInt16)std::thread::hardware_concurrency();
+
+    for (argIdx = 1; argIdx < argc && argv[argIdx][0] == '-' && argv[argIdx][1]; argIdx++)
+    {
+        if (strcmp(argv[argIdx], "-c") == 0)
+            isCount = 1;
+        else if (strcmp(argv[argIdx], "-o") == 0)
+            isOnlyCaps = 1;
+        else if (strcmp(argv[argIdx], "-i") == 0)
+            mode |= REGEXMODE_CASE_INSENSITIVE;
+        else if (strcmp(argv[argIdx], "-j") == 0 && argIdx + 1 < argc)
+            threadNum = (UInt16)atoi(argv[++argIdx]);
+        else
+            break;
+    }
+
+    if (argc - argIdx < 2)
+    {
+        fprintf(stderr, "usage: mxgrep [-c] [-o] [-i] [-j threadNum] regex file...\n");
+        return 2;
+    }
+
+    if (threadNum == 0)
+        threadNum = 1;
+    if (threadNum > GREP_MAX_THREAD)
+        threadNum = GREP_MAX_THREAD;
+
+    if (!isOnlyCaps)                                                    // match only: lazy DFA if possible
+        mode |= REGEXMODE_NOCAPS;
+
+    MxRegex_init();
+
+    regexP = argv[argIdx++];
+    if (MxRegex_compile(regexP, mode, &prog) != REGEXSTS_OK)
+    {
+        fprintf(stderr, "mxgrep: regex error %d at offset %u\n", (int)prog.retSts, (unsigned)prog.retRegexErrOfs);
+        return 2;
+    }
+
+    setvbuf(stdout, outBuf, _IOFBF, sizeof(outBuf));
+
+    fP = new GREPFILE();
+    fP->progP = &prog;
+    fP->isCount = isCount;
+    fP->isOnlyCaps = isOnlyCaps;
+
+    fileNum = argc - argIdx;
+    matchNum = 0;
+    byteNum = 0;
+    isError = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (; argIdx < argc; argIdx++)
+    {
+        fP->nameP = (fileNum > 1) ? argv[argIdx] : 0;
+
+        if ((fileMatchNum = Grep_file(argv[argIdx], fP, threadNum, &fileByteNum)) < 0)
+        {
+            isError = 1;
+            continue;
+        }
+
+        if (isCount)
+        {
+            if (fP->nameP)
+                printf("%s:", fP->nameP);
+            printf("%lld\n", fileMatchNum);
+        }
+
+        matchNum += fileMatchNum;
+        byteNum += fileByteNum;
+    }
+
+    fflush(stdout);
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "mxgrep: %llu bytes, %lld matching lines, %.1f ms, %.1f MB/s, %u threads\n",
+        byteNum, matchNum, ms, ms > 0 ? byteNum / ms / 1000.0 : 0.0, (unsigned)threadNum);
+
+    delete fP;
+
+    if (isError)
+        return 2;
+    return matchNum ? 0 : 1;
+}